@@ -0,0 +1,681 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ImageMetrics.h"
+
+#include <donut/core/log.h>
+
+#include <stb_image.h>
+#include <stb_image_write.h>
+#include <tinyexr.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define IMAGE_METRICS_USE_SSE 1
+#else
+#define IMAGE_METRICS_USE_SSE 0
+#endif
+
+using namespace donut;
+
+static constexpr float c_RelMseEpsilon = 0.01f;
+static constexpr float c_Pi = 3.14159265358979f;
+
+void Image::Resize(uint32_t newWidth, uint32_t newHeight)
+{
+    width = newWidth;
+    height = newHeight;
+
+    for (auto& channel : channels)
+        channel.resize(GetPixelCount());
+}
+
+bool LoadImageFile(const std::string& fileName, Image& image)
+{
+    std::string extension = std::filesystem::path(fileName).extension().generic_string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+
+    if (extension == ".exr")
+    {
+        float* rgba = nullptr;
+        int width = 0, height = 0;
+        const char* errorMessage = nullptr;
+
+        if (LoadEXR(&rgba, &width, &height, fileName.c_str(), &errorMessage) != TINYEXR_SUCCESS)
+        {
+            log::error("Couldn't load '%s': %s", fileName.c_str(), errorMessage ? errorMessage : "unknown error");
+            if (errorMessage)
+                FreeEXRErrorMessage(errorMessage);
+            return false;
+        }
+
+        image.Resize(uint32_t(width), uint32_t(height));
+        image.hdr = true;
+
+        for (size_t pixel = 0; pixel < image.GetPixelCount(); pixel++)
+        {
+            for (int channel = 0; channel < 3; channel++)
+                image.channels[channel][pixel] = rgba[pixel * 4 + channel];
+        }
+
+        free(rgba);
+        return true;
+    }
+
+    int width = 0, height = 0, originalChannels = 0;
+
+    if (stbi_is_hdr(fileName.c_str()))
+    {
+        float* data = stbi_loadf(fileName.c_str(), &width, &height, &originalChannels, 3);
+        if (!data)
+        {
+            log::error("Couldn't load '%s': %s", fileName.c_str(), stbi_failure_reason());
+            return false;
+        }
+
+        image.Resize(uint32_t(width), uint32_t(height));
+        image.hdr = true;
+
+        for (size_t pixel = 0; pixel < image.GetPixelCount(); pixel++)
+        {
+            for (int channel = 0; channel < 3; channel++)
+                image.channels[channel][pixel] = data[pixel * 3 + channel];
+        }
+
+        stbi_image_free(data);
+        return true;
+    }
+
+    stbi_uc* data = stbi_load(fileName.c_str(), &width, &height, &originalChannels, 3);
+    if (!data)
+    {
+        log::error("Couldn't load '%s': %s", fileName.c_str(), stbi_failure_reason());
+        return false;
+    }
+
+    image.Resize(uint32_t(width), uint32_t(height));
+    image.hdr = false;
+
+    for (size_t pixel = 0; pixel < image.GetPixelCount(); pixel++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+            image.channels[channel][pixel] = float(data[pixel * 3 + channel]) * (1.f / 255.f);
+    }
+
+    stbi_image_free(data);
+    return true;
+}
+
+// Splits [0, count) into contiguous ranges and processes them on separate threads.
+static void ParallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t begin, uint32_t end)>& func)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    threadCount = std::min(threadCount, count);
+
+    if (threadCount <= 1)
+    {
+        func(0, count);
+        return;
+    }
+
+    const uint32_t rangeSize = (count + threadCount - 1) / threadCount;
+
+    std::vector<std::thread> threads;
+    for (uint32_t begin = 0; begin < count; begin += rangeSize)
+        threads.emplace_back(func, begin, std::min(begin + rangeSize, count));
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// Adds the sums of squared and relative squared errors over one row of one channel.
+static void AccumulateRowErrors(const float* reference, const float* test, uint32_t count, double& squaredError, double& relativeError)
+{
+    uint32_t i = 0;
+    float squaredSum = 0.f;
+    float relativeSum = 0.f;
+
+#if IMAGE_METRICS_USE_SSE
+    __m128 squaredSum4 = _mm_setzero_ps();
+    __m128 relativeSum4 = _mm_setzero_ps();
+    const __m128 epsilon4 = _mm_set1_ps(c_RelMseEpsilon);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        const __m128 r = _mm_loadu_ps(reference + i);
+        const __m128 t = _mm_loadu_ps(test + i);
+        const __m128 diff = _mm_sub_ps(t, r);
+        const __m128 diffSquared = _mm_mul_ps(diff, diff);
+
+        squaredSum4 = _mm_add_ps(squaredSum4, diffSquared);
+        relativeSum4 = _mm_add_ps(relativeSum4, _mm_div_ps(diffSquared, _mm_add_ps(_mm_mul_ps(r, r), epsilon4)));
+    }
+
+    float lanes[4];
+    _mm_storeu_ps(lanes, squaredSum4);
+    squaredSum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    _mm_storeu_ps(lanes, relativeSum4);
+    relativeSum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+
+    for (; i < count; i++)
+    {
+        const float diff = test[i] - reference[i];
+        squaredSum += diff * diff;
+        relativeSum += diff * diff / (reference[i] * reference[i] + c_RelMseEpsilon);
+    }
+
+    squaredError += double(squaredSum);
+    relativeError += double(relativeSum);
+}
+
+struct Kernel
+{
+    std::vector<float> weights;
+    int radius = 0;
+};
+
+// Convolves one image plane with a separable kernel, clamping at the edges.
+static void ConvolveSeparable(const std::vector<float>& source, std::vector<float>& destination, std::vector<float>& temp,
+    uint32_t width, uint32_t height, const Kernel& horizontal, const Kernel& vertical, uint32_t threadCount)
+{
+    temp.resize(source.size());
+    destination.resize(source.size());
+
+    ParallelFor(height, threadCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; y++)
+        {
+            const float* sourceRow = source.data() + size_t(y) * width;
+            float* tempRow = temp.data() + size_t(y) * width;
+
+            for (int x = 0; x < int(width); x++)
+            {
+                float sum = 0.f;
+                for (int k = -horizontal.radius; k <= horizontal.radius; k++)
+                {
+                    const int sx = std::clamp(x + k, 0, int(width) - 1);
+                    sum += horizontal.weights[k + horizontal.radius] * sourceRow[sx];
+                }
+                tempRow[x] = sum;
+            }
+        }
+    });
+
+    // The vertical pass works on whole rows, so it vectorizes along x.
+    ParallelFor(height, threadCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; y++)
+        {
+            float* destinationRow = destination.data() + size_t(y) * width;
+            std::fill(destinationRow, destinationRow + width, 0.f);
+
+            for (int k = -vertical.radius; k <= vertical.radius; k++)
+            {
+                const int sy = std::clamp(int(y) + k, 0, int(height) - 1);
+                const float* tempRow = temp.data() + size_t(sy) * width;
+                const float weight = vertical.weights[k + vertical.radius];
+
+                uint32_t x = 0;
+#if IMAGE_METRICS_USE_SSE
+                const __m128 weight4 = _mm_set1_ps(weight);
+                for (; x + 4 <= width; x += 4)
+                {
+                    const __m128 accumulated = _mm_loadu_ps(destinationRow + x);
+                    _mm_storeu_ps(destinationRow + x, _mm_add_ps(accumulated, _mm_mul_ps(weight4, _mm_loadu_ps(tempRow + x))));
+                }
+#endif
+                for (; x < width; x++)
+                    destinationRow[x] += weight * tempRow[x];
+            }
+        }
+    });
+}
+
+static float SrgbToLinear(float value)
+{
+    value = std::clamp(value, 0.f, 1.f);
+    return (value <= 0.04045f) ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static void LinearRgbToXyz(const float rgb[3], float xyz[3])
+{
+    xyz[0] = 0.4124564f * rgb[0] + 0.3575761f * rgb[1] + 0.1804375f * rgb[2];
+    xyz[1] = 0.2126729f * rgb[0] + 0.7151522f * rgb[1] + 0.0721750f * rgb[2];
+    xyz[2] = 0.0193339f * rgb[0] + 0.1191920f * rgb[1] + 0.9503041f * rgb[2];
+}
+
+static void XyzToLinearRgb(const float xyz[3], float rgb[3])
+{
+    rgb[0] = 3.2404542f * xyz[0] - 1.5371385f * xyz[1] - 0.4985314f * xyz[2];
+    rgb[1] = -0.9692660f * xyz[0] + 1.8760108f * xyz[1] + 0.0415560f * xyz[2];
+    rgb[2] = 0.0556434f * xyz[0] - 0.2040259f * xyz[1] + 1.0572252f * xyz[2];
+}
+
+// D65 reference white, i.e. LinearRgbToXyz(1, 1, 1)
+static constexpr float c_WhiteXyz[3] = { 0.950470f, 1.f, 1.088830f };
+
+static float LabCurve(float t)
+{
+    const float delta = 6.f / 29.f;
+    return (t > delta * delta * delta) ? std::cbrt(t) : t / (3.f * delta * delta) + 4.f / 29.f;
+}
+
+// Converts linear RGB into CIELAB with the Hunt adjustment applied to the chromatic components
+static void LinearRgbToHuntLab(const float rgb[3], float lab[3])
+{
+    float xyz[3];
+    LinearRgbToXyz(rgb, xyz);
+
+    const float fx = LabCurve(xyz[0] / c_WhiteXyz[0]);
+    const float fy = LabCurve(xyz[1] / c_WhiteXyz[1]);
+    const float fz = LabCurve(xyz[2] / c_WhiteXyz[2]);
+
+    lab[0] = 116.f * fy - 16.f;
+    lab[1] = 500.f * (fx - fy) * 0.01f * lab[0];
+    lab[2] = 200.f * (fy - fz) * 0.01f * lab[0];
+}
+
+static float HyAB(const float a[3], const float b[3])
+{
+    const float da = a[1] - b[1];
+    const float db = a[2] - b[2];
+    return std::abs(a[0] - b[0]) + std::sqrt(da * da + db * db);
+}
+
+static constexpr float c_ColorExponent = 0.7f;   // qc
+static constexpr float c_FeatureExponent = 0.5f; // qf
+static constexpr float c_ColorCutoff = 0.4f;     // pc
+static constexpr float c_ColorCutoffValue = 0.95f; // pt
+static constexpr float c_FeatureWidth = 0.082f;  // Edge and point detector width, in degrees
+
+// The perceptual filters depend only on the observer parameters, so they are built once per comparison.
+struct PerceptualFilters
+{
+    // Contrast sensitivity functions of the three opponent channels, as a weighted sum of up to two
+    // Gaussians each. The weights account for the 2D integral of each Gaussian.
+    struct Csf
+    {
+        Kernel kernels[2];
+        float weights[2] = { 1.f, 0.f };
+    } csf[3];
+
+    Kernel gaussian;
+    Kernel firstDerivative;
+    Kernel secondDerivative;
+
+    float maxColorDifference = 1.f;
+
+    explicit PerceptualFilters(float pixelsPerDegree);
+};
+
+static void NormalizeKernel(Kernel& kernel)
+{
+    float sum = 0.f;
+    for (float weight : kernel.weights)
+        sum += weight;
+
+    for (float& weight : kernel.weights)
+        weight /= sum;
+}
+
+// Scales the positive weights to sum to 1 and the negative weights to sum to -1.
+static void NormalizeDerivativeKernel(Kernel& kernel)
+{
+    float positiveSum = 0.f;
+    float negativeSum = 0.f;
+    for (float weight : kernel.weights)
+    {
+        if (weight > 0.f)
+            positiveSum += weight;
+        else
+            negativeSum -= weight;
+    }
+
+    for (float& weight : kernel.weights)
+        weight /= (weight > 0.f) ? positiveSum : negativeSum;
+}
+
+PerceptualFilters::PerceptualFilters(float pixelsPerDegree)
+{
+    // CSF parameters from FLIP: a1, b1, a2, b2 for the achromatic, red-green and blue-yellow channels
+    const float csfParameters[3][4] = {
+        { 1.f, 0.0047f, 0.f, 1e-5f },
+        { 1.f, 0.0053f, 0.f, 1e-5f },
+        { 34.1f, 0.04f, 13.5f, 0.025f }
+    };
+
+    // Use one radius for all channels, large enough for the widest Gaussian
+    const float maxB = 0.04f;
+    const int csfRadius = int(std::ceil(3.f * std::sqrt(maxB / (2.f * c_Pi * c_Pi)) * pixelsPerDegree));
+
+    for (int channel = 0; channel < 3; channel++)
+    {
+        Csf& channelCsf = csf[channel];
+        float termSums[2] = { 0.f, 0.f };
+
+        for (int term = 0; term < 2; term++)
+        {
+            const float a = csfParameters[channel][term * 2];
+            const float b = csfParameters[channel][term * 2 + 1];
+
+            Kernel& kernel = channelCsf.kernels[term];
+            kernel.radius = csfRadius;
+            kernel.weights.resize(csfRadius * 2 + 1);
+
+            float sum = 0.f;
+            for (int x = -csfRadius; x <= csfRadius; x++)
+            {
+                const float degrees = float(x) / pixelsPerDegree;
+                const float weight = std::exp(-c_Pi * c_Pi * degrees * degrees / b);
+                kernel.weights[x + csfRadius] = weight;
+                sum += weight;
+            }
+
+            termSums[term] = a * (c_Pi / b) * sum * sum;
+            NormalizeKernel(kernel);
+        }
+
+        channelCsf.weights[0] = termSums[0] / (termSums[0] + termSums[1]);
+        channelCsf.weights[1] = termSums[1] / (termSums[0] + termSums[1]);
+    }
+
+    const float sigma = 0.5f * c_FeatureWidth * pixelsPerDegree;
+    const int featureRadius = int(std::ceil(3.f * sigma));
+
+    gaussian.radius = firstDerivative.radius = secondDerivative.radius = featureRadius;
+    gaussian.weights.resize(featureRadius * 2 + 1);
+    firstDerivative.weights.resize(featureRadius * 2 + 1);
+    secondDerivative.weights.resize(featureRadius * 2 + 1);
+
+    for (int x = -featureRadius; x <= featureRadius; x++)
+    {
+        const float g = std::exp(-float(x * x) / (2.f * sigma * sigma));
+        gaussian.weights[x + featureRadius] = g;
+        firstDerivative.weights[x + featureRadius] = -float(x) * g;
+        secondDerivative.weights[x + featureRadius] = (float(x * x) / (sigma * sigma) - 1.f) * g;
+    }
+
+    NormalizeKernel(gaussian);
+    NormalizeDerivativeKernel(firstDerivative);
+    NormalizeDerivativeKernel(secondDerivative);
+
+    // The largest color difference in the gamut is between pure green and pure blue
+    const float green[3] = { 0.f, 1.f, 0.f };
+    const float blue[3] = { 0.f, 0.f, 1.f };
+    float greenLab[3], blueLab[3];
+    LinearRgbToHuntLab(green, greenLab);
+    LinearRgbToHuntLab(blue, blueLab);
+    maxColorDifference = std::pow(HyAB(greenLab, blueLab), c_ColorExponent);
+}
+
+struct PerceptualFeatures
+{
+    std::vector<float> lab[3];
+    std::vector<float> edges;
+    std::vector<float> points;
+};
+
+static void ComputePerceptualFeatures(const Image& image, const PerceptualFilters& filters, uint32_t threadCount,
+    PerceptualFeatures& features)
+{
+    const size_t pixelCount = image.GetPixelCount();
+
+    std::vector<float> opponent[3];
+    std::vector<float> luminance(pixelCount);
+    for (auto& channel : opponent)
+        channel.resize(pixelCount);
+
+    // Convert into the linear opponent space YCxCz. HDR images are tone mapped into [0, 1) first.
+    ParallelFor(image.height, threadCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (size_t pixel = size_t(begin) * image.width; pixel < size_t(end) * image.width; pixel++)
+        {
+            float rgb[3];
+            for (int channel = 0; channel < 3; channel++)
+            {
+                const float value = image.channels[channel][pixel];
+                rgb[channel] = image.hdr ? std::max(value, 0.f) / (1.f + std::max(value, 0.f)) : SrgbToLinear(value);
+            }
+
+            float xyz[3];
+            LinearRgbToXyz(rgb, xyz);
+
+            const float y = xyz[1] / c_WhiteXyz[1];
+            opponent[0][pixel] = 116.f * y - 16.f;
+            opponent[1][pixel] = 500.f * (xyz[0] / c_WhiteXyz[0] - y);
+            opponent[2][pixel] = 200.f * (y - xyz[2] / c_WhiteXyz[2]);
+            luminance[pixel] = y;
+        }
+    });
+
+    // Apply the contrast sensitivity functions
+    std::vector<float> temp;
+    std::vector<float> secondTerm;
+    for (int channel = 0; channel < 3; channel++)
+    {
+        const PerceptualFilters::Csf& csf = filters.csf[channel];
+        std::vector<float>& filtered = features.lab[channel];
+
+        ConvolveSeparable(opponent[channel], filtered, temp, image.width, image.height,
+            csf.kernels[0], csf.kernels[0], threadCount);
+
+        if (csf.weights[1] > 0.f)
+        {
+            ConvolveSeparable(opponent[channel], secondTerm, temp, image.width, image.height,
+                csf.kernels[1], csf.kernels[1], threadCount);
+
+            for (size_t pixel = 0; pixel < pixelCount; pixel++)
+                filtered[pixel] = csf.weights[0] * filtered[pixel] + csf.weights[1] * secondTerm[pixel];
+        }
+    }
+
+    // Convert the filtered colors back into the gamut and then into Hunt-adjusted CIELAB
+    ParallelFor(image.height, threadCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (size_t pixel = size_t(begin) * image.width; pixel < size_t(end) * image.width; pixel++)
+        {
+            const float y = (features.lab[0][pixel] + 16.f) / 116.f;
+            float xyz[3];
+            xyz[0] = (features.lab[1][pixel] / 500.f + y) * c_WhiteXyz[0];
+            xyz[1] = y * c_WhiteXyz[1];
+            xyz[2] = (y - features.lab[2][pixel] / 200.f) * c_WhiteXyz[2];
+
+            float rgb[3];
+            XyzToLinearRgb(xyz, rgb);
+            for (float& value : rgb)
+                value = std::clamp(value, 0.f, 1.f);
+
+            float lab[3];
+            LinearRgbToHuntLab(rgb, lab);
+            for (int channel = 0; channel < 3; channel++)
+                features.lab[channel][pixel] = lab[channel];
+        }
+    });
+
+    // Edge and point detectors on the luminance, as magnitudes of the gradients in x and y
+    std::vector<float> responseX, responseY;
+
+    ConvolveSeparable(luminance, responseX, temp, image.width, image.height, filters.firstDerivative, filters.gaussian, threadCount);
+    ConvolveSeparable(luminance, responseY, temp, image.width, image.height, filters.gaussian, filters.firstDerivative, threadCount);
+    features.edges.resize(pixelCount);
+    for (size_t pixel = 0; pixel < pixelCount; pixel++)
+        features.edges[pixel] = std::sqrt(responseX[pixel] * responseX[pixel] + responseY[pixel] * responseY[pixel]);
+
+    ConvolveSeparable(luminance, responseX, temp, image.width, image.height, filters.secondDerivative, filters.gaussian, threadCount);
+    ConvolveSeparable(luminance, responseY, temp, image.width, image.height, filters.gaussian, filters.secondDerivative, threadCount);
+    features.points.resize(pixelCount);
+    for (size_t pixel = 0; pixel < pixelCount; pixel++)
+        features.points[pixel] = std::sqrt(responseX[pixel] * responseX[pixel] + responseY[pixel] * responseY[pixel]);
+}
+
+bool ComputeImageMetrics(const Image& reference, const Image& test, const MetricSettings& settings,
+    ImageMetrics& outMetrics, std::vector<float>* errorMap)
+{
+    if (reference.width != test.width || reference.height != test.height)
+    {
+        log::error("Image sizes don't match: %dx%d vs. %dx%d",
+            reference.width, reference.height, test.width, test.height);
+        return false;
+    }
+
+    if (reference.GetPixelCount() == 0)
+    {
+        log::error("The images are empty.");
+        return false;
+    }
+
+    const uint32_t width = reference.width;
+    const uint32_t height = reference.height;
+    const size_t pixelCount = reference.GetPixelCount();
+
+    // Plain error metrics, accumulated per row so that the threads don't share anything
+    std::vector<double> rowSquaredErrors(height, 0.0);
+    std::vector<double> rowRelativeErrors(height, 0.0);
+
+    ParallelFor(height, settings.threadCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (uint32_t y = begin; y < end; y++)
+        {
+            const size_t offset = size_t(y) * width;
+            for (int channel = 0; channel < 3; channel++)
+            {
+                AccumulateRowErrors(reference.channels[channel].data() + offset, test.channels[channel].data() + offset,
+                    width, rowSquaredErrors[y], rowRelativeErrors[y]);
+            }
+        }
+    });
+
+    double squaredError = 0.0;
+    double relativeError = 0.0;
+    for (uint32_t y = 0; y < height; y++)
+    {
+        squaredError += rowSquaredErrors[y];
+        relativeError += rowRelativeErrors[y];
+    }
+
+    const double sampleCount = double(pixelCount) * 3.0;
+    outMetrics.mse = squaredError / sampleCount;
+    outMetrics.relMse = relativeError / sampleCount;
+    outMetrics.psnr = (outMetrics.mse > 0.0)
+        ? 10.0 * std::log10(1.0 / outMetrics.mse)
+        : std::numeric_limits<double>::infinity();
+
+    // Perceptual metric
+    const PerceptualFilters filters(settings.pixelsPerDegree);
+
+    PerceptualFeatures referenceFeatures;
+    PerceptualFeatures testFeatures;
+    ComputePerceptualFeatures(reference, filters, settings.threadCount, referenceFeatures);
+    ComputePerceptualFeatures(test, filters, settings.threadCount, testFeatures);
+
+    std::vector<float> localErrorMap;
+    std::vector<float>& flip = errorMap ? *errorMap : localErrorMap;
+    flip.resize(pixelCount);
+
+    const float cutoff = c_ColorCutoff * filters.maxColorDifference;
+
+    ParallelFor(height, settings.threadCount, [&](uint32_t begin, uint32_t end)
+    {
+        for (size_t pixel = size_t(begin) * width; pixel < size_t(end) * width; pixel++)
+        {
+            const float referenceLab[3] = { referenceFeatures.lab[0][pixel], referenceFeatures.lab[1][pixel], referenceFeatures.lab[2][pixel] };
+            const float testLab[3] = { testFeatures.lab[0][pixel], testFeatures.lab[1][pixel], testFeatures.lab[2][pixel] };
+
+            // Compress the large color differences, mapping the cutoff to c_ColorCutoffValue
+            const float colorDifference = std::pow(HyAB(referenceLab, testLab), c_ColorExponent);
+            float colorError;
+            if (colorDifference < cutoff)
+                colorError = (c_ColorCutoffValue / cutoff) * colorDifference;
+            else
+                colorError = c_ColorCutoffValue + (colorDifference - cutoff) / (filters.maxColorDifference - cutoff) * (1.f - c_ColorCutoffValue);
+
+            const float edgeDifference = std::abs(referenceFeatures.edges[pixel] - testFeatures.edges[pixel]);
+            const float pointDifference = std::abs(referenceFeatures.points[pixel] - testFeatures.points[pixel]);
+            const float featureDifference = std::pow(std::max(edgeDifference, pointDifference) / std::sqrt(2.f), c_FeatureExponent);
+
+            flip[pixel] = std::pow(std::clamp(colorError, 0.f, 1.f), 1.f - std::min(featureDifference, 1.f));
+        }
+    });
+
+    double flipSum = 0.0;
+    float flipMax = 0.f;
+    for (float value : flip)
+    {
+        flipSum += double(value);
+        flipMax = std::max(flipMax, value);
+    }
+
+    outMetrics.flipMean = flipSum / double(pixelCount);
+    outMetrics.flipMax = double(flipMax);
+
+    return true;
+}
+
+bool SaveErrorHeatmap(const std::string& fileName, const std::vector<float>& errorMap, uint32_t width, uint32_t height)
+{
+    // Samples of the magma color map
+    struct ColorStop { float position; float r, g, b; };
+    static const ColorStop c_Magma[] = {
+        { 0.000f, 0.001462f, 0.000466f, 0.013866f },
+        { 0.125f, 0.078815f, 0.054184f, 0.211667f },
+        { 0.250f, 0.232077f, 0.059889f, 0.437695f },
+        { 0.375f, 0.390384f, 0.100379f, 0.501864f },
+        { 0.500f, 0.550287f, 0.161158f, 0.505719f },
+        { 0.625f, 0.716387f, 0.214982f, 0.475290f },
+        { 0.750f, 0.868793f, 0.287728f, 0.409303f },
+        { 0.875f, 0.967671f, 0.439703f, 0.359810f },
+        { 0.9375f, 0.995737f, 0.624350f, 0.427397f },
+        { 1.000f, 0.987053f, 0.991438f, 0.749504f }
+    };
+    const size_t stopCount = sizeof(c_Magma) / sizeof(c_Magma[0]);
+
+    std::filesystem::path parentFolder = std::filesystem::path(fileName).parent_path();
+    if (!parentFolder.empty() && !std::filesystem::exists(parentFolder))
+        std::filesystem::create_directories(parentFolder);
+
+    std::vector<uint8_t> pixels(size_t(width) * height * 3);
+
+    for (size_t pixel = 0; pixel < size_t(width) * height; pixel++)
+    {
+        const float value = std::clamp(errorMap[pixel], 0.f, 1.f);
+
+        size_t stop = 1;
+        while (stop < stopCount - 1 && c_Magma[stop].position < value)
+            ++stop;
+
+        const ColorStop& a = c_Magma[stop - 1];
+        const ColorStop& b = c_Magma[stop];
+        const float t = std::clamp((value - a.position) / (b.position - a.position), 0.f, 1.f);
+
+        pixels[pixel * 3 + 0] = uint8_t((a.r + (b.r - a.r) * t) * 255.f + 0.5f);
+        pixels[pixel * 3 + 1] = uint8_t((a.g + (b.g - a.g) * t) * 255.f + 0.5f);
+        pixels[pixel * 3 + 2] = uint8_t((a.b + (b.b - a.b) * t) * 255.f + 0.5f);
+    }
+
+    if (!stbi_write_png(fileName.c_str(), int(width), int(height), 3, pixels.data(), int(width) * 3))
+    {
+        log::error("Couldn't write the heatmap into '%s'", fileName.c_str());
+        return false;
+    }
+
+    return true;
+}
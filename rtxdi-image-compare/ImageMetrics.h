@@ -0,0 +1,64 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// An RGB image with planar float channels, which keeps the metric kernels simple to vectorize.
+struct Image
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+
+    // True for linear HDR images (EXR, HDR), false for sRGB-encoded LDR images with values in [0, 1].
+    bool hdr = false;
+
+    std::vector<float> channels[3];
+
+    void Resize(uint32_t newWidth, uint32_t newHeight);
+    [[nodiscard]] size_t GetPixelCount() const { return size_t(width) * size_t(height); }
+};
+
+// Loads PNG, BMP, JPG, TGA, HDR or EXR files. (Not called LoadImage to avoid the Windows macro.)
+bool LoadImageFile(const std::string& fileName, Image& image);
+
+struct ImageMetrics
+{
+    double mse = 0.0;
+    double psnr = 0.0;      // In dB, relative to a peak value of 1.0. Infinite for identical images.
+    double relMse = 0.0;    // Mean of (test - reference)^2 / (reference^2 + 0.01)
+    double flipMean = 0.0;  // Mean of the per-pixel FLIP-style error, in [0, 1]
+    double flipMax = 0.0;
+};
+
+struct MetricSettings
+{
+    // Observer parameter of the perceptual metric. The default corresponds to a 0.7 m wide 4K monitor
+    // viewed from 0.7 m, which is the default used by FLIP.
+    float pixelsPerDegree = 67.f;
+
+    // Number of worker threads, 0 means one per hardware thread.
+    uint32_t threadCount = 0;
+};
+
+// Computes all metrics for two images of the same size. MSE, PSNR and relMSE are computed on the stored
+// values, i.e. on sRGB-encoded values for LDR images and on linear values for HDR images.
+// The perceptual metric follows the structure of LDR-FLIP (Andersson et al. 2020): CSF-filtered color
+// differences in the HyAB space, amplified by the edge and point feature differences. HDR inputs are
+// tone mapped first, which is a simplification of the exposure sweep done by HDR-FLIP.
+// If errorMap is not null, it receives the per-pixel perceptual error.
+bool ComputeImageMetrics(const Image& reference, const Image& test, const MetricSettings& settings,
+    ImageMetrics& outMetrics, std::vector<float>* errorMap);
+
+// Writes an error map as a PNG using the magma color map, with 0 mapped to black and 1 to light yellow.
+bool SaveErrorHeatmap(const std::string& fileName, const std::vector<float>& errorMap, uint32_t width, uint32_t height);
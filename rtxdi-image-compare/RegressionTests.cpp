@@ -0,0 +1,219 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "RegressionTests.h"
+#include "../src/CaptureFileNames.h"
+
+#include <donut/core/json.h>
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+#include <json/value.h>
+
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+using namespace donut;
+
+MetricThresholds MetricThresholds::WithDefaults(const MetricThresholds& defaults) const
+{
+    MetricThresholds result = *this;
+    if (!result.maxMse) result.maxMse = defaults.maxMse;
+    if (!result.minPsnr) result.minPsnr = defaults.minPsnr;
+    if (!result.maxRelMse) result.maxRelMse = defaults.maxRelMse;
+    if (!result.maxFlip) result.maxFlip = defaults.maxFlip;
+    return result;
+}
+
+bool MetricThresholds::Check(const ImageMetrics& metrics, std::string& outFailures) const
+{
+    std::stringstream failures;
+
+    if (maxMse && metrics.mse > *maxMse)
+        failures << "MSE > " << *maxMse << "; ";
+    if (minPsnr && metrics.psnr < *minPsnr)
+        failures << "PSNR < " << *minPsnr << "; ";
+    if (maxRelMse && metrics.relMse > *maxRelMse)
+        failures << "relMSE > " << *maxRelMse << "; ";
+    if (maxFlip && metrics.flipMean > *maxFlip)
+        failures << "FLIP > " << *maxFlip << "; ";
+
+    outFailures = failures.str();
+    return outFailures.empty();
+}
+
+static void ReadThresholds(const Json::Value& node, MetricThresholds& thresholds)
+{
+    if (node["maxMse"].isNumeric()) thresholds.maxMse = node["maxMse"].asDouble();
+    if (node["minPsnr"].isNumeric()) thresholds.minPsnr = node["minPsnr"].asDouble();
+    if (node["maxRelMse"].isNumeric()) thresholds.maxRelMse = node["maxRelMse"].asDouble();
+    if (node["maxFlip"].isNumeric()) thresholds.maxFlip = node["maxFlip"].asDouble();
+}
+
+bool LoadRegressionTests(const std::string& fileName, std::vector<RegressionTest>& outTests, MetricThresholds& outDefaults)
+{
+    vfs::NativeFileSystem fs;
+    Json::Value root;
+
+    if (!json::LoadFromFile(fs, fileName, root))
+    {
+        log::error("Couldn't load the regression test list from '%s'", fileName.c_str());
+        return false;
+    }
+
+    ReadThresholds(root["defaults"], outDefaults);
+
+    const Json::Value& testsNode = root["tests"];
+    if (!testsNode.isArray() || testsNode.empty())
+    {
+        log::error("The 'tests' item in '%s' must be a non-empty array.", fileName.c_str());
+        return false;
+    }
+
+    for (const auto& testNode : testsNode)
+    {
+        RegressionTest test;
+        test.captureFileName = testNode["capture"].asString();
+        test.goldenFileName = testNode["golden"].asString();
+
+        if (test.captureFileName.empty() || test.goldenFileName.empty())
+        {
+            log::error("Every test in '%s' must have the 'capture' and 'golden' file names.", fileName.c_str());
+            return false;
+        }
+
+        test.name = testNode["name"].isString()
+            ? testNode["name"].asString()
+            : std::filesystem::path(test.captureFileName).stem().generic_string();
+
+        if (testNode["frame"].isNumeric()) test.firstFrame = testNode["frame"].asUInt();
+        if (testNode["lastFrame"].isNumeric()) test.lastFrame = testNode["lastFrame"].asUInt();
+        if (testNode["interval"].isNumeric()) test.interval = testNode["interval"].asUInt();
+        if (testNode["hdr"].isBool()) test.includeHdrBuffers = testNode["hdr"].asBool();
+
+        ReadThresholds(testNode, test.thresholds);
+
+        outTests.push_back(test);
+    }
+
+    log::info("Loaded %d regression tests from '%s'", int(outTests.size()), fileName.c_str());
+    return true;
+}
+
+void RunRegressionTest(const RegressionTest& test, const RegressionSettings& settings, std::vector<RegressionResult>& results)
+{
+    FrameCaptureFormat mainFormat;
+    if (!GetCaptureFormatFromFileName(test.captureFileName, mainFormat) || mainFormat == FrameCaptureFormat::Raw)
+    {
+        log::error("Test '%s': the capture must be a BMP, PNG or EXR file.", test.name.c_str());
+
+        RegressionResult result;
+        result.testName = test.name;
+        result.captureFileName = test.captureFileName;
+        result.failures = "unsupported format";
+        results.push_back(result);
+        return;
+    }
+
+    // Same buffer list and formats as FrameCapture uses in the sample
+    std::vector<std::string> bufferNames = { "" };
+    if (test.includeHdrBuffers)
+    {
+        bufferNames.push_back("HdrColor");
+        bufferNames.push_back("DiffuseLighting");
+        bufferNames.push_back("SpecularLighting");
+    }
+
+    const uint32_t lastFrame = std::max(test.lastFrame, test.firstFrame);
+    const uint32_t interval = std::max(test.interval, 1u);
+    const bool multipleFrames = lastFrame > test.firstFrame;
+    const MetricThresholds thresholds = test.thresholds.WithDefaults(settings.defaultThresholds);
+
+    for (uint32_t frameIndex = test.firstFrame; frameIndex <= lastFrame; frameIndex += interval)
+    {
+        for (const std::string& bufferName : bufferNames)
+        {
+            const FrameCaptureFormat format = bufferName.empty() ? mainFormat : FrameCaptureFormat::Exr;
+
+            RegressionResult result;
+            result.testName = test.name;
+            result.captureFileName = GetCaptureFileName(test.captureFileName, bufferName, format, frameIndex, multipleFrames);
+            result.goldenFileName = GetCaptureFileName(test.goldenFileName, bufferName, format, frameIndex, multipleFrames);
+
+            Image golden, capture;
+            std::vector<float> errorMap;
+
+            if (!LoadImageFile(result.goldenFileName, golden) ||
+                !LoadImageFile(result.captureFileName, capture) ||
+                !ComputeImageMetrics(golden, capture, settings.metrics, result.metrics,
+                    settings.heatmapFolder.empty() ? nullptr : &errorMap))
+            {
+                result.failures = "comparison failed";
+                results.push_back(result);
+                continue;
+            }
+
+            result.loaded = true;
+            result.passed = thresholds.Check(result.metrics, result.failures);
+
+            if (!settings.heatmapFolder.empty())
+            {
+                const std::string heatmapFileName = (std::filesystem::path(settings.heatmapFolder) /
+                    (std::filesystem::path(result.captureFileName).stem().generic_string() + ".flip.png")).generic_string();
+
+                SaveErrorHeatmap(heatmapFileName, errorMap, golden.width, golden.height);
+            }
+
+            results.push_back(result);
+        }
+    }
+}
+
+std::string GetRegressionReport(const std::vector<RegressionResult>& results)
+{
+    std::stringstream text;
+    text << "| Test | Capture | MSE | PSNR | relMSE | FLIP mean | FLIP max | Result |" << std::endl;
+    text << "|---|---|---:|---:|---:|---:|---:|---|" << std::endl;
+
+    int passedCount = 0;
+
+    for (const auto& result : results)
+    {
+        text << "| " << result.testName << " | " << result.captureFileName << " | ";
+
+        if (result.loaded)
+        {
+            text << std::scientific << std::setprecision(3) << result.metrics.mse << " | "
+                << std::fixed << std::setprecision(2) << result.metrics.psnr << " | "
+                << std::scientific << std::setprecision(3) << result.metrics.relMse << " | "
+                << std::fixed << std::setprecision(4) << result.metrics.flipMean << " | "
+                << result.metrics.flipMax << " | ";
+        }
+        else
+        {
+            text << "- | - | - | - | - | ";
+        }
+
+        if (result.passed)
+        {
+            text << "PASS |" << std::endl;
+            ++passedCount;
+        }
+        else
+        {
+            text << "FAIL: " << result.failures << " |" << std::endl;
+        }
+    }
+
+    text << std::endl << passedCount << " of " << results.size() << " comparisons passed." << std::endl;
+
+    return text.str();
+}
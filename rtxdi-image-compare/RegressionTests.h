@@ -0,0 +1,86 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "ImageMetrics.h"
+
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Json
+{
+    class Value;
+}
+
+// Pass/fail limits, unset limits are not checked.
+struct MetricThresholds
+{
+    std::optional<double> maxMse;
+    std::optional<double> minPsnr;
+    std::optional<double> maxRelMse;
+    std::optional<double> maxFlip;
+
+    // Returns a copy of these thresholds where the unset values are taken from 'defaults'.
+    [[nodiscard]] MetricThresholds WithDefaults(const MetricThresholds& defaults) const;
+
+    [[nodiscard]] bool Check(const ImageMetrics& metrics, std::string& outFailures) const;
+};
+
+// One captured image sequence compared against its golden images. The file names follow the same rules
+// as the --save-file, --save-frame, --save-last-frame, --save-interval and --save-hdr arguments of the sample,
+// so the same values can be passed here to find the captured files.
+struct RegressionTest
+{
+    std::string name;
+    std::string captureFileName;
+    std::string goldenFileName;
+    uint32_t firstFrame = 0;
+    uint32_t lastFrame = 0;
+    uint32_t interval = 1;
+    bool includeHdrBuffers = false;
+    MetricThresholds thresholds;
+};
+
+struct RegressionResult
+{
+    std::string testName;
+    std::string captureFileName;
+    std::string goldenFileName;
+    ImageMetrics metrics;
+    bool loaded = false;
+    bool passed = false;
+    std::string failures;
+};
+
+struct RegressionSettings
+{
+    MetricSettings metrics;
+    MetricThresholds defaultThresholds;
+    std::string heatmapFolder; // Empty means no heatmaps
+};
+
+// Loads a list of tests from a JSON file, for example:
+//   {
+//     "defaults": { "maxFlip": 0.05, "minPsnr": 30 },
+//     "tests": [
+//       { "name": "bistro-fast", "capture": "out/fast.png", "golden": "golden/fast.png" },
+//       { "name": "bistro-ultra", "capture": "out/ultra.png", "golden": "golden/ultra.png",
+//         "frame": 60, "lastFrame": 120, "interval": 30, "hdr": true, "maxFlip": 0.08 }
+//     ]
+//   }
+// The "defaults" thresholds are overridden by the thresholds of each test.
+bool LoadRegressionTests(const std::string& fileName, std::vector<RegressionTest>& outTests, MetricThresholds& outDefaults);
+
+// Runs every comparison in the test, one per captured frame and buffer.
+void RunRegressionTest(const RegressionTest& test, const RegressionSettings& settings, std::vector<RegressionResult>& results);
+
+[[nodiscard]] std::string GetRegressionReport(const std::vector<RegressionResult>& results);
@@ -0,0 +1,164 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+// Compares the images captured by the sample with --save-file against golden images,
+// and fails when a quality metric exceeds its threshold. Doesn't need a GPU.
+//
+// Single capture, using the same arguments as the sample:
+//   rtxdi-image-compare --capture out/bistro.png --golden golden/bistro.png --save-frame 60 --max-flip 0.05
+// List of tests with per-test thresholds, see LoadRegressionTests for the format:
+//   rtxdi-image-compare --tests tests.json --report out/quality.md --heatmaps out/heatmaps
+
+#include "RegressionTests.h"
+
+#include <donut/core/log.h>
+
+#include <cxxopts.hpp>
+
+#include <filesystem>
+#include <fstream>
+
+using namespace donut;
+
+static const char* g_ApplicationTitle = "RTXDI Image Comparison Tool";
+
+static bool WriteReport(const std::string& fileName, const std::string& report)
+{
+    std::filesystem::path parentFolder = std::filesystem::path(fileName).parent_path();
+    if (!parentFolder.empty() && !std::filesystem::exists(parentFolder))
+        std::filesystem::create_directories(parentFolder);
+
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        log::error("Failed to open '%s' for writing.", fileName.c_str());
+        return false;
+    }
+
+    file << report;
+    file.close();
+
+    if (file.fail())
+    {
+        log::error("Failed to write the report into '%s'", fileName.c_str());
+        return false;
+    }
+
+    log::info("Saved the quality report into '%s'", fileName.c_str());
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    using namespace cxxopts;
+
+    Options options(argv[0], g_ApplicationTitle);
+
+    bool help = false;
+    std::string testsFileName;
+    std::string reportFileName;
+    RegressionTest commandLineTest;
+    RegressionSettings settings;
+    double maxMse = 0.0, minPsnr = 0.0, maxRelMse = 0.0, maxFlip = 0.0;
+
+    options.add_options()
+        ("capture", "Captured image, same as the --save-file argument of the sample", value(commandLineTest.captureFileName))
+        ("golden", "Golden image, named like --capture", value(commandLineTest.goldenFileName))
+        ("h,help", "Display this help message", value(help))
+        ("heatmaps", "Folder to write the FLIP error heatmaps into", value(settings.heatmapFolder))
+        ("max-flip", "Maximum mean FLIP error, default is 0.05", value(maxFlip))
+        ("max-mse", "Maximum MSE", value(maxMse))
+        ("max-relmse", "Maximum relative MSE", value(maxRelMse))
+        ("min-psnr", "Minimum PSNR in dB", value(minPsnr))
+        ("ppd", "Pixels per degree of the observer for the FLIP metric", value(settings.metrics.pixelsPerDegree))
+        ("report", "Write the results table into a file", value(reportFileName))
+        ("save-frame", "Index of the first captured frame", value(commandLineTest.firstFrame))
+        ("save-hdr", "Also compare HdrColor and the lighting buffers", value(commandLineTest.includeHdrBuffers))
+        ("save-interval", "Interval between the captured frames", value(commandLineTest.interval))
+        ("save-last-frame", "Index of the last captured frame", value(commandLineTest.lastFrame))
+        ("tests", "JSON file with a list of tests and their thresholds", value(testsFileName))
+        ("threads", "Number of worker threads, default is one per hardware thread", value(settings.metrics.threadCount))
+    ;
+
+    try
+    {
+        const ParseResult result = options.parse(argc, argv);
+
+        if (help)
+        {
+            printf("%s", options.help().c_str());
+            return 0;
+        }
+
+        // The command line thresholds override the defaults from the tests file
+        if (result.count("max-mse")) settings.defaultThresholds.maxMse = maxMse;
+        if (result.count("min-psnr")) settings.defaultThresholds.minPsnr = minPsnr;
+        if (result.count("max-relmse")) settings.defaultThresholds.maxRelMse = maxRelMse;
+        if (result.count("max-flip")) settings.defaultThresholds.maxFlip = maxFlip;
+    }
+    catch (const std::exception& e)
+    {
+        log::error("%s", e.what());
+        return 1;
+    }
+
+    std::vector<RegressionTest> tests;
+
+    if (!testsFileName.empty())
+    {
+        MetricThresholds fileDefaults;
+        if (!LoadRegressionTests(testsFileName, tests, fileDefaults))
+            return 1;
+
+        settings.defaultThresholds = settings.defaultThresholds.WithDefaults(fileDefaults);
+    }
+
+    if (!commandLineTest.captureFileName.empty() || !commandLineTest.goldenFileName.empty())
+    {
+        if (commandLineTest.captureFileName.empty() || commandLineTest.goldenFileName.empty())
+        {
+            log::error("The --capture and --golden arguments must be used together.");
+            return 1;
+        }
+
+        commandLineTest.name = std::filesystem::path(commandLineTest.captureFileName).stem().generic_string();
+        tests.push_back(commandLineTest);
+    }
+
+    if (tests.empty())
+    {
+        log::error("Nothing to compare, use --capture and --golden, or --tests.");
+        return 1;
+    }
+
+    if (!settings.defaultThresholds.maxMse && !settings.defaultThresholds.minPsnr &&
+        !settings.defaultThresholds.maxRelMse && !settings.defaultThresholds.maxFlip)
+    {
+        settings.defaultThresholds.maxFlip = 0.05;
+    }
+
+    std::vector<RegressionResult> results;
+    for (const RegressionTest& test : tests)
+        RunRegressionTest(test, settings, results);
+
+    const std::string report = GetRegressionReport(results);
+    log::info("QUALITY REPORT\n%s", report.c_str());
+
+    if (!reportFileName.empty())
+        WriteReport(reportFileName, report);
+
+    for (const auto& result : results)
+    {
+        if (!result.passed)
+            return 1;
+    }
+
+    return 0;
+}
@@ -37,6 +37,54 @@ Texture2D t_DenoisedSpecular : register(t8);
 
 SamplerState s_EnvironmentSampler : register(s0);
 
+// Returns true if the lighting passes shaded the pixel in this frame, see RTXDI_ReservoirPosToPixelPos
+bool IsActiveCheckerboardPixel(int2 pixelPos)
+{
+    return ((pixelPos.x + pixelPos.y) & 1) == (g_Const.activeCheckerboardField & 1);
+}
+
+// Interpolates the lighting of a pixel in the inactive checkerboard field from its four neighbors,
+// which are all in the active field. Neighbors on other surfaces are rejected based on their depth.
+void ReconstructCheckerboardPixel(int2 pixelPos, float depth, inout float4 diffuse, inout float4 specular)
+{
+    const int2 offsets[4] = { int2(-1, 0), int2(1, 0), int2(0, -1), int2(0, 1) };
+    const int2 viewportSize = int2(g_Const.view.viewportSize);
+
+    float4 diffuseSum = 0;
+    float4 specularSum = 0;
+    float weightSum = 0;
+
+    [unroll]
+    for (int i = 0; i < 4; i++)
+    {
+        int2 neighborPos = pixelPos + offsets[i];
+        if (any(neighborPos < 0) || any(neighborPos >= viewportSize))
+            continue;
+
+        float neighborDepth = t_GBufferDepth[neighborPos];
+        if (neighborDepth == BACKGROUND_DEPTH)
+            continue;
+
+        float weight = saturate(1.0 - abs(neighborDepth - depth) / (0.05 * depth));
+        diffuseSum += t_Diffuse[neighborPos] * weight;
+        specularSum += t_Specular[neighborPos] * weight;
+        weightSum += weight;
+    }
+
+    if (weightSum > 0)
+    {
+        diffuse = diffuseSum / weightSum;
+        specular = specularSum / weightSum;
+    }
+    else
+    {
+        // No neighbor on the same surface, e.g. a thin object: take the horizontal neighbor, like the lighting passes used to
+        int2 neighborPos = pixelPos + int2((pixelPos.x > 0) ? -1 : 1, 0);
+        diffuse = t_Diffuse[neighborPos];
+        specular = t_Specular[neighborPos];
+    }
+}
+
 [numthreads(8, 8, 1)]
 void main(uint2 globalIdx : SV_DispatchThreadID)
 {
@@ -61,6 +109,9 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
         float4 diffuse_illumination = t_Diffuse[illuminationPos].rgba;
         float4 specular_illumination = t_Specular[illuminationPos].rgba;
 
+        if (g_Const.reconstructCheckerboard && !IsActiveCheckerboardPixel(globalIdx))
+            ReconstructCheckerboardPixel(globalIdx, depth, diffuse_illumination, specular_illumination);
+
 #ifdef WITH_NRD
         if(g_Const.denoiserMode != DENOISER_MODE_OFF)
         {
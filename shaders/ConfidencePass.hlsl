@@ -13,6 +13,10 @@
 #include "ShaderParameters.h"
 #include <donut/shaders/vulkan.hlsli>
 
+// The fused version filters the texels within 1 texel around its tile for the bilinear interpolation
+#define GRADIENT_TILE_MARGIN 1
+#include "GradientFilter.hlsli"
+
 VK_PUSH_CONSTANT ConstantBuffer<ConfidenceConstants> g_Const : register(b0);
 
 Texture2DArray<float4> t_Gradients : register(t0);
@@ -27,23 +31,10 @@ SamplerState s_Sampler : register(s0);
 // the confidence channel suitable for NRD consumption, and applies an exponential
 // temporal filter on top of that confidence channel. Typically, the temporal filter
 // has very short history, like 1 frame or less, just to reduce the flicker.
+// The C++ model of the fused version, ConfidenceReference, must be kept in sync with it.
 
-[numthreads(8, 8, 1)]
-void main(uint2 globalIdx : SV_DispatchThreadID)
+void StoreConfidence(uint2 pixelPos, float4 gradient)
 {
-    if (any(globalIdx.xy >= g_Const.viewportSize))
-        return;
-
-    // Convert the output pixel position into UV in the gradients texture.
-    float2 inputPos = (float2(globalIdx) + 0.5) / RTXDI_GRAD_FACTOR;
-
-    if (g_Const.checkerboard)
-        inputPos.x *= 0.5;
-
-    inputPos.xy *= g_Const.invGradientTextureSize;
-    
-    // Sample the gradients texture with linear interpolation.
-    float4 gradient = t_Gradients.SampleLevel(s_Sampler, float3(inputPos, g_Const.inputBufferIndex), 0);
     gradient = max(gradient, 0);
 
     // Apply the "darkness bias" to avoid discarding history because of noise on very dark surfaces.
@@ -60,9 +51,9 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
     if (g_Const.blendFactor < 1.0)
     {
         // Find the previous input position using the motion vector.
-        float2 motionVector = t_MotionVectors[globalIdx].xy;
+        float2 motionVector = t_MotionVectors[pixelPos].xy;
         
-        int2 prevInputPos = int2(float2(globalIdx) + 0.5 + motionVector);
+        int2 prevInputPos = int2(float2(pixelPos) + 0.5 + motionVector);
 
         if (all(prevInputPos >= 0) && all(prevInputPos < g_Const.viewportSize))
         {
@@ -93,6 +84,83 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
     }
 
     // Store the output
-    u_DiffuseConfidence[globalIdx] = diffuseConfidence;
-    u_SpecularConfidence[globalIdx] = specularConfidence;
+    u_DiffuseConfidence[pixelPos] = diffuseConfidence;
+    u_SpecularConfidence[pixelPos] = specularConfidence;
+}
+
+// Converts the output pixel position into the position in the gradients texture, in texels.
+float2 GetGradientPosition(uint2 pixelPos)
+{
+    float2 inputPos = (float2(pixelPos) + 0.5) / RTXDI_GRAD_FACTOR;
+
+    if (g_Const.checkerboard)
+        inputPos.x *= 0.5;
+
+    return inputPos;
+}
+
+[numthreads(8, 8, 1)]
+void main(uint2 globalIdx : SV_DispatchThreadID)
+{
+    if (any(globalIdx.xy >= g_Const.viewportSize))
+        return;
+
+    // Convert the output pixel position into UV in the gradients texture.
+    float2 inputPos = GetGradientPosition(globalIdx) * g_Const.invGradientTextureSize;
+    
+    // Sample the gradients texture with linear interpolation.
+    float4 gradient = t_Gradients.SampleLevel(s_Sampler, float3(inputPos, g_Const.inputBufferIndex), 0);
+
+    StoreConfidence(globalIdx, gradient);
+}
+
+// Filtered gradient texel for the bilinear interpolation, zero outside of the gradients like the border of the sampler
+float4 GetFilteredGradient(int2 regionOrigin, int2 pos)
+{
+    return IsInsideGradients(pos, g_Const.gradientSize) ? GetGradientTexel(pos - regionOrigin) : 0;
+}
+
+// The fused version runs the gradient filter on a tile of the unfiltered gradients in shared memory, see FilterGradientTile,
+// and then computes the confidence for all pixels that map into that tile. The filtered gradients never leave the group.
+
+[numthreads(FILTER_GRADIENTS_FUSED_TILE_SIZE, FILTER_GRADIENTS_FUSED_TILE_SIZE, 1)]
+void FusedFilter(uint2 groupIdx : SV_GroupID, uint threadIdx : SV_GroupIndex)
+{
+    const int2 regionOrigin = GetGradientRegionOrigin(groupIdx);
+
+    // Load the tile with its halo from the unfiltered slice
+    for (uint i = threadIdx; i < GRADIENT_REGION_SIZE * GRADIENT_REGION_SIZE; i += GRADIENT_TILE_THREAD_COUNT)
+    {
+        int2 pos = regionOrigin + int2(i % GRADIENT_REGION_SIZE, i / GRADIENT_REGION_SIZE);
+        SetGradientTexel(i, IsInsideGradients(pos, g_Const.gradientSize) ? t_Gradients[int3(pos, 0)] : 0);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    FilterGradientTile(regionOrigin, threadIdx, g_Const.gradientSize, g_Const.checkerboard);
+
+    // The pixels that map into the tile only interpolate the texels within 1 texel around it, see GRADIENT_TILE_MARGIN
+    const uint2 tilePixels = uint2(
+        FILTER_GRADIENTS_FUSED_TILE_SIZE * RTXDI_GRAD_FACTOR * (g_Const.checkerboard ? 2 : 1),
+        FILTER_GRADIENTS_FUSED_TILE_SIZE * RTXDI_GRAD_FACTOR);
+
+    for (uint i = threadIdx; i < tilePixels.x * tilePixels.y; i += GRADIENT_TILE_THREAD_COUNT)
+    {
+        const uint2 pixelPos = groupIdx * tilePixels + uint2(i % tilePixels.x, i / tilePixels.x);
+
+        if (any(pixelPos >= g_Const.viewportSize))
+            continue;
+
+        // Bilinear interpolation between the texel centers, same as the sampler in the separate pass
+        const float2 texelPos = GetGradientPosition(pixelPos) - 0.5;
+        const int2 basePos = int2(floor(texelPos));
+        const float2 f = texelPos - float2(basePos);
+
+        float4 gradient = lerp(
+            lerp(GetFilteredGradient(regionOrigin, basePos), GetFilteredGradient(regionOrigin, basePos + int2(1, 0)), f.x),
+            lerp(GetFilteredGradient(regionOrigin, basePos + int2(0, 1)), GetFilteredGradient(regionOrigin, basePos + int2(1, 1)), f.x),
+            f.y);
+
+        StoreConfidence(pixelPos, gradient);
+    }
 }
@@ -0,0 +1,63 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma pack_matrix(row_major)
+
+#include "ShaderParameters.h"
+#include <donut/shaders/vulkan.hlsli>
+
+VK_PUSH_CONSTANT ConstantBuffer<ConvergenceErrorConstants> g_Const : register(b0);
+
+Texture2D<float4> t_Color : register(t0);
+Texture2D<float4> t_Reference : register(t1);
+
+// One (squared error, relative squared error) pair per thread group, summed on the CPU
+RWStructuredBuffer<float2> u_GroupErrors : register(u0);
+
+#define GROUP_THREADS (CONVERGENCE_ERROR_GROUP_SIZE * CONVERGENCE_ERROR_GROUP_SIZE)
+
+groupshared float2 s_Errors[GROUP_THREADS];
+
+[numthreads(CONVERGENCE_ERROR_GROUP_SIZE, CONVERGENCE_ERROR_GROUP_SIZE, 1)]
+void main(uint2 globalIdx : SV_DispatchThreadID, uint2 groupIdx : SV_GroupID, uint threadIdx : SV_GroupIndex)
+{
+    float2 errors = 0;
+
+    if (all(globalIdx < g_Const.outputSize))
+    {
+        float3 color = t_Color[globalIdx].rgb;
+        float3 reference = t_Reference[globalIdx].rgb;
+        float3 diff = color - reference;
+        float3 squared = diff * diff;
+
+        // Same definitions as in rtxdi-image-compare, averaged over the color channels
+        errors.x = dot(squared, 1.0 / 3.0);
+        errors.y = dot(squared / (reference * reference + 0.01), 1.0 / 3.0);
+
+        // Don't let a single broken pixel make the whole measurement unusable
+        if (any(isnan(errors)) || any(isinf(errors)))
+            errors = 0;
+    }
+
+    s_Errors[threadIdx] = errors;
+    GroupMemoryBarrierWithGroupSync();
+
+    [unroll]
+    for (uint stride = GROUP_THREADS / 2; stride > 0; stride >>= 1)
+    {
+        if (threadIdx < stride)
+            s_Errors[threadIdx] += s_Errors[threadIdx + stride];
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+
+    if (threadIdx == 0)
+        u_GroupErrors[groupIdx.y * g_Const.groupCountX + groupIdx.x] = s_Errors[0];
+}
@@ -13,6 +13,9 @@
 #include "ShaderParameters.h"
 #include <donut/shaders/vulkan.hlsli>
 
+#define GRADIENT_TILE_MARGIN 0
+#include "GradientFilter.hlsli"
+
 VK_PUSH_CONSTANT ConstantBuffer<FilterGradientsConstants> g_Const : register(b0);
 
 RWTexture2DArray<float4> u_Gradients : register(u0);
@@ -23,17 +26,12 @@ RWTexture2DArray<float4> u_Gradients : register(u0);
 [numthreads(8, 8, 1)]
 void main(uint2 globalIdx : SV_DispatchThreadID)
 {
-    if (any(globalIdx.xy >= g_Const.viewportSize))
+    if (any(globalIdx.xy >= g_Const.gradientSize))
         return;
 
-    // The filtering step increases with each pass
-    int2 step = 1l << g_Const.passIndex;
+    const int2 step = GetGradientFilterStep(g_Const.passIndex, g_Const.checkerboard);
     const int inputBuffer = g_Const.passIndex & 1;
 
-    // Preserve the filter aspect ratio when the gradients are half-resolution in the X dimension
-    if (g_Const.checkerboard)
-        step.x >>= 1;
-
     float4 acc = 0;
     float wSum = 0;
 
@@ -44,10 +42,9 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
         int2 pos = globalIdx.xy + int2(xx, yy) * step;
         float4 c = u_Gradients[int3(pos, inputBuffer)];
 
-        if (all(pos >= 0) && all(pos < int2(g_Const.viewportSize)))
+        if (IsInsideGradients(pos, g_Const.gradientSize))
         {
-            // Triangular filter kernel produces a smooth result after a few iterations
-            float w = (xx == 0 ? 1.0 : 0.5) * (yy == 0 ? 1.0 : 0.5);
+            float w = GetGradientFilterWeight(xx, yy);
 
             acc += c * w;
             wSum += w;
@@ -59,3 +56,29 @@ void main(uint2 globalIdx : SV_DispatchThreadID)
 
     u_Gradients[int3(globalIdx, !inputBuffer)] = acc;
 }
+
+// The fused variant runs all filter passes in one dispatch, see FilterGradientTile.
+// The result goes into the second slice of the gradients texture because the first one is read
+// by the neighboring groups' halos.
+
+[numthreads(FILTER_GRADIENTS_FUSED_TILE_SIZE, FILTER_GRADIENTS_FUSED_TILE_SIZE, 1)]
+void FusedFilter(uint2 groupIdx : SV_GroupID, uint2 localIdx : SV_GroupThreadID, uint threadIdx : SV_GroupIndex)
+{
+    const int2 regionOrigin = GetGradientRegionOrigin(groupIdx);
+
+    // Load the tile with its halo
+    for (uint i = threadIdx; i < GRADIENT_REGION_SIZE * GRADIENT_REGION_SIZE; i += GRADIENT_TILE_THREAD_COUNT)
+    {
+        int2 pos = regionOrigin + int2(i % GRADIENT_REGION_SIZE, i / GRADIENT_REGION_SIZE);
+        SetGradientTexel(i, IsInsideGradients(pos, g_Const.gradientSize) ? u_Gradients[int3(pos, 0)] : 0);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    FilterGradientTile(regionOrigin, threadIdx, g_Const.gradientSize, g_Const.checkerboard);
+
+    const int2 outputPos = int2(groupIdx * FILTER_GRADIENTS_FUSED_TILE_SIZE + localIdx);
+
+    if (IsInsideGradients(outputPos, g_Const.gradientSize))
+        u_Gradients[int3(outputPos, 1)] = GetGradientTexel(int2(localIdx) + GRADIENT_TILE_HALO);
+}
@@ -0,0 +1,155 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#ifndef GRADIENT_FILTER_HLSLI
+#define GRADIENT_FILTER_HLSLI
+
+#include "ShaderParameters.h"
+
+// The A-trous spatial filter of the gradients, shared by FilterGradientsPass and the fused ConfidencePass.
+// The C++ reference of the filter, FilterGradientsReference, must be kept in sync with it.
+
+bool IsInsideGradients(int2 pos, uint2 gradientSize)
+{
+    return all(pos >= 0) && all(pos < int2(gradientSize));
+}
+
+int2 GetGradientFilterStep(int passIndex, bool checkerboard)
+{
+    // The filtering step increases with each pass
+    int2 step = 1l << passIndex;
+
+    // Preserve the filter aspect ratio when the gradients are half-resolution in the X dimension
+    if (checkerboard)
+        step.x >>= 1;
+
+    return step;
+}
+
+// Triangular filter kernel produces a smooth result after a few iterations
+float GetGradientFilterWeight(int xx, int yy)
+{
+    return (xx == 0 ? 1.0 : 0.5) * (yy == 0 ? 1.0 : 0.5);
+}
+
+#ifdef GRADIENT_TILE_MARGIN
+
+// The tile version runs all filter passes on a group's tile of FILTER_GRADIENTS_FUSED_TILE_SIZE texels in shared memory.
+// The caller loads the tile with a halo that is wide enough for all passes and GRADIENT_TILE_MARGIN more texels,
+// which are also filtered. The area that still has valid inputs shrinks by the filter step after every pass.
+
+#define GRADIENT_TILE_HALO (FILTER_GRADIENTS_FUSED_HALO + GRADIENT_TILE_MARGIN)
+#define GRADIENT_REGION_SIZE (FILTER_GRADIENTS_FUSED_TILE_SIZE + GRADIENT_TILE_HALO * 2)
+#define GRADIENT_TILE_THREAD_COUNT (FILTER_GRADIENTS_FUSED_TILE_SIZE * FILTER_GRADIENTS_FUSED_TILE_SIZE)
+
+// The first pass has a step of 1 and updates the largest area, i.e. the region minus a 1 texel border
+#define GRADIENT_TILE_MAX_TEXELS_PER_THREAD (((GRADIENT_REGION_SIZE - 2) * (GRADIENT_REGION_SIZE - 2) + GRADIENT_TILE_THREAD_COUNT - 1) / GRADIENT_TILE_THREAD_COUNT)
+
+// The gradients are stored as float16 to match the precision of the multi-pass version and to save space
+groupshared uint2 s_Gradients[GRADIENT_REGION_SIZE * GRADIENT_REGION_SIZE];
+
+uint2 PackGradient(float4 gradient)
+{
+    return uint2(
+        f32tof16(gradient.x) | (f32tof16(gradient.y) << 16),
+        f32tof16(gradient.z) | (f32tof16(gradient.w) << 16));
+}
+
+float4 UnpackGradient(uint2 packed)
+{
+    return float4(
+        f16tof32(packed.x),
+        f16tof32(packed.x >> 16),
+        f16tof32(packed.y),
+        f16tof32(packed.y >> 16));
+}
+
+// Returns the gradients texel position of the first texel in the group's region
+int2 GetGradientRegionOrigin(uint2 groupIdx)
+{
+    return int2(groupIdx * FILTER_GRADIENTS_FUSED_TILE_SIZE) - GRADIENT_TILE_HALO;
+}
+
+void SetGradientTexel(uint regionIndex, float4 gradient)
+{
+    s_Gradients[regionIndex] = PackGradient(gradient);
+}
+
+float4 GetGradientTexel(int2 regionPos)
+{
+    return UnpackGradient(s_Gradients[regionPos.y * GRADIENT_REGION_SIZE + regionPos.x]);
+}
+
+// Filters the loaded region in place. Texels outside of the gradients are not used.
+void FilterGradientTile(int2 regionOrigin, uint threadIdx, uint2 gradientSize, bool checkerboard)
+{
+    int margin = GRADIENT_TILE_HALO;
+
+    for (int passIndex = 0; passIndex < FILTER_GRADIENTS_PASS_COUNT; passIndex++)
+    {
+        const int2 step = GetGradientFilterStep(passIndex, checkerboard);
+
+        // Texels within the remaining margin still have all their taps filtered by the previous passes
+        margin -= 1 << passIndex;
+        const int areaSize = FILTER_GRADIENTS_FUSED_TILE_SIZE + margin * 2;
+        const int areaOffset = GRADIENT_TILE_HALO - margin;
+
+        uint2 results[GRADIENT_TILE_MAX_TEXELS_PER_THREAD];
+
+        [unroll] for (int n = 0; n < GRADIENT_TILE_MAX_TEXELS_PER_THREAD; n++)
+        {
+            const uint i = threadIdx + n * GRADIENT_TILE_THREAD_COUNT;
+            const int2 regionPos = int2(i % areaSize, i / areaSize) + areaOffset;
+
+            results[n] = 0;
+
+            if (i >= uint(areaSize * areaSize) || !IsInsideGradients(regionOrigin + regionPos, gradientSize))
+                continue;
+
+            float4 acc = 0;
+            float wSum = 0;
+
+            // Same taps and order as in the multi-pass version
+            [unroll] for (int yy = -1; yy <= 1; ++yy)
+            [unroll] for (int xx = -1; xx <= 1; ++xx)
+            {
+                int2 pos = regionPos + int2(xx, yy) * step;
+
+                if (IsInsideGradients(regionOrigin + pos, gradientSize))
+                {
+                    float w = GetGradientFilterWeight(xx, yy);
+
+                    acc += GetGradientTexel(pos) * w;
+                    wSum += w;
+                }
+            }
+
+            results[n] = PackGradient(acc / wSum);
+        }
+
+        // All threads must finish reading the previous pass before it's overwritten
+        GroupMemoryBarrierWithGroupSync();
+
+        [unroll] for (int n = 0; n < GRADIENT_TILE_MAX_TEXELS_PER_THREAD; n++)
+        {
+            const uint i = threadIdx + n * GRADIENT_TILE_THREAD_COUNT;
+            const int2 regionPos = int2(i % areaSize, i / areaSize) + areaOffset;
+
+            if (i < uint(areaSize * areaSize) && IsInsideGradients(regionOrigin + regionPos, gradientSize))
+                s_Gradients[regionPos.y * GRADIENT_REGION_SIZE + regionPos.x] = results[n];
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+    }
+}
+
+#endif // GRADIENT_TILE_MARGIN
+
+#endif // GRADIENT_FILTER_HLSLI
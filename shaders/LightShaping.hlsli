@@ -18,6 +18,7 @@ struct LightShaping
     float cosConeSoftness;
     uint isSpot;
     int iesProfileIndex;
+    uint iesProfileRows;
 };
 
 LightShaping unpackLightShaping(PolymorphicLightInfo lightInfo)
@@ -28,10 +29,12 @@ LightShaping unpackLightShaping(PolymorphicLightInfo lightInfo)
     shaping.cosConeAngle = f16tof32(lightInfo.cosConeAngleAndSoftness);
     shaping.cosConeSoftness = f16tof32(lightInfo.cosConeAngleAndSoftness >> 16);
     shaping.iesProfileIndex = (lightInfo.colorTypeAndFlags & kPolymorphicLightIesProfileEnableBit) ? lightInfo.iesProfileIndex : -1;
+    shaping.iesProfileRows = lightInfo.iesProfileRows;
     return shaping;
 }
 
-float evaluateIesProfile(int profileIndex, float3 emissionDirection_, float3 lightPrimaryAxis)
+// Samples the band of the IES profile atlas that holds the profile, see IesProfileAtlas.
+float evaluateIesProfile(int profileIndex, uint profileRows, float3 emissionDirection_, float3 lightPrimaryAxis)
 {
     if (profileIndex < 0)
         return 1.0;
@@ -54,7 +57,17 @@ float evaluateIesProfile(int profileIndex, float3 emissionDirection_, float3 lig
 
     Texture2D<float4> iesProfileTexture = t_BindlessTextures[NonUniformResourceIndex(profileIndex)];
 
-    float iesMultiplier = iesProfileTexture.SampleLevel(IES_SAMPLER, float2(normAngle, normTangentAngle), 0).x;
+    float atlasWidth, atlasHeight;
+    iesProfileTexture.GetDimensions(atlasWidth, atlasHeight);
+
+    // Keep the bilinear footprint inside the band, so that the neighboring profiles don't bleed in
+    const float firstRow = float(profileRows & 0xffff);
+    const float rowCount = float(profileRows >> 16);
+    float2 uv;
+    uv.x = clamp(normAngle * atlasWidth, 0.5, atlasWidth - 0.5) / atlasWidth;
+    uv.y = (firstRow + clamp(normTangentAngle * rowCount, 0.5, rowCount - 0.5)) / atlasHeight;
+
+    float iesMultiplier = iesProfileTexture.SampleLevel(IES_SAMPLER, uv, 0).x;
 
     return iesMultiplier;
 }
@@ -74,7 +87,7 @@ float3 evaluateLightShaping(LightShaping shaping, float3 surfacePosition, float3
     if (softSpotlight <= 0)
         return 0.0;
 
-    const float iesMultiplier = evaluateIesProfile(shaping.iesProfileIndex,
+    const float iesMultiplier = evaluateIesProfile(shaping.iesProfileIndex, shaping.iesProfileRows,
         lightToSurface, shaping.primaryAxis);
 
     return softSpotlight * iesMultiplier;
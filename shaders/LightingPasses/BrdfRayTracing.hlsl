@@ -26,13 +26,17 @@ static const float c_MaxIndirectRadiance = 10;
 
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
-void main(uint2 GlobalIndex : SV_DispatchThreadID)
+void main(uint2 GroupIndex : SV_GroupID, uint2 LocalIndex : SV_GroupThreadID)
 #else
 [shader("raygeneration")]
 void RayGen()
 #endif
 {
-#if !USE_RAY_QUERY
+#if USE_RAY_QUERY
+    uint2 GlobalIndex;
+    if (!GetScreenSpaceDispatchIndex(GroupIndex, LocalIndex, GlobalIndex))
+        return;
+#else
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
     uint2 pixelPosition = RTXDI_ReservoirPosToPixelPos(GlobalIndex, g_Const.runtimeParams.activeCheckerboardField);
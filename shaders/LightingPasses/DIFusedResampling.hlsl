@@ -33,13 +33,17 @@
 
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
-void main(uint2 GlobalIndex : SV_DispatchThreadID, uint2 LocalIndex : SV_GroupThreadID)
+void main(uint2 GroupIndex : SV_GroupID, uint2 LocalIndex : SV_GroupThreadID)
 #else
 [shader("raygeneration")]
 void RayGen()
 #endif
 {
-#if !USE_RAY_QUERY
+#if USE_RAY_QUERY
+    uint2 GlobalIndex;
+    if (!GetScreenSpaceDispatchIndex(GroupIndex, LocalIndex, GlobalIndex))
+        return;
+#else
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
 
@@ -52,8 +56,10 @@ void RayGen()
 
     RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
 
+    const float sampleBudgetScale = GetSampleBudgetScale(pixelPosition);
+
     RTXDI_SampleParameters sampleParams = RTXDI_InitSampleParameters(
-        g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples,
+        ScaleSampleCount(g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples, sampleBudgetScale, rng),
         g_Const.restirDI.initialSamplingParams.numPrimaryInfiniteLightSamples,
         g_Const.restirDI.initialSamplingParams.numPrimaryEnvironmentSamples,
         g_Const.restirDI.initialSamplingParams.numPrimaryBrdfSamples,
@@ -98,8 +104,8 @@ void RayGen()
     stparams.biasCorrectionMode = g_Const.restirDI.temporalResamplingParams.temporalBiasCorrection;
     stparams.depthThreshold = g_Const.restirDI.temporalResamplingParams.temporalDepthThreshold;
     stparams.normalThreshold = g_Const.restirDI.temporalResamplingParams.temporalNormalThreshold;
-    stparams.numSamples = g_Const.restirDI.spatialResamplingParams.numSpatialSamples + 1;
-    stparams.numDisocclusionBoostSamples = g_Const.restirDI.spatialResamplingParams.numDisocclusionBoostSamples;
+    stparams.numSamples = ScaleSampleCount(g_Const.restirDI.spatialResamplingParams.numSpatialSamples, sampleBudgetScale, rng) + 1;
+    stparams.numDisocclusionBoostSamples = ScaleSampleCount(g_Const.restirDI.spatialResamplingParams.numDisocclusionBoostSamples, sampleBudgetScale, rng);
     stparams.samplingRadius = g_Const.restirDI.spatialResamplingParams.spatialSamplingRadius;
     stparams.enableVisibilityShortcut = g_Const.restirDI.temporalResamplingParams.discardInvisibleSamples;
     stparams.enablePermutationSampling = usePermutationSampling;
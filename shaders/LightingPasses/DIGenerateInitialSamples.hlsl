@@ -16,13 +16,17 @@
 
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
-void main(uint2 GlobalIndex : SV_DispatchThreadID)
+void main(uint2 GroupIndex : SV_GroupID, uint2 LocalIndex : SV_GroupThreadID)
 #else
 [shader("raygeneration")]
 void RayGen()
 #endif
 {
-#if !USE_RAY_QUERY
+#if USE_RAY_QUERY
+    uint2 GlobalIndex;
+    if (!GetScreenSpaceDispatchIndex(GroupIndex, LocalIndex, GlobalIndex))
+        return;
+#else
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
 
@@ -35,8 +39,10 @@ void RayGen()
 
     RAB_Surface surface = RAB_GetGBufferSurface(pixelPosition, false);
 
+    const float sampleBudgetScale = GetSampleBudgetScale(pixelPosition);
+
     RTXDI_SampleParameters sampleParams = RTXDI_InitSampleParameters(
-        g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples,
+        ScaleSampleCount(g_Const.restirDI.initialSamplingParams.numPrimaryLocalLightSamples, sampleBudgetScale, rng),
         g_Const.restirDI.initialSamplingParams.numPrimaryInfiniteLightSamples,
         g_Const.restirDI.initialSamplingParams.numPrimaryEnvironmentSamples,
         g_Const.restirDI.initialSamplingParams.numPrimaryBrdfSamples,
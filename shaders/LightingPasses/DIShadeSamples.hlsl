@@ -27,13 +27,17 @@
 
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
-void main(uint2 GlobalIndex : SV_DispatchThreadID, uint2 LocalIndex : SV_GroupThreadID, uint2 GroupIdx : SV_GroupID)
+void main(uint2 GroupIndex : SV_GroupID, uint2 LocalIndex : SV_GroupThreadID)
 #else
 [shader("raygeneration")]
 void RayGen()
 #endif
 {
-#if !USE_RAY_QUERY
+#if USE_RAY_QUERY
+    uint2 GlobalIndex;
+    if (!GetScreenSpaceDispatchIndex(GroupIndex, LocalIndex, GlobalIndex))
+        return;
+#else
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
 
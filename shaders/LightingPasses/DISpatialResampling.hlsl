@@ -16,13 +16,17 @@
 
 #if USE_RAY_QUERY
 [numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
-void main(uint2 GlobalIndex : SV_DispatchThreadID)
+void main(uint2 GroupIndex : SV_GroupID, uint2 LocalIndex : SV_GroupThreadID)
 #else
 [shader("raygeneration")]
 void RayGen()
 #endif
 {
-#if !USE_RAY_QUERY
+#if USE_RAY_QUERY
+    uint2 GlobalIndex;
+    if (!GetScreenSpaceDispatchIndex(GroupIndex, LocalIndex, GlobalIndex))
+        return;
+#else
     uint2 GlobalIndex = DispatchRaysIndex().xy;
 #endif
 
@@ -41,10 +45,12 @@ void RayGen()
         RTXDI_DIReservoir centerSample = RTXDI_LoadDIReservoir(g_Const.restirDI.reservoirBufferParams,
             GlobalIndex, g_Const.restirDI.bufferIndices.spatialResamplingInputBufferIndex);
 
+        const float sampleBudgetScale = GetSampleBudgetScale(pixelPosition);
+
         RTXDI_DISpatialResamplingParameters sparams;
         sparams.sourceBufferIndex = g_Const.restirDI.bufferIndices.spatialResamplingInputBufferIndex;
-        sparams.numSamples = g_Const.restirDI.spatialResamplingParams.numSpatialSamples;
-        sparams.numDisocclusionBoostSamples = g_Const.restirDI.spatialResamplingParams.numDisocclusionBoostSamples;
+        sparams.numSamples = ScaleSampleCount(g_Const.restirDI.spatialResamplingParams.numSpatialSamples, sampleBudgetScale, rng);
+        sparams.numDisocclusionBoostSamples = ScaleSampleCount(g_Const.restirDI.spatialResamplingParams.numDisocclusionBoostSamples, sampleBudgetScale, rng);
         sparams.targetHistoryLength = g_Const.restirDI.temporalResamplingParams.maxHistoryLength;
         sparams.biasCorrectionMode = g_Const.restirDI.spatialResamplingParams.spatialBiasCorrection;
         sparams.samplingRadius = g_Const.restirDI.spatialResamplingParams.spatialSamplingRadius;
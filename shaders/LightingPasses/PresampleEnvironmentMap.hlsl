@@ -12,11 +12,52 @@
 
 #include <rtxdi/PresamplingFunctions.hlsli>
 
+// Selects a texel of mip 0 with one alias table lookup, instead of descending the PDF mip chain.
+// Stores the sample in the same format as RTXDI_PresampleEnvironmentMap.
+void PresampleEnvironmentMapAliasTable(
+    inout RAB_RandomSamplerState rng,
+    uint2 pdfTextureSize,
+    uint tileIndex,
+    uint sampleInTile,
+    RTXDI_RISBufferSegmentParameters params)
+{
+    // Use all 32 random bits for the entry index, the float randoms only have 23 bits which is not enough for large maps.
+    uint texelCount = pdfTextureSize.x * pdfTextureSize.y;
+    uint texelIndex = murmur3(rng) % texelCount;
+
+    uint2 entry = t_EnvironmentAliasTable[texelIndex];
+    if (RAB_GetNextRandom(rng) >= asfloat(entry.y))
+        texelIndex = entry.x;
+
+    uint2 texelPosition = uint2(texelIndex % pdfTextureSize.x, texelIndex / pdfTextureSize.x);
+    float pdf = t_EnvironmentPdfTexture[texelPosition].r * g_Const.environmentAliasTableInvTotalWeight;
+
+    // Uniform position inside the texel, the PDF texels don't necessarily match the environment map texels
+    float2 uv = (float2(texelPosition) + float2(RAB_GetNextRandom(rng), RAB_GetNextRandom(rng))) / float2(pdfTextureSize);
+    uint packedUv = uint(saturate(uv.x) * 0xffff) | (uint(saturate(uv.y) * 0xffff) << 16);
+
+    float invPdf = (pdf > 0) ? 1.0 / pdf : 0;
+
+    uint risBufferPtr = params.bufferOffset + tileIndex * params.tileSize + sampleInTile;
+    RTXDI_RIS_BUFFER[risBufferPtr] = uint2(packedUv, asuint(invPdf));
+}
+
 [numthreads(RTXDI_PRESAMPLING_GROUP_SIZE, 1, 1)] 
 void main(uint2 GlobalIndex : SV_DispatchThreadID) 
 {    
     RAB_RandomSamplerState rng = RAB_InitRandomSampler(GlobalIndex.xy, 0);
 
+    if (g_Const.useEnvironmentAliasTable)
+    {
+        PresampleEnvironmentMapAliasTable(
+            rng,
+            g_Const.environmentPdfTextureSize,
+            GlobalIndex.y,
+            GlobalIndex.x,
+            g_Const.environmentLightRISBufferSegmentParams);
+        return;
+    }
+
     RTXDI_PresampleEnvironmentMap(
         rng,
         t_EnvironmentPdfTexture,
@@ -50,6 +50,8 @@ Texture2D<uint> t_PrevGBufferSpecularRough : register(t9);
 Texture2D<float2> t_PrevRestirLuminance : register(t10);
 Texture2D<float4> t_MotionVectors : register(t11);
 Texture2D<float4> t_DenoiserNormalRoughness : register(t12);
+Texture2D<float> t_SampleBudget : register(t13);
+Buffer<uint> t_ValidTiles : register(t15);
 
 // Scene resources
 RaytracingAccelerationStructure SceneBVH : register(t30);
@@ -65,6 +67,7 @@ Buffer<uint> t_LightIndexMappingBuffer : register(t22);
 Texture2D t_EnvironmentPdfTexture : register(t23);
 Texture2D t_LocalLightPdfTexture : register(t24);
 StructuredBuffer<uint> t_GeometryInstanceToLight : register(t25);
+StructuredBuffer<uint2> t_EnvironmentAliasTable : register(t26);
 
 // Screen-sized UAVs
 RWStructuredBuffer<RTXDI_PackedDIReservoir> u_LightReservoirs : register(u0);
@@ -522,6 +525,10 @@ float RAB_EvaluateEnvironmentMapSamplingPdf(float3 L)
     uint2 pdfTextureSize = g_Const.environmentPdfTextureSize.xy;
     uint2 texelPosition = uint2(pdfTextureSize * uv);
     float texelValue = t_EnvironmentPdfTexture[texelPosition].r;
+
+    // The alias table samples the texels of mip 0 directly, proportional to their weights.
+    if (g_Const.useEnvironmentAliasTable)
+        return texelValue * g_Const.environmentAliasTableInvTotalWeight;
     
     int lastMipLevel = max(0, int(floor(log2(max(pdfTextureSize.x, pdfTextureSize.y)))));
     float averageValue = t_EnvironmentPdfTexture.mips[lastMipLevel][uint2(0, 0)].x;
@@ -900,5 +907,49 @@ bool RAB_GetTemporalConservativeVisibility(RAB_Surface currentSurface, RAB_Surfa
         return GetConservativeVisibility(SceneBVH, currentSurface, samplePosition);
 }
 
+// Returns the factor for the DI sample counts of the pixel's tile when the adaptive sample budget is enabled.
+// The global sample counts are the cap: a tile that needs every sample keeps them, and confident tiles get fewer,
+// so a static view costs less instead of moving the samples to other tiles.
+float GetSampleBudgetScale(uint2 pixelPosition)
+{
+    if (!g_Const.enableAdaptiveSampleBudget)
+        return 1.0;
+
+    float tileNeed = t_SampleBudget[pixelPosition / SAMPLE_BUDGET_TILE_SIZE];
+
+    return clamp(tileNeed, g_Const.minSampleBudgetScale, 1.0);
+}
+
+// Scales a sample count with stochastic rounding, which preserves the average count.
+// A non-zero count never goes to zero.
+uint ScaleSampleCount(uint numSamples, float scale, inout RAB_RandomSamplerState rng)
+{
+    if (numSamples == 0 || scale == 1.0)
+        return numSamples;
+
+    uint scaledSamples = uint(float(numSamples) * scale + RAB_GetNextRandom(rng));
+    return max(scaledSamples, 1);
+}
+
+#if USE_RAY_QUERY
+// Computes the reservoir position of a thread in the screen-space compute passes. When the tile compaction
+// is enabled, the passes are dispatched indirectly, one group per tile from the list of tiles with valid surfaces.
+// Returns false for the groups that pad the last row of such a dispatch.
+bool GetScreenSpaceDispatchIndex(uint2 groupIndex, uint2 localIndex, out uint2 globalIndex)
+{
+    globalIndex = groupIndex * RTXDI_SCREEN_SPACE_GROUP_SIZE + localIndex;
+
+    if (!g_Const.enableTileCompaction)
+        return true;
+
+    uint packedTile = t_ValidTiles[groupIndex.y * TILE_COMPACTION_DISPATCH_WIDTH + groupIndex.x];
+    if (packedTile == TILE_COMPACTION_INVALID_TILE)
+        return false;
+
+    uint2 tile = uint2(packedTile & 0xffff, packedTile >> 16);
+    globalIndex = tile * RTXDI_SCREEN_SPACE_GROUP_SIZE + localIndex;
+    return true;
+}
+#endif
 
 #endif // RTXDI_APPLICATION_BRIDGE_HLSLI
@@ -114,25 +114,19 @@ void StoreShadingOutput(
         specular += priorSpecular.rgb;
     }
 
-    if (g_Const.denoiserMode == DENOISER_MODE_OFF && g_Const.runtimeParams.activeCheckerboardField != 0 && isLastPass)
+    // Without a denoiser, the compositing pass reconstructs the inactive checkerboard field from the active one.
+    // When accumulating, the fields alternate between frames, so the other field is black and this one counts twice.
+    if (g_Const.denoiserMode == DENOISER_MODE_OFF && g_Const.runtimeParams.activeCheckerboardField != 0 && isLastPass && g_Const.enableAccumulation)
     {
         int2 otherFieldPixelPosition = pixelPosition;
         otherFieldPixelPosition.x += (g_Const.runtimeParams.activeCheckerboardField == 1) == ((pixelPosition.y & 1) != 0)
             ? 1 : -1;
 
-        if (g_Const.denoiserMode == DENOISER_MODE_RELAX || g_Const.enableAccumulation)
-        {
-            diffuse *= 2;
-            specular *= 2;
+        diffuse *= 2;
+        specular *= 2;
 
-            u_DiffuseLighting[otherFieldPixelPosition] = 0;
-            u_SpecularLighting[otherFieldPixelPosition] = 0;
-        }
-        else // g_Const.denoiserMode == DENOISER_MODE_OFF
-        {
-            u_DiffuseLighting[otherFieldPixelPosition] = float4(diffuse, 0);
-            u_SpecularLighting[otherFieldPixelPosition] = float4(specular, 0);
-        }
+        u_DiffuseLighting[otherFieldPixelPosition] = 0;
+        u_SpecularLighting[otherFieldPixelPosition] = 0;
     }
 
 #if WITH_NRD
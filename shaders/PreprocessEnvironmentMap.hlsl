@@ -13,10 +13,40 @@
 #include <rtxdi/RtxdiMath.hlsli>
 #include <donut/shaders/vulkan.hlsli>
 
-RWTexture2D<float> u_IntegratedMips[] : register(u0);
+// The counters are written by one thread group and read by another, and so are the mip levels at the stage boundaries.
+globallycoherent RWBuffer<uint> u_StageCounters : register(u0);
+globallycoherent RWTexture2D<float> u_IntegratedMips[] : register(u1);
 
 VK_PUSH_CONSTANT ConstantBuffer<PreprocessEnvironmentMapConstants> g_Const : register(b0);
 
+// Every thread group reduces a 32x32 tile of the stage's source mip level into 5 smaller levels.
+// The last group to finish among the 32x32 tiles that make up one tile of the next stage goes on to reduce that tile,
+// and so on, until a single group writes the 1x1 level. This way, the whole mip chain is built in one dispatch.
+static const uint c_TileSize = 32;
+static const uint c_MipLevelsPerStage = 5;
+
+uint2 GetMipSize(uint mipLevel)
+{
+    return max(g_Const.destSize >> mipLevel, 1);
+}
+
+uint2 GetStageTileCount(uint stage)
+{
+    return (GetMipSize(stage * c_MipLevelsPerStage) + c_TileSize - 1) / c_TileSize;
+}
+
+// The counters of all stages except the first one are packed into one buffer.
+uint GetStageCounterOffset(uint stage)
+{
+    uint offset = 0;
+    for (uint previousStage = 1; previousStage < stage; previousStage++)
+    {
+        uint2 tileCount = GetStageTileCount(previousStage);
+        offset += tileCount.x * tileCount.y;
+    }
+    return offset;
+}
+
 #if INPUT_ENVIRONMENT_MAP
 Texture2D<float4> t_EnvironmentMap : register(t0);
 
@@ -28,7 +58,7 @@ float getPixelWeight(uint2 position)
     // Do not sample invalid colors.
     if (isinf(luma) || isnan(luma))
         return 0;
-    
+
     // Compute the solid angle of the pixel assuming equirectangular projection.
     // We don't need the absolute value of the solid angle here, just one at the same scale as the other pixels.
     float elevation = ((float(position.y) + 0.5) / float(g_Const.sourceSize.y) - 0.5) * c_pi;
@@ -38,124 +68,161 @@ float getPixelWeight(uint2 position)
 
     return clamp(luma * relativeSolidAngle, 0, maxWeight);
 }
-#endif
-
-groupshared float s_weights[16];
 
-// Warning: do not change the group size. The algorithm is hardcoded to process 16x16 tiles.
-[numthreads(256, 1, 1)]
-void main(uint2 GroupIndex : SV_GroupID, uint ThreadIndex : SV_GroupThreadID)
+// The PDF texture has power-of-two dimensions so that the mip descent in the presampling pass can reach every texel.
+// When the environment map doesn't, a PDF texel covers a fractional footprint of the map: average the weights under it.
+float getPdfTexelWeight(uint2 position)
 {
-    uint2 LocalIndex = RTXDI_LinearIndexToZCurve(ThreadIndex);
-    uint2 GlobalIndex = (GroupIndex * 16) + LocalIndex;
-
-    // Step 0: Load a 2x2 quad of pixels from the source texture or the source mip level.
-    float4 sourceWeights;
-#if INPUT_ENVIRONMENT_MAP
-    if (g_Const.sourceMipLevel == 0)
-    {
-        uint2 sourcePos = GlobalIndex.xy * 2;
-
-        sourceWeights.x = getPixelWeight(sourcePos + int2(0, 0));
-        sourceWeights.y = getPixelWeight(sourcePos + int2(0, 1));
-        sourceWeights.z = getPixelWeight(sourcePos + int2(1, 0));
-        sourceWeights.w = getPixelWeight(sourcePos + int2(1, 1));
-
-        RWTexture2D<float> dest = u_IntegratedMips[0];
-        dest[sourcePos + int2(0, 0)] = sourceWeights.x;
-        dest[sourcePos + int2(0, 1)] = sourceWeights.y;
-        dest[sourcePos + int2(1, 0)] = sourceWeights.z;
-        dest[sourcePos + int2(1, 1)] = sourceWeights.w;
-    }
-    else
-#endif
-    {
-        uint2 sourcePos = GlobalIndex.xy * 2;
-
-        RWTexture2D<float> src = u_IntegratedMips[g_Const.sourceMipLevel];
-        sourceWeights.x = src[sourcePos + int2(0, 0)];
-        sourceWeights.y = src[sourcePos + int2(0, 1)];
-        sourceWeights.z = src[sourcePos + int2(1, 0)];
-        sourceWeights.w = src[sourcePos + int2(1, 1)];
-    }
-
-    uint mipLevelsToWrite = g_Const.numDestMipLevels - g_Const.sourceMipLevel - 1;
-    if (mipLevelsToWrite < 1) return;
-
-    // Average those weights and write out the first mip.
-    float weight = (sourceWeights.x + sourceWeights.y + sourceWeights.z + sourceWeights.w) * 0.25;
-
-    u_IntegratedMips[g_Const.sourceMipLevel + 1][GlobalIndex.xy] = weight;
-
-    if (mipLevelsToWrite < 2) return;
-
-    // The following sequence is an optimized hierarchical downsampling algorithm using wave ops.
-    // It assumes that the wave size is at least 16 lanes, which is true for both NV and AMD GPUs.
-    // It also assumes that the threads are laid out in the group using the Z-curve pattern.
-
-    // Step 1: Average 2x2 groups of pixels.
-    uint lane = WaveGetLaneIndex();
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 1)
-        + WaveReadLaneAt(weight, lane + 2)
-        + WaveReadLaneAt(weight, lane + 3)) * 0.25;
-
-    if ((lane & 3) == 0)
-    {
-        u_IntegratedMips[g_Const.sourceMipLevel + 2][GlobalIndex.xy >> 1] = weight;
-    }
+    if (any(position >= g_Const.destSize))
+        return 0;
 
-    if (mipLevelsToWrite < 3) return;
+    if (all(g_Const.sourceSize == g_Const.destSize))
+        return getPixelWeight(position);
 
-    // Step 2: Average the previous results from 2 pixels away.
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 4)
-        + WaveReadLaneAt(weight, lane + 8)
-        + WaveReadLaneAt(weight, lane + 12)) * 0.25;
+    float2 scale = float2(g_Const.sourceSize) / float2(g_Const.destSize);
+    float2 begin = float2(position) * scale;
+    float2 end = begin + scale;
+    uint2 first = uint2(begin);
+    uint2 last = min(uint2(ceil(end)) - 1, g_Const.sourceSize - 1);
 
-    if ((lane & 15) == 0)
+    float sum = 0;
+    for (uint y = first.y; y <= last.y; y++)
     {
-        u_IntegratedMips[g_Const.sourceMipLevel + 3][GlobalIndex.xy >> 2] = weight;
+        float coverageY = min(end.y, float(y + 1)) - max(begin.y, float(y));
 
-        // Store the intermediate result into shared memory.
-        s_weights[ThreadIndex >> 4] = weight;
+        for (uint x = first.x; x <= last.x; x++)
+        {
+            float coverageX = min(end.x, float(x + 1)) - max(begin.x, float(x));
+            sum += coverageX * coverageY * getPixelWeight(uint2(x, y));
+        }
     }
 
-    if (mipLevelsToWrite < 4) return;
+    return sum / (scale.x * scale.y);
+}
+#endif
 
-    GroupMemoryBarrierWithGroupSync();
+// Texels outside of the level are zero, which pads the non-square levels to a square shape.
+float loadWeight(uint mipLevel, uint2 position)
+{
+    if (any(position >= GetMipSize(mipLevel)))
+        return 0;
 
-    // The rest operates on a 4x4 group of values for the entire thread group
-    if (ThreadIndex >= 16)
-        return;
+    return u_IntegratedMips[mipLevel][position];
+}
 
-    // Load the intermediate results
-    weight = s_weights[ThreadIndex];
+void storeWeight(uint mipLevel, uint2 position, float weight)
+{
+    if (all(position < GetMipSize(mipLevel)))
+        u_IntegratedMips[mipLevel][position] = weight;
+}
 
-    // Change the output texture addressing because we'll be only writing a 2x2 block of pixels
-    GlobalIndex = (GroupIndex * 2) + (LocalIndex >> 1);
+groupshared float s_weights[256];
+groupshared bool s_isLastGroup;
 
-    // Step 3: Average the previous results from adjacent threads, meaning from 4 pixels away.
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 1)
-        + WaveReadLaneAt(weight, lane + 2)
-        + WaveReadLaneAt(weight, lane + 3)) * 0.25;
+[numthreads(256, 1, 1)]
+void main(uint2 GroupIndex : SV_GroupID, uint ThreadIndex : SV_GroupIndex)
+{
+    // Linear layout within the group: no assumptions about the wave size or the lane order.
+    uint2 localIndex = uint2(ThreadIndex % 16, ThreadIndex / 16);
+    uint2 tile = GroupIndex;
 
-    if ((lane & 3) == 0)
+    for (uint stage = 0; ; stage++)
     {
-        u_IntegratedMips[g_Const.sourceMipLevel + 4][GlobalIndex.xy] = weight;
-    }
-
-    if (mipLevelsToWrite < 5) return;
+        uint sourceMipLevel = stage * c_MipLevelsPerStage;
+        uint mipLevelsToWrite = min(c_MipLevelsPerStage, g_Const.numDestMipLevels - 1 - sourceMipLevel);
 
-    // Step 4: Average the previous results from 8 pixels away.
-    weight = (weight 
-        + WaveReadLaneAt(weight, lane + 4)
-        + WaveReadLaneAt(weight, lane + 8)
-        + WaveReadLaneAt(weight, lane + 12)) * 0.25;
+        // Step 0: Load a 2x2 quad of pixels from the source texture or the source mip level.
+        uint2 destPos = tile * (c_TileSize / 2) + localIndex;
+        uint2 sourcePos = destPos * 2;
+        float4 sourceWeights;
 
-    if (lane == 0)
-    {
-        u_IntegratedMips[g_Const.sourceMipLevel + 5][GlobalIndex.xy >> 1] = weight;
+#if INPUT_ENVIRONMENT_MAP
+        if (stage == 0)
+        {
+            sourceWeights.x = getPdfTexelWeight(sourcePos + uint2(0, 0));
+            sourceWeights.y = getPdfTexelWeight(sourcePos + uint2(1, 0));
+            sourceWeights.z = getPdfTexelWeight(sourcePos + uint2(0, 1));
+            sourceWeights.w = getPdfTexelWeight(sourcePos + uint2(1, 1));
+
+            storeWeight(0, sourcePos + uint2(0, 0), sourceWeights.x);
+            storeWeight(0, sourcePos + uint2(1, 0), sourceWeights.y);
+            storeWeight(0, sourcePos + uint2(0, 1), sourceWeights.z);
+            storeWeight(0, sourcePos + uint2(1, 1), sourceWeights.w);
+        }
+        else
+#endif
+        {
+            sourceWeights.x = loadWeight(sourceMipLevel, sourcePos + uint2(0, 0));
+            sourceWeights.y = loadWeight(sourceMipLevel, sourcePos + uint2(1, 0));
+            sourceWeights.z = loadWeight(sourceMipLevel, sourcePos + uint2(0, 1));
+            sourceWeights.w = loadWeight(sourceMipLevel, sourcePos + uint2(1, 1));
+        }
+
+        if (mipLevelsToWrite < 1)
+            return;
+
+        // Average those weights and write out the first mip.
+        float weight = (sourceWeights.x + sourceWeights.y + sourceWeights.z + sourceWeights.w) * 0.25;
+
+        storeWeight(sourceMipLevel + 1, destPos, weight);
+        s_weights[ThreadIndex] = weight;
+
+        // Steps 1-4: Average 2x2 groups of the previous results through shared memory, using a quarter of the threads each time.
+        uint levelSize = c_TileSize / 2;
+        for (uint level = 2; level <= mipLevelsToWrite; level++)
+        {
+            GroupMemoryBarrierWithGroupSync();
+
+            levelSize /= 2;
+            bool active = ThreadIndex < levelSize * levelSize;
+            uint2 position = uint2(ThreadIndex % levelSize, ThreadIndex / levelSize);
+            uint sourceIndex = position.y * 2 * (levelSize * 2) + position.x * 2;
+
+            if (active)
+            {
+                weight = (s_weights[sourceIndex]
+                    + s_weights[sourceIndex + 1]
+                    + s_weights[sourceIndex + levelSize * 2]
+                    + s_weights[sourceIndex + levelSize * 2 + 1]) * 0.25;
+            }
+
+            GroupMemoryBarrierWithGroupSync();
+
+            if (active)
+            {
+                s_weights[ThreadIndex] = weight;
+                storeWeight(sourceMipLevel + level, tile * levelSize + position, weight);
+            }
+        }
+
+        // Is there another stage?
+        if (sourceMipLevel + c_MipLevelsPerStage >= g_Const.numDestMipLevels - 1)
+            return;
+
+        // Make the results of this group visible to the group that continues with the next stage.
+        DeviceMemoryBarrierWithGroupSync();
+
+        uint2 parentTile = tile / c_TileSize;
+
+        if (ThreadIndex == 0)
+        {
+            uint2 childCount = min(GetStageTileCount(stage) - parentTile * c_TileSize, c_TileSize);
+            uint counterIndex = GetStageCounterOffset(stage + 1) + parentTile.y * GetStageTileCount(stage + 1).x + parentTile.x;
+
+            uint previousCount;
+            InterlockedAdd(u_StageCounters[counterIndex], 1, previousCount);
+            s_isLastGroup = (previousCount == childCount.x * childCount.y - 1);
+
+            // All other groups are done with this counter, reset it for the next dispatch.
+            if (s_isLastGroup)
+                u_StageCounters[counterIndex] = 0;
+        }
+
+        GroupMemoryBarrierWithGroupSync();
+
+        if (!s_isLastGroup)
+            return;
+
+        tile = parentTile;
     }
-}
\ No newline at end of file
+}
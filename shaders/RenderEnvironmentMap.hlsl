@@ -20,6 +20,12 @@ RWTexture2D<float4> u_EnvironmentMap : register(u0);
 [numthreads(16, 16, 1)]
 void main(uint2 GlobalIndex : SV_DispatchThreadId)
 {
+    // The pass may only update a band of rows, see RenderEnvironmentMapPass::Update
+    if (GlobalIndex.y >= g_Const.rowCount)
+        return;
+
+    GlobalIndex.y += g_Const.rowOffset;
+
     float2 uv = (float2(GlobalIndex) + 0.5) * g_Const.invTextureSize;
 
     float cosElevation;
@@ -0,0 +1,80 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma pack_matrix(row_major)
+
+#include "ShaderParameters.h"
+#include <donut/shaders/vulkan.hlsli>
+
+VK_PUSH_CONSTANT ConstantBuffer<SampleBudgetConstants> g_Const : register(b0);
+
+Texture2D<float> t_Depth : register(t0);
+Texture2D<float> t_PrevDepth : register(t1);
+Texture2D<float4> t_MotionVectors : register(t2);
+Texture2D<float> t_PrevDiffuseConfidence : register(t3);
+Texture2D<float> t_PrevSpecularConfidence : register(t4);
+RWTexture2D<float> u_SampleBudget : register(u0);
+
+groupshared uint s_NeedSum;
+groupshared uint s_PixelCount;
+
+// This shader estimates which fraction of the global sample counts each screen tile needs.
+// Pixels where the previous frame's confidence is high need few samples, pixels that are disoccluded
+// or where the lighting has changed need all of them. The lighting passes scale their sample counts
+// by the tile need, so the global settings are the most that any tile uses.
+
+[numthreads(SAMPLE_BUDGET_TILE_SIZE, SAMPLE_BUDGET_TILE_SIZE, 1)]
+void main(uint2 globalIdx : SV_DispatchThreadID, uint2 tileIdx : SV_GroupID, uint threadIdx : SV_GroupIndex)
+{
+    if (threadIdx == 0)
+    {
+        s_NeedSum = 0;
+        s_PixelCount = 0;
+    }
+    GroupMemoryBarrierWithGroupSync();
+
+    const float depth = all(globalIdx < g_Const.viewportSize) ? t_Depth[globalIdx] : BACKGROUND_DEPTH;
+
+    if (depth != BACKGROUND_DEPTH)
+    {
+        float confidence = 0;
+
+        // Find the previous pixel using the motion vector, same as the confidence pass.
+        float3 motionVector = t_MotionVectors[globalIdx].xyz;
+        int2 prevPos = int2(float2(globalIdx) + 0.5 + motionVector.xy);
+
+        if (all(prevPos >= 0) && all(prevPos < g_Const.viewportSize))
+        {
+            // Disoccluded pixels have no history, treat them as having zero confidence.
+            float expectedPrevDepth = depth + motionVector.z;
+            float prevDepth = t_PrevDepth[prevPos];
+
+            if (abs(prevDepth - expectedPrevDepth) <= g_Const.disocclusionDepthThreshold * expectedPrevDepth)
+            {
+                confidence = min(t_PrevDiffuseConfidence[prevPos], t_PrevSpecularConfidence[prevPos]);
+            }
+        }
+
+        float need = lerp(1.0, g_Const.convergedNeed, saturate(confidence));
+
+        InterlockedAdd(s_NeedSum, uint(need * SAMPLE_BUDGET_NEED_SCALE + 0.5));
+        InterlockedAdd(s_PixelCount, 1);
+    }
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (threadIdx == 0)
+    {
+        // Tiles without any surfaces don't use any samples
+        u_SampleBudget[tileIdx] = (s_PixelCount > 0)
+            ? float(s_NeedSum) / (SAMPLE_BUDGET_NEED_SCALE * float(s_PixelCount))
+            : 0;
+    }
+}
@@ -29,6 +29,21 @@
 #define RTXDI_GRAD_STORAGE_SCALE 256.0f
 #define RTXDI_GRAD_MAX_VALUE 65504.0f
 
+#define CONVERGENCE_ERROR_GROUP_SIZE 16
+
+#define FILTER_GRADIENTS_PASS_COUNT 4
+
+// Output tile of the fused gradient filter, and the halo needed by all filter passes: 1 + 2 + 4 + 8 texels
+#define FILTER_GRADIENTS_FUSED_TILE_SIZE 16
+#define FILTER_GRADIENTS_FUSED_HALO 15
+
+#define SAMPLE_BUDGET_TILE_SIZE 16
+#define SAMPLE_BUDGET_NEED_SCALE 255.0f
+
+// Number of thread groups in a row of the indirect dispatches over the compacted tile list
+#define TILE_COMPACTION_DISPATCH_WIDTH 256
+#define TILE_COMPACTION_INVALID_TILE 0xffffffffu
+
 #define INSTANCE_MASK_OPAQUE 0x01
 #define INSTANCE_MASK_ALPHA_TESTED 0x02
 #define INSTANCE_MASK_TRANSPARENT 0x04
@@ -56,6 +71,10 @@
 
 #define BACKGROUND_DEPTH 65504.f
 
+// Size of one IES profile in the atlas, see IesProfileAtlas
+#define IES_PROFILE_ATLAS_WIDTH 128
+#define IES_PROFILE_ATLAS_ROWS 64
+
 #define RAY_COUNT_TRACED(index) ((index) * 2)
 #define RAY_COUNT_HITS(index) ((index) * 2 + 1)
 
@@ -90,12 +109,14 @@ struct RenderEnvironmentMapConstants
     ProceduralSkyShaderParameters params;
 
     float2 invTextureSize;
+    uint rowOffset;
+    uint rowCount;
 };
 
 struct PreprocessEnvironmentMapConstants
 {
     uint2 sourceSize;
-    uint sourceMipLevel;
+    uint2 destSize;
     uint numDestMipLevels;
 };
 
@@ -148,6 +169,8 @@ struct CompositingConstants
 
     float noiseClampHigh;
     uint checkerboard;
+    uint activeCheckerboardField;
+    uint reconstructCheckerboard; // fill the inactive checkerboard field from the neighbors, see CompositingPass.hlsl
 };
 
 struct AccumulationConstants
@@ -159,9 +182,30 @@ struct AccumulationConstants
     float blendFactor;
 };
 
-struct FilterGradientsConstants
+struct TileCompactionConstants
+{
+    uint2 viewportSize;
+    uint checkerboard;
+    uint pad;
+};
+
+struct SampleBudgetConstants
 {
     uint2 viewportSize;
+    float convergedNeed;
+    float disocclusionDepthThreshold;
+};
+
+struct ConvergenceErrorConstants
+{
+    uint2 outputSize;
+    uint groupCountX;
+    uint pad;
+};
+
+struct FilterGradientsConstants
+{
+    uint2 gradientSize; // in gradient texels, i.e. the reservoir extent divided by RTXDI_GRAD_FACTOR
     int passIndex;
     uint checkerboard;
 };
@@ -177,6 +221,7 @@ struct ConfidenceConstants
     int inputBufferIndex;
 
     float blendFactor;
+    uint2 gradientSize; // only used by the fused version, see FilterGradientsConstants
 };
 
 struct VisualizationConstants
@@ -222,7 +267,7 @@ struct ResamplingConstants
     uint enableBrdfIndirect;
     uint enableBrdfAdditiveBlend;    
     uint enableAccumulation; // StoreShadingOutput
-    uint pad1;
+    uint enableAdaptiveSampleBudget;
 
     SceneConstants sceneConstants;
 
@@ -238,10 +283,16 @@ struct ResamplingConstants
     BRDFPathTracing_Parameters brdfPT;
 
     uint visualizeRegirCells;
-    uint3 pad2;
+    float minSampleBudgetScale;
+    uint pad2;
+    uint enableTileCompaction;
     
     uint2 environmentPdfTextureSize;
     uint2 localLightPdfTextureSize;
+
+    uint useEnvironmentAliasTable;
+    float environmentAliasTableInvTotalWeight;
+    uint2 pad3;
 };
 
 struct PerPassConstants
@@ -307,7 +358,7 @@ struct PolymorphicLightInfo
     uint iesProfileIndex;
     uint primaryAxis; // oct-encoded
     uint cosConeAngleAndSoftness; // 2x float16
-    uint padding;
+    uint iesProfileRows; // first row and row count in the IES profile atlas, 2x uint16
 };
 
 #endif // SHADER_PARAMETERS_H
@@ -0,0 +1,82 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma pack_matrix(row_major)
+
+#include "ShaderParameters.h"
+#include <donut/shaders/vulkan.hlsli>
+
+VK_PUSH_CONSTANT ConstantBuffer<TileCompactionConstants> g_Const : register(b0);
+
+Texture2D<float> t_Depth : register(t0);
+
+// Tile coordinates packed as (x | y << 16), in the order in which the tiles were found
+RWBuffer<uint> u_ValidTiles : register(u0);
+RWBuffer<uint> u_ValidTileCount : register(u1);
+RWBuffer<uint> u_DispatchArguments : register(u2);
+
+groupshared bool s_TileIsValid;
+
+// This shader finds the tiles of the screen-space lighting passes that contain at least one pixel
+// with a valid surface, and appends them to a list. The tiles are in the reservoir space, i.e. they are
+// twice as wide in pixels when checkerboard rendering is enabled, and they cover both checkerboard fields.
+
+[numthreads(RTXDI_SCREEN_SPACE_GROUP_SIZE, RTXDI_SCREEN_SPACE_GROUP_SIZE, 1)]
+void main(uint2 globalIdx : SV_DispatchThreadID, uint2 tileIdx : SV_GroupID, uint threadIdx : SV_GroupIndex)
+{
+    if (threadIdx == 0)
+        s_TileIsValid = false;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    const uint pixelsPerThread = g_Const.checkerboard ? 2 : 1;
+
+    bool isValid = false;
+    for (uint i = 0; i < pixelsPerThread; i++)
+    {
+        uint2 pixelPos = uint2(globalIdx.x * pixelsPerThread + i, globalIdx.y);
+
+        if (all(pixelPos < g_Const.viewportSize) && t_Depth[pixelPos] != BACKGROUND_DEPTH)
+            isValid = true;
+    }
+
+    if (isValid)
+        s_TileIsValid = true;
+
+    GroupMemoryBarrierWithGroupSync();
+
+    if (threadIdx == 0 && s_TileIsValid)
+    {
+        uint tileIndex;
+        InterlockedAdd(u_ValidTileCount[0], 1, tileIndex);
+
+        u_ValidTiles[tileIndex] = tileIdx.x | (tileIdx.y << 16);
+    }
+}
+
+// Writes the indirect dispatch arguments for the tile list, and marks the unused groups
+// in the last row of the dispatch as invalid.
+[numthreads(TILE_COMPACTION_DISPATCH_WIDTH, 1, 1)]
+void WriteArguments(uint threadIdx : SV_GroupIndex)
+{
+    const uint tileCount = u_ValidTileCount[0];
+    const uint rowCount = (tileCount + TILE_COMPACTION_DISPATCH_WIDTH - 1) / TILE_COMPACTION_DISPATCH_WIDTH;
+
+    if (threadIdx == 0)
+    {
+        u_DispatchArguments[0] = TILE_COMPACTION_DISPATCH_WIDTH;
+        u_DispatchArguments[1] = rowCount;
+        u_DispatchArguments[2] = 1;
+    }
+
+    const uint paddingIndex = tileCount + threadIdx;
+    if (paddingIndex < rowCount * TILE_COMPACTION_DISPATCH_WIDTH)
+        u_ValidTiles[paddingIndex] = TILE_COMPACTION_INVALID_TILE;
+}
@@ -0,0 +1,299 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BC6HEncoder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// Mode 11 of the BC6H specification: 5 mode bits, two RGB endpoints with 10 bits per channel, 16 indices with 4 bits each,
+// except for the first one that has an implicit zero MSB.
+static constexpr uint32_t c_Mode11 = 0x03;
+static constexpr uint32_t c_EndpointBits = 10;
+static constexpr int c_MaxEndpoint = (1 << c_EndpointBits) - 1;
+
+static constexpr int c_Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+// Largest finite float16 value
+static constexpr int c_MaxHalf = 0x7bff;
+
+// The decoder expands the quantized endpoints to 16 bits, interpolates, and scales the result by 31/64 to get a float16.
+static int UnquantizeEndpoint(int value)
+{
+    if (value == 0)
+        return 0;
+    if (value == c_MaxEndpoint)
+        return 0xffff;
+    return ((value << 16) + 0x8000) >> c_EndpointBits;
+}
+
+static int InterpolateToHalf(int endpoint0, int endpoint1, int weight)
+{
+    const int value = ((64 - weight) * endpoint0 + weight * endpoint1 + 32) >> 6;
+    return (value * 31) >> 6;
+}
+
+// Finds the quantized endpoint that expands to the value closest to the target, which is in the 16-bit interpolation domain.
+static int QuantizeEndpoint(float target)
+{
+    const int estimate = std::clamp(int((target - 32.f) / 64.f), 0, c_MaxEndpoint);
+
+    int best = estimate;
+    float bestError = std::abs(float(UnquantizeEndpoint(estimate)) - target);
+
+    for (int candidate = std::max(estimate - 1, 0); candidate <= std::min(estimate + 1, c_MaxEndpoint); candidate++)
+    {
+        const float error = std::abs(float(UnquantizeEndpoint(candidate)) - target);
+        if (error < bestError)
+        {
+            best = candidate;
+            bestError = error;
+        }
+    }
+
+    return best;
+}
+
+struct BlockEncoding
+{
+    int endpoints[2][3];
+    int indices[16];
+    float error;
+};
+
+// Quantizes the endpoints, picks the best index for every texel, and measures the error in the float16 bit domain,
+// which is roughly logarithmic and so weighs the dark and bright texels evenly.
+static void EvaluateEndpoints(const int texels[16][3], const float endpoints[2][3], BlockEncoding& outEncoding)
+{
+    int unquantized[2][3];
+    for (int endpoint = 0; endpoint < 2; endpoint++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            outEncoding.endpoints[endpoint][channel] = QuantizeEndpoint(endpoints[endpoint][channel]);
+            unquantized[endpoint][channel] = UnquantizeEndpoint(outEncoding.endpoints[endpoint][channel]);
+        }
+    }
+
+    int palette[16][3];
+    for (int index = 0; index < 16; index++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+            palette[index][channel] = InterpolateToHalf(unquantized[0][channel], unquantized[1][channel], c_Weights[index]);
+    }
+
+    outEncoding.error = 0.f;
+    for (int texel = 0; texel < 16; texel++)
+    {
+        int bestIndex = 0;
+        float bestError = INFINITY;
+
+        for (int index = 0; index < 16; index++)
+        {
+            float error = 0.f;
+            for (int channel = 0; channel < 3; channel++)
+            {
+                const float difference = float(palette[index][channel] - texels[texel][channel]);
+                error += difference * difference;
+            }
+
+            if (error < bestError)
+            {
+                bestIndex = index;
+                bestError = error;
+            }
+        }
+
+        outEncoding.indices[texel] = bestIndex;
+        outEncoding.error += bestError;
+    }
+}
+
+class BitWriter
+{
+public:
+    explicit BitWriter(uint8_t* data)
+        : m_Data(data)
+    {
+        memset(m_Data, 0, c_BC6HBlockSize);
+    }
+
+    void Write(uint32_t value, uint32_t bitCount)
+    {
+        for (uint32_t bit = 0; bit < bitCount; bit++, m_Position++)
+        {
+            if (value & (1u << bit))
+                m_Data[m_Position / 8] |= uint8_t(1u << (m_Position % 8));
+        }
+    }
+
+private:
+    uint8_t* m_Data;
+    uint32_t m_Position = 0;
+};
+
+void EncodeBC6HBlock(const uint16_t texels[16][3], uint8_t outBlock[c_BC6HBlockSize])
+{
+    // Negative values have the sign bit set, and infinities or NaNs are above the largest finite value.
+    int values[16][3];
+    for (int texel = 0; texel < 16; texel++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            const int half = texels[texel][channel];
+            values[texel][channel] = (half & 0x8000) ? 0 : std::min(half, c_MaxHalf);
+        }
+    }
+
+    // Endpoints are searched for in the 16-bit interpolation domain, where a float16 value h maps to h * 64 / 31.
+    constexpr float scale = 64.f / 31.f;
+
+    float mean[3] = { 0.f, 0.f, 0.f };
+    float minValue[3] = { INFINITY, INFINITY, INFINITY };
+    float maxValue[3] = { 0.f, 0.f, 0.f };
+    for (int texel = 0; texel < 16; texel++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+        {
+            const float value = float(values[texel][channel]) * scale;
+            mean[channel] += value / 16.f;
+            minValue[channel] = std::min(minValue[channel], value);
+            maxValue[channel] = std::max(maxValue[channel], value);
+        }
+    }
+
+    // Candidate 1: the diagonal of the bounding box, which is exact for the uniform and the gray blocks.
+    BlockEncoding best;
+    const float boxEndpoints[2][3] = {
+        { minValue[0], minValue[1], minValue[2] },
+        { maxValue[0], maxValue[1], maxValue[2] } };
+    EvaluateEndpoints(values, boxEndpoints, best);
+
+    // Candidate 2: the extent of the texels along their principal axis, found with a few power iterations.
+    float covariance[3][3] = {};
+    for (int texel = 0; texel < 16; texel++)
+    {
+        float centered[3];
+        for (int channel = 0; channel < 3; channel++)
+            centered[channel] = float(values[texel][channel]) * scale - mean[channel];
+
+        for (int row = 0; row < 3; row++)
+        {
+            for (int column = 0; column < 3; column++)
+                covariance[row][column] += centered[row] * centered[column];
+        }
+    }
+
+    float axis[3] = { maxValue[0] - minValue[0], maxValue[1] - minValue[1], maxValue[2] - minValue[2] };
+    for (int iteration = 0; iteration < 8; iteration++)
+    {
+        float next[3];
+        for (int row = 0; row < 3; row++)
+            next[row] = covariance[row][0] * axis[0] + covariance[row][1] * axis[1] + covariance[row][2] * axis[2];
+
+        const float length = std::sqrt(next[0] * next[0] + next[1] * next[1] + next[2] * next[2]);
+        if (length <= 0.f)
+            break;
+
+        for (int channel = 0; channel < 3; channel++)
+            axis[channel] = next[channel] / length;
+    }
+
+    const float axisLength = std::sqrt(axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2]);
+    if (axisLength > 0.f)
+    {
+        float minProjection = INFINITY;
+        float maxProjection = -INFINITY;
+        for (int texel = 0; texel < 16; texel++)
+        {
+            float projection = 0.f;
+            for (int channel = 0; channel < 3; channel++)
+                projection += (float(values[texel][channel]) * scale - mean[channel]) * axis[channel] / axisLength;
+
+            minProjection = std::min(minProjection, projection);
+            maxProjection = std::max(maxProjection, projection);
+        }
+
+        float axisEndpoints[2][3];
+        for (int channel = 0; channel < 3; channel++)
+        {
+            axisEndpoints[0][channel] = std::clamp(mean[channel] + axis[channel] / axisLength * minProjection, 0.f, 65535.f);
+            axisEndpoints[1][channel] = std::clamp(mean[channel] + axis[channel] / axisLength * maxProjection, 0.f, 65535.f);
+        }
+
+        BlockEncoding candidate;
+        EvaluateEndpoints(values, axisEndpoints, candidate);
+        if (candidate.error < best.error)
+            best = candidate;
+    }
+
+    // Refine the endpoints with a least squares fit to the texels, given the chosen indices.
+    for (int iteration = 0; iteration < 2; iteration++)
+    {
+        float aa = 0.f, ab = 0.f, bb = 0.f;
+        float at[3] = {}, bt[3] = {};
+        for (int texel = 0; texel < 16; texel++)
+        {
+            const float b = float(c_Weights[best.indices[texel]]) / 64.f;
+            const float a = 1.f - b;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+
+            for (int channel = 0; channel < 3; channel++)
+            {
+                const float value = float(values[texel][channel]) * scale;
+                at[channel] += a * value;
+                bt[channel] += b * value;
+            }
+        }
+
+        const float determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f)
+            break;
+
+        float fitEndpoints[2][3];
+        for (int channel = 0; channel < 3; channel++)
+        {
+            fitEndpoints[0][channel] = std::clamp((bb * at[channel] - ab * bt[channel]) / determinant, 0.f, 65535.f);
+            fitEndpoints[1][channel] = std::clamp((aa * bt[channel] - ab * at[channel]) / determinant, 0.f, 65535.f);
+        }
+
+        BlockEncoding candidate;
+        EvaluateEndpoints(values, fitEndpoints, candidate);
+        if (candidate.error >= best.error)
+            break;
+
+        best = candidate;
+    }
+
+    // The MSB of the first index is implicitly zero: swap the endpoints if needed, the weights are symmetric.
+    if (best.indices[0] >= 8)
+    {
+        for (int channel = 0; channel < 3; channel++)
+            std::swap(best.endpoints[0][channel], best.endpoints[1][channel]);
+
+        for (int& index : best.indices)
+            index = 15 - index;
+    }
+
+    BitWriter writer(outBlock);
+    writer.Write(c_Mode11, 5);
+    for (int endpoint = 0; endpoint < 2; endpoint++)
+    {
+        for (int channel = 0; channel < 3; channel++)
+            writer.Write(uint32_t(best.endpoints[endpoint][channel]), c_EndpointBits);
+    }
+
+    writer.Write(uint32_t(best.indices[0]), 3);
+    for (int texel = 1; texel < 16; texel++)
+        writer.Write(uint32_t(best.indices[texel]), 4);
+}
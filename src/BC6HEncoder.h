@@ -0,0 +1,21 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// Size of one compressed 4x4 block in bytes
+static constexpr uint32_t c_BC6HBlockSize = 16;
+
+// Encodes a 4x4 block into the BC6H_UFLOAT format. Only mode 11 is used: one region with 10-bit endpoints and 4-bit indices,
+// which suits the smooth content of the environment maps and is simple enough to search exhaustively for the indices.
+// The texels are float16 bit patterns in row-major order, and negative values are treated as zero.
+void EncodeBC6HBlock(const uint16_t texels[16][3], uint8_t outBlock[c_BC6HBlockSize]);
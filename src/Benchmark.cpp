@@ -0,0 +1,206 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "Benchmark.h"
+
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+using namespace donut;
+namespace fs = std::filesystem;
+
+BenchmarkStatistics::BenchmarkStatistics(std::vector<std::string> sectionNames)
+    : m_SectionNames(std::move(sectionNames))
+{
+    m_Samples.resize(m_SectionNames.size());
+}
+
+void BenchmarkStatistics::Reset()
+{
+    for (auto& samples : m_Samples)
+        samples.clear();
+
+    m_FrameCount = 0;
+}
+
+void BenchmarkStatistics::AddFrame(const std::vector<double>& sectionTimes)
+{
+    for (size_t section = 0; section < m_Samples.size(); section++)
+    {
+        const double time = (section < sectionTimes.size()) ? sectionTimes[section] : 0.0;
+        m_Samples[section].push_back(time);
+    }
+
+    ++m_FrameCount;
+}
+
+// Nearest-rank percentile of a sorted array
+static double GetPercentile(const std::vector<double>& sortedValues, double percentile)
+{
+    if (sortedValues.empty())
+        return 0.0;
+
+    const double rank = std::ceil(percentile * 0.01 * double(sortedValues.size()));
+    const size_t index = size_t(std::max(rank, 1.0)) - 1;
+    return sortedValues[std::min(index, sortedValues.size() - 1)];
+}
+
+std::vector<BenchmarkStatistics::SectionSummary> BenchmarkStatistics::Summarize() const
+{
+    std::vector<SectionSummary> result;
+
+    if (m_FrameCount == 0)
+        return result;
+
+    for (size_t section = 0; section < m_Samples.size(); section++)
+    {
+        std::vector<double> sorted = m_Samples[section];
+        std::sort(sorted.begin(), sorted.end());
+
+        if (sorted.back() == 0.0)
+            continue;
+
+        SectionSummary summary;
+        summary.name = m_SectionNames[section];
+        summary.minimum = sorted.front();
+        summary.maximum = sorted.back();
+        summary.median = GetPercentile(sorted, 50.0);
+        summary.percentile95 = GetPercentile(sorted, 95.0);
+
+        double sum = 0.0;
+        for (double value : sorted)
+            sum += value;
+        summary.average = sum / double(sorted.size());
+
+        result.push_back(summary);
+    }
+
+    return result;
+}
+
+std::string BenchmarkStatistics::GetAsText() const
+{
+    const std::vector<SectionSummary> summaries = Summarize();
+
+    size_t nameWidth = 8;
+    for (const auto& summary : summaries)
+        nameWidth = std::max(nameWidth, summary.name.size());
+
+    std::stringstream text;
+    text << "Frames: " << m_FrameCount << std::endl;
+    text << std::left << std::setw(int(nameWidth)) << "Section" << std::right
+        << std::setw(10) << "Avg" << std::setw(10) << "Min" << std::setw(10) << "Median"
+        << std::setw(10) << "95%" << std::setw(10) << "Max" << std::endl;
+
+    text << std::fixed << std::setprecision(3);
+    for (const auto& summary : summaries)
+    {
+        text << std::left << std::setw(int(nameWidth)) << summary.name << std::right
+            << std::setw(10) << summary.average
+            << std::setw(10) << summary.minimum
+            << std::setw(10) << summary.median
+            << std::setw(10) << summary.percentile95
+            << std::setw(10) << summary.maximum << std::endl;
+    }
+
+    return text.str();
+}
+
+bool GetBenchmarkAnimationTime(int benchmarkFrame, float animationDuration, uint32_t maxFrames, float& outAnimationTime)
+{
+    if (benchmarkFrame < 0)
+        return false;
+
+    if (maxFrames > 0 && uint32_t(benchmarkFrame) >= maxFrames)
+        return false;
+
+    const float animationTime = float(benchmarkFrame) * c_BenchmarkAnimationStep;
+    if (animationTime >= animationDuration)
+        return false;
+
+    outAnimationTime = animationTime;
+    return true;
+}
+
+int RunHeadlessFrameLoop(
+    const std::function<HeadlessFrameStatus(uint32_t frameIndex)>& renderFrame,
+    uint32_t maxRenderedFrames,
+    uint32_t maxLoadingFrames)
+{
+    uint32_t renderedFrames = 0;
+    uint32_t loadingFrames = 0;
+
+    for (uint32_t frameIndex = 0; ; frameIndex++)
+    {
+        switch (renderFrame(frameIndex))
+        {
+        case HeadlessFrameStatus::Loading:
+            ++loadingFrames;
+            if (maxLoadingFrames > 0 && loadingFrames >= maxLoadingFrames)
+            {
+                log::error("The scene did not finish loading after %d frames.", loadingFrames);
+                return 1;
+            }
+            break;
+
+        case HeadlessFrameStatus::Rendered:
+            loadingFrames = 0;
+            ++renderedFrames;
+            if (maxRenderedFrames > 0 && renderedFrames >= maxRenderedFrames)
+            {
+                log::error("The application did not finish after rendering %d frames.", renderedFrames);
+                return 1;
+            }
+            break;
+
+        case HeadlessFrameStatus::Finished:
+            return 0;
+
+        case HeadlessFrameStatus::Failed:
+        default:
+            return 1;
+        }
+    }
+}
+
+bool WriteBenchmarkResults(const std::string& fileName, const std::string& results)
+{
+    fs::path parentFolder = fs::path(fileName).parent_path();
+    if (!parentFolder.empty() && !fs::exists(parentFolder))
+    {
+        log::info("Creating folder '%s'", parentFolder.generic_string().c_str());
+        fs::create_directories(parentFolder);
+    }
+
+    std::ofstream file(fileName);
+    if (!file.is_open())
+    {
+        log::error("Failed to open '%s' for writing.", fileName.c_str());
+        return false;
+    }
+
+    file << results;
+    file.close();
+
+    if (file.fail())
+    {
+        log::error("Failed to write the benchmark results into '%s'", fileName.c_str());
+        return false;
+    }
+
+    log::info("Saved the benchmark results into '%s'", fileName.c_str());
+    return true;
+}
@@ -0,0 +1,84 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+// The benchmark animation advances by this much time on every frame, regardless of the actual frame time.
+constexpr float c_BenchmarkAnimationStep = 1.f / 240.f;
+
+// Frames rendered before each benchmark sweep entry starts recording, so that the first uses of the recreated
+// pipelines and resources and the empty temporal history don't show up in its statistics.
+constexpr int c_BenchmarkSweepWarmupFrames = 16;
+
+// Collects per-frame section timings during a benchmark run and computes summary statistics.
+// Contains no graphics objects, so it can be fed with synthetic data.
+class BenchmarkStatistics
+{
+public:
+    struct SectionSummary
+    {
+        std::string name;
+        double average = 0.0;
+        double minimum = 0.0;
+        double median = 0.0;
+        double percentile95 = 0.0;
+        double maximum = 0.0;
+    };
+
+    explicit BenchmarkStatistics(std::vector<std::string> sectionNames);
+
+    void Reset();
+
+    // Adds the timings for one frame, in milliseconds, one value per section.
+    // Missing values are treated as zero, extra values are ignored.
+    void AddFrame(const std::vector<double>& sectionTimes);
+
+    [[nodiscard]] uint32_t GetFrameCount() const { return m_FrameCount; }
+
+    // Returns the statistics for every section that had a non-zero time in at least one frame.
+    [[nodiscard]] std::vector<SectionSummary> Summarize() const;
+
+    [[nodiscard]] std::string GetAsText() const;
+
+private:
+    std::vector<std::string> m_SectionNames;
+    std::vector<std::vector<double>> m_Samples; // [section][frame]
+    uint32_t m_FrameCount = 0;
+};
+
+// Computes the animation time for the given benchmark frame.
+// Returns false when the benchmark is complete, i.e. the animation has ended or 'maxFrames' frames have been rendered.
+// A 'maxFrames' value of 0 means that the whole animation is used.
+bool GetBenchmarkAnimationTime(int benchmarkFrame, float animationDuration, uint32_t maxFrames, float& outAnimationTime);
+
+enum class HeadlessFrameStatus
+{
+    Loading,    // The scene is still loading, nothing was rendered
+    Rendered,   // A frame was rendered
+    Finished,   // The application has completed its work successfully
+    Failed      // The application has completed its work with an error
+};
+
+// Drives the application without a window by calling 'renderFrame' until it reports completion.
+// 'maxRenderedFrames' limits the number of rendered frames, 0 means no limit.
+// 'maxLoadingFrames' limits the number of consecutive loading frames.
+// Returns the process exit code: 0 on success, 1 on failure or when a limit is hit.
+int RunHeadlessFrameLoop(
+    const std::function<HeadlessFrameStatus(uint32_t frameIndex)>& renderFrame,
+    uint32_t maxRenderedFrames,
+    uint32_t maxLoadingFrames);
+
+// Writes the benchmark results into a text file, creating the parent folder if necessary.
+bool WriteBenchmarkResults(const std::string& fileName, const std::string& results);
@@ -0,0 +1,576 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "BenchmarkSweep.h"
+#include "Profiler.h"
+
+#include <donut/core/json.h>
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+#include <json/value.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace donut;
+
+static std::string ToUpper(std::string s)
+{
+    std::transform(s.begin(), s.end(), s.begin(),
+        [](unsigned char c) { return std::toupper(c); });
+    return s;
+}
+
+bool ParseQualityPreset(const std::string& s, QualityPreset& preset)
+{
+    const std::string upper = ToUpper(s);
+
+    if (upper == "FAST")
+        preset = QualityPreset::Fast;
+    else if (upper == "MEDIUM")
+        preset = QualityPreset::Medium;
+    else if (upper == "UNBIASED")
+        preset = QualityPreset::Unbiased;
+    else if (upper == "ULTRA")
+        preset = QualityPreset::Ultra;
+    else if (upper == "REFERENCE")
+        preset = QualityPreset::Reference;
+    else
+        return false;
+
+    return true;
+}
+
+static bool ParseResamplingMode(const std::string& s, rtxdi::ReSTIRDI_ResamplingMode& mode)
+{
+    const std::string upper = ToUpper(s);
+
+    if (upper == "NONE")
+        mode = rtxdi::ReSTIRDI_ResamplingMode::None;
+    else if (upper == "TEMPORAL")
+        mode = rtxdi::ReSTIRDI_ResamplingMode::Temporal;
+    else if (upper == "SPATIAL")
+        mode = rtxdi::ReSTIRDI_ResamplingMode::Spatial;
+    else if (upper == "TEMPORAL_SPATIAL")
+        mode = rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial;
+    else if (upper == "FUSED")
+        mode = rtxdi::ReSTIRDI_ResamplingMode::FusedSpatiotemporal;
+    else
+        return false;
+
+    return true;
+}
+
+static bool ParseReGIRMode(const std::string& s, rtxdi::ReGIRMode& mode)
+{
+    const std::string upper = ToUpper(s);
+
+    if (upper == "DISABLED")
+        mode = rtxdi::ReGIRMode::Disabled;
+    else if (upper == "GRID")
+        mode = rtxdi::ReGIRMode::Grid;
+    else if (upper == "ONION")
+        mode = rtxdi::ReGIRMode::Onion;
+    else
+        return false;
+
+    return true;
+}
+
+static bool ParseEnvironmentPresamplingMode(const std::string& s, EnvironmentPresamplingMode& mode)
+{
+    const std::string upper = ToUpper(s);
+
+    if (upper == "MIP")
+        mode = EnvironmentPresamplingMode::MipDescent;
+    else if (upper == "ALIAS")
+        mode = EnvironmentPresamplingMode::AliasTable;
+    else
+        return false;
+
+    return true;
+}
+
+static bool ParseResolution(const std::string& s, dm::int2& resolution)
+{
+    int width = 0, height = 0;
+    char separator = 0;
+    std::istringstream stream(s);
+    stream >> width >> separator >> height;
+
+    if (stream.fail() || (separator != 'x' && separator != 'X') || width <= 0 || height <= 0)
+        return false;
+
+    resolution = dm::int2(width, height);
+    return true;
+}
+
+const char* GetQualityPresetName(QualityPreset preset)
+{
+    switch (preset)
+    {
+    case QualityPreset::Fast: return "Fast";
+    case QualityPreset::Medium: return "Medium";
+    case QualityPreset::Unbiased: return "Unbiased";
+    case QualityPreset::Ultra: return "Ultra";
+    case QualityPreset::Reference: return "Reference";
+    case QualityPreset::Custom:
+    default: return "Custom";
+    }
+}
+
+static const char* GetResamplingModeName(rtxdi::ReSTIRDI_ResamplingMode mode)
+{
+    switch (mode)
+    {
+    case rtxdi::ReSTIRDI_ResamplingMode::None: return "No Resampling";
+    case rtxdi::ReSTIRDI_ResamplingMode::Temporal: return "Temporal";
+    case rtxdi::ReSTIRDI_ResamplingMode::Spatial: return "Spatial";
+    case rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial: return "Temporal+Spatial";
+    case rtxdi::ReSTIRDI_ResamplingMode::FusedSpatiotemporal: return "Fused";
+    default: return "Unknown";
+    }
+}
+
+static const char* GetReGIRModeName(rtxdi::ReGIRMode mode)
+{
+    switch (mode)
+    {
+    case rtxdi::ReGIRMode::Disabled: return "No ReGIR";
+    case rtxdi::ReGIRMode::Grid: return "Grid";
+    case rtxdi::ReGIRMode::Onion: return "Onion";
+    default: return "Unknown";
+    }
+}
+
+static const char* GetEnvironmentPresamplingModeName(EnvironmentPresamplingMode mode)
+{
+    switch (mode)
+    {
+    case EnvironmentPresamplingMode::MipDescent: return "Mip Descent";
+    case EnvironmentPresamplingMode::AliasTable: return "Alias Table";
+    default: return "Unknown";
+    }
+}
+
+std::string BenchmarkSweepEntry::GetLabel() const
+{
+    std::vector<std::string> parts;
+
+    if (preset != QualityPreset::Custom)
+        parts.push_back(GetQualityPresetName(preset));
+    if (resamplingMode.has_value())
+        parts.push_back(GetResamplingModeName(*resamplingMode));
+    if (checkerboard.has_value())
+        parts.push_back(*checkerboard ? "Checkerboard" : "Full");
+    if (regirMode.has_value())
+        parts.push_back(GetReGIRModeName(*regirMode));
+    if (environmentPresampling.has_value())
+        parts.push_back(GetEnvironmentPresamplingModeName(*environmentPresampling));
+
+    if (parts.empty())
+        return "Default";
+
+    std::string label = parts[0];
+    for (size_t i = 1; i < parts.size(); i++)
+        label += " / " + parts[i];
+
+    return label;
+}
+
+// The static context parameters that the sweep can change, either directly or through a preset
+struct SweepStaticParams
+{
+    rtxdi::CheckerboardMode checkerboardMode;
+    rtxdi::ReGIRMode regirMode;
+
+    bool operator==(const SweepStaticParams& other) const
+    {
+        return checkerboardMode == other.checkerboardMode && regirMode == other.regirMode;
+    }
+};
+
+static SweepStaticParams GetStaticParams(const UIData& ui)
+{
+    return SweepStaticParams{ ui.restirDIStaticParams.CheckerboardSamplingMode, ui.regirStaticParams.Mode };
+}
+
+void BenchmarkSweepEntry::ApplyToUI(UIData& ui) const
+{
+    // The preset also sets the checkerboard mode and requests a context reset when it changes,
+    // but the entry may override it back. Only the final static parameters decide whether a reset is needed.
+    const SweepStaticParams previousStaticParams = GetStaticParams(ui);
+    const bool resetPending = ui.resetISContext;
+
+    if (preset != QualityPreset::Custom)
+    {
+        ui.preset = preset;
+        ui.ApplyPreset();
+    }
+
+    if (resamplingMode.has_value())
+        ui.restirDI.resamplingMode = *resamplingMode;
+
+    if (checkerboard.has_value())
+        ui.restirDIStaticParams.CheckerboardSamplingMode = *checkerboard ? rtxdi::CheckerboardMode::Black : rtxdi::CheckerboardMode::Off;
+
+    if (regirMode.has_value())
+        ui.regirStaticParams.Mode = *regirMode;
+
+    if (environmentPresampling.has_value())
+        ui.environmentPresamplingMode = *environmentPresampling;
+
+    ui.resetISContext = resetPending || !(GetStaticParams(ui) == previousStaticParams);
+    ui.resetAccumulation = true;
+}
+
+bool BenchmarkSweep::LoadConfig(const std::string& fileName)
+{
+    vfs::NativeFileSystem fs;
+    Json::Value root;
+
+    if (!json::LoadFromFile(fs, fileName, root))
+    {
+        log::error("Couldn't load the benchmark sweep configuration from '%s'", fileName.c_str());
+        return false;
+    }
+
+    if (!ParseConfig(root))
+    {
+        log::error("Invalid benchmark sweep configuration in '%s'", fileName.c_str());
+        return false;
+    }
+
+    log::info("Loaded %d benchmark sweep configurations from '%s'", int(m_Entries.size()), fileName.c_str());
+    return true;
+}
+
+// Reads an optional array of strings from the config node and converts every item with the parser.
+// An absent array produces a single unset value, so that the corresponding setting is not changed.
+template<typename T, typename Parser>
+static bool ParseList(const Json::Value& node, const char* name, Parser parser, std::vector<std::optional<T>>& result)
+{
+    result.clear();
+
+    if (node.isNull())
+    {
+        result.push_back(std::nullopt);
+        return true;
+    }
+
+    if (!node.isArray() || node.empty())
+    {
+        log::error("The '%s' item in the benchmark sweep configuration must be a non-empty array.", name);
+        return false;
+    }
+
+    for (const auto& item : node)
+    {
+        T value{};
+        if (!parser(item, value))
+        {
+            const std::string itemText = item.isString() ? item.asString() : item.toStyledString();
+            log::error("Unrecognized value '%s' in the '%s' list.", itemText.c_str(), name);
+            return false;
+        }
+        result.push_back(value);
+    }
+
+    return true;
+}
+
+bool BenchmarkSweep::ParseConfig(const Json::Value& root)
+{
+    m_Entries.clear();
+    m_Results.clear();
+
+    if (!root.isObject())
+        return false;
+
+    m_FramesPerEntry = json::Read<uint32_t>(root["frames"], 0);
+    m_ErrorFrames = json::Read<uint32_t>(root["errorFrames"], 0);
+    m_ReferenceFrames = std::max(json::Read<uint32_t>(root["referenceFrames"], 1024), 1u);
+
+    auto stringParser = [](auto parseFunc)
+    {
+        return [parseFunc](const Json::Value& item, auto& value)
+        {
+            return item.isString() && parseFunc(item.asString(), value);
+        };
+    };
+
+    std::vector<std::optional<QualityPreset>> presets;
+    std::vector<std::optional<rtxdi::ReSTIRDI_ResamplingMode>> resamplingModes;
+    std::vector<std::optional<bool>> checkerboardModes;
+    std::vector<std::optional<rtxdi::ReGIRMode>> regirModes;
+    std::vector<std::optional<EnvironmentPresamplingMode>> environmentPresamplingModes;
+    std::vector<std::optional<dm::int2>> resolutions;
+
+    auto boolParser = [](const Json::Value& item, bool& value)
+    {
+        if (!item.isBool())
+            return false;
+        value = item.asBool();
+        return true;
+    };
+
+    if (!ParseList(root["presets"], "presets", stringParser(ParseQualityPreset), presets) ||
+        !ParseList(root["resampling"], "resampling", stringParser(ParseResamplingMode), resamplingModes) ||
+        !ParseList(root["checkerboard"], "checkerboard", boolParser, checkerboardModes) ||
+        !ParseList(root["regir"], "regir", stringParser(ParseReGIRMode), regirModes) ||
+        !ParseList(root["envPresampling"], "envPresampling", stringParser(ParseEnvironmentPresamplingMode), environmentPresamplingModes) ||
+        !ParseList(root["resolutions"], "resolutions", stringParser(ParseResolution), resolutions))
+        return false;
+
+    for (const auto& resolution : resolutions)
+    for (const auto& checkerboard : checkerboardModes)
+    for (const auto& regirMode : regirModes)
+    for (const auto& preset : presets)
+    for (const auto& environmentPresampling : environmentPresamplingModes)
+    for (const auto& resamplingMode : resamplingModes)
+    {
+        BenchmarkSweepEntry entry;
+        entry.preset = preset.value_or(QualityPreset::Custom);
+        entry.resamplingMode = resamplingMode;
+        entry.checkerboard = checkerboard;
+        entry.regirMode = regirMode;
+        entry.environmentPresampling = environmentPresampling;
+        entry.resolution = resolution.value_or(dm::int2(0));
+        m_Entries.push_back(entry);
+    }
+
+    // The presets change the checkerboard mode, so the loops above don't group the entries by their
+    // static parameters when the checkerboard is not listed explicitly. Sort by the parameters that each entry
+    // ends up with, applied to the default settings, keeping the configuration order otherwise.
+    std::vector<std::pair<SweepStaticParams, BenchmarkSweepEntry>> sortedEntries;
+    for (const BenchmarkSweepEntry& entry : m_Entries)
+    {
+        UIData ui;
+        entry.ApplyToUI(ui);
+        sortedEntries.push_back({ GetStaticParams(ui), entry });
+    }
+
+    std::stable_sort(sortedEntries.begin(), sortedEntries.end(), [](const auto& a, const auto& b)
+    {
+        const dm::int2 resolutionA = a.second.resolution;
+        const dm::int2 resolutionB = b.second.resolution;
+        if (resolutionA.x != resolutionB.x) return resolutionA.x < resolutionB.x;
+        if (resolutionA.y != resolutionB.y) return resolutionA.y < resolutionB.y;
+        if (a.first.checkerboardMode != b.first.checkerboardMode) return a.first.checkerboardMode < b.first.checkerboardMode;
+        return a.first.regirMode < b.first.regirMode;
+    });
+
+    for (size_t i = 0; i < sortedEntries.size(); i++)
+        m_Entries[i] = sortedEntries[i].second;
+
+    return true;
+}
+
+void BenchmarkSweep::AddResult(const BenchmarkSweepEntry& entry, const BenchmarkStatistics& statistics, const std::optional<SweepNoiseResult>& noise)
+{
+    Result result;
+    result.label = entry.GetLabel();
+    result.resolution = entry.resolution;
+    result.sections = statistics.Summarize();
+    result.noise = noise;
+    m_Results.push_back(std::move(result));
+}
+
+std::string BenchmarkSweep::GetResultsTable(const std::string& sceneName, const std::string& rendererName) const
+{
+    // Collect the union of the sections that were active in any of the runs, in the profiler order.
+    std::vector<std::string> sectionNames;
+    for (const auto& result : m_Results)
+    {
+        auto insertPosition = sectionNames.begin();
+        for (const auto& section : result.sections)
+        {
+            auto found = std::find(sectionNames.begin(), sectionNames.end(), section.name);
+            if (found == sectionNames.end())
+                insertPosition = sectionNames.insert(insertPosition, section.name) + 1;
+            else
+                insertPosition = found + 1;
+        }
+    }
+
+    size_t labelWidth = 13;
+    for (const auto& result : m_Results)
+        labelWidth = std::max(labelWidth, result.label.size());
+
+    std::stringstream text;
+    const bool hasNoise = std::any_of(m_Results.begin(), m_Results.end(), [](const Result& result) { return result.noise.has_value(); });
+
+    text << "Scene: " << sceneName << std::endl;
+    text << "Renderer: " << rendererName << std::endl;
+    text << "All times are GPU averages in milliseconds, the Frame 95% column is the 95th percentile of the frame time." << std::endl;
+    if (hasNoise)
+        text << "MSE and Rel MSE are the mean errors of " << m_ErrorFrames << " frames against the entry's own image accumulated over "
+            << m_ReferenceFrames << " frames, at the first benchmark frame." << std::endl;
+    text << std::endl;
+
+    text << "| " << std::left << std::setw(int(labelWidth)) << "Configuration" << " | Resolution ";
+    for (const auto& name : sectionNames)
+        text << "| " << name << " ";
+    text << "| Frame 95% |";
+    if (hasNoise)
+        text << "     MSE      |   Rel MSE    |";
+    text << std::endl;
+
+    text << "|" << std::string(labelWidth + 2, '-') << "|------------";
+    for (const auto& name : sectionNames)
+        text << "|" << std::string(name.size() + 2, '-');
+    text << "|-----------|";
+    if (hasNoise)
+        text << "--------------|--------------|";
+    text << std::endl;
+
+    text << std::fixed << std::setprecision(3);
+    for (const auto& result : m_Results)
+    {
+        std::stringstream resolution;
+        if (result.resolution.x > 0)
+            resolution << result.resolution.x << "x" << result.resolution.y;
+        else
+            resolution << "window";
+
+        text << "| " << std::left << std::setw(int(labelWidth)) << result.label << " | " << std::setw(10) << resolution.str() << " " << std::right;
+
+        for (const auto& name : sectionNames)
+        {
+            auto found = std::find_if(result.sections.begin(), result.sections.end(),
+                [&name](const auto& section) { return section.name == name; });
+
+            text << "| " << std::setw(int(name.size())) << ((found != result.sections.end()) ? found->average : 0.0) << " ";
+        }
+
+        double framePercentile95 = 0.0;
+        for (const auto& section : result.sections)
+        {
+            if (section.name == Profiler::GetSectionName(ProfilerSection::Frame))
+                framePercentile95 = section.percentile95;
+        }
+
+        text << "| " << std::setw(9) << framePercentile95 << " |";
+
+        if (hasNoise)
+        {
+            if (result.noise.has_value())
+            {
+                text << std::scientific << std::setprecision(5)
+                    << " " << std::setw(12) << result.noise->mse << " | " << std::setw(12) << result.noise->relMse << " |"
+                    << std::fixed << std::setprecision(3);
+            }
+            else
+                text << " " << std::setw(12) << "-" << " | " << std::setw(12) << "-" << " |";
+        }
+
+        text << std::endl;
+    }
+
+    return text.str();
+}
+
+SweepNoiseMeasurement::SweepNoiseMeasurement(uint32_t referenceFrames, uint32_t errorFrames)
+    : m_ReferenceFrames(std::max(referenceFrames, 1u))
+    , m_ErrorFrames(std::max(errorFrames, 1u))
+{
+}
+
+ConvergenceMeasurement::FrameActions SweepNoiseMeasurement::BeginFrame(UIData& ui)
+{
+    ConvergenceMeasurement::FrameActions actions;
+
+    switch (m_Phase)
+    {
+    case Phase::Reference:
+        if (m_PhaseFrame == 0)
+        {
+            m_AntiAliasingMode = ui.aaMode;
+            m_FramesToAccumulate = ui.framesToAccumulate;
+
+            ui.aaMode = AntiAliasingMode::Accumulation;
+            ui.framesToAccumulate = m_ReferenceFrames;
+            ui.resetAccumulation = true;
+        }
+        // numAccumulatedFrames is updated later in the frame, so here it still has the value from the previous frame.
+        else if (ui.numAccumulatedFrames + 1 >= m_ReferenceFrames || m_PhaseFrame > m_ReferenceFrames * 2)
+        {
+            if (ui.numAccumulatedFrames + 1 < m_ReferenceFrames)
+                log::warning("Benchmark sweep: the reference only accumulated %d frames, is the camera moving?", ui.numAccumulatedFrames);
+
+            actions.storeReference = true;
+            m_Phase = Phase::Settle;
+            m_PhaseFrame = 0;
+            return actions;
+        }
+        break;
+
+    case Phase::Settle:
+        if (m_PhaseFrame == 0)
+        {
+            ui.aaMode = m_AntiAliasingMode;
+            ui.framesToAccumulate = m_FramesToAccumulate;
+            ui.resetAccumulation = true;
+        }
+        else if (m_PhaseFrame == c_SettleFrames)
+        {
+            m_Phase = Phase::Measure;
+            m_PhaseFrame = 0;
+            return BeginFrame(ui);
+        }
+        break;
+
+    case Phase::Measure:
+        actions.measure = true;
+        actions.sampleIndex = m_PhaseFrame;
+
+        if (m_PhaseFrame + 1 == m_ErrorFrames)
+        {
+            m_Phase = Phase::Drain;
+            m_PhaseFrame = 0;
+            return actions;
+        }
+        break;
+
+    case Phase::Drain:
+        // Wait until the measurements of the last frames have been read back
+        if (m_PhaseFrame >= c_ReadbackLatency)
+            m_Phase = Phase::Finished;
+        break;
+
+    case Phase::Finished:
+        break;
+    }
+
+    ++m_PhaseFrame;
+    return actions;
+}
+
+void SweepNoiseMeasurement::AddSample(uint32_t sampleIndex, double mse, double relMse)
+{
+    if (sampleIndex >= m_ErrorFrames)
+        return;
+
+    m_Sum.mse += mse;
+    m_Sum.relMse += relMse;
+    ++m_SampleCount;
+}
+
+std::optional<SweepNoiseResult> SweepNoiseMeasurement::GetResult() const
+{
+    if (m_SampleCount == 0)
+        return std::nullopt;
+
+    SweepNoiseResult result;
+    result.mse = m_Sum.mse / double(m_SampleCount);
+    result.relMse = m_Sum.relMse / double(m_SampleCount);
+    return result;
+}
@@ -0,0 +1,148 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "Benchmark.h"
+#include "ConvergenceMeasurement.h"
+#include "UserInterface.h"
+
+#include <donut/core/math/math.h>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Json
+{
+    class Value;
+}
+
+// Converts between the preset names used in the configuration files ("fast", "medium", ...) and the enum.
+bool ParseQualityPreset(const std::string& s, QualityPreset& preset);
+const char* GetQualityPresetName(QualityPreset preset);
+
+// One combination of settings in a benchmark sweep. Unset fields keep the current (or preset) values.
+struct BenchmarkSweepEntry
+{
+    QualityPreset preset = QualityPreset::Custom;
+    std::optional<rtxdi::ReSTIRDI_ResamplingMode> resamplingMode;
+    std::optional<bool> checkerboard;
+    std::optional<rtxdi::ReGIRMode> regirMode;
+    std::optional<EnvironmentPresamplingMode> environmentPresampling;
+    dm::int2 resolution = 0;
+
+    [[nodiscard]] std::string GetLabel() const;
+
+    // Applies the settings to the UI state, setting ui.resetISContext if the static context parameters
+    // are different after applying the preset and the overrides.
+    // The resolution is not applied here because it's owned by the command line arguments.
+    void ApplyToUI(UIData& ui) const;
+};
+
+struct SweepNoiseResult
+{
+    double mse = 0.0;
+    double relMse = 0.0;
+};
+
+// Measures the noise of one sweep entry with the camera held at the first benchmark frame. It accumulates the entry's
+// own converged image as the reference, then renders a number of frames with the entry's anti-aliasing mode and averages
+// their error against that reference. The reference has the same bias as the frames, so the result is the variance
+// of the image rather than its error against the ground truth, which is what tells the sampling modes apart.
+// Like ConvergenceMeasurement, this class only manages the settings and the results, the rendering side lives in main.cpp.
+class SweepNoiseMeasurement
+{
+public:
+    SweepNoiseMeasurement(uint32_t referenceFrames, uint32_t errorFrames);
+
+    // Call at the beginning of every frame, updates the UI settings for the current phase.
+    ConvergenceMeasurement::FrameActions BeginFrame(UIData& ui);
+
+    // Records a measurement, which arrives a few frames after it was requested.
+    void AddSample(uint32_t sampleIndex, double mse, double relMse);
+
+    [[nodiscard]] bool IsFinished() const { return m_Phase == Phase::Finished; }
+
+    // Returns the mean of the measurements, or nothing if none were read back.
+    [[nodiscard]] std::optional<SweepNoiseResult> GetResult() const;
+
+private:
+    // Frames rendered after the accumulation is switched off, so that the temporal history recovers from the reset
+    static constexpr uint32_t c_SettleFrames = 16;
+    // Measurements are read back two frames after they are recorded, see ConvergenceErrorPass.
+    static constexpr uint32_t c_ReadbackLatency = 2;
+
+    enum class Phase
+    {
+        Reference,
+        Settle,
+        Measure,
+        Drain,
+        Finished
+    };
+
+    uint32_t m_ReferenceFrames;
+    uint32_t m_ErrorFrames;
+    Phase m_Phase = Phase::Reference;
+    uint32_t m_PhaseFrame = 0;
+    AntiAliasingMode m_AntiAliasingMode = AntiAliasingMode::None;
+    uint32_t m_FramesToAccumulate = 0;
+    SweepNoiseResult m_Sum;
+    uint32_t m_SampleCount = 0;
+};
+
+// Expands a sweep configuration into a list of benchmark runs and collects their results into one table.
+// The configuration is a JSON object with optional arrays, for example:
+//   {
+//     "frames": 240,
+//     "presets": [ "fast", "medium", "ultra" ],
+//     "resampling": [ "temporal_spatial", "fused" ],
+//     "checkerboard": [ false, true ],
+//     "regir": [ "grid", "onion" ],
+//     "envPresampling": [ "mip", "alias" ],
+//     "resolutions": [ "1920x1080", "2560x1440" ],
+//     "errorFrames": 64,
+//     "referenceFrames": 1024
+//   }
+// With a non-zero "errorFrames", every entry also gets a noise measurement after its timed frames,
+// see SweepNoiseMeasurement, and the table gets its mean error.
+// The entries are ordered so that the settings which require recreating resources change least often:
+// resolution first, then the checkerboard and ReGIR modes that each entry ends up with, including the ones
+// implied by its preset, then the dynamic settings.
+class BenchmarkSweep
+{
+public:
+    bool LoadConfig(const std::string& fileName);
+    bool ParseConfig(const Json::Value& root);
+
+    [[nodiscard]] const std::vector<BenchmarkSweepEntry>& GetEntries() const { return m_Entries; }
+    [[nodiscard]] uint32_t GetFramesPerEntry() const { return m_FramesPerEntry; }
+    [[nodiscard]] uint32_t GetErrorFrames() const { return m_ErrorFrames; }
+    [[nodiscard]] uint32_t GetReferenceFrames() const { return m_ReferenceFrames; }
+
+    // 'noise' is the result of the entry's SweepNoiseMeasurement, if one was made.
+    void AddResult(const BenchmarkSweepEntry& entry, const BenchmarkStatistics& statistics, const std::optional<SweepNoiseResult>& noise);
+    [[nodiscard]] std::string GetResultsTable(const std::string& sceneName, const std::string& rendererName) const;
+
+private:
+    struct Result
+    {
+        std::string label;
+        dm::int2 resolution;
+        std::vector<BenchmarkStatistics::SectionSummary> sections;
+        std::optional<SweepNoiseResult> noise;
+    };
+
+    std::vector<BenchmarkSweepEntry> m_Entries;
+    std::vector<Result> m_Results;
+    uint32_t m_FramesPerEntry = 0;
+    uint32_t m_ErrorFrames = 0;
+    uint32_t m_ReferenceFrames = 1024;
+};
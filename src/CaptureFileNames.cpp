@@ -0,0 +1,69 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "CaptureFileNames.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdio>
+#include <filesystem>
+
+namespace fs = std::filesystem;
+
+static const char* GetExtension(FrameCaptureFormat format)
+{
+    switch (format)
+    {
+    case FrameCaptureFormat::Bmp: return ".bmp";
+    case FrameCaptureFormat::Png: return ".png";
+    case FrameCaptureFormat::Exr: return ".exr";
+    case FrameCaptureFormat::Raw:
+    default: return ".raw";
+    }
+}
+
+bool GetCaptureFormatFromFileName(const std::string& fileName, FrameCaptureFormat& outFormat)
+{
+    std::string extension = fs::path(fileName).extension().generic_string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+        [](unsigned char c) { return std::tolower(c); });
+
+    if (extension == ".bmp")
+        outFormat = FrameCaptureFormat::Bmp;
+    else if (extension == ".png")
+        outFormat = FrameCaptureFormat::Png;
+    else if (extension == ".exr")
+        outFormat = FrameCaptureFormat::Exr;
+    else if (extension == ".raw")
+        outFormat = FrameCaptureFormat::Raw;
+    else
+        return false;
+
+    return true;
+}
+
+std::string GetCaptureFileName(const std::string& baseFileName, const std::string& bufferName,
+    FrameCaptureFormat format, uint32_t frameIndex, bool multipleFrames)
+{
+    fs::path path = baseFileName;
+    std::string stem = path.stem().generic_string();
+
+    if (!bufferName.empty())
+        stem += "." + bufferName;
+
+    if (multipleFrames)
+    {
+        char frameText[16];
+        snprintf(frameText, sizeof(frameText), ".%04u", frameIndex);
+        stem += frameText;
+    }
+
+    return (path.parent_path() / (stem + GetExtension(format))).generic_string();
+}
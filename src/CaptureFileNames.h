@@ -0,0 +1,35 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+// This header has no device dependencies, it's shared with the rtxdi-image-compare tool
+// so that the tool can find the files written by --save-file.
+
+#include <cstdint>
+#include <string>
+
+enum class FrameCaptureFormat
+{
+    Bmp,
+    Png,
+    Exr,
+    Raw
+};
+
+// Returns the format that matches the file name extension, or false if the extension is not supported.
+bool GetCaptureFormatFromFileName(const std::string& fileName, FrameCaptureFormat& outFormat);
+
+// Builds the output file name for one buffer of one frame:
+//   "out/frame.png"                                         - main buffer, single frame capture
+//   "out/frame.0042.png"                                    - main buffer, multi-frame capture
+//   "out/frame.HdrColor.exr", "out/frame.HdrColor.0042.exr" - additional buffers
+std::string GetCaptureFileName(const std::string& baseFileName, const std::string& bufferName,
+    FrameCaptureFormat format, uint32_t frameIndex, bool multipleFrames);
@@ -112,7 +112,8 @@ void CompositingPass::Render(
     const donut::engine::IView& view,
     const donut::engine::IView& viewPrev,
     const uint32_t denoiserMode,
-    const bool checkerboard,
+    const uint32_t activeCheckerboardField,
+    const bool enableAccumulation,
     const UIData& ui,
     const EnvironmentLight& environmentLight)
 {
@@ -123,7 +124,11 @@ void CompositingPass::Render(
     viewPrev.FillPlanarViewConstants(constants.viewPrev);
     constants.enableTextures = ui.enableTextures;
     constants.denoiserMode = denoiserMode;
-    constants.checkerboard = checkerboard;
+    constants.checkerboard = activeCheckerboardField != 0;
+    constants.activeCheckerboardField = activeCheckerboardField;
+    // The lighting passes only shade the active field. Without a denoiser, the other field is reconstructed here,
+    // except when accumulating: then the lighting passes write black into the other field and double the active one.
+    constants.reconstructCheckerboard = activeCheckerboardField != 0 && denoiserMode == DENOISER_MODE_OFF && !enableAccumulation;
     constants.enableEnvironmentMap = (environmentLight.textureIndex >= 0);
     constants.environmentMapTextureIndex = (environmentLight.textureIndex >= 0) ? environmentLight.textureIndex : 0;
     constants.environmentScale = environmentLight.radianceScale.x;
@@ -60,7 +60,8 @@ public:
         const donut::engine::IView& view,
         const donut::engine::IView& viewPrev,
         uint32_t denoiserMode,
-        bool checkerboard,
+        uint32_t activeCheckerboardField,
+        bool enableAccumulation,
         const UIData& ui,
         const EnvironmentLight& environmentLight);
 
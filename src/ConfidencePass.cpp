@@ -9,14 +9,16 @@
  **************************************************************************/
 
 #include "ConfidencePass.h"
-#include "FilterGradientsPass.h"
 #include "RenderTargets.h"
+#include "FilterGradientsPass.h"
+#include "HalfFloat.h"
 
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/View.h>
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
 
+#include <algorithm>
 
 using namespace donut::math;
 #include "../shaders/ShaderParameters.h"
@@ -62,6 +64,11 @@ void ConfidencePass::CreatePipeline()
     pipelineDesc.bindingLayouts = { m_BindingLayout };
     pipelineDesc.CS = m_ComputeShader;
     m_ComputePipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    m_FusedComputeShader = m_ShaderFactory->CreateShader("app/ConfidencePass.hlsl", "FusedFilter", nullptr, nvrhi::ShaderType::Compute);
+
+    pipelineDesc.CS = m_FusedComputeShader;
+    m_FusedComputePipeline = m_Device->createComputePipeline(pipelineDesc);
 }
 
 void ConfidencePass::CreateBindingSet(const RenderTargets& renderTargets)
@@ -89,20 +96,21 @@ void ConfidencePass::CreateBindingSet(const RenderTargets& renderTargets)
     }
 
     m_GradientsTexture = renderTargets.Gradients;
+    m_MotionVectorsTexture = renderTargets.MotionVectors;
+    m_InputConfidenceTextures[0] = renderTargets.PrevDiffuseConfidence;
+    m_InputConfidenceTextures[1] = renderTargets.PrevSpecularConfidence;
+    m_OutputConfidenceTextures[0] = renderTargets.DiffuseConfidence;
+    m_OutputConfidenceTextures[1] = renderTargets.SpecularConfidence;
 }
 
-void ConfidencePass::Render(
-    nvrhi::ICommandList* commandList, 
+static ConfidenceConstants GetConfidenceConstants(
     const donut::engine::IView& view,
+    const nvrhi::TextureDesc& gradientsDesc,
     float logDarknessBias,
     float sensitivity,
     float historyLength,
     bool checkerboard)
 {
-    commandList->beginMarker("Confidence");
-
-    const auto& gradientsDesc = m_GradientsTexture->getDesc();
-
     ConfidenceConstants constants = {};
     constants.viewportSize = dm::uint2(view.GetViewExtent().width(), view.GetViewExtent().height());
     constants.invGradientTextureSize.x = 1.f / float(gradientsDesc.width);
@@ -111,7 +119,23 @@ void ConfidencePass::Render(
     constants.sensitivity = sensitivity;
     constants.checkerboard = checkerboard;
     constants.blendFactor = 1.f / (historyLength + 1.f);
-    constants.inputBufferIndex = FilterGradientsPass::GetOutputBufferIndex();
+    return constants;
+}
+
+void ConfidencePass::Render(
+    nvrhi::ICommandList* commandList, 
+    const donut::engine::IView& view,
+    float logDarknessBias,
+    float sensitivity,
+    float historyLength,
+    bool checkerboard,
+    int inputBufferIndex)
+{
+    commandList->beginMarker("Confidence");
+
+    ConfidenceConstants constants = GetConfidenceConstants(view, m_GradientsTexture->getDesc(),
+        logDarknessBias, sensitivity, historyLength, checkerboard);
+    constants.inputBufferIndex = inputBufferIndex;
 
     nvrhi::ComputeState state;
     state.bindings = { m_BindingSet };
@@ -128,7 +152,272 @@ void ConfidencePass::Render(
     commandList->endMarker();
 }
 
+static nvrhi::StagingTextureHandle CaptureTexture(nvrhi::IDevice* device, nvrhi::ICommandList* commandList, nvrhi::ITexture* texture)
+{
+    const nvrhi::TextureDesc& textureDesc = texture->getDesc();
+
+    nvrhi::TextureDesc stagingDesc;
+    stagingDesc.width = textureDesc.width;
+    stagingDesc.height = textureDesc.height;
+    stagingDesc.format = textureDesc.format;
+    stagingDesc.dimension = nvrhi::TextureDimension::Texture2D;
+    stagingDesc.debugName = textureDesc.debugName + "Capture";
+    nvrhi::StagingTextureHandle stagingTexture = device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+
+    // Only copies the first slice of an array, which is the input of the fused pass in the gradients texture
+    commandList->copyTexture(stagingTexture, nvrhi::TextureSlice(), texture, nvrhi::TextureSlice());
+
+    return stagingTexture;
+}
+
+void ConfidencePass::RenderFused(
+    nvrhi::ICommandList* commandList,
+    const donut::engine::IView& view,
+    float logDarknessBias,
+    float sensitivity,
+    float historyLength,
+    bool checkerboard)
+{
+    commandList->beginMarker("Fused Confidence");
+
+    const dm::int2 gradientsExtent = FilterGradientsPass::GetGradientsExtent(view, checkerboard);
+
+    ConfidenceConstants constants = GetConfidenceConstants(view, m_GradientsTexture->getDesc(),
+        logDarknessBias, sensitivity, historyLength, checkerboard);
+    constants.gradientSize = dm::uint2(gradientsExtent);
+
+    const bool capture = m_CaptureRequested;
+    if (capture)
+    {
+        m_CaptureRequested = false;
+
+        m_Capture.gradients = CaptureTexture(m_Device, commandList, m_GradientsTexture);
+        m_Capture.motionVectors = CaptureTexture(m_Device, commandList, m_MotionVectorsTexture);
+        for (int channel = 0; channel < 2; channel++)
+            m_Capture.prevConfidence[channel] = CaptureTexture(m_Device, commandList, m_InputConfidenceTextures[channel]);
+
+        m_Capture.gradientWidth = uint32_t(gradientsExtent.x);
+        m_Capture.gradientHeight = uint32_t(gradientsExtent.y);
+        m_Capture.width = constants.viewportSize.x;
+        m_Capture.height = constants.viewportSize.y;
+        m_Capture.darknessBias = constants.darknessBias;
+        m_Capture.sensitivity = constants.sensitivity;
+        m_Capture.blendFactor = constants.blendFactor;
+        m_Capture.checkerboard = checkerboard;
+    }
+
+    nvrhi::ComputeState state;
+    state.bindings = { m_BindingSet };
+    state.pipeline = m_FusedComputePipeline;
+    commandList->setComputeState(state);
+
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    commandList->dispatch(
+        dm::div_ceil(gradientsExtent.x, FILTER_GRADIENTS_FUSED_TILE_SIZE),
+        dm::div_ceil(gradientsExtent.y, FILTER_GRADIENTS_FUSED_TILE_SIZE),
+        1);
+
+    if (capture)
+    {
+        for (int channel = 0; channel < 2; channel++)
+            m_Capture.confidence[channel] = CaptureTexture(m_Device, commandList, m_OutputConfidenceTextures[channel]);
+
+        m_CapturePending = true;
+    }
+
+    commandList->endMarker();
+}
+
 void ConfidencePass::NextFrame()
 {
     std::swap(m_BindingSet, m_PrevBindingSet);
+
+    for (int channel = 0; channel < 2; channel++)
+        std::swap(m_InputConfidenceTextures[channel], m_OutputConfidenceTextures[channel]);
+}
+
+// Reads the first width x height texels of an RGBA16_FLOAT or R8_UNORM staging texture.
+static bool ReadTexture(nvrhi::IDevice* device, nvrhi::IStagingTexture* stagingTexture, uint32_t width, uint32_t height, std::vector<float>& outValues)
+{
+    const bool isHalf = stagingTexture->getDesc().format == nvrhi::Format::RGBA16_FLOAT;
+    const uint32_t rowValues = width * (isHalf ? 4 : 1);
+
+    size_t rowPitch = 0;
+    const uint8_t* data = static_cast<const uint8_t*>(device->mapStagingTexture(stagingTexture,
+        nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+
+    if (!data)
+        return false;
+
+    outValues.resize(size_t(rowValues) * height);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint8_t* row = data + y * rowPitch;
+        float* outRow = outValues.data() + size_t(y) * rowValues;
+
+        for (uint32_t i = 0; i < rowValues; i++)
+            outRow[i] = isHalf ? HalfToFloat(reinterpret_cast<const uint16_t*>(row)[i]) : float(row[i]) / 255.f;
+    }
+
+    device->unmapStagingTexture(stagingTexture);
+    return true;
+}
+
+bool ConfidencePass::VerifyCapture()
+{
+    m_CapturePending = false;
+
+    m_Device->waitForIdle();
+
+    ConfidenceReferenceInputs inputs;
+    inputs.gradientWidth = m_Capture.gradientWidth;
+    inputs.gradientHeight = m_Capture.gradientHeight;
+    inputs.width = m_Capture.width;
+    inputs.height = m_Capture.height;
+
+    std::vector<float> gpuConfidence[2];
+
+    if (!ReadTexture(m_Device, m_Capture.gradients, inputs.gradientWidth, inputs.gradientHeight, inputs.gradients) ||
+        !ReadTexture(m_Device, m_Capture.motionVectors, inputs.width, inputs.height, inputs.motionVectors) ||
+        !ReadTexture(m_Device, m_Capture.prevConfidence[0], inputs.width, inputs.height, inputs.prevDiffuseConfidence) ||
+        !ReadTexture(m_Device, m_Capture.prevConfidence[1], inputs.width, inputs.height, inputs.prevSpecularConfidence) ||
+        !ReadTexture(m_Device, m_Capture.confidence[0], inputs.width, inputs.height, gpuConfidence[0]) ||
+        !ReadTexture(m_Device, m_Capture.confidence[1], inputs.width, inputs.height, gpuConfidence[1]))
+    {
+        donut::log::error("Couldn't map the confidence readback textures.");
+        return false;
+    }
+
+    if (std::all_of(inputs.gradients.begin(), inputs.gradients.end(), [](float value) { return value == 0.f; }))
+    {
+        // Nothing has changed in the scene yet, try again on the next frame
+        m_CaptureRequested = true;
+        return true;
+    }
+
+    std::vector<float> referenceConfidence[2];
+    ConfidenceReference(inputs, m_Capture.darknessBias, m_Capture.sensitivity, m_Capture.blendFactor, m_Capture.checkerboard,
+        referenceConfidence[0], referenceConfidence[1]);
+
+    // The output is 8-bit, and the sensitivity exponent amplifies the float16 rounding differences in the filter
+    constexpr float tolerance = 3.f / 255.f;
+
+    uint32_t mismatchCount = 0;
+    float maxError = 0.f;
+
+    for (int channel = 0; channel < 2; channel++)
+    {
+        for (size_t i = 0; i < referenceConfidence[channel].size(); i++)
+        {
+            const float error = fabsf(gpuConfidence[channel][i] - referenceConfidence[channel][i]);
+            maxError = std::max(maxError, error);
+
+            if (error > tolerance)
+                ++mismatchCount;
+        }
+    }
+
+    if (mismatchCount > 0)
+    {
+        donut::log::error("The fused confidence pass differs from the CPU model in %d of %d values, max error %f.",
+            mismatchCount, int(referenceConfidence[0].size() * 2), maxError);
+        return false;
+    }
+
+    donut::log::info("The fused confidence pass matches the CPU model (%dx%d pixels, max error %f).",
+        inputs.width, inputs.height, maxError);
+    return true;
+}
+
+void ConfidenceReference(
+    const ConfidenceReferenceInputs& inputs,
+    float darknessBias,
+    float sensitivity,
+    float blendFactor,
+    bool checkerboard,
+    std::vector<float>& outDiffuseConfidence,
+    std::vector<float>& outSpecularConfidence)
+{
+    std::vector<float> gradients = inputs.gradients;
+    FilterGradientsReference(gradients, inputs.gradientWidth, inputs.gradientHeight, checkerboard);
+
+    // Zero outside of the gradients, like the border color of the sampler
+    auto getGradient = [&gradients, &inputs](int x, int y, int channel)
+    {
+        if (x < 0 || y < 0 || x >= int(inputs.gradientWidth) || y >= int(inputs.gradientHeight))
+            return 0.f;
+
+        return gradients[(size_t(y) * inputs.gradientWidth + x) * 4 + channel];
+    };
+
+    auto lerp = [](float a, float b, float t) { return a + (b - a) * t; };
+    auto saturate = [](float value) { return std::clamp(value, 0.f, 1.f); };
+
+    outDiffuseConfidence.resize(size_t(inputs.width) * inputs.height);
+    outSpecularConfidence.resize(size_t(inputs.width) * inputs.height);
+
+    for (int y = 0; y < int(inputs.height); y++)
+    for (int x = 0; x < int(inputs.width); x++)
+    {
+        float posX = (float(x) + 0.5f) / RTXDI_GRAD_FACTOR;
+        const float posY = (float(y) + 0.5f) / RTXDI_GRAD_FACTOR - 0.5f;
+        if (checkerboard)
+            posX *= 0.5f;
+        posX -= 0.5f;
+
+        const int baseX = int(floorf(posX));
+        const int baseY = int(floorf(posY));
+        const float fx = posX - float(baseX);
+        const float fy = posY - float(baseY);
+
+        float gradient[4];
+        for (int channel = 0; channel < 4; channel++)
+        {
+            gradient[channel] = lerp(
+                lerp(getGradient(baseX, baseY, channel), getGradient(baseX + 1, baseY, channel), fx),
+                lerp(getGradient(baseX, baseY + 1, channel), getGradient(baseX + 1, baseY + 1, channel), fx),
+                fy);
+            gradient[channel] = std::max(gradient[channel], 0.f);
+        }
+
+        gradient[2] += darknessBias * RTXDI_GRAD_STORAGE_SCALE;
+        gradient[3] += darknessBias * RTXDI_GRAD_STORAGE_SCALE;
+
+        float confidence[2] = {
+            saturate(powf(saturate(1.f - gradient[0] / gradient[2]), sensitivity)),
+            saturate(powf(saturate(1.f - gradient[1] / gradient[3]), sensitivity))
+        };
+
+        const size_t pixelIndex = size_t(y) * inputs.width + x;
+
+        if (blendFactor < 1.f)
+        {
+            const int prevX = int(float(x) + 0.5f + inputs.motionVectors[pixelIndex * 4 + 0]);
+            const int prevY = int(float(y) + 0.5f + inputs.motionVectors[pixelIndex * 4 + 1]);
+
+            if (prevX >= 0 && prevY >= 0 && prevX < int(inputs.width) && prevY < int(inputs.height))
+            {
+                const size_t prevIndex = size_t(prevY) * inputs.width + prevX;
+                const float prevConfidence[2] = {
+                    inputs.prevDiffuseConfidence[prevIndex],
+                    inputs.prevSpecularConfidence[prevIndex]
+                };
+
+                // Same non-linear blending as in the shader
+                const float power = 0.25f;
+
+                for (int channel = 0; channel < 2; channel++)
+                {
+                    const float current = powf(confidence[channel], power);
+                    const float prev = powf(prevConfidence[channel], power);
+                    confidence[channel] = powf(saturate(lerp(prev, current, blendFactor)), 1.f / power);
+                }
+            }
+        }
+
+        outDiffuseConfidence[pixelIndex] = confidence[0];
+        outSpecularConfidence[pixelIndex] = confidence[1];
+    }
 }
@@ -12,6 +12,7 @@
 
 #include <nvrhi/nvrhi.h>
 #include <memory>
+#include <vector>
 
 namespace donut::engine
 {
@@ -21,6 +22,32 @@ namespace donut::engine
 
 class RenderTargets;
 
+// Inputs of the CPU model of the fused confidence pass, read back from the textures that the pass uses.
+// All images are stored row by row, the gradients and motion vectors with 4 channels per texel.
+struct ConfidenceReferenceInputs
+{
+    uint32_t gradientWidth = 0;
+    uint32_t gradientHeight = 0;
+    std::vector<float> gradients; // unfiltered
+
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<float> motionVectors;
+    std::vector<float> prevDiffuseConfidence;
+    std::vector<float> prevSpecularConfidence;
+};
+
+// CPU model of the gradient filter and the confidence pass with its temporal filter.
+// Interpolates the filtered gradients with exact bilinear weights, like the fused version does.
+void ConfidenceReference(
+    const ConfidenceReferenceInputs& inputs,
+    float darknessBias,
+    float sensitivity,
+    float blendFactor,
+    bool checkerboard,
+    std::vector<float>& outDiffuseConfidence,
+    std::vector<float>& outSpecularConfidence);
+
 class ConfidencePass
 {
 private:
@@ -28,12 +55,39 @@ private:
 
     nvrhi::ShaderHandle m_ComputeShader;
     nvrhi::ComputePipelineHandle m_ComputePipeline;
+    nvrhi::ShaderHandle m_FusedComputeShader;
+    nvrhi::ComputePipelineHandle m_FusedComputePipeline;
     nvrhi::BindingLayoutHandle m_BindingLayout;
     nvrhi::BindingSetHandle m_BindingSet;
     nvrhi::BindingSetHandle m_PrevBindingSet;
     nvrhi::TextureHandle m_GradientsTexture;
     nvrhi::SamplerHandle m_Sampler;
 
+    // The confidence textures that m_BindingSet reads and writes, for the capture
+    nvrhi::TextureHandle m_MotionVectorsTexture;
+    nvrhi::TextureHandle m_InputConfidenceTextures[2]; // diffuse, specular
+    nvrhi::TextureHandle m_OutputConfidenceTextures[2];
+
+    // Readback of the fused pass inputs and outputs for the validation against the CPU model
+    struct Capture
+    {
+        nvrhi::StagingTextureHandle gradients;
+        nvrhi::StagingTextureHandle motionVectors;
+        nvrhi::StagingTextureHandle prevConfidence[2];
+        nvrhi::StagingTextureHandle confidence[2];
+        uint32_t gradientWidth = 0;
+        uint32_t gradientHeight = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        float darknessBias = 0.f;
+        float sensitivity = 0.f;
+        float blendFactor = 0.f;
+        bool checkerboard = false;
+    };
+    Capture m_Capture;
+    bool m_CaptureRequested = false;
+    bool m_CapturePending = false;
+
     std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
 
 public:
@@ -46,6 +100,17 @@ public:
     void CreateBindingSet(const RenderTargets& renderTargets);
 
     void Render(
+        nvrhi::ICommandList* commandList,
+        const donut::engine::IView& view,
+        float logDarknessBias,
+        float sensitivity,
+        float historyLength,
+        bool checkerboard,
+        int inputBufferIndex);
+
+    // Runs the gradient filter and the confidence conversion in one dispatch, keeping the filtered gradients
+    // in shared memory. Reads the unfiltered gradients, so FilterGradientsPass must not run before it.
+    void RenderFused(
         nvrhi::ICommandList* commandList,
         const donut::engine::IView& view,
         float logDarknessBias,
@@ -53,5 +118,14 @@ public:
         float historyLength,
         bool checkerboard);
 
+    // Makes the next RenderFused call copy its inputs and outputs into staging textures.
+    void RequestCapture() { m_CaptureRequested = true; }
+    [[nodiscard]] bool IsCapturePending() const { return m_CapturePending; }
+
+    // Runs the CPU model on the captured inputs and compares the result with the captured confidence.
+    // Waits for the GPU to finish all submitted work. If the captured gradients are all zero,
+    // another capture is requested instead.
+    bool VerifyCapture();
+
     void NextFrame();
 };
@@ -0,0 +1,146 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ConvergenceErrorPass.h"
+#include "RenderTargets.h"
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/core/log.h>
+#include <nvrhi/utils.h>
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+using namespace donut::engine;
+
+
+ConvergenceErrorPass::ConvergenceErrorPass(
+    nvrhi::IDevice* device,
+    std::shared_ptr<ShaderFactory> shaderFactory)
+    : m_Device(device)
+    , m_ShaderFactory(shaderFactory)
+{
+    nvrhi::BindingLayoutDesc bindingLayoutDesc;
+    bindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+    bindingLayoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(ConvergenceErrorConstants))
+    };
+
+    m_BindingLayout = m_Device->createBindingLayout(bindingLayoutDesc);
+}
+
+void ConvergenceErrorPass::CreatePipeline()
+{
+    donut::log::debug("Initializing ConvergenceErrorPass...");
+
+    m_ComputeShader = m_ShaderFactory->CreateShader("app/ConvergenceError.hlsl", "main", nullptr, nvrhi::ShaderType::Compute);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.bindingLayouts = { m_BindingLayout };
+    pipelineDesc.CS = m_ComputeShader;
+    m_ComputePipeline = m_Device->createComputePipeline(pipelineDesc);
+}
+
+void ConvergenceErrorPass::CreateBindingSet(const RenderTargets& renderTargets)
+{
+    const auto& colorDesc = renderTargets.ResolvedColor->getDesc();
+    m_OutputWidth = colorDesc.width;
+    m_OutputHeight = colorDesc.height;
+    m_GroupCountX = dm::div_ceil(m_OutputWidth, CONVERGENCE_ERROR_GROUP_SIZE);
+    m_GroupCountY = dm::div_ceil(m_OutputHeight, CONVERGENCE_ERROR_GROUP_SIZE);
+
+    nvrhi::BufferDesc bufferDesc;
+    bufferDesc.byteSize = sizeof(float) * 2 * m_GroupCountX * m_GroupCountY;
+    bufferDesc.structStride = sizeof(float) * 2;
+    bufferDesc.canHaveUAVs = true;
+    bufferDesc.debugName = "ConvergenceGroupErrors";
+    bufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    bufferDesc.keepInitialState = true;
+    m_GroupErrorBuffer = m_Device->createBuffer(bufferDesc);
+
+    bufferDesc.canHaveUAVs = false;
+    bufferDesc.structStride = 0;
+    bufferDesc.cpuAccess = nvrhi::CpuAccessMode::Read;
+    bufferDesc.initialState = nvrhi::ResourceStates::Common;
+    bufferDesc.keepInitialState = false;
+    bufferDesc.debugName = "ConvergenceGroupErrorsReadback";
+    for (auto& buffer : m_ReadbackBuffers)
+        buffer = m_Device->createBuffer(bufferDesc);
+
+    // The old measurements refer to a different buffer size
+    m_ReadbackValid.fill(false);
+
+    nvrhi::BindingSetDesc bindingSetDesc;
+    bindingSetDesc.bindings = {
+        nvrhi::BindingSetItem::Texture_SRV(0, renderTargets.ResolvedColor),
+        nvrhi::BindingSetItem::Texture_SRV(1, renderTargets.ReferenceColor),
+        nvrhi::BindingSetItem::StructuredBuffer_UAV(0, m_GroupErrorBuffer),
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(ConvergenceErrorConstants))
+    };
+
+    m_BindingSet = m_Device->createBindingSet(bindingSetDesc, m_BindingLayout);
+}
+
+bool ConvergenceErrorPass::ResolvePreviousFrame(uint32_t& outSampleIndex, double& outMse, double& outRelMse)
+{
+    m_ActiveBank = !m_ActiveBank;
+
+    if (!m_ReadbackValid[m_ActiveBank])
+        return false;
+
+    m_ReadbackValid[m_ActiveBank] = false;
+
+    const float* groupErrors = static_cast<const float*>(m_Device->mapBuffer(m_ReadbackBuffers[m_ActiveBank], nvrhi::CpuAccessMode::Read));
+    if (!groupErrors)
+        return false;
+
+    double squaredError = 0.0;
+    double relativeError = 0.0;
+    for (uint32_t group = 0; group < m_GroupCountX * m_GroupCountY; group++)
+    {
+        squaredError += double(groupErrors[group * 2 + 0]);
+        relativeError += double(groupErrors[group * 2 + 1]);
+    }
+
+    m_Device->unmapBuffer(m_ReadbackBuffers[m_ActiveBank]);
+
+    const double pixelCount = double(m_OutputWidth) * double(m_OutputHeight);
+    outSampleIndex = m_ReadbackSampleIndex[m_ActiveBank];
+    outMse = squaredError / pixelCount;
+    outRelMse = relativeError / pixelCount;
+    return true;
+}
+
+void ConvergenceErrorPass::Render(nvrhi::ICommandList* commandList, uint32_t sampleIndex)
+{
+    commandList->beginMarker("ConvergenceError");
+
+    ConvergenceErrorConstants constants = {};
+    constants.outputSize = uint2(m_OutputWidth, m_OutputHeight);
+    constants.groupCountX = m_GroupCountX;
+
+    nvrhi::ComputeState state;
+    state.bindings = { m_BindingSet };
+    state.pipeline = m_ComputePipeline;
+    commandList->setComputeState(state);
+
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    commandList->dispatch(m_GroupCountX, m_GroupCountY, 1);
+
+    commandList->copyBuffer(m_ReadbackBuffers[m_ActiveBank], 0, m_GroupErrorBuffer, 0, m_GroupErrorBuffer->getDesc().byteSize);
+    m_ReadbackValid[m_ActiveBank] = true;
+    m_ReadbackSampleIndex[m_ActiveBank] = sampleIndex;
+
+    commandList->endMarker();
+}
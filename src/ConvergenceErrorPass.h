@@ -0,0 +1,63 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <array>
+#include <memory>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+}
+
+class RenderTargets;
+
+// Measures the error of ResolvedColor against ReferenceColor on the GPU.
+// The per-group sums are read back with the same two-frame latency as the profiler timers,
+// so a measurement and the frame time of the same frame become available together.
+class ConvergenceErrorPass
+{
+private:
+    nvrhi::DeviceHandle m_Device;
+
+    nvrhi::ShaderHandle m_ComputeShader;
+    nvrhi::ComputePipelineHandle m_ComputePipeline;
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::BindingSetHandle m_BindingSet;
+    nvrhi::BufferHandle m_GroupErrorBuffer;
+    std::array<nvrhi::BufferHandle, 2> m_ReadbackBuffers;
+    std::array<bool, 2> m_ReadbackValid{};
+    std::array<uint32_t, 2> m_ReadbackSampleIndex{};
+    uint32_t m_ActiveBank = 0;
+    uint32_t m_GroupCountX = 0;
+    uint32_t m_GroupCountY = 0;
+    uint32_t m_OutputWidth = 0;
+    uint32_t m_OutputHeight = 0;
+
+    std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
+
+public:
+    ConvergenceErrorPass(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory);
+
+    void CreatePipeline();
+
+    void CreateBindingSet(const RenderTargets& renderTargets);
+
+    // Call once per frame, before Render. Returns true and the error sums if a measurement
+    // recorded two frames ago is available.
+    bool ResolvePreviousFrame(uint32_t& outSampleIndex, double& outMse, double& outRelMse);
+
+    // Computes the error of the current ResolvedColor and tags the measurement with sampleIndex.
+    void Render(nvrhi::ICommandList* commandList, uint32_t sampleIndex);
+};
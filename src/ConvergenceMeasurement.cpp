@@ -0,0 +1,234 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "ConvergenceMeasurement.h"
+#include "BenchmarkSweep.h"
+
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+using namespace donut;
+
+bool ParseConvergencePresets(const std::string& list, std::vector<QualityPreset>& outPresets)
+{
+    std::istringstream stream(list);
+    std::string name;
+
+    while (std::getline(stream, name, ','))
+    {
+        QualityPreset preset;
+        if (!ParseQualityPreset(name, preset))
+        {
+            log::error("Unrecognized preset '%s' in the convergence preset list.", name.c_str());
+            return false;
+        }
+
+        outPresets.push_back(preset);
+    }
+
+    return !outPresets.empty();
+}
+
+ConvergenceMeasurement::ConvergenceMeasurement(ConvergenceSettings settings)
+    : m_Settings(std::move(settings))
+{
+    m_Settings.referenceFrames = std::max(m_Settings.referenceFrames, 1u);
+    m_Settings.framesPerPreset = std::max(m_Settings.framesPerPreset, 1u);
+    m_Samples.resize(m_Settings.presets.size() * m_Settings.framesPerPreset);
+}
+
+ConvergenceMeasurement::FrameActions ConvergenceMeasurement::BeginFrame(UIData& ui)
+{
+    FrameActions actions;
+
+    switch (m_Phase)
+    {
+    case Phase::Reference:
+        if (m_PhaseFrame == 0)
+        {
+            BenchmarkSweepEntry entry;
+            entry.preset = QualityPreset::Reference;
+            entry.ApplyToUI(ui);
+            ui.aaMode = AntiAliasingMode::Accumulation;
+            ui.framesToAccumulate = m_Settings.referenceFrames;
+            actions.startRun = true;
+
+            log::info("Convergence: accumulating the reference image over %d frames", m_Settings.referenceFrames);
+        }
+        // numAccumulatedFrames is updated later in the frame, so here it still has the value from the previous frame.
+        else if (ui.numAccumulatedFrames + 1 >= m_Settings.referenceFrames)
+        {
+            actions.storeReference = true;
+            m_Phase = m_Settings.presets.empty() ? Phase::Drain : Phase::Presets;
+            m_PhaseFrame = 0;
+            return actions;
+        }
+        else if (m_PhaseFrame > m_Settings.referenceFrames * 2)
+        {
+            // Accumulation restarts whenever the camera moves, give up instead of running forever.
+            log::warning("Convergence: the reference only accumulated %d frames, is the camera moving?", ui.numAccumulatedFrames);
+            actions.storeReference = true;
+            m_Phase = m_Settings.presets.empty() ? Phase::Drain : Phase::Presets;
+            m_PhaseFrame = 0;
+            return actions;
+        }
+        break;
+
+    case Phase::Presets:
+        if (m_PhaseFrame == 0)
+        {
+            const QualityPreset preset = m_Settings.presets[m_PresetIndex];
+
+            BenchmarkSweepEntry entry;
+            entry.preset = preset;
+            entry.ApplyToUI(ui);
+            ui.aaMode = AntiAliasingMode::Accumulation;
+            ui.framesToAccumulate = 0;
+
+            // Start every run from scratch, so that the reservoirs of the previous run don't give it a head start.
+            ui.resetISContext = true;
+            actions.startRun = true;
+
+            log::info("Convergence: rendering the %s preset for %d frames", GetQualityPresetName(preset), m_Settings.framesPerPreset);
+        }
+
+        actions.measure = true;
+        actions.sampleIndex = uint32_t(m_PresetIndex) * m_Settings.framesPerPreset + m_PhaseFrame;
+
+        if (m_PhaseFrame + 1 == m_Settings.framesPerPreset)
+        {
+            m_PhaseFrame = 0;
+            ++m_PresetIndex;
+
+            if (m_PresetIndex == m_Settings.presets.size())
+                m_Phase = Phase::Drain;
+
+            return actions;
+        }
+        break;
+
+    case Phase::Drain:
+        // Wait until the measurements of the last frames have been read back
+        if (m_PhaseFrame >= c_ReadbackLatency)
+            m_Phase = Phase::Finished;
+        break;
+
+    case Phase::Finished:
+        break;
+    }
+
+    ++m_PhaseFrame;
+    return actions;
+}
+
+void ConvergenceMeasurement::AddSample(uint32_t sampleIndex, double frameTimeMs, double mse, double relMse)
+{
+    if (sampleIndex >= m_Samples.size())
+        return;
+
+    Sample& sample = m_Samples[sampleIndex];
+    sample.frameTimeMs = frameTimeMs;
+    sample.mse = mse;
+    sample.relMse = relMse;
+    sample.valid = true;
+}
+
+std::vector<ConvergenceMeasurement::CurvePoint> ConvergenceMeasurement::GetCurve(size_t presetIndex) const
+{
+    std::vector<CurvePoint> curve;
+    double cumulativeTimeMs = 0.0;
+
+    for (uint32_t frame = 0; frame < m_Settings.framesPerPreset; frame++)
+    {
+        const Sample& sample = m_Samples[presetIndex * m_Settings.framesPerPreset + frame];
+        if (!sample.valid)
+            continue;
+
+        cumulativeTimeMs += sample.frameTimeMs;
+        curve.push_back({ frame, sample.frameTimeMs, cumulativeTimeMs, sample.mse, sample.relMse });
+    }
+
+    return curve;
+}
+
+std::string ConvergenceMeasurement::GetCurveCsv() const
+{
+    std::stringstream text;
+    text << "preset,frame,frame_ms,cumulative_ms,mse,rel_mse" << std::endl;
+
+    for (size_t presetIndex = 0; presetIndex < m_Settings.presets.size(); presetIndex++)
+    {
+        const char* presetName = GetQualityPresetName(m_Settings.presets[presetIndex]);
+
+        for (const CurvePoint& point : GetCurve(presetIndex))
+        {
+            text << presetName << "," << point.frame << ","
+                << std::fixed << std::setprecision(4) << point.frameTimeMs << "," << point.cumulativeTimeMs << ","
+                << std::scientific << std::setprecision(6) << point.mse << "," << point.relMse << std::endl;
+        }
+    }
+
+    return text.str();
+}
+
+std::string ConvergenceMeasurement::GetSummary() const
+{
+    std::vector<std::vector<CurvePoint>> curves;
+    double timeBudgetMs = 0.0;
+
+    // The equal-time budget is the total time of the fastest run, so every preset has a sample within it.
+    for (size_t presetIndex = 0; presetIndex < m_Settings.presets.size(); presetIndex++)
+    {
+        curves.push_back(GetCurve(presetIndex));
+
+        if (!curves.back().empty())
+        {
+            const double totalTimeMs = curves.back().back().cumulativeTimeMs;
+            timeBudgetMs = (timeBudgetMs == 0.0) ? totalTimeMs : std::min(timeBudgetMs, totalTimeMs);
+        }
+    }
+
+    std::stringstream text;
+    text << "Reference frames: " << m_Settings.referenceFrames << ", frames per preset: " << m_Settings.framesPerPreset << std::endl;
+    text << std::fixed << std::setprecision(2);
+    text << "| Preset | Frame (ms) | Total (ms) | Final MSE | Final relMSE | relMSE at " << timeBudgetMs << " ms |" << std::endl;
+    text << "|---|---:|---:|---:|---:|---:|" << std::endl;
+
+    for (size_t presetIndex = 0; presetIndex < curves.size(); presetIndex++)
+    {
+        const std::vector<CurvePoint>& curve = curves[presetIndex];
+        text << "| " << GetQualityPresetName(m_Settings.presets[presetIndex]) << " | ";
+
+        if (curve.empty())
+        {
+            text << "- | - | - | - | - |" << std::endl;
+            continue;
+        }
+
+        // Last point within the budget; the curve is sampled per frame, so this is a step function
+        const CurvePoint* budgetPoint = &curve.front();
+        for (const CurvePoint& point : curve)
+        {
+            if (point.cumulativeTimeMs <= timeBudgetMs)
+                budgetPoint = &point;
+        }
+
+        const CurvePoint& last = curve.back();
+        text << std::fixed << std::setprecision(3) << last.cumulativeTimeMs / double(curve.size()) << " | "
+            << std::setprecision(2) << last.cumulativeTimeMs << " | "
+            << std::scientific << std::setprecision(3) << last.mse << " | " << last.relMse << " | "
+            << budgetPoint->relMse << " |" << std::endl;
+    }
+
+    return text.str();
+}
@@ -0,0 +1,96 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "UserInterface.h"
+
+#include <string>
+#include <vector>
+
+struct ConvergenceSettings
+{
+    std::vector<QualityPreset> presets;
+    uint32_t referenceFrames = 1024;
+    uint32_t framesPerPreset = 64;
+};
+
+// Parses a comma-separated list of preset names, e.g. "fast,medium,ultra".
+bool ParseConvergencePresets(const std::string& list, std::vector<QualityPreset>& outPresets);
+
+// Drives the equal-time convergence measurement: first accumulates a reference image with the Reference preset,
+// then renders each of the requested presets for a number of frames with accumulation, recording the GPU frame
+// time and the error against the reference for every frame. The camera must stay static for the whole run.
+// This class only manages the settings and the results, the rendering side lives in main.cpp.
+class ConvergenceMeasurement
+{
+public:
+    struct FrameActions
+    {
+        bool startRun = false;       // The settings changed, temporal history from the previous run should be dropped
+        bool storeReference = false; // Copy the resolved image into ReferenceColor in this frame
+        bool measure = false;        // Measure the error of this frame and tag it with sampleIndex
+        uint32_t sampleIndex = 0;
+    };
+
+    explicit ConvergenceMeasurement(ConvergenceSettings settings);
+
+    // Call at the beginning of every frame, updates the UI settings for the current phase.
+    FrameActions BeginFrame(UIData& ui);
+
+    // Records a measurement. Measurements arrive a few frames late, possibly after the next preset has started.
+    void AddSample(uint32_t sampleIndex, double frameTimeMs, double mse, double relMse);
+
+    [[nodiscard]] bool IsFinished() const { return m_Phase == Phase::Finished; }
+
+    // Error versus accumulated GPU time, one row per frame:
+    //   preset,frame,frame_ms,cumulative_ms,mse,rel_mse
+    [[nodiscard]] std::string GetCurveCsv() const;
+
+    // One row per preset, including the error of every preset at the time budget of the fastest run.
+    [[nodiscard]] std::string GetSummary() const;
+
+private:
+    // Measurements are read back two frames after they are recorded, see ConvergenceErrorPass.
+    static constexpr uint32_t c_ReadbackLatency = 2;
+
+    enum class Phase
+    {
+        Reference,
+        Presets,
+        Drain,
+        Finished
+    };
+
+    struct Sample
+    {
+        double frameTimeMs = 0.0;
+        double mse = 0.0;
+        double relMse = 0.0;
+        bool valid = false;
+    };
+
+    struct CurvePoint
+    {
+        uint32_t frame;
+        double frameTimeMs;
+        double cumulativeTimeMs;
+        double mse;
+        double relMse;
+    };
+
+    ConvergenceSettings m_Settings;
+    Phase m_Phase = Phase::Reference;
+    uint32_t m_PhaseFrame = 0;
+    size_t m_PresetIndex = 0;
+    std::vector<Sample> m_Samples;
+
+    [[nodiscard]] std::vector<CurvePoint> GetCurve(size_t presetIndex) const;
+};
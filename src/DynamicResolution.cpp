@@ -0,0 +1,92 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "DynamicResolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+// Weight of the latest frame in the smoothed frame time
+constexpr double c_FrameTimeSmoothing = 0.25;
+
+DynamicResolutionController::DynamicResolutionController(const DynamicResolutionSettings& settings)
+{
+    SetSettings(settings);
+    Reset(m_Settings.maxScale);
+}
+
+void DynamicResolutionController::SetSettings(const DynamicResolutionSettings& settings)
+{
+    m_Settings = settings;
+    m_Settings.scaleStep = std::max(m_Settings.scaleStep, 0.01f);
+    m_Settings.minScale = std::clamp(m_Settings.minScale, m_Settings.scaleStep, 1.f);
+    m_Settings.maxScale = std::clamp(m_Settings.maxScale, m_Settings.minScale, 1.f);
+    m_Settings.headroom = std::clamp(m_Settings.headroom, 0.f, 0.9f);
+
+    // Apply the new bounds right away
+    const float scale = SnapScale(m_Scale);
+    if (scale != m_Scale)
+        SetScale(scale);
+}
+
+void DynamicResolutionController::Reset(float scale)
+{
+    SetScale(SnapScale(scale));
+}
+
+float DynamicResolutionController::SnapScale(float scale) const
+{
+    // The small bias keeps the exact multiples from rounding down to the previous step
+    scale = std::floor(scale / m_Settings.scaleStep + 1e-3f) * m_Settings.scaleStep;
+    return std::clamp(scale, m_Settings.minScale, m_Settings.maxScale);
+}
+
+void DynamicResolutionController::SetScale(float scale)
+{
+    m_Scale = scale;
+    m_SmoothedFrameTime = 0.0;
+    m_FramesSinceChange = 0;
+}
+
+float DynamicResolutionController::Update(double frameTime)
+{
+    if (frameTime <= 0.0 || m_Settings.targetFrameTime <= 0.f)
+        return m_Scale;
+
+    // The frames right after a change may still have been rendered at the previous scale
+    if (m_FramesSinceChange < m_Settings.settleFrames)
+    {
+        ++m_FramesSinceChange;
+        return m_Scale;
+    }
+
+    m_SmoothedFrameTime = (m_SmoothedFrameTime > 0.0)
+        ? m_SmoothedFrameTime + (frameTime - m_SmoothedFrameTime) * c_FrameTimeSmoothing
+        : frameTime;
+
+    const double target = m_Settings.targetFrameTime;
+
+    if (m_SmoothedFrameTime > target)
+    {
+        const float scale = SnapScale(m_Scale * float(std::sqrt(target / m_SmoothedFrameTime)));
+        if (scale < m_Scale)
+            SetScale(scale);
+    }
+    else if (m_SmoothedFrameTime < target * (1.0 - m_Settings.headroom))
+    {
+        // Only go up if the next step is predicted to stay below the budget with the headroom
+        const float scale = SnapScale(m_Scale + m_Settings.scaleStep);
+        const double predictedTime = m_SmoothedFrameTime * double(scale * scale) / double(m_Scale * m_Scale);
+        if (scale > m_Scale && predictedTime < target * (1.0 - m_Settings.headroom * 0.5))
+            SetScale(scale);
+    }
+
+    return m_Scale;
+}
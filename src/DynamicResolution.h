@@ -0,0 +1,54 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+struct DynamicResolutionSettings
+{
+    float targetFrameTime = 16.f; // GPU time budget in milliseconds
+    float minScale = 0.5f;
+    float maxScale = 1.f;
+    float scaleStep = 0.05f; // the scale only takes values that are multiples of this, within the bounds
+    float headroom = 0.1f; // fraction of the budget that must be left over before the scale goes up
+    uint32_t settleFrames = 8; // frames to skip after a change, the timer queries report the older frames
+};
+
+// Picks the render resolution scale that keeps the GPU frame time within a budget. The GPU time is assumed
+// to be proportional to the number of pixels, i.e. to the square of the scale. The scale goes down as far as
+// necessary at once, but only goes up one step at a time to avoid oscillating around the budget.
+// Contains no graphics objects, so it can be fed with synthetic timings.
+class DynamicResolutionController
+{
+public:
+    explicit DynamicResolutionController(const DynamicResolutionSettings& settings = DynamicResolutionSettings());
+
+    void SetSettings(const DynamicResolutionSettings& settings);
+
+    // Starts over from the given scale, snapped to a step within the bounds.
+    void Reset(float scale);
+
+    // Takes the GPU time of a frame in milliseconds and returns the scale for the next frame.
+    // A time of zero means that the frame wasn't measured, and it's ignored.
+    float Update(double frameTime);
+
+    [[nodiscard]] float GetScale() const { return m_Scale; }
+    [[nodiscard]] double GetSmoothedFrameTime() const { return m_SmoothedFrameTime; }
+
+private:
+    DynamicResolutionSettings m_Settings;
+    float m_Scale = 1.f;
+    double m_SmoothedFrameTime = 0.0;
+    uint32_t m_FramesSinceChange = 0;
+
+    [[nodiscard]] float SnapScale(float scale) const;
+    void SetScale(float scale);
+};
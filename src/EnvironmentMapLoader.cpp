@@ -0,0 +1,269 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentMapLoader.h"
+#include "EnvironmentPdfBuilder.h"
+#include "BC6HEncoder.h"
+
+#include <donut/engine/CommonRenderPasses.h>
+#include <donut/engine/DescriptorTableManager.h>
+#include <donut/engine/TextureCache.h>
+#include <donut/core/log.h>
+
+#include <algorithm>
+
+using namespace donut;
+
+EnvironmentMapLoader::EnvironmentMapLoader(
+    nvrhi::IDevice* device,
+    std::shared_ptr<vfs::IFileSystem> fs,
+    std::shared_ptr<engine::TextureCache> textureCache,
+    std::shared_ptr<engine::CommonRenderPasses> commonPasses,
+    std::shared_ptr<engine::DescriptorTableManager> descriptorTableManager)
+    : m_Device(device)
+    , m_FS(std::move(fs))
+    , m_TextureCache(std::move(textureCache))
+    , m_CommonPasses(std::move(commonPasses))
+    , m_DescriptorTableManager(std::move(descriptorTableManager))
+{
+    m_CommandList = m_Device->createCommandList();
+}
+
+EnvironmentMapLoader::~EnvironmentMapLoader()
+{
+    for (auto& [key, entry] : m_Entries)
+    {
+        if (entry.loading.valid())
+            entry.loading.wait();
+    }
+}
+
+void EnvironmentMapLoader::SetCompressionEnabled(bool enabled)
+{
+    if (enabled && !(m_Device->queryFormatSupport(nvrhi::Format::BC6H_UFLOAT) & nvrhi::FormatSupport::ShaderSample))
+    {
+        log::warning("The device doesn't support BC6H textures, the environment maps will not be compressed.");
+        enabled = false;
+    }
+
+    m_CompressionEnabled = enabled;
+}
+
+std::string EnvironmentMapLoader::GetKey(const std::string& path) const
+{
+    return m_CompressionEnabled ? path + "|bc6h" : path;
+}
+
+void EnvironmentMapLoader::Request(const std::string& path)
+{
+    const std::string key = GetKey(path);
+
+    if (m_Entries.find(key) != m_Entries.end())
+        return;
+
+    // A map that was forgotten recently may still be waiting for the GPU, take it back instead of loading it again.
+    auto retired = std::find_if(m_RetiredMaps.begin(), m_RetiredMaps.end(), [&key](const RetiredMap& retiredMap) { return retiredMap.key == key; });
+    if (retired != m_RetiredMaps.end())
+    {
+        Entry& entry = m_Entries[key];
+        entry.path = path;
+        entry.compression = m_CompressionEnabled;
+        entry.map = retired->map;
+        entry.loaded = true;
+        m_RetiredMaps.erase(retired);
+        return;
+    }
+
+    log::debug("Loading the environment map '%s' in the background", path.c_str());
+
+    Entry& entry = m_Entries[key];
+    entry.path = path;
+    entry.compression = m_CompressionEnabled;
+    entry.map = std::make_shared<Map>();
+
+    // The texture cache is thread safe, and only the decoding happens here: the texture object is created
+    // and uploaded later on the rendering thread, in Update.
+    entry.loading = std::async(std::launch::async,
+        [map = entry.map, path, compression = m_CompressionEnabled, fs = m_FS, textureCache = m_TextureCache]()
+        {
+            // The BC6H version is cached on disk next to the map, like the PDF. Fall back to the float texture if it fails.
+            if (compression)
+                map->compressedMap = LoadCompressedEnvironmentMap(*fs, path);
+
+            if (!map->compressedMap)
+            {
+                map->texture = textureCache->LoadTextureFromFileDeferred(path, false);
+                if (!textureCache->IsTextureLoaded(map->texture))
+                    return false;
+            }
+
+            // The importance sampling PDF of a file doesn't change, so build it on the CPU once and cache it on disk.
+            // When that fails, the PDF is generated on the GPU like for the procedural map.
+            // The PDF is always built from the full precision map, even when the texture is compressed.
+            map->pdfMips = LoadEnvironmentPdf(*fs, path);
+            return true;
+        });
+}
+
+void EnvironmentMapLoader::Wait(const std::string& path)
+{
+    auto it = m_Entries.find(GetKey(path));
+    if (it == m_Entries.end())
+        return;
+
+    if (it->second.loading.valid())
+        it->second.loading.wait();
+
+    Update();
+}
+
+void EnvironmentMapLoader::Update()
+{
+    std::vector<Entry*> loadedEntries;
+    bool finalizeCachedTextures = false;
+
+    for (auto& [key, entry] : m_Entries)
+    {
+        if (!entry.loading.valid() || entry.loading.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+
+        if (entry.loading.get())
+        {
+            loadedEntries.push_back(&entry);
+            finalizeCachedTextures |= !entry.map->compressedMap;
+        }
+        else
+            entry.failed = true;
+    }
+
+    // Creates and uploads the textures decoded by the workers
+    if (finalizeCachedTextures)
+    {
+        m_TextureCache->ProcessRenderingThreadCommands(*m_CommonPasses, 0.f);
+        m_TextureCache->LoadingFinished();
+    }
+
+    for (Entry* entry : loadedEntries)
+        FinalizeMap(*entry);
+
+    // The event queries are signaled in the order in which they were set
+    while (!m_RetiredMaps.empty() && m_Device->pollEventQuery(m_RetiredMaps.front().query))
+    {
+        const Map& map = *m_RetiredMaps.front().map;
+        if (!map.compressed)
+            m_TextureCache->UnloadTexture(map.texture);
+
+        m_RetiredMaps.pop_front();
+    }
+}
+
+void EnvironmentMapLoader::CreateCompressedTexture(const std::string& path, Map& map)
+{
+    const CompressedEnvironmentMap& compressedMap = *map.compressedMap;
+
+    nvrhi::TextureDesc textureDesc;
+    textureDesc.width = compressedMap.width;
+    textureDesc.height = compressedMap.height;
+    textureDesc.format = nvrhi::Format::BC6H_UFLOAT;
+    textureDesc.debugName = path;
+    textureDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    textureDesc.keepInitialState = true;
+
+    map.texture = std::make_shared<engine::LoadedTexture>();
+    map.texture->texture = m_Device->createTexture(textureDesc);
+    map.texture->path = path;
+    map.compressed = true;
+
+    // The row pitch of block compressed data is one row of blocks
+    m_CommandList->open();
+    m_CommandList->writeTexture(map.texture->texture, 0, 0, compressedMap.blocks.data(), (compressedMap.width / 4) * c_BC6HBlockSize);
+    m_CommandList->close();
+    m_Device->executeCommandList(m_CommandList);
+
+    map.compressedMap = nullptr;
+}
+
+void EnvironmentMapLoader::FinalizeMap(Entry& entry)
+{
+    Map& map = *entry.map;
+
+    if (map.compressedMap)
+        CreateCompressedTexture(entry.path, map);
+
+    if (!map.texture->texture)
+    {
+        entry.failed = true;
+        return;
+    }
+
+    map.texture->bindlessDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, map.texture->texture));
+
+    const auto& textureDesc = map.texture->texture->getDesc();
+    uint32_t pdfWidth, pdfHeight;
+    GetEnvironmentPdfTextureSize(textureDesc.width, textureDesc.height, pdfWidth, pdfHeight);
+    if (map.pdfMips && (map.pdfMips->width != pdfWidth || map.pdfMips->height != pdfHeight))
+    {
+        log::warning("The environment PDF for '%s' doesn't match the texture size, it will be generated on the GPU.", entry.path.c_str());
+        map.pdfMips = nullptr;
+    }
+
+    entry.loaded = true;
+}
+
+std::shared_ptr<EnvironmentMapLoader::Map> EnvironmentMapLoader::GetMap(const std::string& path) const
+{
+    auto it = m_Entries.find(GetKey(path));
+    if (it == m_Entries.end() || !it->second.loaded)
+        return nullptr;
+
+    return it->second.map;
+}
+
+bool EnvironmentMapLoader::IsLoading(const std::string& path) const
+{
+    auto it = m_Entries.find(GetKey(path));
+    return it != m_Entries.end() && !it->second.loaded && !it->second.failed;
+}
+
+bool EnvironmentMapLoader::HasFailed(const std::string& path) const
+{
+    auto it = m_Entries.find(GetKey(path));
+    return it != m_Entries.end() && it->second.failed;
+}
+
+void EnvironmentMapLoader::Retain(const std::vector<std::string>& paths, const std::shared_ptr<Map>& activeMap)
+{
+    for (auto it = m_Entries.begin(); it != m_Entries.end(); )
+    {
+        const Entry& entry = it->second;
+
+        const bool retained = entry.compression == m_CompressionEnabled && std::find(paths.begin(), paths.end(), entry.path) != paths.end();
+
+        if (entry.loading.valid() || retained || entry.map == activeMap)
+        {
+            ++it;
+            continue;
+        }
+
+        // Descriptor manipulations are synchronous and immediately affect whatever is executing on the GPU,
+        // so the descriptor of the map can only be released after the frames that may be reading it.
+        if (entry.loaded)
+        {
+            RetiredMap retiredMap;
+            retiredMap.key = it->first;
+            retiredMap.map = entry.map;
+            retiredMap.query = m_Device->createEventQuery();
+            m_Device->setEventQuery(retiredMap.query, nvrhi::CommandQueue::Graphics);
+            m_RetiredMaps.push_back(std::move(retiredMap));
+        }
+
+        it = m_Entries.erase(it);
+    }
+}
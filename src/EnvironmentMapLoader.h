@@ -0,0 +1,119 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+
+#include <deque>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace donut::engine
+{
+    class CommonRenderPasses;
+    class DescriptorTableManager;
+    class TextureCache;
+    struct LoadedTexture;
+}
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+struct EnvironmentPdfMips;
+struct CompressedEnvironmentMap;
+
+// Loads environment maps and their importance sampling PDFs on worker threads, so that switching maps doesn't stall
+// the renderer, and keeps the maps that are no longer needed alive until the GPU has finished the frames that used them.
+class EnvironmentMapLoader
+{
+public:
+    struct Map
+    {
+        std::shared_ptr<donut::engine::LoadedTexture> texture;
+        std::shared_ptr<EnvironmentPdfMips> pdfMips; // nullptr if the PDF has to be generated on the GPU
+        std::shared_ptr<CompressedEnvironmentMap> compressedMap; // only kept until the texture is created
+        bool compressed = false; // the texture is BC6H and not owned by the texture cache
+    };
+
+    EnvironmentMapLoader(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::vfs::IFileSystem> fs,
+        std::shared_ptr<donut::engine::TextureCache> textureCache,
+        std::shared_ptr<donut::engine::CommonRenderPasses> commonPasses,
+        std::shared_ptr<donut::engine::DescriptorTableManager> descriptorTableManager);
+
+    // Waits for the worker threads.
+    ~EnvironmentMapLoader();
+
+    // Loads the maps requested from now on as BC6H textures, if the device supports them. The maps that were loaded
+    // before stay uncompressed, and the maps that cannot be compressed fall back to the uncompressed format.
+    void SetCompressionEnabled(bool enabled);
+    [[nodiscard]] bool IsCompressionEnabled() const { return m_CompressionEnabled; }
+
+    // Starts loading the map on a worker thread, unless it's already loaded or being loaded.
+    void Request(const std::string& path);
+
+    // Blocks until a requested map is loaded, and finalizes it.
+    void Wait(const std::string& path);
+
+    // Finalizes the maps that the workers have loaded, and releases the forgotten maps that the GPU no longer uses.
+    // Call once per frame on the rendering thread, before recording the frame.
+    void Update();
+
+    // Returns nullptr while the map is loading, or if it hasn't been requested or failed to load.
+    [[nodiscard]] std::shared_ptr<Map> GetMap(const std::string& path) const;
+    [[nodiscard]] bool IsLoading(const std::string& path) const;
+    [[nodiscard]] bool HasFailed(const std::string& path) const;
+
+    // Forgets the maps that are not in the list or loaded with a different compression setting, except the active map
+    // and the ones that are still loading. Their textures and descriptors are released once the GPU has finished
+    // all the work submitted so far.
+    void Retain(const std::vector<std::string>& paths, const std::shared_ptr<Map>& activeMap);
+
+private:
+    struct Entry
+    {
+        std::string path;
+        bool compression = false;
+        std::shared_ptr<Map> map;
+        std::future<bool> loading;
+        bool loaded = false;
+        bool failed = false;
+    };
+
+    struct RetiredMap
+    {
+        std::string key;
+        std::shared_ptr<Map> map;
+        nvrhi::EventQueryHandle query;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::vfs::IFileSystem> m_FS;
+    std::shared_ptr<donut::engine::TextureCache> m_TextureCache;
+    std::shared_ptr<donut::engine::CommonRenderPasses> m_CommonPasses;
+    std::shared_ptr<donut::engine::DescriptorTableManager> m_DescriptorTableManager;
+    nvrhi::CommandListHandle m_CommandList;
+    bool m_CompressionEnabled = false;
+
+    // Keyed by the path and the compression setting, see GetKey
+    std::unordered_map<std::string, Entry> m_Entries;
+    std::deque<RetiredMap> m_RetiredMaps;
+
+    [[nodiscard]] std::string GetKey(const std::string& path) const;
+    void CreateCompressedTexture(const std::string& path, Map& map);
+    void FinalizeMap(Entry& entry);
+};
@@ -0,0 +1,845 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "EnvironmentPdfBuilder.h"
+#include "BC6HEncoder.h"
+#include "HalfFloat.h"
+
+#include <donut/core/log.h>
+#include <donut/core/vfs/VFS.h>
+
+#include <tinyexr.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <thread>
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64)
+#include <emmintrin.h>
+#define ENVIRONMENT_PDF_USE_SSE 1
+#else
+#define ENVIRONMENT_PDF_USE_SSE 0
+#endif
+
+using namespace donut;
+
+// PreprocessEnvironmentMap.hlsl writes 5 mip levels per stage from the stored values of the stage's source level.
+static constexpr uint32_t c_MipLevelsPerStage = 5;
+
+// RTXDI_SamplePdfMipmap supports PDF textures up to 16k.
+static constexpr uint32_t c_MaxPdfTextureSize = 16384;
+
+// Maximum value that can be encoded in a float16 texture, same clamp as the shader.
+static constexpr float c_MaxWeight = 65504.f;
+
+static constexpr float c_Pi = 3.14159265f;
+
+static constexpr uint32_t c_CacheFileMagic = 0x50455852; // 'RXEP'
+static constexpr uint32_t c_CacheFileVersion = 2;
+
+// The compressed map cache uses the same header, with mipLevels = 1.
+static constexpr uint32_t c_CompressedCacheFileMagic = 0x43425852; // 'RXBC'
+static constexpr uint32_t c_CompressedCacheFileVersion = 1;
+
+struct EnvironmentPdfCacheHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t contentHash;
+    uint32_t width;
+    uint32_t height;
+    uint32_t mipLevels;
+    uint32_t reserved;
+};
+
+// Splits [0, count) into contiguous ranges and processes them on separate threads.
+static void ParallelFor(uint32_t count, uint32_t threadCount, const std::function<void(uint32_t begin, uint32_t end)>& func)
+{
+    threadCount = std::min(threadCount, count);
+
+    if (threadCount <= 1)
+    {
+        func(0, count);
+        return;
+    }
+
+    const uint32_t rangeSize = (count + threadCount - 1) / threadCount;
+
+    std::vector<std::thread> threads;
+    for (uint32_t begin = 0; begin < count; begin += rangeSize)
+        threads.emplace_back(func, begin, std::min(begin + rangeSize, count));
+
+    for (auto& thread : threads)
+        thread.join();
+}
+
+// Don't spin up threads for the small mip levels, that costs more than it saves.
+static uint32_t GetLevelThreadCount(uint32_t threadCount, uint32_t width, uint32_t height)
+{
+    constexpr uint32_t minTexelsPerThread = 16384;
+    return std::max(1u, std::min(threadCount, (width * height) / minTexelsPerThread));
+}
+
+// Same as getPixelWeight in PreprocessEnvironmentMap.hlsl, for one row of RGBA texels.
+static void ComputeWeightRow(const float* rgba, uint32_t width, float relativeSolidAngle, float* weights)
+{
+    uint32_t x = 0;
+
+#if ENVIRONMENT_PDF_USE_SSE
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 infinity = _mm_set1_ps(INFINITY);
+    const __m128 maxWeight = _mm_set1_ps(c_MaxWeight);
+    const __m128 solidAngle = _mm_set1_ps(relativeSolidAngle);
+    const __m128 lumaR = _mm_set1_ps(0.299f);
+    const __m128 lumaG = _mm_set1_ps(0.587f);
+    const __m128 lumaB = _mm_set1_ps(0.114f);
+
+    for (; x + 4 <= width; x += 4)
+    {
+        __m128 r = _mm_loadu_ps(rgba + x * 4 + 0);
+        __m128 g = _mm_loadu_ps(rgba + x * 4 + 4);
+        __m128 b = _mm_loadu_ps(rgba + x * 4 + 8);
+        __m128 a = _mm_loadu_ps(rgba + x * 4 + 12);
+        _MM_TRANSPOSE4_PS(r, g, b, a);
+
+        __m128 luma = _mm_add_ps(_mm_add_ps(_mm_mul_ps(r, lumaR), _mm_mul_ps(g, lumaG)), _mm_mul_ps(b, lumaB));
+
+        // max() returns the second operand for NaNs, like the shader's max(luma, 0); then drop the infinities
+        luma = _mm_max_ps(luma, zero);
+        luma = _mm_and_ps(luma, _mm_cmplt_ps(luma, infinity));
+
+        const __m128 weight = _mm_min_ps(_mm_mul_ps(luma, solidAngle), maxWeight);
+        _mm_storeu_ps(weights + x, weight);
+    }
+#endif
+
+    for (; x < width; x++)
+    {
+        const float* color = rgba + x * 4;
+        float luma = color[0] * 0.299f + color[1] * 0.587f + color[2] * 0.114f;
+        luma = (luma > 0.f) ? luma : 0.f;
+
+        if (std::isinf(luma))
+            luma = 0.f;
+
+        weights[x] = std::min(luma * relativeSolidAngle, c_MaxWeight);
+    }
+}
+
+// One 2x2 averaging step of the GPU pass, adding the quad in the same (0,0), (1,0), (0,1), (1,1) order to get the same rounding.
+static void DownsampleRow(const float* sourceRow0, const float* sourceRow1, float* destRow, uint32_t destWidth)
+{
+    uint32_t x = 0;
+
+#if ENVIRONMENT_PDF_USE_SSE
+    const __m128 quarter = _mm_set1_ps(0.25f);
+
+    for (; x + 4 <= destWidth; x += 4)
+    {
+        const __m128 row0Low = _mm_loadu_ps(sourceRow0 + x * 2);
+        const __m128 row0High = _mm_loadu_ps(sourceRow0 + x * 2 + 4);
+        const __m128 row1Low = _mm_loadu_ps(sourceRow1 + x * 2);
+        const __m128 row1High = _mm_loadu_ps(sourceRow1 + x * 2 + 4);
+
+        const __m128 topLeft = _mm_shuffle_ps(row0Low, row0High, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 topRight = _mm_shuffle_ps(row0Low, row0High, _MM_SHUFFLE(3, 1, 3, 1));
+        const __m128 bottomLeft = _mm_shuffle_ps(row1Low, row1High, _MM_SHUFFLE(2, 0, 2, 0));
+        const __m128 bottomRight = _mm_shuffle_ps(row1Low, row1High, _MM_SHUFFLE(3, 1, 3, 1));
+
+        const __m128 sum = _mm_add_ps(_mm_add_ps(_mm_add_ps(topLeft, topRight), bottomLeft), bottomRight);
+
+        _mm_storeu_ps(destRow + x, _mm_mul_ps(sum, quarter));
+    }
+#endif
+
+    for (; x < destWidth; x++)
+    {
+        const float topLeft = sourceRow0[x * 2];
+        const float topRight = sourceRow0[x * 2 + 1];
+        const float bottomLeft = sourceRow1[x * 2];
+        const float bottomRight = sourceRow1[x * 2 + 1];
+
+        destRow[x] = (topLeft + topRight + bottomLeft + bottomRight) * 0.25f;
+    }
+}
+
+// Same as getPdfTexelWeight in PreprocessEnvironmentMap.hlsl: the average of the map weights under one row of PDF texels.
+static void ResampleWeightRow(const float* mapWeights, uint32_t mapWidth, uint32_t mapHeight,
+    uint32_t pdfWidth, uint32_t pdfHeight, uint32_t y, float* pdfRow)
+{
+    const float scaleX = float(mapWidth) / float(pdfWidth);
+    const float scaleY = float(mapHeight) / float(pdfHeight);
+    const float beginY = float(y) * scaleY;
+    const float endY = beginY + scaleY;
+    const uint32_t firstY = uint32_t(beginY);
+    const uint32_t lastY = std::min(uint32_t(ceilf(endY)) - 1, mapHeight - 1);
+
+    for (uint32_t x = 0; x < pdfWidth; x++)
+    {
+        const float beginX = float(x) * scaleX;
+        const float endX = beginX + scaleX;
+        const uint32_t firstX = uint32_t(beginX);
+        const uint32_t lastX = std::min(uint32_t(ceilf(endX)) - 1, mapWidth - 1);
+
+        float sum = 0.f;
+        for (uint32_t mapY = firstY; mapY <= lastY; mapY++)
+        {
+            const float coverageY = std::min(endY, float(mapY + 1)) - std::max(beginY, float(mapY));
+
+            for (uint32_t mapX = firstX; mapX <= lastX; mapX++)
+            {
+                const float coverageX = std::min(endX, float(mapX + 1)) - std::max(beginX, float(mapX));
+                sum += coverageX * coverageY * mapWeights[size_t(mapY) * mapWidth + mapX];
+            }
+        }
+
+        pdfRow[x] = sum / (scaleX * scaleY);
+    }
+}
+
+static uint32_t GetMipSize(uint32_t size, uint32_t mipLevel)
+{
+    return std::max(1u, size >> mipLevel);
+}
+
+static uint32_t RoundUpToPowerOfTwo(uint32_t value)
+{
+    uint32_t result = 1;
+    while (result < value)
+        result <<= 1;
+    return result;
+}
+
+void GetEnvironmentPdfTextureSize(uint32_t mapWidth, uint32_t mapHeight, uint32_t& outWidth, uint32_t& outHeight)
+{
+    outWidth = std::min(RoundUpToPowerOfTwo(mapWidth), c_MaxPdfTextureSize);
+    outHeight = std::min(RoundUpToPowerOfTwo(mapHeight), c_MaxPdfTextureSize);
+}
+
+uint32_t GetEnvironmentPdfMipLevels(uint32_t width, uint32_t height)
+{
+    uint32_t mipLevels = 1;
+    while ((std::max(width, height) >> mipLevels) != 0)
+        ++mipLevels;
+    return mipLevels;
+}
+
+// Stores one level of float weights into the float16 pyramid.
+static void StoreLevel(const std::vector<float>& source, uint32_t sourcePitch, uint32_t width, uint32_t height, std::vector<uint16_t>& level)
+{
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+            level[size_t(y) * width + x] = FloatToHalf(source[size_t(y) * sourcePitch + x]);
+    }
+}
+
+void BuildEnvironmentPdfMips(const float* rgba, uint32_t width, uint32_t height, EnvironmentPdfMips& outMips, uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    uint32_t pdfWidth, pdfHeight;
+    GetEnvironmentPdfTextureSize(width, height, pdfWidth, pdfHeight);
+    const uint32_t mipLevels = GetEnvironmentPdfMipLevels(pdfWidth, pdfHeight);
+
+    outMips.width = pdfWidth;
+    outMips.height = pdfHeight;
+    outMips.levels.resize(mipLevels);
+    for (uint32_t mipLevel = 0; mipLevel < mipLevels; mipLevel++)
+        outMips.levels[mipLevel].resize(size_t(GetMipSize(pdfWidth, mipLevel)) * GetMipSize(pdfHeight, mipLevel));
+
+    // The GPU pass keeps the levels within a stage at float precision and only reads the stored float16 values
+    // at the start of each stage, so do the same. 'source' holds the current level padded to even dimensions
+    // with zeros, which is what the shader reads outside of the level.
+    uint32_t sourcePitch = GetMipSize(pdfWidth, 1) * 2;
+    std::vector<float> source(size_t(sourcePitch) * GetMipSize(pdfHeight, 1) * 2, 0.f);
+
+    auto computeMapWeightRow = [rgba, width, height](uint32_t y, float* weights)
+    {
+        const float elevation = ((float(y) + 0.5f) / float(height) - 0.5f) * c_Pi;
+        ComputeWeightRow(rgba + size_t(y) * width * 4, width, cosf(elevation), weights);
+    };
+
+    if (width == pdfWidth && height == pdfHeight)
+    {
+        ParallelFor(height, GetLevelThreadCount(threadCount, width, height), [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; y++)
+                computeMapWeightRow(y, source.data() + size_t(y) * sourcePitch);
+        });
+    }
+    else
+    {
+        std::vector<float> mapWeights(size_t(width) * height);
+
+        ParallelFor(height, GetLevelThreadCount(threadCount, width, height), [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; y++)
+                computeMapWeightRow(y, mapWeights.data() + size_t(y) * width);
+        });
+
+        ParallelFor(pdfHeight, GetLevelThreadCount(threadCount, pdfWidth, pdfHeight), [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; y++)
+                ResampleWeightRow(mapWeights.data(), width, height, pdfWidth, pdfHeight, y, source.data() + size_t(y) * sourcePitch);
+        });
+    }
+
+    StoreLevel(source, sourcePitch, pdfWidth, pdfHeight, outMips.levels[0]);
+
+    std::vector<float> dest;
+
+    for (uint32_t mipLevel = 1; mipLevel < mipLevels; mipLevel++)
+    {
+        const uint32_t sourceMipLevel = mipLevel - 1;
+
+        if (sourceMipLevel != 0 && sourceMipLevel % c_MipLevelsPerStage == 0)
+        {
+            const std::vector<uint16_t>& level = outMips.levels[sourceMipLevel];
+            const uint32_t sourceWidth = GetMipSize(pdfWidth, sourceMipLevel);
+            const uint32_t sourceHeight = GetMipSize(pdfHeight, sourceMipLevel);
+
+            std::fill(source.begin(), source.end(), 0.f);
+            for (uint32_t y = 0; y < sourceHeight; y++)
+            {
+                for (uint32_t x = 0; x < sourceWidth; x++)
+                    source[size_t(y) * sourcePitch + x] = HalfToFloat(level[size_t(y) * sourceWidth + x]);
+            }
+        }
+
+        const uint32_t mipWidth = GetMipSize(pdfWidth, mipLevel);
+        const uint32_t mipHeight = GetMipSize(pdfHeight, mipLevel);
+        const uint32_t destPitch = GetMipSize(pdfWidth, mipLevel + 1) * 2;
+
+        dest.assign(size_t(destPitch) * GetMipSize(pdfHeight, mipLevel + 1) * 2, 0.f);
+
+        ParallelFor(mipHeight, GetLevelThreadCount(threadCount, mipWidth, mipHeight), [&](uint32_t begin, uint32_t end)
+        {
+            for (uint32_t y = begin; y < end; y++)
+            {
+                const float* sourceRow = source.data() + size_t(y) * 2 * sourcePitch;
+                DownsampleRow(sourceRow, sourceRow + sourcePitch, dest.data() + size_t(y) * destPitch, mipWidth);
+            }
+        });
+
+        StoreLevel(dest, destPitch, mipWidth, mipHeight, outMips.levels[mipLevel]);
+
+        std::swap(source, dest);
+        sourcePitch = destPitch;
+    }
+}
+
+// FNV-1a over 64-bit words, good enough to tell the environment maps apart and fast enough for large files.
+static uint64_t HashFileContents(const uint8_t* data, size_t size)
+{
+    constexpr uint64_t prime = 0x100000001b3ull;
+    uint64_t hash = 0xcbf29ce484222325ull ^ uint64_t(size);
+
+    size_t offset = 0;
+    for (; offset + sizeof(uint64_t) <= size; offset += sizeof(uint64_t))
+    {
+        uint64_t word;
+        memcpy(&word, data + offset, sizeof(word));
+        hash = (hash ^ word) * prime;
+    }
+
+    for (; offset < size; offset++)
+        hash = (hash ^ data[offset]) * prime;
+
+    return hash;
+}
+
+bool ParseEnvironmentPdfCache(const uint8_t* data, size_t size, uint64_t contentHash, EnvironmentPdfMips& outMips)
+{
+    if (size < sizeof(EnvironmentPdfCacheHeader))
+        return false;
+
+    EnvironmentPdfCacheHeader header;
+    memcpy(&header, data, sizeof(header));
+
+    if (header.magic != c_CacheFileMagic || header.version != c_CacheFileVersion || header.contentHash != contentHash)
+        return false;
+
+    if (header.width == 0 || header.height == 0 || header.mipLevels != GetEnvironmentPdfMipLevels(header.width, header.height))
+        return false;
+
+    size_t offset = sizeof(header);
+    outMips.width = header.width;
+    outMips.height = header.height;
+    outMips.levels.resize(header.mipLevels);
+
+    for (uint32_t mipLevel = 0; mipLevel < header.mipLevels; mipLevel++)
+    {
+        std::vector<uint16_t>& level = outMips.levels[mipLevel];
+        level.resize(size_t(GetMipSize(header.width, mipLevel)) * GetMipSize(header.height, mipLevel));
+
+        const size_t levelSize = level.size() * sizeof(uint16_t);
+        if (offset + levelSize > size)
+            return false;
+
+        memcpy(level.data(), data + offset, levelSize);
+        offset += levelSize;
+    }
+
+    return offset == size;
+}
+
+std::vector<uint8_t> SerializeEnvironmentPdfCache(uint64_t contentHash, const EnvironmentPdfMips& mips)
+{
+    EnvironmentPdfCacheHeader header{};
+    header.magic = c_CacheFileMagic;
+    header.version = c_CacheFileVersion;
+    header.contentHash = contentHash;
+    header.width = mips.width;
+    header.height = mips.height;
+    header.mipLevels = uint32_t(mips.levels.size());
+
+    std::vector<uint8_t> contents(sizeof(header));
+    memcpy(contents.data(), &header, sizeof(header));
+
+    for (const auto& level : mips.levels)
+    {
+        const uint8_t* levelData = reinterpret_cast<const uint8_t*>(level.data());
+        contents.insert(contents.end(), levelData, levelData + level.size() * sizeof(uint16_t));
+    }
+
+    return contents;
+}
+
+static bool ReadCacheFile(vfs::IFileSystem& fs, const std::string& fileName, uint64_t contentHash, EnvironmentPdfMips& outMips)
+{
+    if (!fs.fileExists(fileName))
+        return false;
+
+    std::shared_ptr<vfs::IBlob> blob = fs.readFile(fileName);
+    if (!blob)
+        return false;
+
+    if (!ParseEnvironmentPdfCache(static_cast<const uint8_t*>(blob->data()), blob->size(), contentHash, outMips))
+    {
+        log::info("The environment PDF cache '%s' is out of date or invalid", fileName.c_str());
+        return false;
+    }
+
+    return true;
+}
+
+static void WriteCacheFile(vfs::IFileSystem& fs, const std::string& fileName, uint64_t contentHash, const EnvironmentPdfMips& mips)
+{
+    const std::vector<uint8_t> contents = SerializeEnvironmentPdfCache(contentHash, mips);
+
+    // Not fatal, the media folder may be read-only - the PDF will be built again next time.
+    if (!fs.writeFile(fileName, contents.data(), contents.size()))
+        log::warning("Couldn't write the environment PDF cache '%s'", fileName.c_str());
+}
+
+std::shared_ptr<EnvironmentPdfMips> LoadEnvironmentPdf(vfs::IFileSystem& fs, const std::string& environmentMapPath)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    auto getElapsedMs = [&startTime]()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    };
+
+    std::shared_ptr<vfs::IBlob> mapFile = fs.readFile(environmentMapPath);
+    if (!mapFile)
+    {
+        log::warning("Couldn't read '%s' to build the environment PDF", environmentMapPath.c_str());
+        return nullptr;
+    }
+
+    const uint8_t* mapData = static_cast<const uint8_t*>(mapFile->data());
+    const uint64_t contentHash = HashFileContents(mapData, mapFile->size());
+    const std::string cacheFileName = environmentMapPath + ".envpdf";
+
+    auto mips = std::make_shared<EnvironmentPdfMips>();
+
+    if (ReadCacheFile(fs, cacheFileName, contentHash, *mips))
+    {
+        log::info("Loaded the environment PDF from '%s' in %.1f ms", cacheFileName.c_str(), getElapsedMs());
+        return mips;
+    }
+
+    float* rgba = nullptr;
+    int width = 0, height = 0;
+    const char* errorMessage = nullptr;
+
+    if (LoadEXRFromMemory(&rgba, &width, &height, mapData, mapFile->size(), &errorMessage) != TINYEXR_SUCCESS)
+    {
+        log::warning("Couldn't decode '%s' to build the environment PDF: %s", environmentMapPath.c_str(),
+            errorMessage ? errorMessage : "unknown error");
+        if (errorMessage)
+            FreeEXRErrorMessage(errorMessage);
+        return nullptr;
+    }
+
+    BuildEnvironmentPdfMips(rgba, uint32_t(width), uint32_t(height), *mips);
+    free(rgba);
+
+    log::info("Built the environment PDF for '%s' in %.1f ms", environmentMapPath.c_str(), getElapsedMs());
+
+    WriteCacheFile(fs, cacheFileName, contentHash, *mips);
+
+    return mips;
+}
+
+void BuildCompressedEnvironmentMap(const float* rgba, uint32_t width, uint32_t height, CompressedEnvironmentMap& outMap, uint32_t threadCount)
+{
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+    const uint32_t blocksX = width / 4;
+    const uint32_t blocksY = height / 4;
+
+    outMap.width = width;
+    outMap.height = height;
+    outMap.blocks.resize(size_t(blocksX) * blocksY * c_BC6HBlockSize);
+
+    ParallelFor(blocksY, GetLevelThreadCount(threadCount, width, height), [&](uint32_t begin, uint32_t end)
+    {
+        uint16_t texels[16][3];
+
+        for (uint32_t blockY = begin; blockY < end; blockY++)
+        {
+            for (uint32_t blockX = 0; blockX < blocksX; blockX++)
+            {
+                for (uint32_t texel = 0; texel < 16; texel++)
+                {
+                    const float* source = rgba + ((size_t(blockY) * 4 + texel / 4) * width + size_t(blockX) * 4 + texel % 4) * 4;
+
+                    // The encoder clamps the negative values, the float16 conversion takes care of the large values.
+                    for (uint32_t channel = 0; channel < 3; channel++)
+                        texels[texel][channel] = std::isnan(source[channel]) ? 0 : FloatToHalf(source[channel]);
+                }
+
+                EncodeBC6HBlock(texels, outMap.blocks.data() + (size_t(blockY) * blocksX + blockX) * c_BC6HBlockSize);
+            }
+        }
+    });
+}
+
+static bool ReadCompressedCacheFile(vfs::IFileSystem& fs, const std::string& fileName, uint64_t contentHash, CompressedEnvironmentMap& outMap)
+{
+    if (!fs.fileExists(fileName))
+        return false;
+
+    std::shared_ptr<vfs::IBlob> blob = fs.readFile(fileName);
+    if (!blob || blob->size() < sizeof(EnvironmentPdfCacheHeader))
+        return false;
+
+    EnvironmentPdfCacheHeader header;
+    memcpy(&header, blob->data(), sizeof(header));
+
+    if (header.magic != c_CompressedCacheFileMagic || header.version != c_CompressedCacheFileVersion)
+        return false;
+
+    if (header.contentHash != contentHash)
+    {
+        log::info("The compressed environment map cache '%s' is out of date", fileName.c_str());
+        return false;
+    }
+
+    const size_t blocksSize = size_t(header.width / 4) * (header.height / 4) * c_BC6HBlockSize;
+    if (header.mipLevels != 1 || blob->size() != sizeof(header) + blocksSize)
+        return false;
+
+    outMap.width = header.width;
+    outMap.height = header.height;
+    outMap.blocks.resize(blocksSize);
+    memcpy(outMap.blocks.data(), static_cast<const uint8_t*>(blob->data()) + sizeof(header), blocksSize);
+
+    return true;
+}
+
+static void WriteCompressedCacheFile(vfs::IFileSystem& fs, const std::string& fileName, uint64_t contentHash, const CompressedEnvironmentMap& map)
+{
+    EnvironmentPdfCacheHeader header{};
+    header.magic = c_CompressedCacheFileMagic;
+    header.version = c_CompressedCacheFileVersion;
+    header.contentHash = contentHash;
+    header.width = map.width;
+    header.height = map.height;
+    header.mipLevels = 1;
+
+    std::vector<uint8_t> contents(sizeof(header));
+    memcpy(contents.data(), &header, sizeof(header));
+    contents.insert(contents.end(), map.blocks.begin(), map.blocks.end());
+
+    if (!fs.writeFile(fileName, contents.data(), contents.size()))
+        log::warning("Couldn't write the compressed environment map cache '%s'", fileName.c_str());
+}
+
+std::shared_ptr<CompressedEnvironmentMap> LoadCompressedEnvironmentMap(vfs::IFileSystem& fs, const std::string& environmentMapPath)
+{
+    const auto startTime = std::chrono::steady_clock::now();
+    auto getElapsedMs = [&startTime]()
+    {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    };
+
+    std::shared_ptr<vfs::IBlob> mapFile = fs.readFile(environmentMapPath);
+    if (!mapFile)
+    {
+        log::warning("Couldn't read '%s' to compress the environment map", environmentMapPath.c_str());
+        return nullptr;
+    }
+
+    const uint8_t* mapData = static_cast<const uint8_t*>(mapFile->data());
+    const uint64_t contentHash = HashFileContents(mapData, mapFile->size());
+    const std::string cacheFileName = environmentMapPath + ".bc6h";
+
+    auto map = std::make_shared<CompressedEnvironmentMap>();
+
+    if (ReadCompressedCacheFile(fs, cacheFileName, contentHash, *map))
+    {
+        log::info("Loaded the compressed environment map from '%s' in %.1f ms", cacheFileName.c_str(), getElapsedMs());
+        return map;
+    }
+
+    float* rgba = nullptr;
+    int width = 0, height = 0;
+    const char* errorMessage = nullptr;
+
+    if (LoadEXRFromMemory(&rgba, &width, &height, mapData, mapFile->size(), &errorMessage) != TINYEXR_SUCCESS)
+    {
+        log::warning("Couldn't decode '%s' to compress the environment map: %s", environmentMapPath.c_str(),
+            errorMessage ? errorMessage : "unknown error");
+        if (errorMessage)
+            FreeEXRErrorMessage(errorMessage);
+        return nullptr;
+    }
+
+    // Block compressed textures need whole blocks in the top mip level
+    if (width % 4 != 0 || height % 4 != 0)
+    {
+        log::info("The size of '%s' is not a multiple of 4, it will not be compressed.", environmentMapPath.c_str());
+        free(rgba);
+        return nullptr;
+    }
+
+    BuildCompressedEnvironmentMap(rgba, uint32_t(width), uint32_t(height), *map);
+    free(rgba);
+
+    log::info("Compressed the environment map '%s' in %.1f ms", environmentMapPath.c_str(), getElapsedMs());
+
+    WriteCompressedCacheFile(fs, cacheFileName, contentHash, *map);
+
+    return map;
+}
+
+bool BuildEnvironmentAliasTable(const EnvironmentPdfMips& mips, EnvironmentAliasTable& outTable)
+{
+    const std::vector<uint16_t>& weights = mips.levels[0];
+    const size_t count = weights.size();
+
+    outTable.totalWeight = 0.0;
+    for (uint16_t weight : weights)
+        outTable.totalWeight += double(HalfToFloat(weight));
+
+    if (outTable.totalWeight <= 0.0)
+        return false;
+
+    // Scale the weights so that the average is 1, then pair every texel below the average
+    // with one above it that donates the rest of the entry's probability.
+    std::vector<double> scaledWeights(count);
+    std::vector<uint32_t> small;
+    std::vector<uint32_t> large;
+    small.reserve(count);
+    large.reserve(count);
+
+    const double scale = double(count) / outTable.totalWeight;
+    for (size_t index = 0; index < count; index++)
+    {
+        scaledWeights[index] = double(HalfToFloat(weights[index])) * scale;
+        (scaledWeights[index] < 1.0 ? small : large).push_back(uint32_t(index));
+    }
+
+    outTable.entries.resize(count);
+
+    while (!small.empty() && !large.empty())
+    {
+        const uint32_t smallIndex = small.back();
+        const uint32_t largeIndex = large.back();
+        small.pop_back();
+
+        outTable.entries[smallIndex] = { largeIndex, float(scaledWeights[smallIndex]) };
+
+        scaledWeights[largeIndex] = (scaledWeights[largeIndex] + scaledWeights[smallIndex]) - 1.0;
+        if (scaledWeights[largeIndex] < 1.0)
+        {
+            large.pop_back();
+            small.push_back(largeIndex);
+        }
+    }
+
+    // What's left is at the average, up to the rounding errors
+    for (uint32_t index : large)
+        outTable.entries[index] = { index, 1.f };
+    for (uint32_t index : small)
+        outTable.entries[index] = { index, 1.f };
+
+    return true;
+}
+
+bool ValidateEnvironmentAliasTable(const EnvironmentPdfMips& mips, const EnvironmentAliasTable& table)
+{
+    const std::vector<uint16_t>& weights = mips.levels[0];
+    const size_t count = weights.size();
+
+    if (table.entries.size() != count || table.totalWeight <= 0.0)
+    {
+        log::error("The environment alias table has %d entries, expected %d.", int(table.entries.size()), int(count));
+        return false;
+    }
+
+    // Each entry is selected with probability 1/count, then keeps its texel with 'threshold' or goes to the alias.
+    std::vector<double> probabilities(count, 0.0);
+    for (size_t index = 0; index < count; index++)
+    {
+        const EnvironmentAliasTable::Entry& entry = table.entries[index];
+        if (entry.alias >= count)
+        {
+            log::error("The environment alias table entry %d points outside of the table.", int(index));
+            return false;
+        }
+
+        probabilities[index] += double(entry.threshold) / double(count);
+        probabilities[entry.alias] += (1.0 - double(entry.threshold)) / double(count);
+    }
+
+    // The thresholds are stored as floats, so allow for their rounding.
+    constexpr double relativeTolerance = 1e-5;
+    double maxRelativeError = 0.0;
+    uint32_t mismatchCount = 0;
+
+    for (size_t index = 0; index < count; index++)
+    {
+        const double expected = double(HalfToFloat(weights[index])) / table.totalWeight;
+        const double error = std::abs(probabilities[index] - expected);
+
+        if (expected > 0.0)
+            maxRelativeError = std::max(maxRelativeError, error / expected);
+
+        if (error > expected * relativeTolerance + 1.0 / double(count) * relativeTolerance)
+            ++mismatchCount;
+    }
+
+    if (mismatchCount != 0)
+    {
+        log::error("The environment alias table distribution differs from the PDF in %d texels, max relative error is %g.", mismatchCount, maxRelativeError);
+        return false;
+    }
+
+    log::info("The environment alias table matches the PDF, max relative error is %g.", maxRelativeError);
+    return true;
+}
+
+void UploadEnvironmentPdf(nvrhi::ICommandList* commandList, nvrhi::ITexture* pdfTexture, const EnvironmentPdfMips& mips)
+{
+    commandList->beginMarker("UploadEnvironmentPdf");
+
+    for (uint32_t mipLevel = 0; mipLevel < uint32_t(mips.levels.size()); mipLevel++)
+    {
+        const size_t rowPitch = GetMipSize(mips.width, mipLevel) * sizeof(uint16_t);
+        commandList->writeTexture(pdfTexture, 0, mipLevel, mips.levels[mipLevel].data(), rowPitch);
+    }
+
+    commandList->endMarker();
+}
+
+bool VerifyEnvironmentPdf(nvrhi::IDevice* device, nvrhi::ITexture* pdfTexture, const EnvironmentPdfMips& mips)
+{
+    const nvrhi::TextureDesc& textureDesc = pdfTexture->getDesc();
+
+    if (textureDesc.width != mips.width || textureDesc.height != mips.height || textureDesc.mipLevels != mips.levels.size())
+    {
+        log::error("The environment PDF texture is %dx%d with %d mips, but the CPU build is %dx%d with %d mips.",
+            textureDesc.width, textureDesc.height, textureDesc.mipLevels, mips.width, mips.height, int(mips.levels.size()));
+        return false;
+    }
+
+    nvrhi::TextureDesc stagingDesc;
+    stagingDesc.width = textureDesc.width;
+    stagingDesc.height = textureDesc.height;
+    stagingDesc.mipLevels = textureDesc.mipLevels;
+    stagingDesc.format = textureDesc.format;
+    stagingDesc.dimension = nvrhi::TextureDimension::Texture2D;
+    stagingDesc.debugName = "EnvironmentPdfStaging";
+    nvrhi::StagingTextureHandle stagingTexture = device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+
+    nvrhi::CommandListHandle commandList = device->createCommandList();
+    commandList->open();
+    for (uint32_t mipLevel = 0; mipLevel < textureDesc.mipLevels; mipLevel++)
+    {
+        const auto slice = nvrhi::TextureSlice().setMipLevel(mipLevel);
+        commandList->copyTexture(stagingTexture, slice, pdfTexture, slice);
+    }
+    commandList->close();
+    device->executeCommandList(commandList);
+    device->waitForIdle();
+
+    // Allow for a couple of float16 ulps: the GPU may use FMA for the luminance and round differently.
+    constexpr float relativeTolerance = 1.f / 512.f;
+    constexpr float absoluteTolerance = 1e-7f;
+
+    uint32_t mismatchCount = 0;
+    float maxRelativeError = 0.f;
+
+    for (uint32_t mipLevel = 0; mipLevel < textureDesc.mipLevels; mipLevel++)
+    {
+        const uint32_t mipWidth = GetMipSize(mips.width, mipLevel);
+        const uint32_t mipHeight = GetMipSize(mips.height, mipLevel);
+
+        size_t rowPitch = 0;
+        const uint8_t* data = static_cast<const uint8_t*>(device->mapStagingTexture(stagingTexture,
+            nvrhi::TextureSlice().setMipLevel(mipLevel), nvrhi::CpuAccessMode::Read, &rowPitch));
+
+        if (!data)
+        {
+            log::error("Couldn't map the environment PDF readback texture.");
+            return false;
+        }
+
+        for (uint32_t y = 0; y < mipHeight; y++)
+        {
+            const uint16_t* gpuRow = reinterpret_cast<const uint16_t*>(data + y * rowPitch);
+            const uint16_t* cpuRow = mips.levels[mipLevel].data() + size_t(y) * mipWidth;
+
+            for (uint32_t x = 0; x < mipWidth; x++)
+            {
+                const float gpuValue = HalfToFloat(gpuRow[x]);
+                const float cpuValue = HalfToFloat(cpuRow[x]);
+                const float error = fabsf(gpuValue - cpuValue);
+                const float magnitude = std::max(fabsf(gpuValue), fabsf(cpuValue));
+
+                if (magnitude > 0.f)
+                    maxRelativeError = std::max(maxRelativeError, error / magnitude);
+
+                if (error > std::max(absoluteTolerance, magnitude * relativeTolerance))
+                    ++mismatchCount;
+            }
+        }
+
+        device->unmapStagingTexture(stagingTexture);
+    }
+
+    if (mismatchCount != 0)
+    {
+        log::error("The CPU environment PDF differs from the GPU one in %d texels, max relative error is %g.", mismatchCount, maxRelativeError);
+        return false;
+    }
+
+    log::info("The CPU environment PDF matches the GPU one, max relative error is %g.", maxRelativeError);
+    return true;
+}
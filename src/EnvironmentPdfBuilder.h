@@ -0,0 +1,97 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+// The environment map importance sampling PDF pyramid, as built by GenerateMipsPass with PreprocessEnvironmentMap.hlsl.
+// The texels are stored in the R16_FLOAT format of RtxdiResources::EnvironmentPdfTexture, mip 0 first.
+// The width and height are the PDF texture size, see GetEnvironmentPdfTextureSize.
+struct EnvironmentPdfMips
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<std::vector<uint16_t>> levels;
+};
+
+// Vose alias table over the texels of mip 0 of the PDF pyramid, for sampling the environment map in O(1)
+// instead of descending the mip chain. The entries are indexed by texel, row by row.
+struct EnvironmentAliasTable
+{
+    // Same layout as the uint2 entries read by PresampleEnvironmentMap.hlsl
+    struct Entry
+    {
+        uint32_t alias;
+        float threshold; // probability of keeping the texel instead of taking the alias
+    };
+
+    std::vector<Entry> entries;
+    double totalWeight = 0.0;
+};
+
+// The PDF texture is the environment map size rounded up to powers of two, so that the mip descent in the presampling
+// pass can reach every texel, and limited to 16k. Mip 0 is resampled from the map when the sizes differ.
+void GetEnvironmentPdfTextureSize(uint32_t mapWidth, uint32_t mapHeight, uint32_t& outWidth, uint32_t& outHeight);
+
+// Same mip count as RtxdiResources uses for the PDF texture: the full chain down to 1x1.
+uint32_t GetEnvironmentPdfMipLevels(uint32_t width, uint32_t height);
+
+// Builds the PDF pyramid from an RGBA32F equirectangular map on the CPU.
+// The results match the GPU pass up to the float rounding differences, including the float16 reads at the start of every stage.
+void BuildEnvironmentPdfMips(const float* rgba, uint32_t width, uint32_t height, EnvironmentPdfMips& outMips, uint32_t threadCount = 0);
+
+// The contents of the PDF cache file: a header with the format version and the hash of the map file, then the levels.
+std::vector<uint8_t> SerializeEnvironmentPdfCache(uint64_t contentHash, const EnvironmentPdfMips& mips);
+
+// Returns false if the cache contents are from a different version or map, or are truncated.
+bool ParseEnvironmentPdfCache(const uint8_t* data, size_t size, uint64_t contentHash, EnvironmentPdfMips& outMips);
+
+// Loads the PDF pyramid of an EXR environment map from the cache file next to it, "<map>.envpdf",
+// or builds it from the map and writes the cache file. The cache is keyed by a hash of the map contents.
+// Returns nullptr if the map cannot be read or decoded.
+std::shared_ptr<EnvironmentPdfMips> LoadEnvironmentPdf(donut::vfs::IFileSystem& fs, const std::string& environmentMapPath);
+
+// The environment map encoded as BC6H_UFLOAT blocks, row by row. There is only one mip level, the shaders sample mip 0.
+struct CompressedEnvironmentMap
+{
+    uint32_t width = 0;
+    uint32_t height = 0;
+    std::vector<uint8_t> blocks;
+};
+
+// Encodes an RGBA32F map into BC6H on the CPU, the size must be a multiple of 4. Negative and NaN values become zero.
+void BuildCompressedEnvironmentMap(const float* rgba, uint32_t width, uint32_t height, CompressedEnvironmentMap& outMap, uint32_t threadCount = 0);
+
+// Loads the compressed version of an EXR environment map from the cache file next to it, "<map>.bc6h",
+// or encodes the map and writes the cache file, keyed like the PDF cache. The PDF is still built from the original map.
+// Returns nullptr if the map cannot be read or decoded, or if its size is not a multiple of 4.
+std::shared_ptr<CompressedEnvironmentMap> LoadCompressedEnvironmentMap(donut::vfs::IFileSystem& fs, const std::string& environmentMapPath);
+
+// Builds the alias table from mip 0 of the pyramid, using the same float16 values that are in the PDF texture.
+// Returns false if the map has no energy.
+bool BuildEnvironmentAliasTable(const EnvironmentPdfMips& mips, EnvironmentAliasTable& outTable);
+
+// Reconstructs the sampling distribution of the alias table and compares it with the normalized texel weights.
+bool ValidateEnvironmentAliasTable(const EnvironmentPdfMips& mips, const EnvironmentAliasTable& table);
+
+void UploadEnvironmentPdf(nvrhi::ICommandList* commandList, nvrhi::ITexture* pdfTexture, const EnvironmentPdfMips& mips);
+
+// Reads back the PDF texture and compares it with the CPU pyramid, allowing for a small relative error.
+// Waits for the GPU to finish all submitted work.
+bool VerifyEnvironmentPdf(nvrhi::IDevice* device, nvrhi::ITexture* pdfTexture, const EnvironmentPdfMips& mips);
@@ -10,18 +10,21 @@
 
 #include "FilterGradientsPass.h"
 #include "RenderTargets.h"
+#include "HalfFloat.h"
 
 #include <donut/engine/ShaderFactory.h>
 #include <donut/engine/View.h>
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
 
+#include <algorithm>
+
 using namespace donut::math;
 #include "../shaders/ShaderParameters.h"
 
 using namespace donut::engine;
 
-static const int c_NumFilterPasses = 4;
+static const int c_NumFilterPasses = FILTER_GRADIENTS_PASS_COUNT;
 
 FilterGradientsPass::FilterGradientsPass(
     nvrhi::IDevice* device,
@@ -49,6 +52,11 @@ void FilterGradientsPass::CreatePipeline()
     pipelineDesc.bindingLayouts = { m_BindingLayout };
     pipelineDesc.CS = m_ComputeShader;
     m_ComputePipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    m_FusedComputeShader = m_ShaderFactory->CreateShader("app/FilterGradientsPass.hlsl", "FusedFilter", nullptr, nvrhi::ShaderType::Compute);
+
+    pipelineDesc.CS = m_FusedComputeShader;
+    m_FusedComputePipeline = m_Device->createComputePipeline(pipelineDesc);
 }
 
 void FilterGradientsPass::CreateBindingSet(const RenderTargets& renderTargets)
@@ -68,38 +76,228 @@ void FilterGradientsPass::CreateBindingSet(const RenderTargets& renderTargets)
 void FilterGradientsPass::Render(
     nvrhi::ICommandList* commandList,
     const donut::engine::IView& view,
-    bool checkerboard)
+    bool checkerboard,
+    bool fused)
 {
     commandList->beginMarker("Filter Gradients");
 
+    const dm::int2 gradientsExtent = GetGradientsExtent(view, checkerboard);
+    const int gradientWidth = gradientsExtent.x;
+    const int gradientHeight = gradientsExtent.y;
+
     FilterGradientsConstants constants = {};
-    constants.viewportSize = dm::uint2(view.GetViewExtent().width(), view.GetViewExtent().height());
-    if (checkerboard) constants.viewportSize.x /= 2;
+    constants.gradientSize = dm::uint2(gradientWidth, gradientHeight);
     constants.checkerboard = checkerboard;
-    
+
+    m_Fused = fused;
+
+    const bool capture = m_CaptureRequested;
+    if (capture)
+    {
+        m_CaptureRequested = false;
+
+        const nvrhi::TextureDesc& gradientsDesc = m_GradientsTexture->getDesc();
+
+        nvrhi::TextureDesc stagingDesc;
+        stagingDesc.width = gradientsDesc.width;
+        stagingDesc.height = gradientsDesc.height;
+        stagingDesc.format = gradientsDesc.format;
+        stagingDesc.dimension = nvrhi::TextureDimension::Texture2D;
+        stagingDesc.debugName = "GradientsCaptureInput";
+        m_CaptureInputTexture = m_Device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+        stagingDesc.debugName = "GradientsCaptureOutput";
+        m_CaptureOutputTexture = m_Device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+
+        commandList->copyTexture(m_CaptureInputTexture, nvrhi::TextureSlice(), m_GradientsTexture, nvrhi::TextureSlice().setArraySlice(0));
+
+        m_CaptureWidth = uint32_t(gradientWidth);
+        m_CaptureHeight = uint32_t(gradientHeight);
+        m_CaptureCheckerboard = checkerboard;
+    }
+
     nvrhi::ComputeState state;
     state.bindings = { m_BindingSet };
-    state.pipeline = m_ComputePipeline;
+    state.pipeline = fused ? m_FusedComputePipeline : m_ComputePipeline;
     commandList->setComputeState(state);
 
-    for (int passIndex = 0; passIndex < c_NumFilterPasses; passIndex++)
+    if (fused)
     {
-        constants.passIndex = passIndex;
         commandList->setPushConstants(&constants, sizeof(constants));
 
         commandList->dispatch(
-            dm::div_ceil(view.GetViewExtent().width(), 8),
-            dm::div_ceil(view.GetViewExtent().height(), 8),
+            dm::div_ceil(gradientWidth, FILTER_GRADIENTS_FUSED_TILE_SIZE),
+            dm::div_ceil(gradientHeight, FILTER_GRADIENTS_FUSED_TILE_SIZE),
             1);
 
         nvrhi::utils::TextureUavBarrier(commandList, m_GradientsTexture);
         commandList->commitBarriers();
     }
+    else
+    {
+        for (int passIndex = 0; passIndex < c_NumFilterPasses; passIndex++)
+        {
+            constants.passIndex = passIndex;
+            commandList->setPushConstants(&constants, sizeof(constants));
+
+            commandList->dispatch(
+                dm::div_ceil(gradientWidth, 8),
+                dm::div_ceil(gradientHeight, 8),
+                1);
+
+            nvrhi::utils::TextureUavBarrier(commandList, m_GradientsTexture);
+            commandList->commitBarriers();
+        }
+    }
+
+    if (capture)
+    {
+        commandList->copyTexture(m_CaptureOutputTexture, nvrhi::TextureSlice(), m_GradientsTexture, nvrhi::TextureSlice().setArraySlice(GetOutputBufferIndex()));
+
+        m_CapturePending = true;
+    }
 
     commandList->endMarker();
 }
 
-int FilterGradientsPass::GetOutputBufferIndex()
+dm::int2 FilterGradientsPass::GetGradientsExtent(const donut::engine::IView& view, bool checkerboard)
+{
+    // One gradient texel covers RTXDI_GRAD_FACTOR x RTXDI_GRAD_FACTOR reservoirs
+    const int reservoirWidth = GetReservoirSpaceWidth(view.GetViewExtent().width(), checkerboard);
+
+    return dm::int2(
+        dm::div_ceil(reservoirWidth, RTXDI_GRAD_FACTOR),
+        dm::div_ceil(view.GetViewExtent().height(), RTXDI_GRAD_FACTOR));
+}
+
+int FilterGradientsPass::GetOutputBufferIndex() const
+{
+    // The fused filter can't write its result over its input, that is still read by the neighboring groups
+    return m_Fused ? 1 : (c_NumFilterPasses & 1);
+}
+
+// Reads the first width x height texels of an RGBA16_FLOAT staging texture.
+static bool ReadGradients(nvrhi::IDevice* device, nvrhi::IStagingTexture* stagingTexture, uint32_t width, uint32_t height, std::vector<float>& outRgba)
+{
+    size_t rowPitch = 0;
+    const uint8_t* data = static_cast<const uint8_t*>(device->mapStagingTexture(stagingTexture,
+        nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch));
+
+    if (!data)
+        return false;
+
+    outRgba.resize(size_t(width) * height * 4);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        const uint16_t* row = reinterpret_cast<const uint16_t*>(data + y * rowPitch);
+
+        for (uint32_t i = 0; i < width * 4; i++)
+            outRgba[size_t(y) * width * 4 + i] = HalfToFloat(row[i]);
+    }
+
+    device->unmapStagingTexture(stagingTexture);
+    return true;
+}
+
+bool FilterGradientsPass::VerifyCapture()
 {
-    return c_NumFilterPasses & 1;
+    m_CapturePending = false;
+
+    m_Device->waitForIdle();
+
+    std::vector<float> reference;
+    std::vector<float> gpuOutput;
+
+    if (!ReadGradients(m_Device, m_CaptureInputTexture, m_CaptureWidth, m_CaptureHeight, reference) ||
+        !ReadGradients(m_Device, m_CaptureOutputTexture, m_CaptureWidth, m_CaptureHeight, gpuOutput))
+    {
+        donut::log::error("Couldn't map the gradients readback textures.");
+        return false;
+    }
+
+    if (std::all_of(reference.begin(), reference.end(), [](float value) { return value == 0.f; }))
+    {
+        // Nothing has changed in the scene yet, try again on the next frame
+        m_CaptureRequested = true;
+        return true;
+    }
+
+    FilterGradientsReference(reference, m_CaptureWidth, m_CaptureHeight, m_CaptureCheckerboard);
+
+    // Allow for a couple of float16 ulps: the rounding after every pass may differ when the GPU uses FMA.
+    // The gradients are stored pre-multiplied by RTXDI_GRAD_STORAGE_SCALE, so the absolute tolerance is tiny.
+    constexpr float relativeTolerance = 1.f / 256.f;
+    constexpr float absoluteTolerance = 1e-3f;
+
+    uint32_t mismatchCount = 0;
+    float maxRelativeError = 0.f;
+
+    for (size_t i = 0; i < reference.size(); i++)
+    {
+        const float error = fabsf(gpuOutput[i] - reference[i]);
+        const float magnitude = std::max(fabsf(gpuOutput[i]), fabsf(reference[i]));
+
+        if (magnitude > 0.f)
+            maxRelativeError = std::max(maxRelativeError, error / magnitude);
+
+        if (error > std::max(absoluteTolerance, magnitude * relativeTolerance))
+            ++mismatchCount;
+    }
+
+    const char* mode = m_Fused ? "fused" : "multi-pass";
+
+    if (mismatchCount > 0)
+    {
+        donut::log::error("The %s gradient filter differs from the CPU reference in %d of %d values, max relative error %f.",
+            mode, mismatchCount, int(reference.size()), maxRelativeError);
+        return false;
+    }
+
+    donut::log::info("The %s gradient filter matches the CPU reference (%dx%d texels, max relative error %f).",
+        mode, m_CaptureWidth, m_CaptureHeight, maxRelativeError);
+    return true;
+}
+
+void FilterGradientsReference(std::vector<float>& rgba, uint32_t width, uint32_t height, bool checkerboard)
+{
+    std::vector<float> output(rgba.size());
+
+    for (int passIndex = 0; passIndex < c_NumFilterPasses; passIndex++)
+    {
+        int stepX = 1 << passIndex;
+        const int stepY = 1 << passIndex;
+        if (checkerboard)
+            stepX >>= 1;
+
+        for (int y = 0; y < int(height); y++)
+        for (int x = 0; x < int(width); x++)
+        {
+            float acc[4] = {};
+            float wSum = 0.f;
+
+            for (int yy = -1; yy <= 1; ++yy)
+            for (int xx = -1; xx <= 1; ++xx)
+            {
+                const int posX = x + xx * stepX;
+                const int posY = y + yy * stepY;
+
+                if (posX < 0 || posY < 0 || posX >= int(width) || posY >= int(height))
+                    continue;
+
+                const float w = (xx == 0 ? 1.f : 0.5f) * (yy == 0 ? 1.f : 0.5f);
+                const float* c = &rgba[(size_t(posY) * width + posX) * 4];
+
+                for (int channel = 0; channel < 4; channel++)
+                    acc[channel] += c[channel] * w;
+                wSum += w;
+            }
+
+            // The GPU versions store every pass as float16
+            float* out = &output[(size_t(y) * width + x) * 4];
+            for (int channel = 0; channel < 4; channel++)
+                out[channel] = HalfToFloat(FloatToHalf(acc[channel] / wSum));
+        }
+
+        std::swap(rgba, output);
+    }
 }
@@ -10,8 +10,10 @@
 
 #pragma once
 
+#include <donut/core/math/math.h>
 #include <nvrhi/nvrhi.h>
 #include <memory>
+#include <vector>
 
 namespace donut::engine
 {
@@ -21,6 +23,10 @@ namespace donut::engine
 
 class RenderTargets;
 
+// CPU version of the gradient filter, applied in place to an RGBA image of width x height gradient texels.
+// Rounds the result of every pass to float16, like the GPU versions do.
+void FilterGradientsReference(std::vector<float>& rgba, uint32_t width, uint32_t height, bool checkerboard);
+
 class FilterGradientsPass
 {
 private:
@@ -28,9 +34,21 @@ private:
 
     nvrhi::ShaderHandle m_ComputeShader;
     nvrhi::ComputePipelineHandle m_ComputePipeline;
+    nvrhi::ShaderHandle m_FusedComputeShader;
+    nvrhi::ComputePipelineHandle m_FusedComputePipeline;
     nvrhi::BindingLayoutHandle m_BindingLayout;
     nvrhi::BindingSetHandle m_BindingSet;
     nvrhi::TextureHandle m_GradientsTexture;
+    bool m_Fused = false;
+
+    // Readback of the filter input and output for the validation against the CPU reference
+    nvrhi::StagingTextureHandle m_CaptureInputTexture;
+    nvrhi::StagingTextureHandle m_CaptureOutputTexture;
+    bool m_CaptureRequested = false;
+    bool m_CapturePending = false;
+    uint32_t m_CaptureWidth = 0;
+    uint32_t m_CaptureHeight = 0;
+    bool m_CaptureCheckerboard = false;
 
     std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
 
@@ -46,7 +64,21 @@ public:
     void Render(
         nvrhi::ICommandList* commandList,
         const donut::engine::IView& view,
-        bool checkerboard);
+        bool checkerboard,
+        bool fused);
+
+    // Returns the number of gradient texels that cover the view's reservoirs, see DIComputeGradients.
+    static dm::int2 GetGradientsExtent(const donut::engine::IView& view, bool checkerboard);
+
+    // Returns the slice of the gradients texture that has the output of the last Render call.
+    [[nodiscard]] int GetOutputBufferIndex() const;
+
+    // Makes the next Render call copy the filter input and output into staging textures.
+    void RequestCapture() { m_CaptureRequested = true; }
+    [[nodiscard]] bool IsCapturePending() const { return m_CapturePending; }
 
-    static int GetOutputBufferIndex();
+    // Runs the CPU reference on the captured input and compares the result with the captured output.
+    // Waits for the GPU to finish all submitted work. If the captured gradients are all zero,
+    // the comparison is meaningless, and another capture is requested instead.
+    bool VerifyCapture();
 };
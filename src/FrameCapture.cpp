@@ -0,0 +1,344 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "FrameCapture.h"
+#include "HalfFloat.h"
+
+#include <donut/core/log.h>
+
+#include <stb_image_write.h>
+#include <tinyexr.h>
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+using namespace donut;
+namespace fs = std::filesystem;
+
+FrameCapture::FrameCapture(nvrhi::IDevice* device, const FrameCaptureSettings& settings)
+    : m_Device(device)
+    , m_Settings(settings)
+{
+    m_Settings.interval = std::max(m_Settings.interval, 1u);
+    m_Settings.lastFrame = std::max(m_Settings.lastFrame, m_Settings.firstFrame);
+
+    if (!GetCaptureFormatFromFileName(m_Settings.fileName, m_MainFormat))
+    {
+        log::warning("Unrecognized capture file extension in '%s', using BMP.", m_Settings.fileName.c_str());
+        m_MainFormat = FrameCaptureFormat::Bmp;
+    }
+
+    m_EncoderThread = std::thread(&FrameCapture::EncoderThreadProc, this);
+}
+
+FrameCapture::~FrameCapture()
+{
+    Flush();
+
+    {
+        std::lock_guard<std::mutex> lock(m_QueueMutex);
+        m_StopEncoder = true;
+    }
+    m_QueueCondition.notify_all();
+    m_EncoderThread.join();
+}
+
+bool FrameCapture::ShouldCapture(uint32_t frameIndex) const
+{
+    if (frameIndex < m_Settings.firstFrame || frameIndex > m_Settings.lastFrame)
+        return false;
+
+    return (frameIndex - m_Settings.firstFrame) % m_Settings.interval == 0;
+}
+
+void FrameCapture::Capture(nvrhi::ICommandList* commandList, uint32_t frameIndex, const std::vector<Source>& sources)
+{
+    StagingSlot& slot = m_Slots[m_NextSlot];
+    m_NextSlot = (m_NextSlot + 1) % c_RingSize;
+
+    // The ring is full, which means the oldest capture hasn't been picked up by ProcessPendingCaptures yet.
+    // Reading it back here may stall, but only if the GPU is more than c_RingSize frames behind.
+    if (slot.pending)
+        ReadBackSlot(slot);
+
+    slot.buffers.resize(sources.size());
+
+    for (size_t index = 0; index < sources.size(); index++)
+    {
+        const Source& source = sources[index];
+        StagingSlot::Buffer& buffer = slot.buffers[index];
+        const nvrhi::TextureDesc& sourceDesc = source.texture->getDesc();
+
+        if (!buffer.stagingTexture ||
+            buffer.stagingTexture->getDesc().width != sourceDesc.width ||
+            buffer.stagingTexture->getDesc().height != sourceDesc.height ||
+            buffer.stagingTexture->getDesc().format != sourceDesc.format)
+        {
+            nvrhi::TextureDesc stagingDesc;
+            stagingDesc.width = sourceDesc.width;
+            stagingDesc.height = sourceDesc.height;
+            stagingDesc.format = sourceDesc.format;
+            stagingDesc.dimension = nvrhi::TextureDimension::Texture2D;
+            stagingDesc.debugName = "CaptureStaging";
+            buffer.stagingTexture = m_Device->createStagingTexture(stagingDesc, nvrhi::CpuAccessMode::Read);
+        }
+
+        buffer.name = source.name;
+        commandList->copyTexture(buffer.stagingTexture, nvrhi::TextureSlice(), source.texture, nvrhi::TextureSlice());
+    }
+
+    slot.frameIndex = frameIndex;
+    slot.submitIndex = m_SubmitIndex;
+    slot.pending = true;
+}
+
+void FrameCapture::ProcessPendingCaptures()
+{
+    ++m_SubmitIndex;
+
+    // Map the slots that were submitted at least (c_RingSize - 1) frames ago, those are almost certainly
+    // finished on the GPU by now, so mapping won't wait.
+    for (StagingSlot& slot : m_Slots)
+    {
+        if (slot.pending && m_SubmitIndex - slot.submitIndex >= c_RingSize - 1)
+            ReadBackSlot(slot);
+    }
+}
+
+void FrameCapture::ReadBackSlot(StagingSlot& slot)
+{
+    const bool multipleFrames = m_Settings.lastFrame > m_Settings.firstFrame;
+
+    for (const auto& buffer : slot.buffers)
+    {
+        const nvrhi::TextureDesc& desc = buffer.stagingTexture->getDesc();
+        const nvrhi::FormatInfo& formatInfo = nvrhi::getFormatInfo(desc.format);
+
+        EncodeJob job;
+        job.width = desc.width;
+        job.height = desc.height;
+        job.pixelFormat = desc.format;
+
+        if (buffer.name.empty())
+            job.format = m_MainFormat;
+        else
+            job.format = (m_MainFormat == FrameCaptureFormat::Raw) ? FrameCaptureFormat::Raw : FrameCaptureFormat::Exr;
+
+        job.fileName = GetCaptureFileName(m_Settings.fileName, buffer.name, job.format, slot.frameIndex, multipleFrames);
+
+        size_t rowPitch = 0;
+        const void* data = m_Device->mapStagingTexture(buffer.stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch);
+
+        if (!data)
+        {
+            log::error("Couldn't map the readback texture for '%s'.", job.fileName.c_str());
+            ++m_FailedWrites;
+            continue;
+        }
+
+        const size_t packedRowSize = size_t(desc.width) * formatInfo.bytesPerBlock;
+        job.pixels.resize(packedRowSize * desc.height);
+
+        for (uint32_t row = 0; row < desc.height; row++)
+        {
+            memcpy(job.pixels.data() + row * packedRowSize, static_cast<const uint8_t*>(data) + row * rowPitch, packedRowSize);
+        }
+
+        m_Device->unmapStagingTexture(buffer.stagingTexture);
+
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            m_Queue.push_back(std::move(job));
+        }
+        m_QueueCondition.notify_one();
+    }
+
+    slot.pending = false;
+}
+
+bool FrameCapture::Flush()
+{
+    for (uint32_t offset = 0; offset < c_RingSize; offset++)
+    {
+        // Read back in submission order, oldest slot first
+        StagingSlot& slot = m_Slots[(m_NextSlot + offset) % c_RingSize];
+        if (slot.pending)
+            ReadBackSlot(slot);
+    }
+
+    std::unique_lock<std::mutex> lock(m_QueueMutex);
+    m_IdleCondition.wait(lock, [this]() { return m_Queue.empty() && !m_EncoderBusy; });
+
+    return m_FailedWrites == 0;
+}
+
+void FrameCapture::EncoderThreadProc()
+{
+    while (true)
+    {
+        EncodeJob job;
+
+        {
+            std::unique_lock<std::mutex> lock(m_QueueMutex);
+            m_QueueCondition.wait(lock, [this]() { return !m_Queue.empty() || m_StopEncoder; });
+
+            if (m_Queue.empty())
+                return;
+
+            job = std::move(m_Queue.front());
+            m_Queue.pop_front();
+            m_EncoderBusy = true;
+        }
+
+        if (!EncodeFile(job))
+            ++m_FailedWrites;
+
+        {
+            std::lock_guard<std::mutex> lock(m_QueueMutex);
+            m_EncoderBusy = false;
+        }
+        m_IdleCondition.notify_all();
+    }
+}
+
+// Converts the supported color formats into float RGBA, returns false for other formats.
+static bool ConvertToFloatRGBA(const uint8_t* pixels, nvrhi::Format format, size_t pixelCount, std::vector<float>& output)
+{
+    output.resize(pixelCount * 4);
+
+    for (size_t index = 0; index < pixelCount; index++)
+    {
+        float* rgba = output.data() + index * 4;
+        rgba[0] = rgba[1] = rgba[2] = 0.f;
+        rgba[3] = 1.f;
+
+        switch (format)
+        {
+        case nvrhi::Format::RGBA8_UNORM:
+        case nvrhi::Format::SRGBA8_UNORM:
+            for (int channel = 0; channel < 4; channel++)
+                rgba[channel] = float(pixels[index * 4 + channel]) / 255.f;
+            break;
+        case nvrhi::Format::BGRA8_UNORM:
+        case nvrhi::Format::SBGRA8_UNORM:
+            for (int channel = 0; channel < 4; channel++)
+                rgba[channel] = float(pixels[index * 4 + ((channel < 3) ? 2 - channel : 3)]) / 255.f;
+            break;
+        case nvrhi::Format::R8_UNORM:
+            rgba[0] = float(pixels[index]) / 255.f;
+            break;
+        case nvrhi::Format::R16_FLOAT:
+            rgba[0] = HalfToFloat(reinterpret_cast<const uint16_t*>(pixels)[index]);
+            break;
+        case nvrhi::Format::RG16_FLOAT:
+            for (int channel = 0; channel < 2; channel++)
+                rgba[channel] = HalfToFloat(reinterpret_cast<const uint16_t*>(pixels)[index * 2 + channel]);
+            break;
+        case nvrhi::Format::RGBA16_FLOAT:
+            for (int channel = 0; channel < 4; channel++)
+                rgba[channel] = HalfToFloat(reinterpret_cast<const uint16_t*>(pixels)[index * 4 + channel]);
+            break;
+        case nvrhi::Format::R32_FLOAT:
+            rgba[0] = reinterpret_cast<const float*>(pixels)[index];
+            break;
+        case nvrhi::Format::RGBA32_FLOAT:
+            memcpy(rgba, pixels + index * 16, 16);
+            break;
+        default:
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool FrameCapture::EncodeFile(const EncodeJob& job)
+{
+    fs::path parentFolder = fs::path(job.fileName).parent_path();
+    if (!parentFolder.empty() && !fs::exists(parentFolder))
+    {
+        std::error_code error;
+        fs::create_directories(parentFolder, error);
+    }
+
+    const size_t pixelCount = size_t(job.width) * job.height;
+    bool success = false;
+
+    switch (job.format)
+    {
+    case FrameCaptureFormat::Bmp:
+    case FrameCaptureFormat::Png: {
+        const uint8_t* rgba8 = job.pixels.data();
+        std::vector<uint8_t> converted;
+
+        if (job.pixelFormat != nvrhi::Format::RGBA8_UNORM && job.pixelFormat != nvrhi::Format::SRGBA8_UNORM)
+        {
+            // Clamp anything else into 8 bits, there is no tone mapping here
+            std::vector<float> floats;
+            if (!ConvertToFloatRGBA(job.pixels.data(), job.pixelFormat, pixelCount, floats))
+            {
+                log::error("Unsupported texture format for '%s'", job.fileName.c_str());
+                return false;
+            }
+
+            converted.resize(pixelCount * 4);
+            for (size_t index = 0; index < converted.size(); index++)
+                converted[index] = uint8_t(std::clamp(floats[index], 0.f, 1.f) * 255.f + 0.5f);
+            rgba8 = converted.data();
+        }
+
+        if (job.format == FrameCaptureFormat::Png)
+            success = stbi_write_png(job.fileName.c_str(), int(job.width), int(job.height), 4, rgba8, int(job.width * 4)) != 0;
+        else
+            success = stbi_write_bmp(job.fileName.c_str(), int(job.width), int(job.height), 4, rgba8) != 0;
+        break;
+    }
+
+    case FrameCaptureFormat::Exr: {
+        std::vector<float> floats;
+        if (!ConvertToFloatRGBA(job.pixels.data(), job.pixelFormat, pixelCount, floats))
+        {
+            log::error("Unsupported texture format for '%s'", job.fileName.c_str());
+            return false;
+        }
+
+        const char* error = nullptr;
+        success = SaveEXR(floats.data(), int(job.width), int(job.height), 4, /* save_as_fp16 = */ 0, job.fileName.c_str(), &error) == TINYEXR_SUCCESS;
+        if (error)
+        {
+            log::error("%s", error);
+            FreeEXRErrorMessage(error);
+        }
+        break;
+    }
+
+    case FrameCaptureFormat::Raw: {
+        // Tightly packed texels in the texture's own format, described by the log message below.
+        std::ofstream file(job.fileName, std::ios::binary);
+        file.write(reinterpret_cast<const char*>(job.pixels.data()), std::streamsize(job.pixels.size()));
+        success = file.good();
+        if (success)
+        {
+            log::info("Raw capture '%s' is %dx%d, %s", job.fileName.c_str(), job.width, job.height,
+                nvrhi::getFormatInfo(job.pixelFormat).name);
+        }
+        break;
+    }
+    }
+
+    if (success)
+        log::info("Saved the capture into '%s'", job.fileName.c_str());
+    else
+        log::error("Failed to save the capture into '%s'", job.fileName.c_str());
+
+    return success;
+}
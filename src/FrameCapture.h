@@ -0,0 +1,117 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include "CaptureFileNames.h"
+
+#include <nvrhi/nvrhi.h>
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct FrameCaptureSettings
+{
+    // Frames [firstFrame, lastFrame] are captured, every 'interval' frames.
+    uint32_t firstFrame = 0;
+    uint32_t lastFrame = 0;
+    uint32_t interval = 1;
+
+    // Output file name for the final image, the format is derived from its extension.
+    // Other buffers and frame numbers are inserted before the extension, see GetCaptureFileName.
+    std::string fileName;
+
+    // Also capture HdrColor and the lighting buffers, stored as EXR unless the main format is raw.
+    bool captureHdr = false;
+};
+
+// Captures render targets without stalling the GPU: the copies go into a ring of staging textures
+// that are only mapped a few frames later, and the file encoding happens on a background thread.
+class FrameCapture
+{
+public:
+    struct Source
+    {
+        std::string name; // Empty for the main image
+        nvrhi::ITexture* texture = nullptr;
+    };
+
+    FrameCapture(nvrhi::IDevice* device, const FrameCaptureSettings& settings);
+    ~FrameCapture();
+
+    [[nodiscard]] bool ShouldCapture(uint32_t frameIndex) const;
+    [[nodiscard]] bool IsComplete(uint32_t frameIndex) const { return frameIndex >= m_Settings.lastFrame; }
+    [[nodiscard]] bool IsHdrCaptureEnabled() const { return m_Settings.captureHdr; }
+
+    // Records copies of the sources into the next staging slot.
+    void Capture(nvrhi::ICommandList* commandList, uint32_t frameIndex, const std::vector<Source>& sources);
+
+    // Call once per frame after the command list has been executed. Maps the slots that are old enough
+    // to have finished on the GPU and hands their contents over to the encoding thread.
+    void ProcessPendingCaptures();
+
+    // Reads back all outstanding captures and waits for the encoding thread to write them.
+    // Returns false if any file could not be written.
+    bool Flush();
+
+private:
+    static constexpr uint32_t c_RingSize = 3;
+
+    struct StagingSlot
+    {
+        struct Buffer
+        {
+            std::string name;
+            nvrhi::StagingTextureHandle stagingTexture;
+        };
+
+        std::vector<Buffer> buffers;
+        uint32_t frameIndex = 0;
+        uint64_t submitIndex = 0;
+        bool pending = false;
+    };
+
+    struct EncodeJob
+    {
+        std::string fileName;
+        FrameCaptureFormat format = FrameCaptureFormat::Raw;
+        nvrhi::Format pixelFormat = nvrhi::Format::UNKNOWN;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        std::vector<uint8_t> pixels; // Tightly packed rows
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    FrameCaptureSettings m_Settings;
+    FrameCaptureFormat m_MainFormat = FrameCaptureFormat::Bmp;
+    std::array<StagingSlot, c_RingSize> m_Slots;
+    uint32_t m_NextSlot = 0;
+    uint64_t m_SubmitIndex = 0;
+
+    std::thread m_EncoderThread;
+    std::mutex m_QueueMutex;
+    std::condition_variable m_QueueCondition;
+    std::condition_variable m_IdleCondition;
+    std::deque<EncodeJob> m_Queue;
+    bool m_EncoderBusy = false;
+    bool m_StopEncoder = false;
+    std::atomic<uint32_t> m_FailedWrites{ 0 };
+
+    void ReadBackSlot(StagingSlot& slot);
+    void EncoderThreadProc();
+
+    static bool EncodeFile(const EncodeJob& job);
+};
@@ -135,7 +135,7 @@ void RaytracedGBufferPass::Render(
     commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
 
     PerPassConstants pushConstants{};
-    pushConstants.rayCountBufferIndex = ProfilerSection::GBufferFill;
+    pushConstants.rayCountBufferIndex = settings.enableRayCounts ? ProfilerSection::GBufferFill : -1;
 
     m_Pass.Execute(
         commandList, 
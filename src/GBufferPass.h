@@ -41,6 +41,9 @@ struct GBufferSettings
     ibool enableTransparentGeometry = true;
     float textureLodBias = -1.f;
 
+    // Adds the traced rays to the GBufferFill ray count, off for the additional views
+    bool enableRayCounts = true;
+
     bool enableMaterialReadback = false;
     dm::int2 materialReadbackPosition = 0;
 };
@@ -19,6 +19,18 @@ using namespace donut::math;
 
 #include "../shaders/ShaderParameters.h"
 
+// Same tiling as in PreprocessEnvironmentMap.hlsl
+static constexpr uint32_t c_TileSize = 32;
+static constexpr uint32_t c_MipLevelsPerStage = 5;
+
+static uint2 GetStageTileCount(const nvrhi::TextureDesc& desc, uint32_t stage)
+{
+    const uint32_t mipLevel = stage * c_MipLevelsPerStage;
+    return uint2(
+        div_ceil(std::max(desc.width >> mipLevel, 1u), c_TileSize),
+        div_ceil(std::max(desc.height >> mipLevel, 1u), c_TileSize));
+}
+
 GenerateMipsPass::GenerateMipsPass(
     nvrhi::IDevice* device, 
     std::shared_ptr<donut::engine::ShaderFactory> shaderFactory,
@@ -31,9 +43,28 @@ GenerateMipsPass::GenerateMipsPass(
 
     const auto& destinationDesc = m_DestinationTexture->getDesc();
 
+    // One counter for every tile of the stages after the first one
+    uint32_t stageCounterCount = 0;
+    for (uint32_t stage = 1; stage * c_MipLevelsPerStage < destinationDesc.mipLevels - 1; stage++)
+    {
+        const uint2 tileCount = GetStageTileCount(destinationDesc, stage);
+        stageCounterCount += tileCount.x * tileCount.y;
+    }
+
+    nvrhi::BufferDesc stageCounterBufferDesc;
+    stageCounterBufferDesc.byteSize = sizeof(uint32_t) * std::max(stageCounterCount, 1u);
+    stageCounterBufferDesc.format = nvrhi::Format::R32_UINT;
+    stageCounterBufferDesc.canHaveUAVs = true;
+    stageCounterBufferDesc.canHaveTypedViews = true;
+    stageCounterBufferDesc.debugName = "GenerateMipsStageCounters";
+    stageCounterBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    stageCounterBufferDesc.keepInitialState = true;
+    m_StageCounterBuffer = device->createBuffer(stageCounterBufferDesc);
+
     nvrhi::BindingSetDesc bindingSetDesc;
     bindingSetDesc.bindings = {
-        nvrhi::BindingSetItem::PushConstants(0, sizeof(PreprocessEnvironmentMapConstants))
+        nvrhi::BindingSetItem::PushConstants(0, sizeof(PreprocessEnvironmentMapConstants)),
+        nvrhi::BindingSetItem::TypedBuffer_UAV(0, m_StageCounterBuffer)
     };
 
     if (sourceEnvironmentMap) 
@@ -44,7 +75,7 @@ GenerateMipsPass::GenerateMipsPass(
     for (uint32_t mipLevel = 0; mipLevel < destinationDesc.mipLevels; mipLevel++)
     {
         bindingSetDesc.bindings.push_back(nvrhi::BindingSetItem::Texture_UAV(
-            mipLevel, 
+            mipLevel + 1, 
             m_DestinationTexture,
             nvrhi::Format::UNKNOWN, 
             nvrhi::TextureSubresourceSet(mipLevel, 1, 0, 1)));
@@ -70,30 +101,28 @@ void GenerateMipsPass::Process(nvrhi::ICommandList* commandList)
     
     const auto& destDesc = m_DestinationTexture->getDesc();
 
-    constexpr uint32_t mipLevelsPerPass = 5;
-    uint32_t width = destDesc.width;
-    uint32_t height = destDesc.height;
-
-    for (uint32_t sourceMipLevel = 0; sourceMipLevel < destDesc.mipLevels; sourceMipLevel += mipLevelsPerPass)
+    // The shader resets the counters after use, so they only need to be cleared once.
+    if (!m_StageCountersCleared)
     {
-        nvrhi::ComputeState state;
-        state.pipeline = m_Pipeline;
-        state.bindings = { m_BindingSet };
-        commandList->setComputeState(state);
-
-        PreprocessEnvironmentMapConstants constants{};
-        constants.sourceSize = { destDesc.width, destDesc.height };
-        constants.numDestMipLevels = destDesc.mipLevels;
-        constants.sourceMipLevel = sourceMipLevel;
-        commandList->setPushConstants(&constants, sizeof(constants));
-
-        commandList->dispatch(div_ceil(width, 32), div_ceil(height, 32), 1);
-
-        width = std::max(1u, width >> mipLevelsPerPass);
-        height = std::max(1u, height >> mipLevelsPerPass);
-        
-        commandList->clearState(); // make sure nvrhi inserts a barrier
+        commandList->clearBufferUInt(m_StageCounterBuffer, 0);
+        m_StageCountersCleared = true;
     }
 
+    nvrhi::ComputeState state;
+    state.pipeline = m_Pipeline;
+    state.bindings = { m_BindingSet };
+    commandList->setComputeState(state);
+
+    PreprocessEnvironmentMapConstants constants{};
+    constants.sourceSize = m_SourceTexture
+        ? uint2(m_SourceTexture->getDesc().width, m_SourceTexture->getDesc().height)
+        : uint2(destDesc.width, destDesc.height);
+    constants.destSize = { destDesc.width, destDesc.height };
+    constants.numDestMipLevels = destDesc.mipLevels;
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    const uint2 tileCount = GetStageTileCount(destDesc, 0);
+    commandList->dispatch(tileCount.x, tileCount.y, 1);
+
     commandList->endMarker();
 }
@@ -25,6 +25,8 @@ private:
     nvrhi::BindingSetHandle m_BindingSet;
     nvrhi::TextureHandle m_SourceTexture;
     nvrhi::TextureHandle m_DestinationTexture;
+    nvrhi::BufferHandle m_StageCounterBuffer;
+    bool m_StageCountersCleared = false;
     
 public:
     GenerateMipsPass(
@@ -33,5 +35,6 @@ public:
         nvrhi::ITexture* sourceEnvironmentMap,
         nvrhi::ITexture* destinationTexture);
     
+    // Generates all mip levels in a single dispatch, see PreprocessEnvironmentMap.hlsl.
     void Process(nvrhi::ICommandList* commandList);
 };
@@ -0,0 +1,77 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// Conversions between float and IEEE 754 half, rounding to nearest even like the GPU format conversions.
+
+inline uint16_t FloatToHalf(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    const uint32_t sign = (bits >> 16) & 0x8000;
+    bits &= 0x7fffffff;
+
+    if (bits >= 0x7f800000) // Inf or NaN
+        return uint16_t(sign | 0x7c00 | (bits > 0x7f800000 ? 0x200 : 0));
+
+    if (bits >= 0x477ff000) // Rounds to infinity
+        return uint16_t(sign | 0x7c00);
+
+    if (bits < 0x38800000) // Half denormals and zero
+    {
+        if (bits < 0x33000000)
+            return uint16_t(sign);
+
+        const uint32_t exponent = bits >> 23;
+        const uint32_t mantissa = (bits & 0x7fffff) | 0x800000;
+        const uint32_t shift = 126 - exponent;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+
+        uint32_t half = mantissa >> shift;
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            ++half;
+
+        return uint16_t(sign | half);
+    }
+
+    // Rebias the exponent and round the mantissa to nearest even
+    bits -= 112u << 23;
+    return uint16_t(sign | ((bits + 0x0fff + ((bits >> 13) & 1)) >> 13));
+}
+
+inline float HalfToFloat(uint16_t half)
+{
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+
+    if (exponent == 0)
+    {
+        const float value = std::ldexp(float(mantissa), -24);
+        return sign ? -value : value;
+    }
+
+    uint32_t bits;
+    if (exponent == 31)
+        bits = sign | 0x7f800000 | (mantissa << 13);
+    else
+        bits = sign | ((exponent + 112) << 23) | (mantissa << 13);
+
+    float value;
+    memcpy(&value, &bits, sizeof(value));
+    return value;
+}
@@ -0,0 +1,385 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "IesProfileAtlas.h"
+
+#include <donut/core/log.h>
+#include <donut/core/math/math.h>
+#include <donut/core/vfs/VFS.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+using namespace donut;
+using namespace donut::math;
+
+#include "../shaders/ShaderParameters.h"
+
+// Maximum texture height supported by all APIs
+static constexpr uint32_t c_MaxAtlasRows = 16384;
+
+bool ParseIesProfile(const char* text, size_t size, IesProfileData& outProfile)
+{
+    const char* end = text + size;
+
+    // Skip the keyword lines until the TILT line, which is the last line of the header
+    const char* position = text;
+    const char* tilt = nullptr;
+    while (position < end)
+    {
+        const char* lineEnd = std::find(position, end, '\n');
+        if (lineEnd - position >= 5 && strncmp(position, "TILT=", 5) == 0)
+        {
+            tilt = position + 5;
+            position = lineEnd;
+            break;
+        }
+        position = (lineEnd < end) ? lineEnd + 1 : end;
+    }
+
+    if (!tilt)
+        return false;
+
+    // The rest of the file is numbers, separated by whitespace or commas, and not necessarily one line per field
+    std::vector<float> numbers;
+    std::string token;
+    for (; position <= end; position++)
+    {
+        const char c = (position < end) ? *position : ' ';
+        if (c == ' ' || c == ',' || c == '\t' || c == '\r' || c == '\n')
+        {
+            if (!token.empty())
+            {
+                char* tokenEnd = nullptr;
+                numbers.push_back(strtof(token.c_str(), &tokenEnd));
+                if (*tokenEnd != 0)
+                    return false;
+                token.clear();
+            }
+        }
+        else
+            token.push_back(c);
+    }
+
+    size_t index = 0;
+    auto next = [&numbers, &index]() { return (index < numbers.size()) ? numbers[index++] : 0.f; };
+
+    // TILT=INCLUDE has the lamp-to-luminaire geometry and a table of multipliers, which are not used here
+    if (strncmp(tilt, "INCLUDE", 7) == 0)
+    {
+        next();
+        const size_t tiltAngleCount = size_t(next());
+        index += tiltAngleCount * 2;
+    }
+
+    next(); // number of lamps
+    next(); // lumens per lamp
+    const float candelaMultiplier = next();
+    const int verticalAngleCount = int(next());
+    const int horizontalAngleCount = int(next());
+    const int photometricType = int(next());
+    index += 7; // units, dimensions, ballast factor, future use, input watts
+
+    if (verticalAngleCount < 1 || horizontalAngleCount < 1 || verticalAngleCount > 10000 || horizontalAngleCount > 10000)
+        return false;
+
+    const size_t valueCount = size_t(verticalAngleCount) + size_t(horizontalAngleCount) * (1 + size_t(verticalAngleCount));
+    if (index + valueCount > numbers.size())
+        return false;
+
+    if (photometricType != 1)
+        log::warning("IES photometric type %d is not supported, the profile will be interpreted as type C", photometricType);
+
+    outProfile.verticalAngles.assign(numbers.begin() + index, numbers.begin() + index + verticalAngleCount);
+    index += verticalAngleCount;
+    outProfile.horizontalAngles.assign(numbers.begin() + index, numbers.begin() + index + horizontalAngleCount);
+    index += horizontalAngleCount;
+    outProfile.candela.assign(numbers.begin() + index, numbers.begin() + index + size_t(horizontalAngleCount) * verticalAngleCount);
+
+    for (float& value : outProfile.candela)
+        value = std::max(value * candelaMultiplier, 0.f);
+
+    return true;
+}
+
+// Finds the segment of a sorted list of angles that contains the angle, and the position within the segment.
+// Returns false if the angle is outside of the list.
+static bool FindAngleSegment(const std::vector<float>& angles, float angle, size_t& outIndex, float& outFraction)
+{
+    if (angles.size() == 1 || angle <= angles.front())
+    {
+        outIndex = 0;
+        outFraction = 0.f;
+        return angles.size() == 1 || angle >= angles.front() - 1e-3f;
+    }
+
+    if (angle >= angles.back())
+    {
+        outIndex = angles.size() - 1;
+        outFraction = 0.f;
+        return angle <= angles.back() + 1e-3f;
+    }
+
+    outIndex = size_t(std::upper_bound(angles.begin(), angles.end(), angle) - angles.begin()) - 1;
+    const float segmentLength = angles[outIndex + 1] - angles[outIndex];
+    outFraction = (segmentLength > 0.f) ? (angle - angles[outIndex]) / segmentLength : 0.f;
+    return true;
+}
+
+// Candela value in a direction, with the symmetries that the LM-63 format implies by the range of the horizontal angles.
+static float EvaluateProfile(const IesProfileData& profile, float verticalAngle, float horizontalAngle)
+{
+    const float lastHorizontalAngle = profile.horizontalAngles.back();
+
+    if (lastHorizontalAngle <= 90.f)
+    {
+        // Symmetric in each quadrant
+        if (horizontalAngle > 180.f)
+            horizontalAngle = 360.f - horizontalAngle;
+        if (horizontalAngle > 90.f)
+            horizontalAngle = 180.f - horizontalAngle;
+    }
+    else if (lastHorizontalAngle <= 180.f)
+    {
+        // Symmetric about the 0-180 degree plane
+        if (horizontalAngle > 180.f)
+            horizontalAngle = 360.f - horizontalAngle;
+    }
+
+    size_t verticalIndex;
+    float verticalFraction;
+    if (!FindAngleSegment(profile.verticalAngles, verticalAngle, verticalIndex, verticalFraction))
+        return 0.f;
+
+    const size_t verticalCount = profile.verticalAngles.size();
+    auto evaluateRow = [&](size_t horizontalIndex)
+    {
+        const float* row = profile.candela.data() + horizontalIndex * verticalCount;
+        const float value = row[verticalIndex];
+        return (verticalIndex + 1 < verticalCount) ? value + (row[verticalIndex + 1] - value) * verticalFraction : value;
+    };
+
+    size_t horizontalIndex;
+    float horizontalFraction;
+    if (!FindAngleSegment(profile.horizontalAngles, horizontalAngle, horizontalIndex, horizontalFraction))
+    {
+        // Between the last angle of a full profile and 360 degrees, wrap around to the first angle
+        const float gap = profile.horizontalAngles.front() + 360.f - lastHorizontalAngle;
+        const float fraction = (gap > 0.f) ? (horizontalAngle - lastHorizontalAngle) / gap : 0.f;
+        const float first = evaluateRow(profile.horizontalAngles.size() - 1);
+        return first + (evaluateRow(0) - first) * std::clamp(fraction, 0.f, 1.f);
+    }
+
+    const float value = evaluateRow(horizontalIndex);
+    if (horizontalIndex + 1 >= profile.horizontalAngles.size())
+        return value;
+
+    return value + (evaluateRow(horizontalIndex + 1) - value) * horizontalFraction;
+}
+
+// Reduces a profile that is the same at all horizontal angles to one horizontal angle, so that it only takes one row.
+// Normalizes the profile to the peak intensity, the light color and intensity give the absolute scale.
+static void SimplifyProfile(IesProfileData& profile)
+{
+    const size_t verticalCount = profile.verticalAngles.size();
+
+    bool axiallySymmetric = true;
+    for (size_t index = verticalCount; index < profile.candela.size() && axiallySymmetric; index++)
+        axiallySymmetric = profile.candela[index] == profile.candela[index % verticalCount];
+
+    if (axiallySymmetric)
+    {
+        profile.horizontalAngles = { 0.f };
+        profile.candela.resize(verticalCount);
+    }
+
+    const float maxCandela = *std::max_element(profile.candela.begin(), profile.candela.end());
+    const float scale = (maxCandela > 0.f) ? 1.f / maxCandela : 0.f;
+    for (float& value : profile.candela)
+        value *= scale;
+}
+
+static size_t HashProfile(const IesProfileData& profile)
+{
+    size_t hash = 0;
+    for (const std::vector<float>* values : { &profile.verticalAngles, &profile.horizontalAngles, &profile.candela })
+    {
+        nvrhi::hash_combine(hash, values->size());
+        for (float value : *values)
+            nvrhi::hash_combine(hash, value);
+    }
+    return hash;
+}
+
+static bool operator==(const IesProfileData& a, const IesProfileData& b)
+{
+    return a.verticalAngles == b.verticalAngles && a.horizontalAngles == b.horizontalAngles && a.candela == b.candela;
+}
+
+IesProfileAtlas::IesProfileAtlas(nvrhi::IDevice* device, std::shared_ptr<engine::DescriptorTableManager> descriptorTableManager)
+    : m_Device(device)
+    , m_DescriptorTableManager(std::move(descriptorTableManager))
+{
+}
+
+void IesProfileAtlas::LoadProfiles(vfs::IFileSystem& fs, const std::string& folder)
+{
+    std::vector<std::string> fileNames;
+    fs.enumerateFiles(folder, { ".ies" }, vfs::enumerate_to_vector(fileNames));
+    std::sort(fileNames.begin(), fileNames.end());
+
+    // Read and parse the files on worker threads, each taking the next file from the list
+    std::vector<IesProfileData> profiles(fileNames.size());
+    std::vector<char> loaded(fileNames.size(), 0);
+    std::atomic<size_t> nextFile = 0;
+
+    auto worker = [&]()
+    {
+        for (size_t fileIndex = nextFile++; fileIndex < fileNames.size(); fileIndex = nextFile++)
+        {
+            const std::string path = folder + "/" + fileNames[fileIndex];
+            std::shared_ptr<vfs::IBlob> blob = fs.readFile(path);
+
+            if (blob && ParseIesProfile(static_cast<const char*>(blob->data()), blob->size(), profiles[fileIndex]))
+                loaded[fileIndex] = 1;
+            else
+                log::warning("Couldn't load the IES profile '%s'", path.c_str());
+        }
+    };
+
+    const size_t threadCount = std::min(fileNames.size(), size_t(std::max(std::thread::hardware_concurrency(), 1u)));
+    std::vector<std::thread> threads;
+    for (size_t thread = 1; thread < threadCount; thread++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    // Files with the same photometric data share one band of the atlas, looked up by the hash of the data
+    std::unordered_multimap<size_t, int> bandsByHash;
+    uint32_t atlasRows = 0;
+
+    for (size_t fileIndex = 0; fileIndex < fileNames.size(); fileIndex++)
+    {
+        if (!loaded[fileIndex])
+            continue;
+
+        IesProfileData& data = profiles[fileIndex];
+        SimplifyProfile(data);
+
+        const size_t hash = HashProfile(data);
+        int bandIndex = -1;
+        for (auto [it, end] = bandsByHash.equal_range(hash); it != end; ++it)
+        {
+            if (m_Bands[it->second].data == data)
+            {
+                bandIndex = it->second;
+                break;
+            }
+        }
+
+        if (bandIndex < 0)
+        {
+            const uint32_t rowCount = (data.horizontalAngles.size() == 1) ? 1 : IES_PROFILE_ATLAS_ROWS;
+            if (atlasRows + rowCount > c_MaxAtlasRows)
+            {
+                log::warning("The IES profile atlas is full, '%s' is not loaded", fileNames[fileIndex].c_str());
+                continue;
+            }
+
+            Band band;
+            band.data = std::move(data);
+            band.firstRow = atlasRows;
+            band.rowCount = rowCount;
+            atlasRows += rowCount;
+
+            bandIndex = int(m_Bands.size());
+            bandsByHash.emplace(hash, bandIndex);
+            m_Bands.push_back(std::move(band));
+        }
+
+        m_ProfileIndices[fileNames[fileIndex]] = int(m_ProfileNames.size());
+        m_ProfileNames.push_back(fileNames[fileIndex]);
+        m_ProfileBands.push_back(bandIndex);
+    }
+
+    if (m_Bands.empty())
+        return;
+
+    log::debug("Loaded %d IES profiles into %d atlas rows", int(m_ProfileNames.size()), int(atlasRows));
+
+    nvrhi::TextureDesc textureDesc;
+    textureDesc.width = IES_PROFILE_ATLAS_WIDTH;
+    textureDesc.height = atlasRows;
+    textureDesc.format = nvrhi::Format::R32_FLOAT;
+    textureDesc.debugName = "IesProfileAtlas";
+    textureDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    textureDesc.keepInitialState = true;
+    m_Texture = m_Device->createTexture(textureDesc);
+
+    m_TextureDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, m_Texture));
+
+    m_Texels.resize(size_t(textureDesc.width) * textureDesc.height, 0.f);
+    m_UploadPending = true;
+}
+
+int IesProfileAtlas::FindProfile(const std::string& name) const
+{
+    auto it = m_ProfileIndices.find(name);
+    return (it != m_ProfileIndices.end()) ? it->second : -1;
+}
+
+int IesProfileAtlas::GetTextureIndex() const
+{
+    return m_TextureDescriptor.IsValid() ? m_TextureDescriptor.Get() : -1;
+}
+
+uint32_t IesProfileAtlas::UseProfile(int profileIndex)
+{
+    Band& band = m_Bands[m_ProfileBands[profileIndex]];
+
+    if (!band.baked)
+        BakeBand(band);
+
+    return band.firstRow | (band.rowCount << 16);
+}
+
+void IesProfileAtlas::BakeBand(Band& band)
+{
+    for (uint32_t row = 0; row < band.rowCount; row++)
+    {
+        // Texel centers, same as evaluateIesProfile: the rows map atan2 over [-pi, pi], the IES angles are in [0, 360)
+        float horizontalAngle = ((float(row) + 0.5f) / float(band.rowCount) - 0.5f) * 360.f;
+        if (horizontalAngle < 0.f)
+            horizontalAngle += 360.f;
+
+        float* texels = m_Texels.data() + size_t(band.firstRow + row) * IES_PROFILE_ATLAS_WIDTH;
+        for (uint32_t column = 0; column < IES_PROFILE_ATLAS_WIDTH; column++)
+        {
+            const float verticalAngle = (float(column) + 0.5f) / float(IES_PROFILE_ATLAS_WIDTH) * 180.f;
+            texels[column] = EvaluateProfile(band.data, verticalAngle, horizontalAngle);
+        }
+    }
+
+    band.baked = true;
+    m_UploadPending = true;
+}
+
+void IesProfileAtlas::Upload(nvrhi::ICommandList* commandList)
+{
+    if (!m_UploadPending || !m_Texture)
+        return;
+
+    commandList->writeTexture(m_Texture, 0, 0, m_Texels.data(), IES_PROFILE_ATLAS_WIDTH * sizeof(float));
+    m_UploadPending = false;
+}
@@ -0,0 +1,89 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <donut/engine/DescriptorTableManager.h>
+#include <nvrhi/nvrhi.h>
+
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace donut::vfs
+{
+    class IFileSystem;
+}
+
+// Photometric data of an IES (LM-63) file: the candela values for every horizontal angle, each over all the vertical angles.
+struct IesProfileData
+{
+    std::vector<float> verticalAngles; // degrees from the light axis
+    std::vector<float> horizontalAngles; // degrees around the light axis
+    std::vector<float> candela; // horizontalAngles.size() rows of verticalAngles.size() values
+};
+
+// Parses the text of an IES file. Returns false if it's not a valid file.
+bool ParseIesProfile(const char* text, size_t size, IesProfileData& outProfile);
+
+// Keeps the IES profiles in one texture instead of one bindless texture per profile. A profile takes a band of rows
+// in the atlas: the columns cover the angle from the light axis over [0, pi], and the rows cover the angle
+// around the axis over [-pi, pi], which is the parameterization that evaluateIesProfile in LightShaping.hlsli uses.
+// Axially symmetric profiles take a single row, and files with identical normalized data share one band.
+// The profiles are only baked into the atlas when a light starts using them.
+class IesProfileAtlas
+{
+public:
+    IesProfileAtlas(nvrhi::IDevice* device, std::shared_ptr<donut::engine::DescriptorTableManager> descriptorTableManager);
+
+    // Reads and parses all the .ies files in the folder on worker threads, and creates the atlas texture for them.
+    void LoadProfiles(donut::vfs::IFileSystem& fs, const std::string& folder);
+
+    [[nodiscard]] const std::vector<std::string>& GetProfileNames() const { return m_ProfileNames; }
+
+    // Returns -1 if there is no profile with that name.
+    [[nodiscard]] int FindProfile(const std::string& name) const;
+
+    // Bakes the profile into the atlas if it's not there yet, and returns its rows in the atlas
+    // packed like PolymorphicLightInfo::iesProfileRows.
+    uint32_t UseProfile(int profileIndex);
+
+    // Bindless descriptor index of the atlas, or -1 if there are no profiles.
+    [[nodiscard]] int GetTextureIndex() const;
+
+    // Uploads the atlas if any profiles have been baked since the last upload.
+    void Upload(nvrhi::ICommandList* commandList);
+
+private:
+    // Rows of the atlas that hold one distinct profile
+    struct Band
+    {
+        IesProfileData data; // normalized to the peak intensity
+        uint32_t firstRow = 0;
+        uint32_t rowCount = 0;
+        bool baked = false;
+    };
+
+    nvrhi::DeviceHandle m_Device;
+    std::shared_ptr<donut::engine::DescriptorTableManager> m_DescriptorTableManager;
+
+    std::vector<Band> m_Bands;
+    std::vector<std::string> m_ProfileNames;
+    std::vector<int> m_ProfileBands; // band index for every profile name
+    std::unordered_map<std::string, int> m_ProfileIndices;
+
+    nvrhi::TextureHandle m_Texture;
+    donut::engine::DescriptorHandle m_TextureDescriptor;
+    std::vector<float> m_Texels;
+    bool m_UploadPending = false;
+
+    void BakeBand(Band& band);
+};
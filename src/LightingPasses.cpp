@@ -23,6 +23,10 @@
 #include <nvrhi/utils.h>
 #include <rtxdi/ImportanceSamplingContext.h>
 
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <sstream>
 #include <utility>
 
 #if WITH_NRD
@@ -108,6 +112,8 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::Texture_SRV(10),
         nvrhi::BindingLayoutItem::Texture_SRV(11),
         nvrhi::BindingLayoutItem::Texture_SRV(12),
+        nvrhi::BindingLayoutItem::Texture_SRV(13),
+        nvrhi::BindingLayoutItem::TypedBuffer_SRV(15),
 
         nvrhi::BindingLayoutItem::RayTracingAccelStruct(30),
         nvrhi::BindingLayoutItem::RayTracingAccelStruct(31),
@@ -121,6 +127,7 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::Texture_SRV(23),
         nvrhi::BindingLayoutItem::Texture_SRV(24),
         nvrhi::BindingLayoutItem::StructuredBuffer_SRV(25),
+        nvrhi::BindingLayoutItem::StructuredBuffer_SRV(26),
 
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(0),
         nvrhi::BindingLayoutItem::Texture_UAV(1),
@@ -135,7 +142,7 @@ LightingPasses::LightingPasses(
         nvrhi::BindingLayoutItem::TypedBuffer_UAV(12),
         nvrhi::BindingLayoutItem::StructuredBuffer_UAV(13),
 
-        nvrhi::BindingLayoutItem::VolatileConstantBuffer(0),
+        nvrhi::BindingLayoutItem::ConstantBuffer(0),
         nvrhi::BindingLayoutItem::PushConstants(1, sizeof(PerPassConstants)),
         nvrhi::BindingLayoutItem::Sampler(0),
         nvrhi::BindingLayoutItem::Sampler(1),
@@ -143,7 +150,9 @@ LightingPasses::LightingPasses(
 
     m_BindingLayout = m_Device->createBindingLayout(globalBindingLayoutDesc);
 
-    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateVolatileConstantBufferDesc(sizeof(ResamplingConstants), "ResamplingConstants", 16));
+    // Not a volatile buffer: the constants are written once per frame on the light preparation command list,
+    // and the lighting command list that runs after it reads the same contents.
+    m_ConstantBuffer = m_Device->createBuffer(nvrhi::utils::CreateStaticConstantBufferDesc(sizeof(ResamplingConstants), "ResamplingConstants"));
 }
 
 void LightingPasses::CreateBindingSet(
@@ -174,6 +183,8 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::Texture_SRV(10, currentFrame ? renderTargets.PrevRestirLuminance : renderTargets.RestirLuminance),
             nvrhi::BindingSetItem::Texture_SRV(11, renderTargets.MotionVectors),
             nvrhi::BindingSetItem::Texture_SRV(12, renderTargets.NormalRoughness),
+            nvrhi::BindingSetItem::Texture_SRV(13, renderTargets.SampleBudget),
+            nvrhi::BindingSetItem::TypedBuffer_SRV(15, renderTargets.ValidTiles),
             
             nvrhi::BindingSetItem::RayTracingAccelStruct(30, currentFrame ? topLevelAS : prevTopLevelAS),
             nvrhi::BindingSetItem::RayTracingAccelStruct(31, currentFrame ? prevTopLevelAS : topLevelAS),
@@ -187,6 +198,7 @@ void LightingPasses::CreateBindingSet(
             nvrhi::BindingSetItem::Texture_SRV(23, resources.EnvironmentPdfTexture),
             nvrhi::BindingSetItem::Texture_SRV(24, resources.LocalLightPdfTexture),
             nvrhi::BindingSetItem::StructuredBuffer_SRV(25, resources.GeometryInstanceToLightBuffer),
+            nvrhi::BindingSetItem::StructuredBuffer_SRV(26, resources.EnvironmentAliasTableBuffer),
 
             nvrhi::BindingSetItem::StructuredBuffer_UAV(0, resources.LightReservoirBuffer),
             nvrhi::BindingSetItem::Texture_UAV(1, renderTargets.DiffuseLighting),
@@ -224,26 +236,33 @@ void LightingPasses::CreateBindingSet(
     m_LocalLightPdfTextureSize.y = localLightPdfDesc.height;
 
     m_LightReservoirBuffer = resources.LightReservoirBuffer;
+    m_TileDispatchArguments = renderTargets.TileDispatchArguments;
     m_SecondarySurfaceBuffer = resources.SecondaryGBuffer;
     m_GIReservoirBuffer = resources.GIReservoirBuffer;
+
+    m_LightDataBuffer = resources.LightDataBuffer;
+    m_NeighborOffsetsBuffer = resources.NeighborOffsetsBuffer;
+    m_RisBuffer = resources.RisBuffer;
+    m_RisLightDataBuffer = resources.RisLightDataBuffer;
+    m_EnvironmentAliasTableBuffer = resources.EnvironmentAliasTableBuffer;
+    m_EnvironmentPdfTexture = resources.EnvironmentPdfTexture;
+    m_LocalLightPdfTexture = resources.LocalLightPdfTexture;
 }
 
-void LightingPasses::CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros)
+std::string LightingPasses::GetPermutationKey(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery)
 {
-    donut::log::debug("Initializing ComputePass %s...", shaderName);
-
-    pass.Shader = m_ShaderFactory->CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
-
-    nvrhi::ComputePipelineDesc pipelineDesc;
-    pipelineDesc.bindingLayouts = { m_BindingLayout, m_BindlessLayout };
-    pipelineDesc.CS = pass.Shader;
-    pass.Pipeline = m_Device->createComputePipeline(pipelineDesc);
+    std::string key = shaderName;
+    for (const auto& macro : macros)
+        key += ";" + macro.name + "=" + macro.definition;
+    key += useRayQuery ? ";RayQuery" : ";RayTracingPipeline";
+    return key;
 }
 
 void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection)
 {
     commandList->beginMarker(passName);
-    m_Profiler->BeginSection(commandList, profilerSection);
+    if (!m_IsAdditionalView)
+        m_Profiler->BeginSection(commandList, profilerSection);
 
     nvrhi::ComputeState state;
     state.bindings = { m_BindingSet, m_Scene->GetDescriptorTable() };
@@ -256,21 +275,47 @@ void LightingPasses::ExecuteComputePass(nvrhi::ICommandList* commandList, Comput
 
     commandList->dispatch(dispatchSize.x, dispatchSize.y, 1);
 
-    m_Profiler->EndSection(commandList, profilerSection);
+    if (!m_IsAdditionalView)
+        m_Profiler->EndSection(commandList, profilerSection);
     commandList->endMarker();
 }
 
 void LightingPasses::ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet)
 {
     commandList->beginMarker(passName);
-    m_Profiler->BeginSection(commandList, profilerSection);
+    if (!m_IsAdditionalView)
+        m_Profiler->BeginSection(commandList, profilerSection);
 
     PerPassConstants pushConstants{};
     pushConstants.rayCountBufferIndex = enableRayCounts ? profilerSection : -1;
     
     pass.Execute(commandList, dispatchSize.x, dispatchSize.y, m_BindingSet, extraBindingSet, m_Scene->GetDescriptorTable(), &pushConstants, sizeof(pushConstants));
     
-    m_Profiler->EndSection(commandList, profilerSection);
+    if (!m_IsAdditionalView)
+        m_Profiler->EndSection(commandList, profilerSection);
+    commandList->endMarker();
+}
+
+void LightingPasses::ExecuteScreenSpacePass(nvrhi::ICommandList* commandList, RayTracingPass& pass, const RenderSettings& localSettings, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection)
+{
+    // The shaders only read the tile list in their compute versions, the ray tracing pipelines always cover the full grid
+    if (!localSettings.enableTileCompaction || !pass.ComputePipeline)
+    {
+        ExecuteRayTracingPass(commandList, pass, localSettings.enableRayCounts, passName, dispatchSize, profilerSection);
+        return;
+    }
+
+    commandList->beginMarker(passName);
+    if (!m_IsAdditionalView)
+        m_Profiler->BeginSection(commandList, profilerSection);
+
+    PerPassConstants pushConstants{};
+    pushConstants.rayCountBufferIndex = localSettings.enableRayCounts ? profilerSection : -1;
+
+    pass.ExecuteIndirect(commandList, m_TileDispatchArguments, m_BindingSet, nullptr, m_Scene->GetDescriptorTable(), &pushConstants, sizeof(pushConstants));
+
+    if (!m_IsAdditionalView)
+        m_Profiler->EndSection(commandList, profilerSection);
     commandList->endMarker();
 }
 
@@ -294,50 +339,290 @@ donut::engine::ShaderMacro LightingPasses::GetRegirMacro(const rtxdi::ReGIRStati
     return { "RTXDI_REGIR_MODE", regirMode };
 }
 
-void LightingPasses::createPresamplingPipelines()
+bool ParseLightingPipelinePermutations(const std::string& list, bool defaultUseRayQuery, std::vector<LightingPipelinePermutation>& outPermutations)
 {
-    CreateComputePass(m_PresampleLightsPass, "app/LightingPasses/PresampleLights.hlsl", {});
-    CreateComputePass(m_PresampleEnvironmentMapPass, "app/LightingPasses/PresampleEnvironmentMap.hlsl", {});
+    std::istringstream stream(list);
+    std::string item;
+
+    while (std::getline(stream, item, ','))
+    {
+        std::transform(item.begin(), item.end(), item.begin(), [](unsigned char c) { return std::toupper(c); });
+
+        const size_t separator = item.find(':');
+        const std::string modeName = item.substr(0, separator);
+        const std::string apiName = (separator != std::string::npos) ? item.substr(separator + 1) : std::string();
+
+        std::vector<rtxdi::ReGIRMode> modes;
+        if (modeName == "NONE")
+            modes = { rtxdi::ReGIRMode::Disabled };
+        else if (modeName == "GRID")
+            modes = { rtxdi::ReGIRMode::Grid };
+        else if (modeName == "ONION")
+            modes = { rtxdi::ReGIRMode::Onion };
+        else if (modeName == "ALL")
+            modes = { rtxdi::ReGIRMode::Disabled, rtxdi::ReGIRMode::Grid, rtxdi::ReGIRMode::Onion };
+
+        std::vector<bool> rayQueryValues;
+        if (apiName.empty())
+            rayQueryValues = { defaultUseRayQuery };
+        else if (apiName == "RQ")
+            rayQueryValues = { true };
+        else if (apiName == "RT")
+            rayQueryValues = { false };
+        else if (apiName == "ALL")
+            rayQueryValues = { true, false };
+
+        if (modes.empty() || rayQueryValues.empty())
+        {
+            donut::log::error("Unrecognized permutation '%s' in the pipeline prewarming list.", item.c_str());
+            return false;
+        }
+
+        for (rtxdi::ReGIRMode mode : modes)
+        {
+            for (bool useRayQuery : rayQueryValues)
+                outPermutations.push_back({ mode, useRayQuery });
+        }
+    }
+
+    return !outPermutations.empty();
 }
 
-void LightingPasses::createReGIRPipeline(const rtxdi::ReGIRStaticParameters& regirStaticParams, const std::vector<donut::engine::ShaderMacro>& regirMacros)
+struct LightingPasses::PipelineRequest
+{
+    const char* shaderName = nullptr;
+    std::vector<ShaderMacro> macros;
+    bool useRayQuery = false;
+    bool isCompute = false;
+
+    // The pass that receives the pipeline, null when prewarming
+    ComputePass* computePass = nullptr;
+    RayTracingPass* rayTracingPass = nullptr;
+
+    [[nodiscard]] std::string GetKey() const { return GetPermutationKey(shaderName, macros, isCompute || useRayQuery); }
+};
+
+void LightingPasses::GetPipelineRequests(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery, bool selectPipelines, std::vector<PipelineRequest>& requests)
 {
+    const std::vector<ShaderMacro> regirMacros = {
+        GetRegirMacro(regirStaticParams)
+    };
+
+    auto compute = [&](ComputePass& pass, const char* shaderName, const std::vector<ShaderMacro>& macros)
+    {
+        PipelineRequest& request = requests.emplace_back();
+        request.shaderName = shaderName;
+        request.macros = macros;
+        request.isCompute = true;
+        request.computePass = selectPipelines ? &pass : nullptr;
+    };
+
+    auto rayTracing = [&](RayTracingPass& pass, const char* shaderName, const std::vector<ShaderMacro>& macros)
+    {
+        PipelineRequest& request = requests.emplace_back();
+        request.shaderName = shaderName;
+        request.macros = macros;
+        request.useRayQuery = useRayQuery;
+        request.rayTracingPass = selectPipelines ? &pass : nullptr;
+    };
+
+    // Presampling
+    compute(m_PresampleLightsPass, "app/LightingPasses/PresampleLights.hlsl", {});
+    compute(m_PresampleEnvironmentMapPass, "app/LightingPasses/PresampleEnvironmentMap.hlsl", {});
+
+    // ReGIR
     if (regirStaticParams.Mode != rtxdi::ReGIRMode::Disabled)
     {
-        CreateComputePass(m_PresampleReGIR, "app/LightingPasses/PresampleReGIR.hlsl", regirMacros);
+        compute(m_PresampleReGIR, "app/LightingPasses/PresampleReGIR.hlsl", regirMacros);
     }
+
+    // ReSTIR DI
+    rayTracing(m_GenerateInitialSamplesPass, "app/LightingPasses/DIGenerateInitialSamples.hlsl", regirMacros);
+    rayTracing(m_TemporalResamplingPass, "app/LightingPasses/DITemporalResampling.hlsl", {});
+    rayTracing(m_SpatialResamplingPass, "app/LightingPasses/DISpatialResampling.hlsl", {});
+    rayTracing(m_ShadeSamplesPass, "app/LightingPasses/DIShadeSamples.hlsl", regirMacros);
+    rayTracing(m_BrdfRayTracingPass, "app/LightingPasses/BrdfRayTracing.hlsl", {});
+    rayTracing(m_ShadeSecondarySurfacesPass, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirMacros);
+    rayTracing(m_FusedResamplingPass, "app/LightingPasses/DIFusedResampling.hlsl", regirMacros);
+    rayTracing(m_GradientsPass, "app/LightingPasses/DIComputeGradients.hlsl", {});
+
+    // ReSTIR GI
+    rayTracing(m_GITemporalResamplingPass, "app/LightingPasses/GITemporalResampling.hlsl", {});
+    rayTracing(m_GISpatialResamplingPass, "app/LightingPasses/GISpatialResampling.hlsl", {});
+    rayTracing(m_GIFusedResamplingPass, "app/LightingPasses/GIFusedResampling.hlsl", {});
+    rayTracing(m_GIFinalShadingPass, "app/LightingPasses/GIFinalShading.hlsl", {});
 }
 
-void LightingPasses::createReSTIRDIPipelines(const std::vector<donut::engine::ShaderMacro>& regirMacros, bool useRayQuery)
+void LightingPasses::CreateRequestedPipelines(const std::vector<PipelineRequest>& requests, uint32_t threadCount)
 {
-    m_GenerateInitialSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIGenerateInitialSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_TemporalResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DITemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_SpatialResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DISpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_ShadeSamplesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIShadeSamples.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_BrdfRayTracingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/BrdfRayTracing.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_ShadeSecondarySurfacesPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/ShadeSecondarySurfaces.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_FusedResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIFusedResampling.hlsl", regirMacros, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GradientsPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/DIComputeGradients.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    // Collect the permutations that are not in the cache yet. Several requests may share one permutation,
+    // e.g. the passes without the ReGIR macro when prewarming all the ReGIR modes.
+    struct CreatedPipeline
+    {
+        const PipelineRequest* request = nullptr;
+        std::string key;
+        ComputePass computePass;
+        RayTracingPass rayTracingPass;
+        bool succeeded = false;
+    };
+
+    std::vector<CreatedPipeline> createdPipelines;
+    for (const PipelineRequest& request : requests)
+    {
+        std::string key = request.GetKey();
+
+        const bool cached = request.isCompute
+            ? m_ComputePassCache.find(key) != m_ComputePassCache.end()
+            : m_RayTracingPassCache.find(key) != m_RayTracingPassCache.end();
+
+        const bool queued = std::any_of(createdPipelines.begin(), createdPipelines.end(),
+            [&key](const CreatedPipeline& pipeline) { return pipeline.key == key; });
+
+        if (!cached && !queued)
+        {
+            CreatedPipeline& pipeline = createdPipelines.emplace_back();
+            pipeline.request = &request;
+            pipeline.key = std::move(key);
+        }
+    }
+
+    // Every job only writes its own CreatedPipeline and the caches are updated after all of them are done,
+    // so the create steps need no lock
+    std::vector<PipelineCreationJob> jobs;
+    for (CreatedPipeline& pipeline : createdPipelines)
+    {
+        PipelineCreationJob& job = jobs.emplace_back();
+        job.name = pipeline.key;
+
+        job.load = [this, &pipeline]()
+        {
+            const PipelineRequest& request = *pipeline.request;
+
+            if (request.isCompute)
+            {
+                donut::log::debug("Initializing ComputePass %s...", request.shaderName);
+
+                pipeline.computePass.Shader = m_ShaderFactory->CreateShader(request.shaderName, "main", &request.macros, nvrhi::ShaderType::Compute);
+            }
+            else
+            {
+                donut::log::debug("Initializing RayTracingPass %s...", request.shaderName);
+
+                pipeline.rayTracingPass.LoadShaders(*m_ShaderFactory, request.shaderName, request.macros, request.useRayQuery);
+            }
+        };
+
+        job.create = [this, &pipeline]()
+        {
+            if (pipeline.request->isCompute)
+            {
+                if (!pipeline.computePass.Shader)
+                    return;
+
+                nvrhi::ComputePipelineDesc pipelineDesc;
+                pipelineDesc.bindingLayouts = { m_BindingLayout, m_BindlessLayout };
+                pipelineDesc.CS = pipeline.computePass.Shader;
+                pipeline.computePass.Pipeline = m_Device->createComputePipeline(pipelineDesc);
+                pipeline.succeeded = pipeline.computePass.Pipeline != nullptr;
+            }
+            else
+            {
+                pipeline.succeeded = pipeline.rayTracingPass.CreatePipeline(m_Device, RTXDI_SCREEN_SPACE_GROUP_SIZE,
+                    m_BindingLayout, nullptr, m_BindlessLayout);
+            }
+        };
+    }
+
+    RunPipelineCreationJobs(jobs, threadCount, m_PipelineCreationTimes);
+
+    for (CreatedPipeline& pipeline : createdPipelines)
+    {
+        if (!pipeline.succeeded)
+            continue;
+
+        if (pipeline.request->isCompute)
+            m_ComputePassCache[pipeline.key] = pipeline.computePass;
+        else
+            m_RayTracingPassCache[pipeline.key] = pipeline.rayTracingPass;
+    }
+
+    // A pass whose pipeline failed to compile is left empty
+    for (const PipelineRequest& request : requests)
+    {
+        if (request.computePass)
+        {
+            auto cached = m_ComputePassCache.find(request.GetKey());
+            *request.computePass = (cached != m_ComputePassCache.end()) ? cached->second : ComputePass();
+        }
+        else if (request.rayTracingPass)
+        {
+            auto cached = m_RayTracingPassCache.find(request.GetKey());
+            *request.rayTracingPass = (cached != m_RayTracingPassCache.end()) ? cached->second : RayTracingPass();
+        }
+    }
 }
 
-void LightingPasses::createReSTIRGIPipelines(bool useRayQuery)
+void LightingPasses::CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery, uint32_t threadCount)
 {
-    m_GITemporalResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GITemporalResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GISpatialResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GISpatialResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GIFusedResamplingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GIFusedResampling.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
-    m_GIFinalShadingPass.Init(m_Device, *m_ShaderFactory, "app/LightingPasses/GIFinalShading.hlsl", {}, useRayQuery, RTXDI_SCREEN_SPACE_GROUP_SIZE, m_BindingLayout, nullptr, m_BindlessLayout);
+    const std::string permutation = GetPermutationKey("", { GetRegirMacro(regirStaticParams) }, useRayQuery);
+    if (m_CurrentPermutation == permutation)
+        return;
+
+    m_CurrentPermutation = permutation;
+
+    std::vector<PipelineRequest> requests;
+    GetPipelineRequests(regirStaticParams, useRayQuery, true, requests);
+    CreateRequestedPipelines(requests, threadCount);
 }
 
-void LightingPasses::CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery)
+void LightingPasses::PrewarmPipelines(const std::vector<LightingPipelinePermutation>& permutations, uint32_t threadCount)
 {
-    std::vector<donut::engine::ShaderMacro> regirMacros = {
-        GetRegirMacro(regirStaticParams)
-    };
+    // All the permutations go into one batch to keep the worker threads busy
+    std::vector<PipelineRequest> requests;
+    for (const LightingPipelinePermutation& permutation : permutations)
+    {
+        rtxdi::ReGIRStaticParameters regirStaticParams;
+        regirStaticParams.Mode = permutation.regirMode;
+        GetPipelineRequests(regirStaticParams, permutation.useRayQuery, false, requests);
+    }
 
-    createPresamplingPipelines();
-    createReGIRPipeline(regirStaticParams, regirMacros);
-    createReSTIRDIPipelines(regirMacros, useRayQuery);
-    createReSTIRGIPipelines(useRayQuery);
+    CreateRequestedPipelines(requests, threadCount);
+}
+
+void LightingPasses::ClearPipelineCache()
+{
+    m_ComputePassCache.clear();
+    m_RayTracingPassCache.clear();
+    m_CurrentPermutation.reset();
+    m_PipelineCreationTimes.clear();
+}
+
+void LightingPasses::SharePipelines(const LightingPasses& mainPasses)
+{
+    assert(mainPasses.m_CurrentPermutation.has_value());
+
+    m_IsAdditionalView = true;
+    m_BindingLayout = mainPasses.m_BindingLayout;
+
+    if (m_CurrentPermutation == mainPasses.m_CurrentPermutation)
+        return;
+
+    m_CurrentPermutation = mainPasses.m_CurrentPermutation;
+    m_PresampleLightsPass = mainPasses.m_PresampleLightsPass;
+    m_PresampleEnvironmentMapPass = mainPasses.m_PresampleEnvironmentMapPass;
+    m_PresampleReGIR = mainPasses.m_PresampleReGIR;
+    m_GenerateInitialSamplesPass = mainPasses.m_GenerateInitialSamplesPass;
+    m_TemporalResamplingPass = mainPasses.m_TemporalResamplingPass;
+    m_SpatialResamplingPass = mainPasses.m_SpatialResamplingPass;
+    m_ShadeSamplesPass = mainPasses.m_ShadeSamplesPass;
+    m_BrdfRayTracingPass = mainPasses.m_BrdfRayTracingPass;
+    m_ShadeSecondarySurfacesPass = mainPasses.m_ShadeSecondarySurfacesPass;
+    m_FusedResamplingPass = mainPasses.m_FusedResamplingPass;
+    m_GradientsPass = mainPasses.m_GradientsPass;
+    m_GITemporalResamplingPass = mainPasses.m_GITemporalResamplingPass;
+    m_GISpatialResamplingPass = mainPasses.m_GISpatialResamplingPass;
+    m_GIFusedResamplingPass = mainPasses.m_GIFusedResamplingPass;
+    m_GIFinalShadingPass = mainPasses.m_GIFinalShadingPass;
 }
 
 #if WITH_NRD
@@ -431,15 +716,28 @@ void FillBRDFPTConstants(BRDFPathTracing_Parameters& constants, const GBufferSet
 void LightingPasses::FillResamplingConstants(
     ResamplingConstants& constants,
     const RenderSettings& lightingSettings,
+    const GBufferSettings& gbufferSettings,
+    const EnvironmentLight& environmentLight,
     const rtxdi::ImportanceSamplingContext& isContext)
 {
     const RTXDI_LightBufferParameters& lightBufferParameters = isContext.getLightBufferParameters();
 
     constants.enablePreviousTLAS = lightingSettings.enablePreviousTLAS;
     constants.denoiserMode = lightingSettings.denoiserMode;
+    constants.enableBrdfIndirect = lightingSettings.enableBrdfIndirect;
+    constants.enableBrdfAdditiveBlend = lightingSettings.enableBrdfAdditiveBlend;
     constants.sceneConstants.enableAlphaTestedGeometry = lightingSettings.enableAlphaTestedGeometry;
     constants.sceneConstants.enableTransparentGeometry = lightingSettings.enableTransparentGeometry;
+    constants.sceneConstants.enableEnvironmentMap = (environmentLight.textureIndex >= 0);
+    constants.sceneConstants.environmentMapTextureIndex = (environmentLight.textureIndex >= 0) ? environmentLight.textureIndex : 0;
+    constants.sceneConstants.environmentScale = environmentLight.radianceScale.x;
+    // The DI passes read the rotation too, in RAB_GetEnvironmentMapRandXYFromDir. They used to see zero here,
+    // which sampled the environment PDF at the unrotated directions when the map was rotated.
+    constants.sceneConstants.environmentRotation = environmentLight.rotation;
     constants.visualizeRegirCells = lightingSettings.visualizeRegirCells;
+    constants.enableAdaptiveSampleBudget = lightingSettings.enableAdaptiveSampleBudget;
+    constants.minSampleBudgetScale = lightingSettings.minSampleBudgetScale;
+    constants.enableTileCompaction = lightingSettings.enableTileCompaction;
 #if WITH_NRD
     if (lightingSettings.denoiserMode != DENOISER_MODE_OFF)
     {
@@ -455,37 +753,92 @@ void LightingPasses::FillResamplingConstants(
     FillReSTIRDIConstants(constants.restirDI, isContext.getReSTIRDIContext(), isContext.getLightBufferParameters());
     FillReGIRConstants(constants.regir, isContext.getReGIRContext());
     FillReSTIRGIConstants(constants.restirGI, isContext.getReSTIRGIContext());
+    FillBRDFPTConstants(constants.brdfPT, gbufferSettings, lightingSettings, lightBufferParameters);
 
     constants.localLightPdfTextureSize = m_LocalLightPdfTextureSize;
 
     if (lightBufferParameters.environmentLightParams.lightPresent)
     {
         constants.environmentPdfTextureSize = m_EnvironmentPdfTextureSize;
+
+        if (lightingSettings.environmentAliasTableInvTotalWeight > 0.f)
+        {
+            constants.useEnvironmentAliasTable = true;
+            constants.environmentAliasTableInvTotalWeight = lightingSettings.environmentAliasTableInvTotalWeight;
+        }
     }
 
     m_CurrentFrameOutputReservoir = isContext.getReSTIRDIContext().getBufferIndices().shadingInputBufferIndex;
+    m_CurrentFrameGIOutputReservoir = isContext.getReSTIRGIContext().getBufferIndices().finalShadingInputBufferIndex;
 }
 
-void LightingPasses::PrepareForLightSampling(
+void LightingPasses::WriteResamplingConstants(
     nvrhi::ICommandList* commandList,
     rtxdi::ImportanceSamplingContext& isContext,
     const donut::engine::IView& view,
     const donut::engine::IView& previousView,
     const RenderSettings& localSettings,
+    const GBufferSettings& gbufferSettings,
+    const EnvironmentLight& environmentLight,
     bool enableAccumulation)
 {
-    rtxdi::ReSTIRDIContext& restirDIContext = isContext.getReSTIRDIContext();
-    rtxdi::ReGIRContext& regirContext = isContext.getReGIRContext();
+    const auto startTime = std::chrono::steady_clock::now();
 
     ResamplingConstants constants = {};
-    constants.frameIndex = restirDIContext.getFrameIndex();
+    constants.frameIndex = isContext.getReSTIRDIContext().getFrameIndex();
     view.FillPlanarViewConstants(constants.view);
     previousView.FillPlanarViewConstants(constants.prevView);
-    FillResamplingConstants(constants, localSettings, isContext);
+    FillResamplingConstants(constants, localSettings, gbufferSettings, environmentLight, isContext);
     constants.enableAccumulation = enableAccumulation;
 
     commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
 
+    m_Profiler->AddConstantUpload(sizeof(constants),
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+}
+
+void LightingPasses::PrepareForLightSampling(
+    nvrhi::ICommandList* commandList,
+    rtxdi::ImportanceSamplingContext& isContext,
+    const donut::engine::IView& view,
+    const donut::engine::IView& previousView,
+    const RenderSettings& localSettings,
+    const GBufferSettings& gbufferSettings,
+    const EnvironmentLight& environmentLight,
+    bool enableAccumulation)
+{
+    rtxdi::ReGIRContext& regirContext = isContext.getReGIRContext();
+
+    WriteResamplingConstants(commandList, isContext, view, previousView, localSettings, gbufferSettings, environmentLight, enableAccumulation);
+
+    // The binding set also has the G-buffer and the lighting outputs, which the graphics queue uses at the same time
+    // when this runs on the compute queue. Only transition the resources that the presampling passes use,
+    // and put UAV barriers between the passes manually.
+    const bool asyncCompute = commandList->getDesc().queueType == nvrhi::CommandQueue::Compute;
+    if (asyncCompute)
+    {
+        commandList->setEnableAutomaticBarriers(false);
+        commandList->setBufferState(m_ConstantBuffer, nvrhi::ResourceStates::ConstantBuffer);
+        commandList->setBufferState(m_LightDataBuffer, nvrhi::ResourceStates::ShaderResource);
+        commandList->setBufferState(m_NeighborOffsetsBuffer, nvrhi::ResourceStates::ShaderResource);
+        commandList->setBufferState(m_EnvironmentAliasTableBuffer, nvrhi::ResourceStates::ShaderResource);
+        commandList->setTextureState(m_EnvironmentPdfTexture, nvrhi::AllSubresources, nvrhi::ResourceStates::ShaderResource);
+        commandList->setTextureState(m_LocalLightPdfTexture, nvrhi::AllSubresources, nvrhi::ResourceStates::ShaderResource);
+        commandList->setBufferState(m_RisBuffer, nvrhi::ResourceStates::UnorderedAccess);
+        commandList->setBufferState(m_RisLightDataBuffer, nvrhi::ResourceStates::UnorderedAccess);
+        commandList->commitBarriers();
+    }
+
+    auto presamplingUavBarrier = [this, commandList, asyncCompute]()
+    {
+        if (!asyncCompute)
+            return;
+
+        nvrhi::utils::BufferUavBarrier(commandList, m_RisBuffer);
+        nvrhi::utils::BufferUavBarrier(commandList, m_RisLightDataBuffer);
+        commandList->commitBarriers();
+    };
+
     auto& lightBufferParams = isContext.getLightBufferParameters();
 
     if (isContext.isLocalLightPowerRISEnabled() &&
@@ -497,6 +850,7 @@ void LightingPasses::PrepareForLightSampling(
         };
 
         ExecuteComputePass(commandList, m_PresampleLightsPass, "PresampleLights", presampleDispatchSize, ProfilerSection::PresampleLights);
+        presamplingUavBarrier();
     }
 
     if (lightBufferParams.environmentLightParams.lightPresent)
@@ -507,6 +861,7 @@ void LightingPasses::PrepareForLightSampling(
         };
 
         ExecuteComputePass(commandList, m_PresampleEnvironmentMapPass, "PresampleEnvironmentMap", presampleDispatchSize, ProfilerSection::PresampleEnvMap);
+        presamplingUavBarrier();
     }
 
     if (isContext.isReGIREnabled() &&
@@ -519,6 +874,9 @@ void LightingPasses::PrepareForLightSampling(
 
         ExecuteComputePass(commandList, m_PresampleReGIR, "PresampleReGIR", worldGridDispatchSize, ProfilerSection::PresampleReGIR);
     }
+
+    if (asyncCompute)
+        commandList->setEnableAutomaticBarriers(true);
 }
 
 void LightingPasses::RenderDirectLighting(
@@ -532,8 +890,8 @@ void LightingPasses::RenderDirectLighting(
         view.GetViewExtent().height()
     };
 
-    if (context.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
-        dispatchSize.x /= 2;
+    dispatchSize.x = GetReservoirSpaceWidth(dispatchSize.x,
+        context.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off);
 
     // Run the lighting passes in the necessary sequence: one fused kernel or multiple separate passes.
     //
@@ -545,105 +903,94 @@ void LightingPasses::RenderDirectLighting(
     {
         nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
 
-        ExecuteRayTracingPass(commandList, m_FusedResamplingPass, localSettings.enableRayCounts, "DIFusedResampling", dispatchSize, ProfilerSection::Shading);
+        ExecuteScreenSpacePass(commandList, m_FusedResamplingPass, localSettings, "DIFusedResampling", dispatchSize, ProfilerSection::Shading);
     }
     else
     {
-        ExecuteRayTracingPass(commandList, m_GenerateInitialSamplesPass, localSettings.enableRayCounts, "DIGenerateInitialSamples", dispatchSize, ProfilerSection::InitialSamples);
+        ExecuteScreenSpacePass(commandList, m_GenerateInitialSamplesPass, localSettings, "DIGenerateInitialSamples", dispatchSize, ProfilerSection::InitialSamples);
 
         if (context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::Temporal || context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial)
         {
             nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
 
-            ExecuteRayTracingPass(commandList, m_TemporalResamplingPass, localSettings.enableRayCounts, "DITemporalResampling", dispatchSize, ProfilerSection::TemporalResampling);
+            ExecuteScreenSpacePass(commandList, m_TemporalResamplingPass, localSettings, "DITemporalResampling", dispatchSize, ProfilerSection::TemporalResampling);
         }
 
         if (context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::Spatial || context.getResamplingMode() == rtxdi::ReSTIRDI_ResamplingMode::TemporalAndSpatial)
         {
             nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
 
-            ExecuteRayTracingPass(commandList, m_SpatialResamplingPass, localSettings.enableRayCounts, "DISpatialResampling", dispatchSize, ProfilerSection::SpatialResampling);
+            ExecuteScreenSpacePass(commandList, m_SpatialResamplingPass, localSettings, "DISpatialResampling", dispatchSize, ProfilerSection::SpatialResampling);
         }
 
         nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
 
-        ExecuteRayTracingPass(commandList, m_ShadeSamplesPass, localSettings.enableRayCounts, "DIShadeSamples", dispatchSize, ProfilerSection::Shading);
+        ExecuteScreenSpacePass(commandList, m_ShadeSamplesPass, localSettings, "DIShadeSamples", dispatchSize, ProfilerSection::Shading);
     }
-    
-    if (localSettings.enableGradients)
-    {
-        nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
+}
 
-        ExecuteRayTracingPass(commandList, m_GradientsPass, localSettings.enableRayCounts, "DIGradients", (dispatchSize + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR, ProfilerSection::Gradients);
-    }
+void LightingPasses::RenderGradients(
+    nvrhi::ICommandList* commandList,
+    rtxdi::ReSTIRDIContext& context,
+    const donut::engine::IView& view,
+    const RenderSettings& localSettings)
+{
+    dm::int2 dispatchSize = {
+        view.GetViewExtent().width(),
+        view.GetViewExtent().height()
+    };
+
+    dispatchSize.x = GetReservoirSpaceWidth(dispatchSize.x,
+        context.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off);
+
+    nvrhi::utils::BufferUavBarrier(commandList, m_LightReservoirBuffer);
+
+    // Not timed with ExecuteRayTracingPass: the section is open already, but the rays are still counted in it
+    commandList->beginMarker("DIGradients");
+
+    PerPassConstants pushConstants{};
+    pushConstants.rayCountBufferIndex = localSettings.enableRayCounts ? ProfilerSection::Gradients : -1;
+
+    dispatchSize = (dispatchSize + RTXDI_GRAD_FACTOR - 1) / RTXDI_GRAD_FACTOR;
+    m_GradientsPass.Execute(commandList, dispatchSize.x, dispatchSize.y, m_BindingSet, nullptr, m_Scene->GetDescriptorTable(), &pushConstants, sizeof(pushConstants));
+
+    commandList->endMarker();
 }
 
 void LightingPasses::RenderBrdfRays(
     nvrhi::ICommandList* commandList, 
     rtxdi::ImportanceSamplingContext& isContext,
     const donut::engine::IView& view,
-    const donut::engine::IView& previousView,
-    const RenderSettings& localSettings,
-    const GBufferSettings& gbufferSettings,
-    const EnvironmentLight& environmentLight,
-    bool enableIndirect,
-    bool enableAdditiveBlend,
-    bool enableEmissiveSurfaces,
-    bool enableAccumulation,
-    bool enableReSTIRGI
-    )
+    const RenderSettings& localSettings)
 {
-    ResamplingConstants constants = {};
-    view.FillPlanarViewConstants(constants.view);
-    previousView.FillPlanarViewConstants(constants.prevView);
-
     rtxdi::ReSTIRDIContext& restirDIContext = isContext.getReSTIRDIContext();
     rtxdi::ReSTIRGIContext& restirGIContext = isContext.getReSTIRGIContext();
 
-    constants.frameIndex = restirDIContext.getFrameIndex();
-    constants.denoiserMode = localSettings.denoiserMode;
-    constants.enableBrdfIndirect = enableIndirect;
-    constants.enableBrdfAdditiveBlend = enableAdditiveBlend;
-    constants.enableAccumulation = enableAccumulation;
-    constants.sceneConstants.enableEnvironmentMap = (environmentLight.textureIndex >= 0);
-    constants.sceneConstants.environmentMapTextureIndex = (environmentLight.textureIndex >= 0) ? environmentLight.textureIndex : 0;
-    constants.sceneConstants.environmentScale = environmentLight.radianceScale.x;
-    constants.sceneConstants.environmentRotation = environmentLight.rotation;
-    FillResamplingConstants(constants, localSettings, isContext);
-    FillBRDFPTConstants(constants.brdfPT, gbufferSettings, localSettings, isContext.getLightBufferParameters());
-    constants.brdfPT.enableIndirectEmissiveSurfaces = enableEmissiveSurfaces;
-    constants.brdfPT.enableReSTIRGI = enableReSTIRGI;
-
-    ReSTIRGI_BufferIndices restirGIBufferIndices = restirGIContext.getBufferIndices();
-    m_CurrentFrameGIOutputReservoir = restirGIBufferIndices.finalShadingInputBufferIndex;
-
-    commandList->writeBuffer(m_ConstantBuffer, &constants, sizeof(constants));
-
     dm::int2 dispatchSize = {
         view.GetViewExtent().width(),
         view.GetViewExtent().height()
     };
 
-    if (restirDIContext.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off)
-        dispatchSize.x /= 2;
+    dispatchSize.x = GetReservoirSpaceWidth(dispatchSize.x,
+        restirDIContext.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off);
 
-    ExecuteRayTracingPass(commandList, m_BrdfRayTracingPass, localSettings.enableRayCounts, "BrdfRayTracingPass", dispatchSize, ProfilerSection::BrdfRays);
+    ExecuteScreenSpacePass(commandList, m_BrdfRayTracingPass, localSettings, "BrdfRayTracingPass", dispatchSize, ProfilerSection::BrdfRays);
 
-    if (enableIndirect)
+    if (localSettings.enableBrdfIndirect)
     {
         // Place an explicit UAV barrier between the passes. See the note on barriers in RenderDirectLighting(...)
         nvrhi::utils::BufferUavBarrier(commandList, m_SecondarySurfaceBuffer);
 
-        ExecuteRayTracingPass(commandList, m_ShadeSecondarySurfacesPass, localSettings.enableRayCounts, "ShadeSecondarySurfaces", dispatchSize, ProfilerSection::ShadeSecondary, nullptr);
+        ExecuteScreenSpacePass(commandList, m_ShadeSecondarySurfacesPass, localSettings, "ShadeSecondarySurfaces", dispatchSize, ProfilerSection::ShadeSecondary);
         
-        if (enableReSTIRGI)
+        if (localSettings.brdfptParams.enableReSTIRGI)
         {
             rtxdi::ReSTIRGI_ResamplingMode resamplingMode = restirGIContext.getResamplingMode();
             if (resamplingMode == rtxdi::ReSTIRGI_ResamplingMode::FusedSpatiotemporal)
             {
                 nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
 
-                ExecuteRayTracingPass(commandList, m_GIFusedResamplingPass, localSettings.enableRayCounts, "GIFusedResampling", dispatchSize, ProfilerSection::GIFusedResampling, nullptr);
+                ExecuteScreenSpacePass(commandList, m_GIFusedResamplingPass, localSettings, "GIFusedResampling", dispatchSize, ProfilerSection::GIFusedResampling);
             }
             else
             {
@@ -652,7 +999,7 @@ void LightingPasses::RenderBrdfRays(
                 {
                     nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
 
-                    ExecuteRayTracingPass(commandList, m_GITemporalResamplingPass, localSettings.enableRayCounts, "GITemporalResampling", dispatchSize, ProfilerSection::GITemporalResampling, nullptr);
+                    ExecuteScreenSpacePass(commandList, m_GITemporalResamplingPass, localSettings, "GITemporalResampling", dispatchSize, ProfilerSection::GITemporalResampling);
                 }
 
                 if (resamplingMode == rtxdi::ReSTIRGI_ResamplingMode::Spatial ||
@@ -660,13 +1007,13 @@ void LightingPasses::RenderBrdfRays(
                 {
                     nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
 
-                    ExecuteRayTracingPass(commandList, m_GISpatialResamplingPass, localSettings.enableRayCounts, "GISpatialResampling", dispatchSize, ProfilerSection::GISpatialResampling, nullptr);
+                    ExecuteScreenSpacePass(commandList, m_GISpatialResamplingPass, localSettings, "GISpatialResampling", dispatchSize, ProfilerSection::GISpatialResampling);
                 }
             }
 
             nvrhi::utils::BufferUavBarrier(commandList, m_GIReservoirBuffer);
 
-            ExecuteRayTracingPass(commandList, m_GIFinalShadingPass, localSettings.enableRayCounts, "GIFinalShading", dispatchSize, ProfilerSection::GIFinalShading, nullptr);
+            ExecuteScreenSpacePass(commandList, m_GIFinalShadingPass, localSettings, "GIFinalShading", dispatchSize, ProfilerSection::GIFinalShading);
         }
     }
 }
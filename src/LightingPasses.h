@@ -12,11 +12,16 @@
 
 #include "RayTracingPass.h"
 #include "ProfilerSections.h"
+#include "PipelineCreation.h"
 
 #include <donut/core/math/math.h>
 #include <nvrhi/nvrhi.h>
 #include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
 
+#include <rtxdi/ReGIRParameters.h>
 #include <rtxdi/ReSTIRDIParameters.h>
 #include <rtxdi/ReSTIRGIParameters.h>
 #include "../shaders/BRDFPTParameters.h"
@@ -56,6 +61,17 @@ BRDFPathTracing_MaterialOverrideParameters getDefaultBRDFPathTracingMaterialOver
 BRDFPathTracing_SecondarySurfaceReSTIRDIParameters getDefaultBRDFPathTracingSecondarySurfaceReSTIRDIParams();
 BRDFPathTracing_Parameters getDefaultBRDFPathTracingParams();
 
+// One combination of the settings that select the lighting pipelines, see LightingPasses::PrewarmPipelines.
+struct LightingPipelinePermutation
+{
+    rtxdi::ReGIRMode regirMode = rtxdi::ReGIRMode::Disabled;
+    bool useRayQuery = false;
+};
+
+// Parses a comma-separated list of permutations, e.g. "grid:rq,onion:rt". The ReGIR mode is NONE, GRID, ONION or ALL,
+// and the optional suffix is RQ for ray queries, RT for ray tracing pipelines or ALL; without it, 'defaultUseRayQuery' is used.
+bool ParseLightingPipelinePermutations(const std::string& list, bool defaultUseRayQuery, std::vector<LightingPipelinePermutation>& outPermutations);
+
 class LightingPasses
 {
 private:
@@ -87,9 +103,19 @@ private:
     nvrhi::BindingSetHandle m_PrevBindingSet;
     nvrhi::BufferHandle m_ConstantBuffer;
     nvrhi::BufferHandle m_LightReservoirBuffer;
+    nvrhi::BufferHandle m_TileDispatchArguments;
     nvrhi::BufferHandle m_SecondarySurfaceBuffer;
     nvrhi::BufferHandle m_GIReservoirBuffer;
 
+    // Resources that the presampling passes use, see PrepareForLightSampling
+    nvrhi::BufferHandle m_LightDataBuffer;
+    nvrhi::BufferHandle m_NeighborOffsetsBuffer;
+    nvrhi::BufferHandle m_RisBuffer;
+    nvrhi::BufferHandle m_RisLightDataBuffer;
+    nvrhi::BufferHandle m_EnvironmentAliasTableBuffer;
+    nvrhi::TextureHandle m_EnvironmentPdfTexture;
+    nvrhi::TextureHandle m_LocalLightPdfTexture;
+
     dm::uint2 m_EnvironmentPdfTextureSize;
     dm::uint2 m_LocalLightPdfTextureSize;
 
@@ -102,7 +128,26 @@ private:
     std::shared_ptr<donut::engine::Scene> m_Scene;
     std::shared_ptr<Profiler> m_Profiler;
 
-    void CreateComputePass(ComputePass& pass, const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros);
+    // Every pipeline permutation that has been created, keyed by the shader name, the macros and the ray query flag.
+    // Switching the permutations back and forth or recreating the resources doesn't create the pipelines again.
+    std::unordered_map<std::string, ComputePass> m_ComputePassCache;
+    std::unordered_map<std::string, RayTracingPass> m_RayTracingPassCache;
+
+    // Permutation of the current pipelines, to skip CreatePipelines when nothing changes
+    std::optional<std::string> m_CurrentPermutation;
+
+    // Time spent creating each of the cached pipelines
+    std::vector<PipelineCreationTime> m_PipelineCreationTimes;
+
+    // Set by SharePipelines: the passes of the additional views are not timed individually
+    bool m_IsAdditionalView = false;
+
+    // One pass of a permutation, see GetPipelineRequests
+    struct PipelineRequest;
+
+    static std::string GetPermutationKey(const char* shaderName, const std::vector<donut::engine::ShaderMacro>& macros, bool useRayQuery);
+    void GetPipelineRequests(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery, bool selectPipelines, std::vector<PipelineRequest>& requests);
+    void CreateRequestedPipelines(const std::vector<PipelineRequest>& requests, uint32_t threadCount);
     void ExecuteComputePass(nvrhi::ICommandList* commandList, ComputePass& pass, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection);
     void ExecuteRayTracingPass(nvrhi::ICommandList* commandList, RayTracingPass& pass, bool enableRayCounts, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection, nvrhi::IBindingSet* extraBindingSet = nullptr);
 
@@ -122,6 +167,26 @@ public:
         float gradientLogDarknessBias = -12.f;
         float gradientSensitivity = 8.f;
         float confidenceHistoryLength = 0.75f;
+        ibool enableFusedGradientFilter = false; // all filter passes in one dispatch, see FilterGradientsPass
+        ibool enableFusedConfidence = false; // gradient filter and confidence in one dispatch, see ConfidencePass::RenderFused
+
+        // Reduces the DI initial and spatial samples in the screen tiles where the previous frame's confidence
+        // is high. The global settings are the most that any tile uses. Requires the gradients.
+        ibool enableAdaptiveSampleBudget = false;
+        float sampleBudgetConvergedNeed = 0.25f; // need of a fully confident pixel relative to a disoccluded one
+        float sampleBudgetDisocclusionThreshold = 0.1f; // relative view depth difference
+        float minSampleBudgetScale = 0.25f;
+
+        // Runs the screen-space DI and GI passes only over the tiles that contain valid surfaces,
+        // using the list built by TileCompactionPass. Only affects the ray query versions of the passes.
+        ibool enableTileCompaction = false;
+
+        // Non-zero when the environment map is presampled with the alias table, which doesn't store the normalization
+        float environmentAliasTableInvTotalWeight = 0.f;
+
+        // Set per frame from the lighting modes for the BRDF and indirect passes
+        bool enableBrdfIndirect = false;
+        bool enableBrdfAdditiveBlend = false;
 
         BRDFPathTracing_Parameters brdfptParams = getDefaultBRDFPathTracingParams();
         
@@ -139,7 +204,24 @@ public:
         std::shared_ptr<Profiler> profiler,
         nvrhi::IBindingLayout* bindlessLayout);
 
-    void CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery);
+    // Selects the pipelines for the ReGIR mode and the ray query setting, creating the ones that weren't used before
+    // on up to 'threadCount' threads, 0 meaning one per CPU core. Does nothing if the permutation is the same as the current one.
+    void CreatePipelines(const rtxdi::ReGIRStaticParameters& regirStaticParams, bool useRayQuery, uint32_t threadCount = 0);
+
+    // Creates the pipelines for the permutations in advance, so that switching to them later doesn't stall.
+    // The current pipelines stay selected.
+    void PrewarmPipelines(const std::vector<LightingPipelinePermutation>& permutations, uint32_t threadCount = 0);
+
+    // Forgets all the pipelines, for reloading the shaders.
+    void ClearPipelineCache();
+
+    // Makes this instance render an additional view with the pipelines and the binding layout of 'mainPasses',
+    // which must have created its pipelines. Call before CreateBindingSet, and again whenever the main
+    // permutation may have changed. The additional views don't run the presampling passes, they use the results
+    // of the main view, and their passes are left out of the profiler sections.
+    void SharePipelines(const LightingPasses& mainPasses);
+
+    [[nodiscard]] const std::vector<PipelineCreationTime>& GetPipelineCreationTimes() const { return m_PipelineCreationTimes; }
 
     void CreateBindingSet(
         nvrhi::rt::IAccelStruct* topLevelAS,
@@ -147,12 +229,29 @@ public:
         const RenderTargets& renderTargets,
         const RtxdiResources& resources);
 
+    // Writes the constants and runs the presampling passes. The command list may be on the compute queue,
+    // in which case only the resources that the presampling passes use are transitioned.
     void PrepareForLightSampling(
         nvrhi::ICommandList* commandList,
         rtxdi::ImportanceSamplingContext& context,
         const donut::engine::IView& view,
         const donut::engine::IView& previousView,
         const RenderSettings& localSettings,
+        const GBufferSettings& gbufferSettings,
+        const EnvironmentLight& environmentLight,
+        bool enableAccumulation);
+
+    // Writes the constants for all the lighting passes of the frame. They are the same for every pass,
+    // and the per-pass values go into the push constants. PrepareForLightSampling calls this, so it's only needed
+    // in the frames that don't prepare the lights. The buffer keeps its contents for the command lists submitted after it.
+    void WriteResamplingConstants(
+        nvrhi::ICommandList* commandList,
+        rtxdi::ImportanceSamplingContext& context,
+        const donut::engine::IView& view,
+        const donut::engine::IView& previousView,
+        const RenderSettings& localSettings,
+        const GBufferSettings& gbufferSettings,
+        const EnvironmentLight& environmentLight,
         bool enableAccumulation);
 
     void RenderDirectLighting(
@@ -161,20 +260,19 @@ public:
         const donut::engine::IView& view,
         const RenderSettings& localSettings);
 
+    // Computes the gradients of the DI after RenderDirectLighting. The caller measures it in ProfilerSection::Gradients,
+    // together with the passes that turn the gradients into confidence.
+    void RenderGradients(
+        nvrhi::ICommandList* commandList,
+        rtxdi::ReSTIRDIContext& context,
+        const donut::engine::IView& view,
+        const RenderSettings& localSettings);
+
     void RenderBrdfRays(
         nvrhi::ICommandList* commandList,
         rtxdi::ImportanceSamplingContext& isContext,
         const donut::engine::IView& view,
-        const donut::engine::IView& previousView,
-        const RenderSettings& localSettings,
-        const GBufferSettings& gbufferSettings,
-        const EnvironmentLight& environmentLight,
-        bool enableIndirect,
-        bool enableAdditiveBlend,
-        bool enableEmissiveSurfaces,
-        bool enableAccumulation,
-        bool enableReStirGI
-    );
+        const RenderSettings& localSettings);
 
     void NextFrame();
 
@@ -189,10 +287,10 @@ private:
     void FillResamplingConstants(
         ResamplingConstants& constants,
         const RenderSettings& lightingSettings,
+        const GBufferSettings& gbufferSettings,
+        const EnvironmentLight& environmentLight,
         const rtxdi::ImportanceSamplingContext& isContext);
 
-    void createPresamplingPipelines();
-    void createReGIRPipeline(const rtxdi::ReGIRStaticParameters& regirStaticParams, const std::vector<donut::engine::ShaderMacro>& regirMacros);
-    void createReSTIRDIPipelines(const std::vector<donut::engine::ShaderMacro>& regirMacros, bool useRayQuery);
-    void createReSTIRGIPipelines(bool useRayQuery);
+    // Runs a pass over the reservoir grid, or only over the tiles with valid surfaces when the tile compaction is enabled
+    void ExecuteScreenSpacePass(nvrhi::ICommandList* commandList, RayTracingPass& pass, const RenderSettings& localSettings, const char* passName, dm::int2 dispatchSize, ProfilerSection::Enum profilerSection);
 };
@@ -0,0 +1,104 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "PipelineCreation.h"
+
+#include <donut/core/log.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+#include <sstream>
+#include <thread>
+
+using namespace donut;
+
+void RunPipelineCreationJobs(const std::vector<PipelineCreationJob>& jobs, uint32_t threadCount, std::vector<PipelineCreationTime>& outTimes)
+{
+    if (jobs.empty())
+        return;
+
+    using clock = std::chrono::steady_clock;
+    const auto startTime = clock::now();
+
+    std::vector<double> jobTimes(jobs.size(), 0.0);
+
+    for (size_t jobIndex = 0; jobIndex < jobs.size(); jobIndex++)
+    {
+        if (!jobs[jobIndex].load)
+            continue;
+
+        const auto jobStartTime = clock::now();
+        jobs[jobIndex].load();
+        jobTimes[jobIndex] = std::chrono::duration<double, std::milli>(clock::now() - jobStartTime).count();
+    }
+
+    std::atomic<size_t> nextJob = 0;
+
+    auto worker = [&]()
+    {
+        for (size_t jobIndex = nextJob++; jobIndex < jobs.size(); jobIndex = nextJob++)
+        {
+            if (!jobs[jobIndex].create)
+                continue;
+
+            const auto jobStartTime = clock::now();
+            jobs[jobIndex].create();
+            jobTimes[jobIndex] += std::chrono::duration<double, std::milli>(clock::now() - jobStartTime).count();
+        }
+    };
+
+    if (threadCount == 0)
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    threadCount = uint32_t(std::min(size_t(threadCount), jobs.size()));
+
+    std::vector<std::thread> threads;
+    for (uint32_t thread = 1; thread < threadCount; thread++)
+        threads.emplace_back(worker);
+    worker();
+    for (auto& thread : threads)
+        thread.join();
+
+    for (size_t jobIndex = 0; jobIndex < jobs.size(); jobIndex++)
+    {
+        log::debug("Created pipeline %s in %.2f ms", jobs[jobIndex].name.c_str(), jobTimes[jobIndex]);
+        outTimes.push_back({ jobs[jobIndex].name, jobTimes[jobIndex] });
+    }
+
+    const double totalTime = std::chrono::duration<double, std::milli>(clock::now() - startTime).count();
+    log::info("Created %d pipelines in %.2f ms on %u threads", int(jobs.size()), totalTime, threadCount);
+}
+
+std::string GetPipelineCreationTimesAsText(const std::vector<PipelineCreationTime>& times)
+{
+    std::vector<PipelineCreationTime> sortedTimes = times;
+    std::stable_sort(sortedTimes.begin(), sortedTimes.end(),
+        [](const PipelineCreationTime& a, const PipelineCreationTime& b) { return a.milliseconds > b.milliseconds; });
+
+    size_t nameWidth = 8;
+    double total = 0.0;
+    for (const auto& time : sortedTimes)
+    {
+        nameWidth = std::max(nameWidth, time.name.size());
+        total += time.milliseconds;
+    }
+
+    std::stringstream text;
+    text << std::left << std::setw(int(nameWidth)) << "Pipeline" << std::right << std::setw(12) << "Time (ms)" << std::endl;
+
+    text << std::fixed << std::setprecision(3);
+    for (const auto& time : sortedTimes)
+        text << std::left << std::setw(int(nameWidth)) << time.name << std::right << std::setw(12) << time.milliseconds << std::endl;
+
+    text << std::left << std::setw(int(nameWidth)) << "Total" << std::right << std::setw(12) << total << std::endl;
+
+    return text.str();
+}
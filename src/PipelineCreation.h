@@ -0,0 +1,44 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+// Time it took to create one pipeline, including the shader compilation or loading.
+struct PipelineCreationTime
+{
+    std::string name;
+    double milliseconds = 0.0;
+};
+
+struct PipelineCreationJob
+{
+    std::string name;
+
+    // Loads or compiles the shaders. The shader factory keeps its caches without any locking,
+    // so this runs on the calling thread, one job after another.
+    std::function<void()> load;
+
+    // Creates the pipeline from the loaded shaders on a worker thread. The nvrhi device can create pipelines
+    // from several threads at once, so this only needs a lock for state that it shares with other jobs.
+    std::function<void()> create;
+};
+
+// Runs the 'load' function of every job on the calling thread, then the 'create' functions on up to 'threadCount'
+// threads, each taking the next job from the list. Appends the time of every job, both steps together, to 'outTimes'
+// in the order of the jobs. A 'threadCount' of 0 means one thread per CPU core.
+// Either function can be empty. The jobs must only touch their own objects, the device and the shader factory.
+void RunPipelineCreationJobs(const std::vector<PipelineCreationJob>& jobs, uint32_t threadCount, std::vector<PipelineCreationTime>& outTimes);
+
+// Formats the times as a table, slowest first, followed by the total.
+std::string GetPipelineCreationTimesAsText(const std::vector<PipelineCreationTime>& times);
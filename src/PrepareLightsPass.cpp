@@ -226,6 +226,7 @@ static bool ConvertLight(const donut::engine::Light& light, PolymorphicLightInfo
         if (spot.profileTextureIndex >= 0)
         {
             polymorphic.iesProfileIndex = spot.profileTextureIndex;
+            polymorphic.iesProfileRows = spot.profileAtlasRows;
             polymorphic.colorTypeAndFlags |= kPolymorphicLightIesProfileEnableBit;
         }
 
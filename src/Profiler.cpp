@@ -11,6 +11,7 @@
 #include "Profiler.h"
 #include <donut/app/DeviceManager.h>
 #include <imgui.h>
+#include <algorithm>
 #include <sstream>
 
 #include "RenderTargets.h"
@@ -25,6 +26,9 @@ static const char* g_SectionNames[ProfilerSection::Count] = {
     "Presample Lights",
     "Presample Env. Map",
     "ReGIR Build",
+    "Async Compute Total",
+    "Tile Compaction",
+    "Sample Budget",
     "Initial Samples",
     "Temporal Resampling",
     "Spatial Resampling",
@@ -39,10 +43,19 @@ static const char* g_SectionNames[ProfilerSection::Count] = {
     "Denoising",
     "Glass",
     "TAA or DLSS",
+    "Main View Lighting",
+    "Additional Views",
     "Frame Time (GPU)",
     "(Material Readback)"
 };
 
+static const char* g_CommandListNames[ProfilerCommandList::Count] = {
+    "Setup",
+    "G-Buffer",
+    "Light Preparation",
+    "Lighting and Post"
+};
+
 Profiler::Profiler(donut::app::DeviceManager& deviceManager)
     : m_DeviceManager(deviceManager)
     , m_Device(deviceManager.GetDevice())
@@ -86,6 +99,8 @@ void Profiler::ResetAccumulation()
     m_TimerValues.fill(0.0);
     m_RayCounts.fill(0);
     m_HitCounts.fill(0);
+    m_RecordingTimes.fill(0.0);
+    m_RecordingWallTime = 0.0;
 }
 
 void Profiler::ResolvePreviousFrame()
@@ -118,6 +133,7 @@ void Profiler::ResolvePreviousFrame()
         }
 
         m_TimersUsed[timerIndex] = false;
+        m_LatestTimerValues[section] = time;
 
         if (m_IsAccumulating)
         {
@@ -133,6 +149,37 @@ void Profiler::ResolvePreviousFrame()
         }
     }
 
+    for (uint32_t commandList = 0; commandList < ProfilerCommandList::Count; commandList++)
+    {
+        if (m_IsAccumulating)
+            m_RecordingTimes[commandList] += m_PendingRecordingTimes[commandList];
+        else
+            m_RecordingTimes[commandList] = m_PendingRecordingTimes[commandList];
+    }
+
+    if (m_IsAccumulating)
+        m_RecordingWallTime += m_PendingRecordingWallTime;
+    else
+        m_RecordingWallTime = m_PendingRecordingWallTime;
+
+    if (m_IsAccumulating)
+    {
+        m_ConstantUploadTime += m_PendingConstantUploadTime;
+        m_ConstantUploadBytes += m_PendingConstantUploadBytes;
+        m_ConstantUploadCount += m_PendingConstantUploadCount;
+    }
+    else
+    {
+        m_ConstantUploadTime = m_PendingConstantUploadTime;
+        m_ConstantUploadBytes = m_PendingConstantUploadBytes;
+        m_ConstantUploadCount = m_PendingConstantUploadCount;
+    }
+
+    // Unlike the recording times, the uploads add up during the frame
+    m_PendingConstantUploadTime = 0.0;
+    m_PendingConstantUploadBytes = 0;
+    m_PendingConstantUploadCount = 0;
+
     if (rayCountData)
         m_RayCounts[ProfilerSection::MaterialReadback] = rayCountData[ProfilerSection::MaterialReadback * 2];
     else
@@ -217,6 +264,79 @@ double Profiler::GetHitCount(ProfilerSection::Enum section)
     return double(m_HitCounts[section]) / double(m_AccumulatedFrames);
 }
 
+double Profiler::GetRecordingTime(ProfilerCommandList::Enum commandList)
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return m_RecordingTimes[commandList] / double(m_AccumulatedFrames);
+}
+
+double Profiler::GetRecordingWallTime()
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return m_RecordingWallTime / double(m_AccumulatedFrames);
+}
+
+void Profiler::AddConstantUpload(size_t bytes, double time)
+{
+    if (!m_Enabled)
+        return;
+
+    m_PendingConstantUploadTime += time;
+    m_PendingConstantUploadBytes += bytes;
+    ++m_PendingConstantUploadCount;
+}
+
+double Profiler::GetConstantUploadTime()
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return m_ConstantUploadTime / double(m_AccumulatedFrames);
+}
+
+double Profiler::GetConstantUploadBytes()
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return double(m_ConstantUploadBytes) / double(m_AccumulatedFrames);
+}
+
+double Profiler::GetConstantUploadCount()
+{
+    if (m_AccumulatedFrames == 0)
+        return 0.0;
+
+    return double(m_ConstantUploadCount) / double(m_AccumulatedFrames);
+}
+
+void Profiler::GetViewCosts(double& sharedTime, double& mainViewTime, double& additionalViewTime)
+{
+    static const ProfilerSection::Enum sharedSections[] = {
+        ProfilerSection::TlasUpdate,
+        ProfilerSection::EnvironmentMap,
+        ProfilerSection::MeshProcessing,
+        ProfilerSection::LocalLightPdfMap,
+        ProfilerSection::PresampleLights,
+        ProfilerSection::PresampleEnvMap,
+        ProfilerSection::PresampleReGIR
+    };
+
+    sharedTime = 0.0;
+    for (ProfilerSection::Enum section : sharedSections)
+        sharedTime += GetTimer(section);
+
+    // The main view is measured directly: subtracting the other sections from the frame time doesn't work
+    // with async compute, where the shared work overlaps with the G-buffer fill.
+    const double additionalViewsTime = GetTimer(ProfilerSection::AdditionalViews);
+    mainViewTime = GetTimer(ProfilerSection::GBufferFill) + GetTimer(ProfilerSection::MainView);
+    additionalViewTime = (m_ViewCount > 1) ? additionalViewsTime / double(m_ViewCount - 1) : 0.0;
+}
+
 int Profiler::GetMaterialReadback()
 {
     return int(m_RayCounts[ProfilerSection::MaterialReadback]) - 1;
@@ -245,7 +365,7 @@ void Profiler::BuildUI(const bool enableRayCounts)
     
     for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
     {
-        if (section == ProfilerSection::InitialSamples ||
+        if (section == ProfilerSection::TileCompaction ||
             section == ProfilerSection::Gradients || 
             section == ProfilerSection::Frame)
             ImGui::Separator();
@@ -265,6 +385,9 @@ void Profiler::BuildUI(const bool enableRayCounts)
         ImGui::TableNextRow();
         ImGui::TableSetColumnIndex(0);
         ImGui::Text("%s", g_SectionNames[section]);
+        if (section == ProfilerSection::AsyncCompute && ImGui::IsItemHovered())
+            ImGui::SetTooltip("The light preparation passes above ran on the compute queue, overlapping with the G-buffer fill.\n"
+                "Their time only adds to the frame time where it exceeds the G-buffer fill time.");
         ImGui::TableSetColumnIndex(1);
 
         char text[16];
@@ -290,6 +413,41 @@ void Profiler::BuildUI(const bool enableRayCounts)
     }
 
     ImGui::EndTable();
+
+    if (m_ViewCount > 1)
+    {
+        double sharedTime, mainViewTime, additionalViewTime;
+        GetViewCosts(sharedTime, mainViewTime, additionalViewTime);
+
+        ImGui::Separator();
+        ImGui::Text("Shared by %u views: %.3f ms", m_ViewCount, sharedTime);
+        ImGui::Text("Main view: %.3f ms", mainViewTime);
+        ImGui::Text("Per additional view: %.3f ms", additionalViewTime);
+    }
+
+    if (GetRecordingWallTime() > 0.0)
+    {
+        ImGui::Separator();
+        double totalTime = 0.0;
+        for (uint32_t commandList = 0; commandList < ProfilerCommandList::Count; commandList++)
+        {
+            const double time = GetRecordingTime(ProfilerCommandList::Enum(commandList));
+            ImGui::Text("Record %s: %.3f ms", g_CommandListNames[commandList], time);
+            totalTime += time;
+        }
+        ImGui::Text("Recording (CPU): %.3f ms, %.3f ms wall", totalTime, GetRecordingWallTime());
+        if (ImGui::IsItemHovered())
+            ImGui::SetTooltip("The first number is the sum of the command list recording times,\n"
+                "the second is the time until all command lists were closed.\n"
+                "The difference is the time saved by recording in parallel.");
+    }
+
+    if (GetConstantUploadCount() > 0.0)
+    {
+        ImGui::Separator();
+        ImGui::Text("Lighting constants (CPU): %.3f ms", GetConstantUploadTime());
+        ImGui::Text("%.1f writes, %.0f bytes per frame", GetConstantUploadCount(), GetConstantUploadBytes());
+    }
 }
 
 std::string Profiler::GetAsText()
@@ -337,9 +495,55 @@ std::string Profiler::GetAsText()
         text << std::endl;
     }
 
+    if (m_ViewCount > 1)
+    {
+        double sharedTime, mainViewTime, additionalViewTime;
+        GetViewCosts(sharedTime, mainViewTime, additionalViewTime);
+
+        text.precision(3);
+        text << "Views: " << m_ViewCount << std::endl;
+        text << "Shared by all views: " << std::fixed << sharedTime << " ms" << std::endl;
+        text << "Main view: " << std::fixed << mainViewTime << " ms" << std::endl;
+        text << "Per additional view: " << std::fixed << additionalViewTime << " ms" << std::endl;
+    }
+
+    if (GetRecordingWallTime() > 0.0)
+    {
+        double totalTime = 0.0;
+        text.precision(3);
+        for (uint32_t commandList = 0; commandList < ProfilerCommandList::Count; commandList++)
+        {
+            const double time = GetRecordingTime(ProfilerCommandList::Enum(commandList));
+            text << "Record " << g_CommandListNames[commandList] << " (CPU): " << std::fixed << time << " ms" << std::endl;
+            totalTime += time;
+        }
+        text << "Recording Total (CPU): " << std::fixed << totalTime << " ms" << std::endl;
+        text << "Recording Wall Time (CPU): " << std::fixed << GetRecordingWallTime() << " ms" << std::endl;
+    }
+
+    if (GetConstantUploadCount() > 0.0)
+    {
+        text.precision(3);
+        text << "Lighting Constants (CPU): " << std::fixed << GetConstantUploadTime() << " ms" << std::endl;
+        text.precision(1);
+        text << "Lighting Constant Writes: " << std::fixed << GetConstantUploadCount() << " per frame, ";
+        text.precision(0);
+        text << GetConstantUploadBytes() << " bytes" << std::endl;
+    }
+
     return text.str();
 }
 
+const char* Profiler::GetSectionName(ProfilerSection::Enum section)
+{
+    return g_SectionNames[section];
+}
+
+const char* Profiler::GetCommandListName(ProfilerCommandList::Enum commandList)
+{
+    return g_CommandListNames[commandList];
+}
+
 ProfilerScope::ProfilerScope(Profiler& profiler, nvrhi::ICommandList* commandList, ProfilerSection::Enum section)
     : m_Profiler(profiler)
     , m_CommandList(commandList)
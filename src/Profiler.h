@@ -30,13 +30,29 @@ private:
     bool m_IsAccumulating = false;
     uint32_t m_AccumulatedFrames = 0;
     uint32_t m_ActiveBank = 0;
+    uint32_t m_ViewCount = 1;
 
     std::array<nvrhi::TimerQueryHandle, ProfilerSection::Count * 2> m_TimerQueries;
     std::array<double, ProfilerSection::Count> m_TimerValues{};
+    std::array<double, ProfilerSection::Count> m_LatestTimerValues{};
     std::array<size_t, ProfilerSection::Count> m_RayCounts{};
     std::array<size_t, ProfilerSection::Count> m_HitCounts{};
     std::array<bool, ProfilerSection::Count * 2> m_TimersUsed{};
 
+    // CPU recording times in milliseconds, the pending values are written by the recording threads
+    std::array<double, ProfilerCommandList::Count> m_PendingRecordingTimes{};
+    std::array<double, ProfilerCommandList::Count> m_RecordingTimes{};
+    double m_PendingRecordingWallTime = 0.0;
+    double m_RecordingWallTime = 0.0;
+
+    // CPU time spent filling and writing the lighting constant buffers, and the amount of data written
+    double m_PendingConstantUploadTime = 0.0;
+    size_t m_PendingConstantUploadBytes = 0;
+    uint32_t m_PendingConstantUploadCount = 0;
+    double m_ConstantUploadTime = 0.0;
+    size_t m_ConstantUploadBytes = 0;
+    uint32_t m_ConstantUploadCount = 0;
+
     donut::app::DeviceManager& m_DeviceManager;
     nvrhi::DeviceHandle m_Device;
     nvrhi::BufferHandle m_RayCountBuffer;
@@ -56,15 +72,43 @@ public:
     void BeginSection(nvrhi::ICommandList* commandList, ProfilerSection::Enum section);
     void EndSection(nvrhi::ICommandList* commandList, ProfilerSection::Enum section);
     void SetRenderTargets(const std::shared_ptr<RenderTargets>& renderTargets) { m_RenderTargets = renderTargets; }
+    void SetViewCount(uint32_t viewCount) { m_ViewCount = viewCount; }
+
+    // Stores the CPU time spent recording a command list in the current frame.
+    // Can be called from any thread, as long as each command list is recorded by one thread.
+    void SetRecordingTime(ProfilerCommandList::Enum commandList, double time) { m_PendingRecordingTimes[commandList] = time; }
+
+    // Stores the CPU time from the start of the recording to the point where all command lists are closed.
+    // When the command lists are recorded in parallel, this is less than the sum of the recording times.
+    void SetRecordingWallTime(double time) { m_PendingRecordingWallTime = time; }
+
+    // Adds one constant buffer write of the lighting passes to the current frame, with the CPU time spent
+    // filling and writing it. Only called from the thread that records the lighting.
+    void AddConstantUpload(size_t bytes, double time);
+
+    // Splits the frame time into the work that is done once for all views (the scene and light preparation),
+    // the main view (the G-buffer fill and the MainView section), and one additional view.
+    void GetViewCosts(double& sharedTime, double& mainViewTime, double& additionalViewTime);
 
     double GetTimer(ProfilerSection::Enum section);
+    double GetLatestTimer(ProfilerSection::Enum section) const { return m_LatestTimerValues[section]; }
     double GetRayCount(ProfilerSection::Enum section);
     double GetHitCount(ProfilerSection::Enum section);
+    double GetRecordingTime(ProfilerCommandList::Enum commandList);
+    double GetRecordingWallTime();
+
+    // Per-frame averages of the lighting constant buffer writes
+    double GetConstantUploadTime();
+    double GetConstantUploadBytes();
+    double GetConstantUploadCount();
     int GetMaterialReadback();
 
     void BuildUI(bool enableRayCounts);
     std::string GetAsText();
 
+    static const char* GetSectionName(ProfilerSection::Enum section);
+    static const char* GetCommandListName(ProfilerCommandList::Enum commandList);
+
     [[nodiscard]] nvrhi::IBuffer* GetRayCountBuffer() const { return m_RayCountBuffer; }
 };
 
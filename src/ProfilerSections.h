@@ -22,6 +22,9 @@ struct ProfilerSection
         PresampleLights,
         PresampleEnvMap,
         PresampleReGIR,
+        AsyncCompute, // spans the sections above that run on the compute queue, when enabled
+        TileCompaction,
+        SampleBudget,
         InitialSamples,
         TemporalResampling,
         SpatialResampling,
@@ -36,6 +39,8 @@ struct ProfilerSection
         Denoising,
         Glass,
         Resolve,
+        MainView, // the lighting command list of the main view, only measured when there are additional views
+        AdditionalViews, // everything that the additional views render, after the main view
         Frame,
 
         // Not really a section, just using a slot in the count buffer
@@ -44,3 +49,17 @@ struct ProfilerSection
         Count
     };
 };
+
+// Command lists that make up a frame, for measuring the CPU time spent recording them
+struct ProfilerCommandList
+{
+    enum Enum
+    {
+        Setup,
+        GBuffer,
+        LightPreparation,
+        Lighting,
+
+        Count
+    };
+};
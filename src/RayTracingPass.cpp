@@ -14,35 +14,42 @@
 #include <donut/core/math/math.h>
 #include <donut/core/log.h>
 #include <nvrhi/utils.h>
+#include <cassert>
 
 using namespace donut::engine;
 
 
-bool RayTracingPass::Init(
-    nvrhi::IDevice* device,
+bool RayTracingPass::LoadShaders(
     donut::engine::ShaderFactory& shaderFactory,
     const char* shaderName,
     const std::vector<donut::engine::ShaderMacro>& extraMacros,
-    bool useRayQuery,
-    uint32_t computeGroupSize,
-    nvrhi::IBindingLayout* bindingLayout,
-    nvrhi::IBindingLayout* extraBindingLayout,
-    nvrhi::IBindingLayout* bindlessLayout)
+    bool useRayQuery)
 {
-    donut::log::debug("Initializing RayTracingPass %s...", shaderName);
-
-    ComputeGroupSize = computeGroupSize;
-
-    std::vector<donut::engine::ShaderMacro> macros = { { "USE_RAY_QUERY", "1" } };
+    std::vector<donut::engine::ShaderMacro> macros = { { "USE_RAY_QUERY", useRayQuery ? "1" : "0" } };
 
     macros.insert(macros.end(), extraMacros.begin(), extraMacros.end());
 
     if (useRayQuery)
     {
         ComputeShader = shaderFactory.CreateShader(shaderName, "main", &macros, nvrhi::ShaderType::Compute);
-        if (!ComputeShader)
-            return false;
+        return ComputeShader != nullptr;
+    }
 
+    ShaderLibrary = shaderFactory.CreateShaderLibrary(shaderName, &macros);
+    return ShaderLibrary != nullptr;
+}
+
+bool RayTracingPass::CreatePipeline(
+    nvrhi::IDevice* device,
+    uint32_t computeGroupSize,
+    nvrhi::IBindingLayout* bindingLayout,
+    nvrhi::IBindingLayout* extraBindingLayout,
+    nvrhi::IBindingLayout* bindlessLayout)
+{
+    ComputeGroupSize = computeGroupSize;
+
+    if (ComputeShader)
+    {
         nvrhi::ComputePipelineDesc pipelineDesc;
         pipelineDesc.bindingLayouts = { bindingLayout };
         if (bindlessLayout)
@@ -58,8 +65,6 @@ bool RayTracingPass::Init(
         return true;
     }
 
-    macros[0].definition = "0"; // USE_RAY_QUERY
-    ShaderLibrary = shaderFactory.CreateShaderLibrary(shaderName, &macros);
     if (!ShaderLibrary)
         return false;
 
@@ -102,6 +107,25 @@ bool RayTracingPass::Init(
     return true;
 }
 
+bool RayTracingPass::Init(
+    nvrhi::IDevice* device,
+    donut::engine::ShaderFactory& shaderFactory,
+    const char* shaderName,
+    const std::vector<donut::engine::ShaderMacro>& extraMacros,
+    bool useRayQuery,
+    uint32_t computeGroupSize,
+    nvrhi::IBindingLayout* bindingLayout,
+    nvrhi::IBindingLayout* extraBindingLayout,
+    nvrhi::IBindingLayout* bindlessLayout)
+{
+    donut::log::debug("Initializing RayTracingPass %s...", shaderName);
+
+    if (!LoadShaders(shaderFactory, shaderName, extraMacros, useRayQuery))
+        return false;
+
+    return CreatePipeline(device, computeGroupSize, bindingLayout, extraBindingLayout, bindlessLayout);
+}
+
 void RayTracingPass::Execute(
     nvrhi::ICommandList* commandList,
     int width,
@@ -149,3 +173,30 @@ void RayTracingPass::Execute(
         commandList->dispatchRays(args);
     }
 }
+
+void RayTracingPass::ExecuteIndirect(
+    nvrhi::ICommandList* commandList,
+    nvrhi::IBuffer* argumentBuffer,
+    nvrhi::IBindingSet* bindingSet,
+    nvrhi::IBindingSet* extraBindingSet,
+    nvrhi::IDescriptorTable* descriptorTable,
+    const void* pushConstants,
+    const size_t pushConstantSize)
+{
+    assert(ComputePipeline);
+
+    nvrhi::ComputeState state;
+    state.bindings = { bindingSet };
+    if (descriptorTable)
+        state.bindings.push_back(descriptorTable);
+    if (extraBindingSet)
+        state.bindings.push_back(extraBindingSet);
+    state.pipeline = ComputePipeline;
+    state.indirectParams = argumentBuffer;
+    commandList->setComputeState(state);
+
+    if (pushConstants)
+        commandList->setPushConstants(pushConstants, pushConstantSize);
+
+    commandList->dispatchIndirect(0);
+}
@@ -30,6 +30,21 @@ struct RayTracingPass
 
     uint32_t ComputeGroupSize = 0;
 
+    // Loads or compiles the shaders, the shader factory must not be used from several threads at once.
+    bool LoadShaders(
+        donut::engine::ShaderFactory& shaderFactory,
+        const char* shaderName,
+        const std::vector<donut::engine::ShaderMacro>& extraMacros,
+        bool useRayQuery);
+
+    // Creates the pipeline for the shaders loaded by LoadShaders.
+    bool CreatePipeline(
+        nvrhi::IDevice* device,
+        uint32_t computeGroupSize,
+        nvrhi::IBindingLayout* bindingLayout,
+        nvrhi::IBindingLayout* extraBindingLayout,
+        nvrhi::IBindingLayout* bindlessLayout);
+
     bool Init(
         nvrhi::IDevice* device,
         donut::engine::ShaderFactory& shaderFactory,
@@ -50,4 +65,15 @@ struct RayTracingPass
         nvrhi::IDescriptorTable* descriptorTable,
         const void* pushConstants = nullptr,
         size_t pushConstantSize = 0);
+
+    // Dispatches the compute shader with the group counts taken from 'argumentBuffer'.
+    // Ray tracing pipelines can't be dispatched indirectly, so only valid when ComputePipeline is set.
+    void ExecuteIndirect(
+        nvrhi::ICommandList* commandList,
+        nvrhi::IBuffer* argumentBuffer,
+        nvrhi::IBindingSet* bindingSet,
+        nvrhi::IBindingSet* extraBindingSet,
+        nvrhi::IDescriptorTable* descriptorTable,
+        const void* pushConstants = nullptr,
+        size_t pushConstantSize = 0);
 };
\ No newline at end of file
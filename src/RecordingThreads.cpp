@@ -0,0 +1,80 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "RecordingThreads.h"
+
+RecordingThreads::RecordingThreads(uint32_t threadCount)
+{
+    for (uint32_t thread = 0; thread < threadCount; thread++)
+        m_Threads.emplace_back(&RecordingThreads::ThreadProc, this);
+}
+
+RecordingThreads::~RecordingThreads()
+{
+    Wait();
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Stop = true;
+    }
+    m_JobQueued.notify_all();
+
+    for (auto& thread : m_Threads)
+        thread.join();
+}
+
+void RecordingThreads::Run(std::function<void()> job)
+{
+    if (m_Threads.empty())
+    {
+        job();
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_Mutex);
+        m_Jobs.push_back(std::move(job));
+    }
+    m_JobQueued.notify_one();
+}
+
+void RecordingThreads::Wait()
+{
+    std::unique_lock<std::mutex> lock(m_Mutex);
+    m_JobsFinished.wait(lock, [this]() { return m_Jobs.empty() && m_RunningJobs == 0; });
+}
+
+void RecordingThreads::ThreadProc()
+{
+    while (true)
+    {
+        std::function<void()> job;
+
+        {
+            std::unique_lock<std::mutex> lock(m_Mutex);
+            m_JobQueued.wait(lock, [this]() { return !m_Jobs.empty() || m_Stop; });
+
+            if (m_Jobs.empty())
+                return;
+
+            job = std::move(m_Jobs.front());
+            m_Jobs.pop_front();
+            ++m_RunningJobs;
+        }
+
+        job();
+
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            --m_RunningJobs;
+        }
+        m_JobsFinished.notify_all();
+    }
+}
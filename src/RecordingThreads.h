@@ -0,0 +1,52 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent worker threads that record command lists while the main thread records others.
+// Every job must record into its own command list, and the caller submits the command lists
+// in order once Wait returns. The jobs start in the order they were added.
+class RecordingThreads
+{
+public:
+    explicit RecordingThreads(uint32_t threadCount);
+    ~RecordingThreads();
+
+    // Non-copyable and non-movable
+    RecordingThreads(const RecordingThreads&) = delete;
+    RecordingThreads(RecordingThreads&&) = delete;
+    RecordingThreads& operator=(const RecordingThreads&) = delete;
+    RecordingThreads& operator=(RecordingThreads&&) = delete;
+
+    // Queues the job for the next free thread, or runs it on the calling thread if there are no threads.
+    void Run(std::function<void()> job);
+
+    // Waits until all the queued jobs have finished.
+    void Wait();
+
+private:
+    std::vector<std::thread> m_Threads;
+    std::deque<std::function<void()>> m_Jobs;
+    std::mutex m_Mutex;
+    std::condition_variable m_JobQueued;
+    std::condition_variable m_JobsFinished;
+    uint32_t m_RunningJobs = 0;
+    bool m_Stop = false;
+
+    void ThreadProc();
+};
@@ -19,6 +19,9 @@
 #include "PrepareLightsPass.h"
 #include "donut/engine/DescriptorTableManager.h"
 #include "donut/engine/SceneTypes.h"
+
+#include <cstring>
+
 using namespace donut::math;
 
 #include "../shaders/ShaderParameters.h"
@@ -29,6 +32,7 @@ RenderEnvironmentMapPass::RenderEnvironmentMapPass(
     std::shared_ptr<donut::engine::DescriptorTableManager> descriptorTable,
     uint32_t textureWidth)
     : m_DescriptorTable(std::move(descriptorTable))
+    , m_SkyParams(std::make_unique<ProceduralSkyShaderParameters>())
 {
     donut::log::debug("Initializing RenderEnvironmentMapPass...");
 
@@ -72,23 +76,63 @@ RenderEnvironmentMapPass::~RenderEnvironmentMapPass()
     }
 }
 
-void RenderEnvironmentMapPass::Render(nvrhi::ICommandList* commandList, const donut::engine::DirectionalLight& light, const donut::render::SkyParameters& params)
+void RenderEnvironmentMapPass::RenderRows(nvrhi::ICommandList* commandList, uint32_t rowOffset, uint32_t rowCount)
 {
-    commandList->beginMarker("RenderEnvironmentMap");
-
     const auto& destDesc = m_DestinationTexture->getDesc();
 
+    RenderEnvironmentMapConstants constants{};
+    constants.params = *m_SkyParams;
+    constants.invTextureSize = { 1.f / float(destDesc.width), 1.f / float(destDesc.height) };
+    constants.rowOffset = rowOffset;
+    constants.rowCount = rowCount;
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    commandList->dispatch(div_ceil(destDesc.width, 16), div_ceil(rowCount, 16), 1);
+}
+
+bool RenderEnvironmentMapPass::Update(nvrhi::ICommandList* commandList, const donut::engine::DirectionalLight& light,
+    const donut::render::SkyParameters& params, uint32_t progressiveFrames)
+{
+    const uint32_t height = m_DestinationTexture->getDesc().height;
+
+    ProceduralSkyShaderParameters skyParams{};
+    donut::render::SkyPass::FillShaderParameters(light, params, skyParams);
+
+    // Any change restarts the update of all rows, starting where the previous one stopped
+    if (!m_HasContents || memcmp(&skyParams, m_SkyParams.get(), sizeof(skyParams)) != 0)
+    {
+        *m_SkyParams = skyParams;
+        m_PendingRows = height;
+    }
+
+    m_LastRenderedRows = 0;
+
+    if (m_PendingRows == 0)
+        return false;
+
+    const uint32_t rowCount = (m_HasContents && progressiveFrames > 1)
+        ? std::min(m_PendingRows, div_ceil(height, progressiveFrames))
+        : m_PendingRows;
+
+    commandList->beginMarker("RenderEnvironmentMap");
+
     nvrhi::ComputeState state;
     state.pipeline = m_Pipeline;
     state.bindings = { m_BindingSet };
     commandList->setComputeState(state);
 
-    RenderEnvironmentMapConstants constants{};
-    constants.invTextureSize = { 1.f / float(destDesc.width), 1.f / float(destDesc.height) };
-    donut::render::SkyPass::FillShaderParameters(light, params, constants.params);
-    commandList->setPushConstants(&constants, sizeof(constants));
+    // The band of rows may wrap around the bottom of the texture
+    const uint32_t firstBandRows = std::min(rowCount, height - m_RowCursor);
+    RenderRows(commandList, m_RowCursor, firstBandRows);
+    if (firstBandRows < rowCount)
+        RenderRows(commandList, 0, rowCount - firstBandRows);
 
-    commandList->dispatch(div_ceil(destDesc.width, 16), div_ceil(destDesc.height, 16), 1);
-    
     commandList->endMarker();
+
+    m_RowCursor = (m_RowCursor + rowCount) % height;
+    m_PendingRows -= rowCount;
+    m_HasContents = true;
+    m_LastRenderedRows = rowCount;
+
+    return m_PendingRows == 0;
 }
@@ -26,6 +26,8 @@ namespace donut::render
     struct SkyParameters;
 }
 
+struct ProceduralSkyShaderParameters;
+
 class RenderEnvironmentMapPass
 {
 private:
@@ -36,6 +38,15 @@ private:
     std::shared_ptr<donut::engine::DescriptorTableManager> m_DescriptorTable;
     int m_DestinationTextureIndex = -1;
 
+    // Parameters that the texture is being rendered with, and the rows that still have older contents
+    std::unique_ptr<ProceduralSkyShaderParameters> m_SkyParams;
+    bool m_HasContents = false;
+    uint32_t m_RowCursor = 0;
+    uint32_t m_PendingRows = 0;
+    uint32_t m_LastRenderedRows = 0;
+
+    void RenderRows(nvrhi::ICommandList* commandList, uint32_t rowOffset, uint32_t rowCount);
+
 public:
 
     RenderEnvironmentMapPass(
@@ -46,7 +57,14 @@ public:
 
     ~RenderEnvironmentMapPass();
 
-    void Render(nvrhi::ICommandList* commandList, const donut::engine::DirectionalLight& light, const donut::render::SkyParameters& params);
+    // Renders the sky when the light or sky parameters differ from the ones the texture was rendered with.
+    // With progressiveFrames > 1, a changed sky is rendered over that many calls, a band of rows at a time,
+    // which is enough for slow sun motion. The first render is always complete.
+    // Returns true when the texture has become fully up to date, i.e. when its PDF should be regenerated.
+    bool Update(nvrhi::ICommandList* commandList, const donut::engine::DirectionalLight& light, const donut::render::SkyParameters& params, uint32_t progressiveFrames);
+
+    // Number of texel rows rendered by the last Update call
+    uint32_t GetLastRenderedRows() const { return m_LastRenderedRows; }
 
     nvrhi::ITexture* GetTexture() const { return m_DestinationTexture; }
     int GetTextureIndex() const { return m_DestinationTextureIndex; }
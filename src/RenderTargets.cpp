@@ -197,6 +197,37 @@ RenderTargets::RenderTargets(nvrhi::IDevice* device, int2 size)
     desc.debugName = "Gradients";
     Gradients = device->createTexture(desc);
 
+    desc.dimension = nvrhi::TextureDimension::Texture2D;
+    desc.arraySize = 1;
+    desc.width = (size.x + SAMPLE_BUDGET_TILE_SIZE - 1) / SAMPLE_BUDGET_TILE_SIZE;
+    desc.height = (size.y + SAMPLE_BUDGET_TILE_SIZE - 1) / SAMPLE_BUDGET_TILE_SIZE;
+    desc.format = nvrhi::Format::R16_FLOAT;
+    desc.debugName = "SampleBudget";
+    SampleBudget = device->createTexture(desc);
+
+    // The tile list is padded to whole rows of the indirect dispatch, see TileCompactionPass.hlsl
+    const uint32_t tileCountX = (size.x + RTXDI_SCREEN_SPACE_GROUP_SIZE - 1) / RTXDI_SCREEN_SPACE_GROUP_SIZE;
+    const uint32_t tileCountY = (size.y + RTXDI_SCREEN_SPACE_GROUP_SIZE - 1) / RTXDI_SCREEN_SPACE_GROUP_SIZE;
+
+    nvrhi::BufferDesc tileBufferDesc;
+    tileBufferDesc.byteSize = sizeof(uint32_t) * (tileCountX * tileCountY + TILE_COMPACTION_DISPATCH_WIDTH);
+    tileBufferDesc.format = nvrhi::Format::R32_UINT;
+    tileBufferDesc.canHaveUAVs = true;
+    tileBufferDesc.canHaveTypedViews = true;
+    tileBufferDesc.debugName = "ValidTiles";
+    tileBufferDesc.initialState = nvrhi::ResourceStates::UnorderedAccess;
+    tileBufferDesc.keepInitialState = true;
+    ValidTiles = device->createBuffer(tileBufferDesc);
+
+    tileBufferDesc.byteSize = sizeof(uint32_t);
+    tileBufferDesc.debugName = "ValidTileCount";
+    ValidTileCount = device->createBuffer(tileBufferDesc);
+
+    tileBufferDesc.byteSize = sizeof(uint32_t) * 3;
+    tileBufferDesc.isDrawIndirectArgs = true;
+    tileBufferDesc.debugName = "TileDispatchArguments";
+    TileDispatchArguments = device->createBuffer(tileBufferDesc);
+
     nvrhi::TextureDesc debugDesc;
     debugDesc.width = size.x;
     debugDesc.height = size.y;
@@ -57,6 +57,10 @@ public:
     nvrhi::TextureHandle SpecularConfidence;
     nvrhi::TextureHandle PrevDiffuseConfidence;
     nvrhi::TextureHandle PrevSpecularConfidence;
+    nvrhi::TextureHandle SampleBudget;
+    nvrhi::BufferHandle ValidTiles;
+    nvrhi::BufferHandle ValidTileCount;
+    nvrhi::BufferHandle TileDispatchArguments;
 
     nvrhi::TextureHandle DebugColor;
     nvrhi::TextureHandle ReferenceColor;
@@ -73,3 +77,11 @@ public:
     bool IsUpdateRequired(dm::int2 size);
     void NextFrame();
 };
+
+// Width of the reservoir space for a view of the given width. With checkerboard rendering, every reservoir covers
+// two pixels, and the odd pixel at the end of the row gets a reservoir of its own, like in the reservoir buffer layout.
+// The dispatches over the reservoirs and the gradients must use this to cover the last column.
+inline int GetReservoirSpaceWidth(int viewWidth, bool checkerboard)
+{
+    return checkerboard ? (viewWidth + 1) / 2 : viewWidth;
+}
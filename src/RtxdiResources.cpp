@@ -9,6 +9,7 @@
  **************************************************************************/
 
 #include "RtxdiResources.h"
+#include "EnvironmentPdfBuilder.h"
 #include <rtxdi/ReSTIRDI.h>
 #include <rtxdi/ReSTIRGI.h>
 #include <rtxdi/RISBufferSegmentAllocator.h>
@@ -26,12 +27,14 @@ RtxdiResources::RtxdiResources(
     uint32_t maxEmissiveTriangles,
     uint32_t maxPrimitiveLights,
     uint32_t maxGeometryInstances,
-    uint32_t environmentMapWidth,
-    uint32_t environmentMapHeight)
+    uint32_t environmentPdfWidth,
+    uint32_t environmentPdfHeight,
+    uint32_t environmentAliasTableSize)
     : m_MaxEmissiveMeshes(maxEmissiveMeshes)
     , m_MaxEmissiveTriangles(maxEmissiveTriangles)
     , m_MaxPrimitiveLights(maxPrimitiveLights)
     , m_MaxGeometryInstances(maxGeometryInstances)
+    , m_EnvironmentAliasTableSize(environmentAliasTableSize)
 {
     nvrhi::BufferDesc taskBufferDesc;
     taskBufferDesc.byteSize = sizeof(PrepareLightsTask) * (maxEmissiveMeshes + maxPrimitiveLights);
@@ -112,6 +115,66 @@ RtxdiResources::RtxdiResources(
     NeighborOffsetsBuffer = device->createBuffer(neighborOffsetBufferDesc);
 
 
+    nvrhi::TextureDesc environmentPdfDesc;
+    environmentPdfDesc.width = environmentPdfWidth;
+    environmentPdfDesc.height = environmentPdfHeight;
+    environmentPdfDesc.mipLevels = GetEnvironmentPdfMipLevels(environmentPdfWidth, environmentPdfHeight); // full mip chain up to 1x1
+    environmentPdfDesc.isUAV = true;
+    environmentPdfDesc.debugName = "EnvironmentPdf";
+    environmentPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    environmentPdfDesc.keepInitialState = true;
+    environmentPdfDesc.format = nvrhi::Format::R16_FLOAT;
+    EnvironmentPdfTexture = device->createTexture(environmentPdfDesc);
+
+    // Only allocated when the alias table presampling is used, it has one entry per PDF texel.
+    nvrhi::BufferDesc environmentAliasTableDesc;
+    environmentAliasTableDesc.byteSize = sizeof(uint32_t) * 2 * std::max(environmentAliasTableSize, 1u); // uint2 per texel: alias, threshold
+    environmentAliasTableDesc.structStride = sizeof(uint32_t) * 2;
+    environmentAliasTableDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    environmentAliasTableDesc.keepInitialState = true;
+    environmentAliasTableDesc.debugName = "EnvironmentAliasTable";
+    EnvironmentAliasTableBuffer = device->createBuffer(environmentAliasTableDesc);
+
+    nvrhi::TextureDesc localLightPdfDesc;
+    rtxdi::ComputePdfTextureSize(maxLocalLights, localLightPdfDesc.width, localLightPdfDesc.height, localLightPdfDesc.mipLevels);
+    assert(localLightPdfDesc.width * localLightPdfDesc.height >= maxLocalLights);
+    localLightPdfDesc.isUAV = true;
+    localLightPdfDesc.debugName = "LocalLightPdf";
+    localLightPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
+    localLightPdfDesc.keepInitialState = true;
+    localLightPdfDesc.format = nvrhi::Format::R32_FLOAT; // Use FP32 here to allow a wide range of flux values, esp. when downsampled.
+    LocalLightPdfTexture = device->createTexture(localLightPdfDesc);
+
+    CreateViewResources(device, context);
+}
+
+RtxdiResources::RtxdiResources(
+    nvrhi::IDevice* device,
+    const rtxdi::ReSTIRDIContext& context,
+    const RtxdiResources& sharedResources)
+    : m_NeighborOffsetsInitialized(true) // the buffer is shared, and the main view initializes it
+    , m_MaxEmissiveMeshes(sharedResources.m_MaxEmissiveMeshes)
+    , m_MaxEmissiveTriangles(sharedResources.m_MaxEmissiveTriangles)
+    , m_MaxPrimitiveLights(sharedResources.m_MaxPrimitiveLights)
+    , m_MaxGeometryInstances(sharedResources.m_MaxGeometryInstances)
+    , m_EnvironmentAliasTableSize(sharedResources.m_EnvironmentAliasTableSize)
+    , TaskBuffer(sharedResources.TaskBuffer)
+    , PrimitiveLightBuffer(sharedResources.PrimitiveLightBuffer)
+    , LightDataBuffer(sharedResources.LightDataBuffer)
+    , GeometryInstanceToLightBuffer(sharedResources.GeometryInstanceToLightBuffer)
+    , LightIndexMappingBuffer(sharedResources.LightIndexMappingBuffer)
+    , RisBuffer(sharedResources.RisBuffer)
+    , RisLightDataBuffer(sharedResources.RisLightDataBuffer)
+    , NeighborOffsetsBuffer(sharedResources.NeighborOffsetsBuffer)
+    , EnvironmentPdfTexture(sharedResources.EnvironmentPdfTexture)
+    , LocalLightPdfTexture(sharedResources.LocalLightPdfTexture)
+    , EnvironmentAliasTableBuffer(sharedResources.EnvironmentAliasTableBuffer)
+{
+    CreateViewResources(device, context);
+}
+
+void RtxdiResources::CreateViewResources(nvrhi::IDevice* device, const rtxdi::ReSTIRDIContext& context)
+{
     nvrhi::BufferDesc lightReservoirBufferDesc;
     lightReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedDIReservoir) * context.getReservoirBufferParameters().reservoirArrayPitch * rtxdi::c_NumReSTIRDIReservoirBuffers;
     lightReservoirBufferDesc.structStride = sizeof(RTXDI_PackedDIReservoir);
@@ -132,27 +195,6 @@ RtxdiResources::RtxdiResources(
     SecondaryGBuffer = device->createBuffer(secondaryGBufferDesc);
 
 
-    nvrhi::TextureDesc environmentPdfDesc;
-    environmentPdfDesc.width = environmentMapWidth;
-    environmentPdfDesc.height = environmentMapHeight;
-    environmentPdfDesc.mipLevels = uint32_t(ceilf(::log2f(float(std::max(environmentPdfDesc.width, environmentPdfDesc.height)))) + 1); // full mip chain up to 1x1
-    environmentPdfDesc.isUAV = true;
-    environmentPdfDesc.debugName = "EnvironmentPdf";
-    environmentPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    environmentPdfDesc.keepInitialState = true;
-    environmentPdfDesc.format = nvrhi::Format::R16_FLOAT;
-    EnvironmentPdfTexture = device->createTexture(environmentPdfDesc);
-
-    nvrhi::TextureDesc localLightPdfDesc;
-    rtxdi::ComputePdfTextureSize(maxLocalLights, localLightPdfDesc.width, localLightPdfDesc.height, localLightPdfDesc.mipLevels);
-    assert(localLightPdfDesc.width * localLightPdfDesc.height >= maxLocalLights);
-    localLightPdfDesc.isUAV = true;
-    localLightPdfDesc.debugName = "LocalLightPdf";
-    localLightPdfDesc.initialState = nvrhi::ResourceStates::ShaderResource;
-    localLightPdfDesc.keepInitialState = true;
-    localLightPdfDesc.format = nvrhi::Format::R32_FLOAT; // Use FP32 here to allow a wide range of flux values, esp. when downsampled.
-    LocalLightPdfTexture = device->createTexture(localLightPdfDesc);
-    
     nvrhi::BufferDesc giReservoirBufferDesc;
     giReservoirBufferDesc.byteSize = sizeof(RTXDI_PackedGIReservoir) * context.getReservoirBufferParameters().reservoirArrayPitch * rtxdi::c_NumReSTIRGIReservoirBuffers;
     giReservoirBufferDesc.structStride = sizeof(RTXDI_PackedGIReservoir);
@@ -161,6 +203,19 @@ RtxdiResources::RtxdiResources(
     giReservoirBufferDesc.debugName = "GIReservoirBuffer";
     giReservoirBufferDesc.canHaveUAVs = true;
     GIReservoirBuffer = device->createBuffer(giReservoirBufferDesc);
+
+    m_ViewResourcesSize = lightReservoirBufferDesc.byteSize + secondaryGBufferDesc.byteSize + giReservoirBufferDesc.byteSize;
+
+    // The same layout without the checkerboard, see the reservoir buffer parameters in the RTXDI runtime
+    const auto& staticParams = context.getStaticParameters();
+    const size_t blockSize = RTXDI_RESERVOIR_BLOCK_SIZE;
+    const size_t fullResolutionArrayPitch = ((staticParams.RenderWidth + blockSize - 1) / blockSize)
+        * ((staticParams.RenderHeight + blockSize - 1) / blockSize)
+        * blockSize * blockSize;
+    m_FullResolutionViewResourcesSize = fullResolutionArrayPitch * (
+        sizeof(RTXDI_PackedDIReservoir) * rtxdi::c_NumReSTIRDIReservoirBuffers +
+        sizeof(SecondaryGBufferData) +
+        sizeof(RTXDI_PackedGIReservoir) * rtxdi::c_NumReSTIRGIReservoirBuffers);
 }
 
 void RtxdiResources::InitializeNeighborOffsets(nvrhi::ICommandList* commandList, uint32_t neighborOffsetCount)
@@ -27,6 +27,11 @@ private:
     uint32_t m_MaxEmissiveTriangles = 0;
     uint32_t m_MaxPrimitiveLights = 0;
     uint32_t m_MaxGeometryInstances = 0;
+    uint32_t m_EnvironmentAliasTableSize = 0;
+    size_t m_ViewResourcesSize = 0;
+    size_t m_FullResolutionViewResourcesSize = 0;
+
+    void CreateViewResources(nvrhi::IDevice* device, const rtxdi::ReSTIRDIContext& context);
 
 public:
     nvrhi::BufferHandle TaskBuffer;
@@ -41,6 +46,7 @@ public:
     nvrhi::BufferHandle SecondaryGBuffer;
     nvrhi::TextureHandle EnvironmentPdfTexture;
     nvrhi::TextureHandle LocalLightPdfTexture;
+    nvrhi::BufferHandle EnvironmentAliasTableBuffer;
     nvrhi::BufferHandle GIReservoirBuffer;
 
     RtxdiResources(
@@ -51,8 +57,16 @@ public:
         uint32_t maxEmissiveTriangles,
         uint32_t maxPrimitiveLights,
         uint32_t maxGeometryInstances,
-        uint32_t environmentMapWidth,
-        uint32_t environmentMapHeight);
+        uint32_t environmentPdfWidth,
+        uint32_t environmentPdfHeight,
+        uint32_t environmentAliasTableSize);
+
+    // Creates the resources for an additional view: the reservoir buffers and the secondary G-buffer are new,
+    // and the light buffers, the PDF textures and the RIS buffers are shared with 'sharedResources'.
+    RtxdiResources(
+        nvrhi::IDevice* device,
+        const rtxdi::ReSTIRDIContext& context,
+        const RtxdiResources& sharedResources);
 
     void InitializeNeighborOffsets(nvrhi::ICommandList* commandList, uint32_t neighborOffsetCount);
 
@@ -60,4 +74,10 @@ public:
     uint32_t GetMaxEmissiveTriangles() const { return m_MaxEmissiveTriangles; }
     uint32_t GetMaxPrimitiveLights() const { return m_MaxPrimitiveLights; }
     uint32_t GetMaxGeometryInstances() const { return m_MaxGeometryInstances; }
+    uint32_t GetEnvironmentAliasTableSize() const { return m_EnvironmentAliasTableSize; }
+
+    // Size of the buffers that follow the reservoir layout: the light and GI reservoirs and the secondary G-buffer.
+    // The layout is half as wide with checkerboard rendering, the second function returns the size without it.
+    size_t GetViewResourcesSize() const { return m_ViewResourcesSize; }
+    size_t GetFullResolutionViewResourcesSize() const { return m_FullResolutionViewResourcesSize; }
 };
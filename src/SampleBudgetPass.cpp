@@ -0,0 +1,115 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "SampleBudgetPass.h"
+#include "RenderTargets.h"
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/core/log.h>
+#include <nvrhi/utils.h>
+
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+using namespace donut::engine;
+
+SampleBudgetPass::SampleBudgetPass(
+    nvrhi::IDevice* device,
+    std::shared_ptr<ShaderFactory> shaderFactory)
+    : m_Device(device)
+    , m_ShaderFactory(shaderFactory)
+{
+    nvrhi::BindingLayoutDesc bindingLayoutDesc;
+    bindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+    bindingLayoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::Texture_SRV(1),
+        nvrhi::BindingLayoutItem::Texture_SRV(2),
+        nvrhi::BindingLayoutItem::Texture_SRV(3),
+        nvrhi::BindingLayoutItem::Texture_SRV(4),
+        nvrhi::BindingLayoutItem::Texture_UAV(0),
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(SampleBudgetConstants))
+    };
+
+    m_BindingLayout = m_Device->createBindingLayout(bindingLayoutDesc);
+}
+
+void SampleBudgetPass::CreatePipeline()
+{
+    donut::log::debug("Initializing SampleBudgetPass...");
+
+    m_ComputeShader = m_ShaderFactory->CreateShader("app/SampleBudgetPass.hlsl", "main", nullptr, nvrhi::ShaderType::Compute);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.bindingLayouts = { m_BindingLayout };
+    pipelineDesc.CS = m_ComputeShader;
+    m_ComputePipeline = m_Device->createComputePipeline(pipelineDesc);
+}
+
+void SampleBudgetPass::CreateBindingSet(const RenderTargets& renderTargets)
+{
+    // The confidence inputs are the outputs of the previous frame's ConfidencePass,
+    // so the binding sets alternate in the same way as in that pass.
+    for (int currentFrame = 0; currentFrame <= 1; currentFrame++)
+    {
+        nvrhi::BindingSetDesc bindingSetDesc;
+
+        bindingSetDesc.bindings = {
+            nvrhi::BindingSetItem::Texture_SRV(0, currentFrame ? renderTargets.Depth : renderTargets.PrevDepth),
+            nvrhi::BindingSetItem::Texture_SRV(1, currentFrame ? renderTargets.PrevDepth : renderTargets.Depth),
+            nvrhi::BindingSetItem::Texture_SRV(2, renderTargets.MotionVectors),
+            nvrhi::BindingSetItem::Texture_SRV(3, currentFrame ? renderTargets.PrevDiffuseConfidence : renderTargets.DiffuseConfidence),
+            nvrhi::BindingSetItem::Texture_SRV(4, currentFrame ? renderTargets.PrevSpecularConfidence : renderTargets.SpecularConfidence),
+            nvrhi::BindingSetItem::Texture_UAV(0, renderTargets.SampleBudget),
+            nvrhi::BindingSetItem::PushConstants(0, sizeof(SampleBudgetConstants))
+        };
+
+        nvrhi::BindingSetHandle bindingSet = m_Device->createBindingSet(bindingSetDesc, m_BindingLayout);
+        if (currentFrame)
+            m_BindingSet = bindingSet;
+        else
+            m_PrevBindingSet = bindingSet;
+    }
+}
+
+void SampleBudgetPass::Render(
+    nvrhi::ICommandList* commandList,
+    const donut::engine::IView& view,
+    float convergedNeed,
+    float disocclusionDepthThreshold)
+{
+    commandList->beginMarker("Sample Budget");
+
+    SampleBudgetConstants constants = {};
+    constants.viewportSize = dm::uint2(view.GetViewExtent().width(), view.GetViewExtent().height());
+    constants.convergedNeed = convergedNeed;
+    constants.disocclusionDepthThreshold = disocclusionDepthThreshold;
+
+    nvrhi::ComputeState state;
+    state.bindings = { m_BindingSet };
+    state.pipeline = m_ComputePipeline;
+    commandList->setComputeState(state);
+
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    commandList->dispatch(
+        dm::div_ceil(view.GetViewExtent().width(), SAMPLE_BUDGET_TILE_SIZE),
+        dm::div_ceil(view.GetViewExtent().height(), SAMPLE_BUDGET_TILE_SIZE),
+        1);
+
+    commandList->endMarker();
+}
+
+void SampleBudgetPass::NextFrame()
+{
+    std::swap(m_BindingSet, m_PrevBindingSet);
+}
@@ -48,6 +48,7 @@ std::shared_ptr<engine::SceneGraphLeaf> SpotLightWithProfile::Clone()
     copy->outerAngle = outerAngle;
     copy->profileName = profileName;
     copy->profileTextureIndex = profileTextureIndex;
+    copy->profileAtlasRows = profileAtlasRows;
     return std::static_pointer_cast<SceneGraphLeaf>(copy);
 }
 
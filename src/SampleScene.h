@@ -22,7 +22,8 @@ class SpotLightWithProfile : public donut::engine::SpotLight
 {
 public:
     std::string profileName;
-    int profileTextureIndex = -1;
+    int profileTextureIndex = -1; // descriptor of the IES profile atlas, -1 until the profile is resolved
+    uint32_t profileAtlasRows = 0; // rows of the profile in the atlas, see IesProfileAtlas::UseProfile
 
     void Load(const Json::Value& node) override;
     void Store(Json::Value& node) const override;
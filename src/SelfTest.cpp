@@ -0,0 +1,770 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "SelfTest.h"
+#include "Benchmark.h"
+#include "BenchmarkSweep.h"
+#include "DynamicResolution.h"
+#include "EnvironmentPdfBuilder.h"
+#include "HalfFloat.h"
+#include "Testing.h"
+#include "UserInterface.h"
+
+#include <donut/app/DeviceManager.h>
+#include <donut/core/log.h>
+#include <json/value.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace donut;
+
+bool SelfTestContext::Check(bool condition, const char* expression, const char* file, int line)
+{
+    ++m_CheckCount;
+
+    if (!condition)
+    {
+        ++m_FailureCount;
+        printf("FAILED: %s at %s:%d\n", expression, file, line);
+    }
+
+    return condition;
+}
+
+// The tested code logs errors for the invalid inputs on purpose, keep them out of the test output
+static void SelfTestLogCallback(log::Severity severity, const char* message)
+{
+    if (severity == log::Severity::Fatal)
+    {
+        fprintf(stderr, "FATAL ERROR: %s\n", message);
+        abort();
+    }
+}
+
+static bool NearlyEqual(double a, double b)
+{
+    return std::abs(a - b) <= 1e-9 * std::max(1.0, std::abs(b));
+}
+
+// Runs ProcessCommandLine on a fresh set of settings, the first argument is the program name
+static CommandLineStatus ParseArguments(const std::vector<std::string>& arguments, UIData& ui, CommandLineArguments& args)
+{
+    std::vector<std::string> storage = { "rtxdi-sample" };
+    storage.insert(storage.end(), arguments.begin(), arguments.end());
+
+    std::vector<char*> argv;
+    for (std::string& argument : storage)
+        argv.push_back(argument.data());
+
+    app::DeviceCreationParameters deviceParams;
+    deviceParams.backBufferWidth = 1920;
+    deviceParams.backBufferHeight = 1080;
+
+    return ProcessCommandLine(int(argv.size()), argv.data(), deviceParams, ui, args);
+}
+
+static void TestCommandLine(SelfTestContext& context)
+{
+    {
+        UIData ui;
+        CommandLineArguments args;
+        const CommandLineStatus status = ParseArguments({ "--benchmark", "--benchmark-frames", "100", "--checkerboard" }, ui, args);
+        SELF_TEST_CHECK(context, status == CommandLineStatus::Ok);
+        SELF_TEST_CHECK(context, args.benchmark);
+        SELF_TEST_CHECK(context, args.benchmarkFrames == 100);
+        SELF_TEST_CHECK(context, ui.animationFrame == 0);
+        SELF_TEST_CHECK(context, ui.restirDIStaticParams.CheckerboardSamplingMode == rtxdi::CheckerboardMode::Black);
+    }
+
+    {
+        // The sweep implies the benchmark
+        UIData ui;
+        CommandLineArguments args;
+        SELF_TEST_CHECK(context, ParseArguments({ "--benchmark-sweep", "sweep.json" }, ui, args) == CommandLineStatus::Ok);
+        SELF_TEST_CHECK(context, args.benchmark);
+    }
+
+    {
+        // Headless uses the window size as the render size
+        UIData ui;
+        CommandLineArguments args;
+        SELF_TEST_CHECK(context, ParseArguments({ "--headless", "--save-file", "frame.png", "--width", "640", "--height", "480" }, ui, args) == CommandLineStatus::Ok);
+        SELF_TEST_CHECK(context, args.renderWidth == 640 && args.renderHeight == 480);
+    }
+
+#if !defined(_WIN32) || defined(IS_CONSOLE_APP)
+    {
+        // The GUI build displays the help in a message box, so only test it in the console build
+        UIData ui;
+        CommandLineArguments args;
+        SELF_TEST_CHECK(context, ParseArguments({ "--help" }, ui, args) == CommandLineStatus::Exit);
+    }
+#endif
+
+    const std::vector<std::vector<std::string>> invalidArguments = {
+        { "--direct-resampling", "BOGUS" },
+        { "--no-such-option" },
+        { "--headless" },
+        { "--views", "0" },
+        { "--benchmark", "--convergence", "FAST" }
+    };
+
+    for (const auto& arguments : invalidArguments)
+    {
+        UIData ui;
+        CommandLineArguments args;
+        if (!SELF_TEST_CHECK(context, ParseArguments(arguments, ui, args) == CommandLineStatus::Error))
+            printf("    with %s\n", arguments[0].c_str());
+    }
+}
+
+static void TestHeadlessFrameLoop(SelfTestContext& context)
+{
+    // Loads for 3 frames, renders 5, then finishes
+    auto finishAfter5 = [](uint32_t frameIndex)
+    {
+        if (frameIndex < 3)
+            return HeadlessFrameStatus::Loading;
+        return (frameIndex < 8) ? HeadlessFrameStatus::Rendered : HeadlessFrameStatus::Finished;
+    };
+
+    SELF_TEST_CHECK(context, RunHeadlessFrameLoop(finishAfter5, 0, 0) == 0);
+    SELF_TEST_CHECK(context, RunHeadlessFrameLoop(finishAfter5, 6, 10) == 0);
+
+    // The frame-count cutoff stops a run that would never finish
+    uint32_t renderedFrames = 0;
+    auto neverFinishes = [&renderedFrames](uint32_t)
+    {
+        ++renderedFrames;
+        return HeadlessFrameStatus::Rendered;
+    };
+    SELF_TEST_CHECK(context, RunHeadlessFrameLoop(neverFinishes, 5, 0) == 1);
+    SELF_TEST_CHECK(context, renderedFrames == 5);
+
+    SELF_TEST_CHECK(context, RunHeadlessFrameLoop(finishAfter5, 5, 0) == 1);
+    SELF_TEST_CHECK(context, RunHeadlessFrameLoop(finishAfter5, 0, 3) == 1);
+    SELF_TEST_CHECK(context, RunHeadlessFrameLoop([](uint32_t) { return HeadlessFrameStatus::Failed; }, 0, 0) == 1);
+
+    // The benchmark stops at the frame limit or at the end of the animation, whichever comes first
+    float animationTime = -1.f;
+    SELF_TEST_CHECK(context, GetBenchmarkAnimationTime(0, 1.f, 10, animationTime) && animationTime == 0.f);
+    SELF_TEST_CHECK(context, GetBenchmarkAnimationTime(9, 1.f, 10, animationTime));
+    SELF_TEST_CHECK(context, !GetBenchmarkAnimationTime(10, 1.f, 10, animationTime));
+    SELF_TEST_CHECK(context, !GetBenchmarkAnimationTime(-1, 1.f, 10, animationTime));
+
+    // An animation that ends between frames 10 and 11
+    const float animationDuration = 10.5f * c_BenchmarkAnimationStep;
+    SELF_TEST_CHECK(context, GetBenchmarkAnimationTime(10, animationDuration, 0, animationTime));
+    SELF_TEST_CHECK(context, !GetBenchmarkAnimationTime(11, animationDuration, 0, animationTime));
+    SELF_TEST_CHECK(context, !GetBenchmarkAnimationTime(11, animationDuration, 100, animationTime));
+}
+
+static void TestBenchmarkStatistics(SelfTestContext& context)
+{
+    BenchmarkStatistics statistics({ "Ramp", "Constant", "Unused" });
+
+    // The ramp section takes 20..1 ms in reverse order, the statistics must not depend on the order
+    for (int frame = 20; frame >= 1; frame--)
+        statistics.AddFrame({ double(frame), 2.0 });
+
+    SELF_TEST_CHECK(context, statistics.GetFrameCount() == 20);
+
+    const std::vector<BenchmarkStatistics::SectionSummary> summaries = statistics.Summarize();
+
+    // The sections that are always zero are skipped
+    if (!SELF_TEST_CHECK(context, summaries.size() == 2))
+        return;
+
+    const BenchmarkStatistics::SectionSummary& ramp = summaries[0];
+    SELF_TEST_CHECK(context, ramp.name == "Ramp");
+    SELF_TEST_CHECK(context, NearlyEqual(ramp.minimum, 1.0));
+    SELF_TEST_CHECK(context, NearlyEqual(ramp.maximum, 20.0));
+    SELF_TEST_CHECK(context, NearlyEqual(ramp.average, 10.5));
+    SELF_TEST_CHECK(context, NearlyEqual(ramp.median, 10.0)); // nearest rank: ceil(0.5 * 20) = 10th value
+    SELF_TEST_CHECK(context, NearlyEqual(ramp.percentile95, 19.0)); // ceil(0.95 * 20) = 19th value
+
+    const BenchmarkStatistics::SectionSummary& constant = summaries[1];
+    SELF_TEST_CHECK(context, constant.name == "Constant");
+    SELF_TEST_CHECK(context, NearlyEqual(constant.minimum, 2.0) && NearlyEqual(constant.maximum, 2.0));
+    SELF_TEST_CHECK(context, NearlyEqual(constant.median, 2.0) && NearlyEqual(constant.percentile95, 2.0));
+
+    statistics.Reset();
+    SELF_TEST_CHECK(context, statistics.GetFrameCount() == 0);
+    SELF_TEST_CHECK(context, statistics.Summarize().empty());
+
+    // A single frame is its own median and percentile
+    statistics.AddFrame({ 3.0 });
+    const std::vector<BenchmarkStatistics::SectionSummary> single = statistics.Summarize();
+    if (SELF_TEST_CHECK(context, single.size() == 1))
+        SELF_TEST_CHECK(context, NearlyEqual(single[0].median, 3.0) && NearlyEqual(single[0].percentile95, 3.0));
+}
+
+static void TestBenchmarkSweep(SelfTestContext& context)
+{
+    // The Fast preset enables the checkerboard, the others disable it
+    Json::Value root;
+    root["presets"].append("fast");
+    root["presets"].append("medium");
+    root["presets"].append("fast");
+    root["resolutions"].append("1280x720");
+    root["resolutions"].append("640x480");
+
+    BenchmarkSweep sweep;
+    if (!SELF_TEST_CHECK(context, sweep.ParseConfig(root)))
+        return;
+
+    const std::vector<BenchmarkSweepEntry>& entries = sweep.GetEntries();
+    if (!SELF_TEST_CHECK(context, entries.size() == 6))
+        return;
+
+    // Replaying the sweep resets the context only when the resolution or the implied checkerboard mode changes
+    UIData ui;
+    uint32_t contextResets = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        if (i > 0)
+            SELF_TEST_CHECK(context, entries[i - 1].resolution.x <= entries[i].resolution.x);
+
+        ui.resetISContext = false;
+        entries[i].ApplyToUI(ui);
+        if (ui.resetISContext)
+            ++contextResets;
+    }
+    SELF_TEST_CHECK(context, contextResets <= 3);
+
+    // The two Fast entries of each resolution are next to each other
+    uint32_t presetChanges = 0;
+    for (size_t i = 1; i < entries.size(); i++)
+    {
+        if (entries[i].preset != entries[i - 1].preset)
+            ++presetChanges;
+    }
+    SELF_TEST_CHECK(context, presetChanges <= 3);
+
+    // A preset that enables the checkerboard, overridden back to the current mode, doesn't reset the context
+    {
+        UIData overrideUI;
+        overrideUI.restirDIStaticParams.CheckerboardSamplingMode = rtxdi::CheckerboardMode::Off;
+        overrideUI.resetISContext = false;
+
+        BenchmarkSweepEntry entry;
+        entry.preset = QualityPreset::Fast;
+        entry.checkerboard = false;
+        entry.ApplyToUI(overrideUI);
+        SELF_TEST_CHECK(context, !overrideUI.resetISContext);
+
+        entry.checkerboard = true;
+        entry.ApplyToUI(overrideUI);
+        SELF_TEST_CHECK(context, overrideUI.resetISContext);
+    }
+}
+
+// A synthetic RGBA32F environment map
+struct TestEnvironmentMap
+{
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+    std::vector<float> rgba;
+};
+
+static TestEnvironmentMap CreateTestEnvironmentMap(const char* name, uint32_t width, uint32_t height,
+    const std::function<float(uint32_t x, uint32_t y)>& luminance)
+{
+    TestEnvironmentMap map{ name, width, height };
+    map.rgba.resize(size_t(width) * height * 4);
+
+    for (uint32_t y = 0; y < height; y++)
+    {
+        for (uint32_t x = 0; x < width; x++)
+        {
+            float* texel = map.rgba.data() + (size_t(y) * width + x) * 4;
+            texel[0] = texel[1] = texel[2] = luminance(x, y);
+            texel[3] = 1.f;
+        }
+    }
+
+    return map;
+}
+
+static std::vector<TestEnvironmentMap> CreateTestEnvironmentMaps()
+{
+    std::vector<TestEnvironmentMap> maps;
+    maps.push_back(CreateTestEnvironmentMap("constant", 16, 8, [](uint32_t, uint32_t) { return 1.f; }));
+    maps.push_back(CreateTestEnvironmentMap("gradient", 32, 16, [](uint32_t x, uint32_t y) { return float(x + y * 3) * 0.1f; }));
+    maps.push_back(CreateTestEnvironmentMap("hot texel", 16, 16, [](uint32_t x, uint32_t y) { return (x == 5 && y == 3) ? 1000.f : 0.f; }));
+    maps.push_back(CreateTestEnvironmentMap("npot gradient", 12, 5, [](uint32_t x, uint32_t y) { return float(x + 1) * float(y + 2) * 0.25f; }));
+    maps.push_back(CreateTestEnvironmentMap("npot hot texel", 7, 3, [](uint32_t x, uint32_t y) { return (x == 6 && y == 1) ? 50.f : 0.f; }));
+    maps.push_back(CreateTestEnvironmentMap("zero rows", 16, 8, [](uint32_t x, uint32_t y) { return (y % 3 == 0) ? 0.f : float(x % 4 + 1); }));
+    // Large enough to use several threads and to cross a stage boundary of the GPU pass
+    maps.push_back(CreateTestEnvironmentMap("large", 256, 128, [](uint32_t x, uint32_t y) { return float((x * 7 + y * 13) % 29) + 0.5f; }));
+    return maps;
+}
+
+// Straightforward double precision version of the PDF pyramid: the luminance times the relative solid angle,
+// box-resampled to the power-of-two size, then averaged 2x2 with zeros outside of each level.
+static std::vector<std::vector<double>> BuildReferencePdfMips(const TestEnvironmentMap& map, uint32_t& outWidth, uint32_t& outHeight)
+{
+    uint32_t pdfWidth = 1, pdfHeight = 1;
+    while (pdfWidth < map.width) pdfWidth *= 2;
+    while (pdfHeight < map.height) pdfHeight *= 2;
+
+    std::vector<double> mapWeights(size_t(map.width) * map.height);
+    for (uint32_t y = 0; y < map.height; y++)
+    {
+        const double elevation = ((double(y) + 0.5) / double(map.height) - 0.5) * 3.14159265358979;
+
+        for (uint32_t x = 0; x < map.width; x++)
+        {
+            const float* texel = map.rgba.data() + (size_t(y) * map.width + x) * 4;
+            const double luma = std::max(0.0, texel[0] * 0.299 + texel[1] * 0.587 + texel[2] * 0.114);
+            mapWeights[size_t(y) * map.width + x] = std::min(luma * std::cos(elevation), 65504.0);
+        }
+    }
+
+    std::vector<std::vector<double>> levels(1);
+    levels[0].resize(size_t(pdfWidth) * pdfHeight);
+
+    const double scaleX = double(map.width) / double(pdfWidth);
+    const double scaleY = double(map.height) / double(pdfHeight);
+
+    for (uint32_t y = 0; y < pdfHeight; y++)
+    {
+        for (uint32_t x = 0; x < pdfWidth; x++)
+        {
+            double sum = 0.0;
+            for (uint32_t mapY = 0; mapY < map.height; mapY++)
+            {
+                const double coverageY = std::min((y + 1) * scaleY, mapY + 1.0) - std::max(y * scaleY, double(mapY));
+                if (coverageY <= 0.0)
+                    continue;
+
+                for (uint32_t mapX = 0; mapX < map.width; mapX++)
+                {
+                    const double coverageX = std::min((x + 1) * scaleX, mapX + 1.0) - std::max(x * scaleX, double(mapX));
+                    if (coverageX > 0.0)
+                        sum += coverageX * coverageY * mapWeights[size_t(mapY) * map.width + mapX];
+                }
+            }
+
+            levels[0][size_t(y) * pdfWidth + x] = sum / (scaleX * scaleY);
+        }
+    }
+
+    uint32_t levelWidth = pdfWidth;
+    uint32_t levelHeight = pdfHeight;
+    while (levelWidth > 1 || levelHeight > 1)
+    {
+        const std::vector<double>& source = levels.back();
+        const uint32_t destWidth = std::max(1u, levelWidth / 2);
+        const uint32_t destHeight = std::max(1u, levelHeight / 2);
+        std::vector<double> dest(size_t(destWidth) * destHeight);
+
+        for (uint32_t y = 0; y < destHeight; y++)
+        {
+            for (uint32_t x = 0; x < destWidth; x++)
+            {
+                double sum = 0.0;
+                for (uint32_t i = 0; i < 4; i++)
+                {
+                    const uint32_t sourceX = x * 2 + (i & 1);
+                    const uint32_t sourceY = y * 2 + (i >> 1);
+                    if (sourceX < levelWidth && sourceY < levelHeight)
+                        sum += source[size_t(sourceY) * levelWidth + sourceX];
+                }
+                dest[size_t(y) * destWidth + x] = sum * 0.25;
+            }
+        }
+
+        levels.push_back(std::move(dest));
+        levelWidth = destWidth;
+        levelHeight = destHeight;
+    }
+
+    outWidth = pdfWidth;
+    outHeight = pdfHeight;
+    return levels;
+}
+
+static void TestEnvironmentPdfBuilder(SelfTestContext& context)
+{
+    for (const TestEnvironmentMap& map : CreateTestEnvironmentMaps())
+    {
+        uint32_t referenceWidth = 0, referenceHeight = 0;
+        const std::vector<std::vector<double>> reference = BuildReferencePdfMips(map, referenceWidth, referenceHeight);
+
+        EnvironmentPdfMips mips;
+        BuildEnvironmentPdfMips(map.rgba.data(), map.width, map.height, mips, 1);
+
+        bool matches = SELF_TEST_CHECK(context, mips.width == referenceWidth && mips.height == referenceHeight);
+        matches = SELF_TEST_CHECK(context, mips.levels.size() == reference.size()) && matches;
+        if (!matches)
+        {
+            printf("    with the %s map\n", map.name);
+            continue;
+        }
+
+        // The builder rounds to float16 after every stage of 5 levels, allow for a few float16 ulps
+        constexpr double relativeTolerance = 1.0 / 256.0;
+        constexpr double absoluteTolerance = 1e-6;
+
+        uint32_t mismatchCount = 0;
+        for (size_t mipLevel = 0; mipLevel < reference.size(); mipLevel++)
+        {
+            for (size_t index = 0; index < reference[mipLevel].size(); index++)
+            {
+                const double expected = reference[mipLevel][index];
+                const double actual = HalfToFloat(mips.levels[mipLevel][index]);
+                if (std::abs(actual - expected) > expected * relativeTolerance + absoluteTolerance)
+                    ++mismatchCount;
+            }
+        }
+
+        if (!SELF_TEST_CHECK(context, mismatchCount == 0))
+            printf("    %u texels differ from the reference in the %s map\n", mismatchCount, map.name);
+
+        // The result must not depend on the number of threads
+        EnvironmentPdfMips threadedMips;
+        BuildEnvironmentPdfMips(map.rgba.data(), map.width, map.height, threadedMips, 8);
+        if (!SELF_TEST_CHECK(context, threadedMips.levels == mips.levels))
+            printf("    with the %s map\n", map.name);
+    }
+}
+
+static void TestEnvironmentPdfCache(SelfTestContext& context)
+{
+    const TestEnvironmentMap map = CreateTestEnvironmentMap("cache", 12, 5, [](uint32_t x, uint32_t y) { return float(x * y) + 0.5f; });
+
+    EnvironmentPdfMips mips;
+    BuildEnvironmentPdfMips(map.rgba.data(), map.width, map.height, mips, 1);
+
+    constexpr uint64_t contentHash = 0x0123456789abcdefull;
+    std::vector<uint8_t> contents = SerializeEnvironmentPdfCache(contentHash, mips);
+
+    EnvironmentPdfMips loadedMips;
+    SELF_TEST_CHECK(context, ParseEnvironmentPdfCache(contents.data(), contents.size(), contentHash, loadedMips));
+    SELF_TEST_CHECK(context, loadedMips.width == mips.width && loadedMips.height == mips.height);
+    SELF_TEST_CHECK(context, loadedMips.levels == mips.levels);
+
+    // A cache from a different map file
+    SELF_TEST_CHECK(context, !ParseEnvironmentPdfCache(contents.data(), contents.size(), contentHash + 1, loadedMips));
+
+    // Truncated or extended files
+    SELF_TEST_CHECK(context, !ParseEnvironmentPdfCache(contents.data(), contents.size() - 1, contentHash, loadedMips));
+    SELF_TEST_CHECK(context, !ParseEnvironmentPdfCache(contents.data(), 16, contentHash, loadedMips));
+    std::vector<uint8_t> extended = contents;
+    extended.push_back(0);
+    SELF_TEST_CHECK(context, !ParseEnvironmentPdfCache(extended.data(), extended.size(), contentHash, loadedMips));
+
+    // A cache from a different version of the builder, the version follows the magic number
+    std::vector<uint8_t> otherVersion = contents;
+    uint32_t version;
+    memcpy(&version, otherVersion.data() + sizeof(uint32_t), sizeof(version));
+    ++version;
+    memcpy(otherVersion.data() + sizeof(uint32_t), &version, sizeof(version));
+    SELF_TEST_CHECK(context, !ParseEnvironmentPdfCache(otherVersion.data(), otherVersion.size(), contentHash, loadedMips));
+
+    // Not a PDF cache at all
+    std::vector<uint8_t> otherMagic = contents;
+    otherMagic[0] ^= 0xff;
+    SELF_TEST_CHECK(context, !ParseEnvironmentPdfCache(otherMagic.data(), otherMagic.size(), contentHash, loadedMips));
+}
+
+// Draws samples from the alias table with the same rule as PresampleEnvironmentMap.hlsl and compares
+// the histogram with the normalized texel weights. Returns the chi-square statistic divided by its bound.
+static double SampleEnvironmentAliasTable(const EnvironmentPdfMips& mips, const EnvironmentAliasTable& table, uint32_t sampleCount,
+    uint32_t& outZeroWeightHits)
+{
+    const std::vector<uint16_t>& weights = mips.levels[0];
+    const uint32_t texelCount = uint32_t(weights.size());
+
+    std::mt19937 rng(12345);
+    std::vector<uint32_t> histogram(texelCount, 0);
+
+    for (uint32_t sample = 0; sample < sampleCount; sample++)
+    {
+        // All 32 random bits for the entry, then a float in [0, 1) for the threshold
+        uint32_t texelIndex = uint32_t(rng()) % texelCount;
+        const float random = float(rng() >> 8) * (1.f / 16777216.f);
+
+        if (random >= table.entries[texelIndex].threshold)
+            texelIndex = table.entries[texelIndex].alias;
+
+        ++histogram[texelIndex];
+    }
+
+    double chiSquare = 0.0;
+    uint32_t degreesOfFreedom = 0;
+    outZeroWeightHits = 0;
+
+    for (uint32_t index = 0; index < texelCount; index++)
+    {
+        const double expected = double(sampleCount) * double(HalfToFloat(weights[index])) / table.totalWeight;
+        if (expected <= 0.0)
+        {
+            outZeroWeightHits += histogram[index];
+            continue;
+        }
+
+        const double difference = double(histogram[index]) - expected;
+        chiSquare += difference * difference / expected;
+        ++degreesOfFreedom;
+    }
+
+    if (degreesOfFreedom <= 1)
+        return 0.0;
+
+    // About 5 standard deviations above the mean of the chi-square distribution, the seed is fixed
+    const double dof = double(degreesOfFreedom - 1);
+    return chiSquare / (dof + 5.0 * std::sqrt(2.0 * dof));
+}
+
+static void TestEnvironmentAliasTable(SelfTestContext& context)
+{
+    for (const TestEnvironmentMap& map : CreateTestEnvironmentMaps())
+    {
+        EnvironmentPdfMips mips;
+        BuildEnvironmentPdfMips(map.rgba.data(), map.width, map.height, mips, 1);
+
+        EnvironmentAliasTable table;
+        if (!SELF_TEST_CHECK(context, BuildEnvironmentAliasTable(mips, table)) ||
+            !SELF_TEST_CHECK(context, table.entries.size() == mips.levels[0].size()))
+        {
+            printf("    with the %s map\n", map.name);
+            continue;
+        }
+
+        SELF_TEST_CHECK(context, ValidateEnvironmentAliasTable(mips, table));
+
+        uint32_t zeroWeightHits = 0;
+        const uint32_t sampleCount = std::max(200000u, uint32_t(table.entries.size()) * 100);
+        const double chiSquareRatio = SampleEnvironmentAliasTable(mips, table, sampleCount, zeroWeightHits);
+
+        if (!SELF_TEST_CHECK(context, chiSquareRatio <= 1.0))
+            printf("    the %s map histogram is %.2fx above the chi-square bound\n", map.name, chiSquareRatio);
+
+        // The texels without energy must never be selected
+        if (!SELF_TEST_CHECK(context, zeroWeightHits == 0))
+            printf("    the %s map sampled %u zero-weight texels\n", map.name, zeroWeightHits);
+    }
+
+    // A map with a single hot texel always selects that texel
+    {
+        const TestEnvironmentMap map = CreateTestEnvironmentMap("single texel", 8, 8, [](uint32_t x, uint32_t y) { return (x == 2 && y == 6) ? 10.f : 0.f; });
+        EnvironmentPdfMips mips;
+        BuildEnvironmentPdfMips(map.rgba.data(), map.width, map.height, mips, 1);
+
+        EnvironmentAliasTable table;
+        if (SELF_TEST_CHECK(context, BuildEnvironmentAliasTable(mips, table)))
+        {
+            bool allToHotTexel = true;
+            for (uint32_t index = 0; index < uint32_t(table.entries.size()); index++)
+            {
+                const EnvironmentAliasTable::Entry& entry = table.entries[index];
+                const uint32_t hotIndex = 6 * 8 + 2;
+                if (index != hotIndex && (entry.alias != hotIndex || entry.threshold != 0.f))
+                    allToHotTexel = false;
+            }
+            SELF_TEST_CHECK(context, allToHotTexel);
+        }
+    }
+
+    // A map without energy has no table
+    {
+        const TestEnvironmentMap map = CreateTestEnvironmentMap("black", 8, 4, [](uint32_t, uint32_t) { return 0.f; });
+        EnvironmentPdfMips mips;
+        BuildEnvironmentPdfMips(map.rgba.data(), map.width, map.height, mips, 1);
+
+        EnvironmentAliasTable table;
+        SELF_TEST_CHECK(context, !BuildEnvironmentAliasTable(mips, table));
+    }
+}
+
+// Replays a synthetic GPU that takes 'fullResolutionTime' ms at scale 1 and proportionally less with fewer pixels.
+// The reported time is for the frame rendered 'latency' frames ago, like the timer queries.
+// Returns the scale after every frame.
+static std::vector<float> ReplayDynamicResolution(DynamicResolutionController& controller, uint32_t frameCount,
+    const std::function<double(uint32_t frameIndex)>& fullResolutionTime, uint32_t latency = 3)
+{
+    std::vector<float> renderedScales;
+    std::vector<float> scales;
+
+    for (uint32_t frameIndex = 0; frameIndex < frameCount; frameIndex++)
+    {
+        renderedScales.push_back(controller.GetScale());
+
+        double frameTime = 0.0;
+        if (frameIndex >= latency)
+        {
+            const uint32_t measuredFrame = frameIndex - latency;
+            const double scale = renderedScales[measuredFrame];
+            frameTime = fullResolutionTime(measuredFrame) * scale * scale;
+        }
+
+        scales.push_back(controller.Update(frameTime));
+    }
+
+    return scales;
+}
+
+static uint32_t CountScaleChanges(const std::vector<float>& scales, size_t firstFrame)
+{
+    uint32_t changes = 0;
+    for (size_t i = std::max<size_t>(firstFrame, 1); i < scales.size(); i++)
+    {
+        if (scales[i] != scales[i - 1])
+            ++changes;
+    }
+    return changes;
+}
+
+static void TestDynamicResolution(SelfTestContext& context)
+{
+    DynamicResolutionSettings settings;
+    settings.targetFrameTime = 16.f;
+    settings.minScale = 0.5f;
+    settings.maxScale = 1.f;
+    settings.scaleStep = 0.05f;
+    settings.headroom = 0.1f;
+    settings.settleFrames = 8;
+
+    constexpr float epsilon = 1e-4f;
+
+    {
+        // A frame that is twice over the budget drops to sqrt(1/2) at once, snapped down to 0.70
+        DynamicResolutionController controller(settings);
+        const std::vector<float> scales = ReplayDynamicResolution(controller, 40, [](uint32_t) { return 32.0; });
+
+        // Nothing happens during the first settleFrames measured frames
+        SELF_TEST_CHECK(context, scales[3 + settings.settleFrames - 1] == 1.f);
+
+        const float droppedScale = scales[3 + settings.settleFrames];
+        SELF_TEST_CHECK(context, std::abs(droppedScale - 0.7f) < epsilon);
+        SELF_TEST_CHECK(context, CountScaleChanges(scales, 0) == 1);
+    }
+
+    {
+        // After a change, the next settleFrames measurements are ignored even if they are way over the budget
+        DynamicResolutionController controller(settings);
+        controller.Reset(0.7f);
+        for (uint32_t frame = 0; frame < settings.settleFrames; frame++)
+            controller.Update(1000.0);
+        SELF_TEST_CHECK(context, std::abs(controller.GetScale() - 0.7f) < epsilon);
+
+        // Unmeasured frames don't count towards the settle period
+        controller.Reset(0.7f);
+        for (uint32_t frame = 0; frame < settings.settleFrames * 2; frame++)
+            controller.Update(0.0);
+        for (uint32_t frame = 0; frame < settings.settleFrames; frame++)
+            controller.Update(1000.0);
+        SELF_TEST_CHECK(context, std::abs(controller.GetScale() - 0.7f) < epsilon);
+
+        controller.Update(1000.0);
+        SELF_TEST_CHECK(context, controller.GetScale() < 0.7f - epsilon);
+    }
+
+    {
+        // A cheap frame goes up one step at a time and stops at the maximum
+        DynamicResolutionController controller(settings);
+        controller.Reset(0.5f);
+        const std::vector<float> scales = ReplayDynamicResolution(controller, 400, [](uint32_t) { return 10.0; });
+
+        bool singleSteps = true;
+        for (size_t i = 1; i < scales.size(); i++)
+        {
+            if (scales[i] != scales[i - 1] && std::abs(scales[i] - scales[i - 1] - settings.scaleStep) > epsilon)
+                singleSteps = false;
+        }
+        SELF_TEST_CHECK(context, singleSteps);
+        SELF_TEST_CHECK(context, scales.back() == 1.f);
+        SELF_TEST_CHECK(context, CountScaleChanges(scales, 0) == 10);
+    }
+
+    {
+        // Within the headroom below the budget, the scale stays: 20 ms * 0.85^2 = 14.45 ms, between 14.4 and 16 ms
+        DynamicResolutionController controller(settings);
+        controller.Reset(0.85f);
+        const std::vector<float> scales = ReplayDynamicResolution(controller, 200, [](uint32_t) { return 20.0; });
+        SELF_TEST_CHECK(context, CountScaleChanges(scales, 0) == 0);
+
+        // 17.5 ms goes up from 0.85 (12.6 ms) to 0.9 (14.2 ms), but not to 0.95 where it would be 15.8 ms,
+        // over the budget minus half of the headroom
+        controller.Reset(0.85f);
+        const std::vector<float> stepUp = ReplayDynamicResolution(controller, 200, [](uint32_t) { return 17.5; });
+        SELF_TEST_CHECK(context, std::abs(stepUp.back() - 0.9f) < epsilon);
+    }
+
+    {
+        // The scale is clamped to the bounds however far the frame time is from the budget
+        DynamicResolutionController controller(settings);
+        const std::vector<float> slow = ReplayDynamicResolution(controller, 100, [](uint32_t) { return 1000.0; });
+        SELF_TEST_CHECK(context, std::abs(slow.back() - settings.minScale) < epsilon);
+        SELF_TEST_CHECK(context, *std::min_element(slow.begin(), slow.end()) >= settings.minScale - epsilon);
+
+        const std::vector<float> fast = ReplayDynamicResolution(controller, 400, [](uint32_t) { return 1.0; });
+        SELF_TEST_CHECK(context, fast.back() == settings.maxScale);
+
+        // New bounds apply right away
+        DynamicResolutionSettings narrowSettings = settings;
+        narrowSettings.maxScale = 0.8f;
+        controller.SetSettings(narrowSettings);
+        SELF_TEST_CHECK(context, std::abs(controller.GetScale() - 0.8f) < epsilon);
+    }
+
+    {
+        // A workload right at the budget with some frame-to-frame noise settles and stays:
+        // 24 ms at full resolution fits at 0.80 (15.4 ms), 0.85 would be 17.3 ms.
+        DynamicResolutionController controller(settings);
+        const std::vector<float> scales = ReplayDynamicResolution(controller, 600,
+            [](uint32_t frameIndex) { return 24.0 * (1.0 + 0.02 * std::sin(double(frameIndex) * 1.7)); });
+
+        SELF_TEST_CHECK(context, CountScaleChanges(scales, 100) == 0);
+        SELF_TEST_CHECK(context, std::abs(scales.back() - 0.8f) < epsilon);
+    }
+}
+
+int RunSelfTests()
+{
+    log::SetCallback(&SelfTestLogCallback);
+
+    const std::vector<std::pair<const char*, std::function<void(SelfTestContext&)>>> tests = {
+        { "CommandLine", TestCommandLine },
+        { "HeadlessFrameLoop", TestHeadlessFrameLoop },
+        { "BenchmarkStatistics", TestBenchmarkStatistics },
+        { "BenchmarkSweep", TestBenchmarkSweep },
+        { "EnvironmentPdfBuilder", TestEnvironmentPdfBuilder },
+        { "EnvironmentPdfCache", TestEnvironmentPdfCache },
+        { "EnvironmentAliasTable", TestEnvironmentAliasTable },
+        { "DynamicResolution", TestDynamicResolution },
+    };
+
+    uint32_t failedTests = 0;
+    for (const auto& [name, test] : tests)
+    {
+        SelfTestContext context;
+        test(context);
+
+        printf("%s: %s (%u checks)\n", name, context.GetFailureCount() == 0 ? "passed" : "FAILED", context.GetCheckCount());
+
+        if (context.GetFailureCount() != 0)
+            ++failedTests;
+    }
+
+    printf("%u of %u tests passed.\n", uint32_t(tests.size()) - failedTests, uint32_t(tests.size()));
+
+    return (failedTests == 0) ? 0 : 1;
+}
@@ -0,0 +1,34 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <cstdint>
+
+// Minimal test harness for the parts of the application that don't need a graphics device.
+// The tests run with --self-test, before the device is created.
+class SelfTestContext
+{
+public:
+    // Records a failure with the location of the check if the condition is false. Returns the condition.
+    bool Check(bool condition, const char* expression, const char* file, int line);
+
+    [[nodiscard]] uint32_t GetCheckCount() const { return m_CheckCount; }
+    [[nodiscard]] uint32_t GetFailureCount() const { return m_FailureCount; }
+
+private:
+    uint32_t m_CheckCount = 0;
+    uint32_t m_FailureCount = 0;
+};
+
+#define SELF_TEST_CHECK(context, condition) (context).Check((condition), #condition, __FILE__, __LINE__)
+
+// Runs all the self-tests and returns the process exit code: 0 if they all pass, 1 otherwise.
+int RunSelfTests();
@@ -16,12 +16,8 @@
 #include <donut/core/log.h>
 
 #include <cxxopts.hpp>
-#include <stb_image.h>
-#include <stb_image_write.h>
-#include <filesystem>
 
 using namespace donut;
-namespace fs = std::filesystem;
 
 const char* g_ApplicationTitle = "RTX Dynamic Illumination SDK Sample";
 
@@ -135,6 +131,23 @@ std::istream& operator>> (std::istream& is, rtxdi::ReSTIRGI_ResamplingMode& mode
     return is;
 }
 
+std::istream& operator>> (std::istream& is, EnvironmentPresamplingMode& mode)
+{
+    std::string s;
+    is >> s;
+    toupper(s);
+
+    if (s == "MIP")
+        mode = EnvironmentPresamplingMode::MipDescent;
+    else if (s == "ALIAS")
+        mode = EnvironmentPresamplingMode::AliasTable;
+
+    else
+        throw cxxopts::exceptions::exception("Unrecognized value passed to the --env-presampling argument.");
+
+    return is;
+}
+
 // A hacky operator to allow selecting the preset
 std::istream& operator>> (std::istream& is, UIData& ui)
 {
@@ -160,7 +173,7 @@ std::istream& operator>> (std::istream& is, UIData& ui)
     return is;
 }
 
-void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args)
+CommandLineStatus ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args)
 {
     using namespace cxxopts;
     
@@ -169,36 +182,68 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
     bool help = false;
     bool useVk = false;
     ibool checkerboard = false;
+    uint32_t viewCount = 1;
     std::string denoiserMode;
 
     options.add_options()
         ("aa-mode", "Anti-aliasing mode: OFF, ACC, TAA, DLSS (if supported)", value(ui.aaMode))
+        ("adaptive-samples", "Redistribute the ReSTIR DI samples between screen tiles based on the confidence, requires a denoiser", value(ui.lightingSettings.enableAdaptiveSampleBudget))
         ("alpha-tested", "Alpha-tested materials toggle", value(ui.gbufferSettings.enableAlphaTestedGeometry))
         ("animation", "Animations toggle", value(ui.enableAnimations))
+        ("async-compute", "Run the light preparation and presampling on the compute queue", value(ui.asyncCompute))
         ("benchmark", "Run the benchmark", value(args.benchmark))
+        ("benchmark-frames", "Number of benchmark frames to render, default is the whole animation", value(args.benchmarkFrames))
+        ("benchmark-output", "Write the benchmark results into a text file", value(args.benchmarkOutputFileName))
+        ("benchmark-sweep", "Run the benchmark for every combination of settings listed in a JSON file", value(args.benchmarkSweepFileName))
         ("bloom", "Bloom effect toggle", value(ui.enableBloom))
         ("checkerboard", "Use checkerboard rendering", value(checkerboard))
+        ("convergence", "Measure the error against an accumulated reference versus GPU time for a comma-separated list of presets", value(args.convergencePresets))
+        ("convergence-frames", "Number of frames to render with each preset when measuring convergence, default is 64", value(args.convergenceFrames))
+        ("convergence-output", "Write the convergence curves into a CSV file", value(args.convergenceOutputFileName))
+        ("convergence-reference-frames", "Number of frames to accumulate for the convergence reference, default is 1024", value(args.convergenceReferenceFrames))
         ("d,debug", "Enable the DX12 or Vulkan validation layers", value(deviceParams.enableDebugRuntime))
         ("disable-bg-opt", "Disable DX12 driver background optimization", value(args.disableBackgroundOptimization))
         ("direct-resampling", "Direct lighting resampling mode: NONE, TEMPORAL, SPATIAL, TEMPORAL_SPATIAL, FUSED", value(ui.restirDI.resamplingMode))
+        ("dynamic-res", "Adjust the resolution scale to keep the GPU frame time within --dynamic-res-budget", value(ui.enableDynamicResolution))
+        ("dynamic-res-budget", "GPU frame time budget for the dynamic resolution in milliseconds, default is 16", value(ui.dynamicResolution.targetFrameTime))
+        ("env-bc6h", "Compress the environment maps loaded from files into BC6H", value(ui.environmentMapCompression))
+        ("env-map", "Name of the environment map file to use instead of the procedural sky", value(args.environmentMapName))
+        ("env-prefetch", "Number of environment maps to load in the background after the selected one", value(ui.environmentMapPrefetchCount))
+        ("env-presampling", "Environment map presampling mode: MIP, ALIAS", value(ui.environmentPresamplingMode))
         ("fullscreen", "Run in full screen", value(deviceParams.startFullscreen))
+        ("fused-confidence", "Filter the gradients and compute the confidence in one dispatch", value(ui.lightingSettings.enableFusedConfidence))
+        ("fused-gradient-filter", "Run all gradient filter passes in one dispatch", value(ui.lightingSettings.enableFusedGradientFilter))
         ("h,help", "Display this help message", value(help))
+        ("headless", "Render offscreen without a window, requires --benchmark, --convergence or --save-file", value(args.headless))
         ("height", "Window height", value(deviceParams.backBufferHeight))
         ("indirect-resampling", "ReSTIR GI resampling mode: NONE, TEMPORAL, SPATIAL, TEMPORAL_SPATIAL, FUSED", value(ui.restirGI.resamplingMode))
         ("noise-mix", "Amount of noise to mix in after denoising", value(ui.noiseMix))
+        ("parallel-recording", "Record the G-buffer command list on a worker thread", value(ui.parallelRecording))
+        ("pipeline-threads", "Number of threads that create the lighting pipelines, 0 means one per CPU core", value(args.pipelineThreads))
         ("pixel-jitter", "Pixel jitter toggle", value(ui.enablePixelJitter))
         ("preset", "Rendering settings preset: FAST, MEDIUM, UNBIASED, ULTRA, REFERENCE", value(ui))
+        ("prewarm-pipelines", "Create the lighting pipelines for a comma-separated list of ReGIR modes at startup: NONE, GRID, ONION or ALL, each with an optional :RQ, :RT or :ALL suffix", value(args.prewarmPipelines))
         ("rasterize-gbuffer", "G-buffer rasterization toggle", value(ui.rasterizeGBuffer))
         ("ray-query", "Ray Query toggle", value(ui.useRayQuery))
         ("direct-mode", "Direct lighting mode: NONE, BRDF, RESTIR", value(ui.directLightingMode))
         ("indirect-mode", "Indirect lighting mode: NONE, BRDF, RESTIRGI", value(ui.indirectLightingMode))
         ("render-width", "Internal render target width, overrides window size", value(args.renderWidth))
         ("render-height", "Internal render target height, overrides window size", value(args.renderHeight))
-        ("save-file", "Save frame to file and exit", value(args.saveFrameFileName))
+        ("save-file", "Save frame to file and exit, the format is derived from the extension: BMP, PNG, EXR or RAW", value(args.saveFrameFileName))
         ("save-frame", "Index of the frame to save, default is 0", value(args.saveFrameIndex))
+        ("save-hdr", "Also save HdrColor and the lighting buffers into EXR files", value(args.saveHdr))
+        ("save-interval", "Save every Nth frame between --save-frame and --save-last-frame", value(args.saveFrameInterval))
+        ("save-last-frame", "Index of the last frame to save, default is the same as --save-frame", value(args.saveLastFrameIndex))
+        ("self-test", "Run the tests of the code that doesn't need a graphics device and exit", value(args.selfTest))
+        ("tile-compaction", "Run the lighting passes only over the screen tiles with valid surfaces, requires ray queries", value(ui.lightingSettings.enableTileCompaction))
         ("tone-mapping", "Tone mapping toggle", value(ui.enableToneMapping))
         ("transparent", "Transparent materials toggle", value(ui.gbufferSettings.enableTransparentGeometry))
         ("verbose", "Enable debug log messages", value(args.verbose))
+        ("verify-confidence", "Compare the fused confidence pass output with the CPU model on a frame with gradients, requires --fused-confidence", value(args.verifyConfidence))
+        ("verify-env-pdf", "Generate the environment map PDF on the GPU and compare it with the CPU build", value(args.verifyEnvironmentPdf))
+        ("verify-gradient-filter", "Compare the GPU gradient filter output with the CPU reference on a frame with gradients", value(args.verifyGradientFilter))
+        ("view-separation", "Horizontal distance between the views in world units, default is 0.065", value(ui.additionalViewSeparation))
+        ("views", "Number of views to render, the views after the first one share its light presampling", value(viewCount))
         ("vk", "Run the application using Vulkan (otherwise D3D12 if supported)", value(useVk))
         ("width", "Window width", value(deviceParams.backBufferWidth))
     ;
@@ -220,7 +265,7 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
 #else
             printf("%s", options.help().c_str());
 #endif
-            exit(0);
+            return CommandLineStatus::Exit;
         }
         
         if (!denoiserMode.empty())
@@ -243,12 +288,55 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
     catch (const std::exception& e)
     {
         donut::log::error("%s", e.what());
-        exit(1);
+        return CommandLineStatus::Error;
+    }
+
+    if ((args.saveFrameIndex != 0 || args.saveLastFrameIndex != 0 || args.saveHdr) && args.saveFrameFileName.empty())
+    {
+        log::warning("The --save-frame, --save-last-frame and --save-hdr arguments are used without --save-file. They will be ignored.");
+    }
+
+    args.saveLastFrameIndex = std::max(args.saveLastFrameIndex, args.saveFrameIndex);
+    args.saveFrameInterval = std::max(args.saveFrameInterval, 1u);
+
+    if (!args.benchmarkSweepFileName.empty())
+        args.benchmark = true;
+
+    if ((args.benchmarkFrames != 0 || !args.benchmarkOutputFileName.empty()) && !args.benchmark)
+    {
+        log::warning("The --benchmark-frames and --benchmark-output arguments are used without --benchmark. They will be ignored.");
+    }
+
+    if (!args.convergencePresets.empty())
+    {
+        if (args.benchmark)
+        {
+            log::error("The --convergence and --benchmark arguments cannot be used together.");
+            return CommandLineStatus::Error;
+        }
+
+        // The measurement needs a static scene to converge
+        ui.enableAnimations = false;
+    }
+    else if (!args.convergenceOutputFileName.empty())
+    {
+        log::warning("The --convergence-output argument is used without --convergence. It will be ignored.");
     }
 
-    if (args.saveFrameIndex != 0 && args.saveFrameFileName.empty())
+    if (args.headless)
     {
-        log::warning("The --save-frame argument is used without --save-file. It will be ignored.");
+        if (!args.benchmark && args.saveFrameFileName.empty() && args.convergencePresets.empty())
+        {
+            log::error("The --headless argument requires --benchmark, --convergence or --save-file, otherwise the application would never exit.");
+            return CommandLineStatus::Error;
+        }
+
+        // There is no window to take the size from, so use the window size arguments as the render size.
+        if (args.renderWidth <= 0 || args.renderHeight <= 0)
+        {
+            args.renderWidth = int(deviceParams.backBufferWidth);
+            args.renderHeight = int(deviceParams.backBufferHeight);
+        }
     }
 
 #if DONUT_WITH_DX12 && DONUT_WITH_VULKAN
@@ -266,8 +354,17 @@ void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParamet
     if (args.benchmark)
         ui.animationFrame = 0;
 
+    if (viewCount < 1 || viewCount > c_MaxViewCount)
+    {
+        log::error("The --views argument must be between 1 and %u.", c_MaxViewCount);
+        return CommandLineStatus::Error;
+    }
+    ui.additionalViewCount = viewCount - 1;
+
     if (checkerboard)
         ui.restirDIStaticParams.CheckerboardSamplingMode = rtxdi::CheckerboardMode::Black;
+
+    return CommandLineStatus::Ok;
 }
 
 void ApplicationLogCallback(log::Severity severity, const char* message)
@@ -311,65 +408,3 @@ void ApplicationLogCallback(log::Severity severity, const char* message)
     if (severity == log::Severity::Fatal)
         abort();
 }
-
-bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName)
-{
-    nvrhi::TextureDesc desc = texture->getDesc();
-    nvrhi::FramebufferHandle tempFramebuffer;
-
-    nvrhi::CommandListHandle commandList = device->createCommandList();
-    commandList->open();
-    
-    nvrhi::StagingTextureHandle stagingTexture = device->createStagingTexture(desc, nvrhi::CpuAccessMode::Read);
-    commandList->copyTexture(stagingTexture, nvrhi::TextureSlice(), texture, nvrhi::TextureSlice());
-    
-    commandList->close();
-    device->executeCommandList(commandList);
-    device->waitForIdle();
-
-    size_t rowPitch = 0;
-    void* pData = device->mapStagingTexture(stagingTexture, nvrhi::TextureSlice(), nvrhi::CpuAccessMode::Read, &rowPitch);
-
-    if (!pData)
-    {
-        log::error("Couldn't map the readback texture.");
-        return false;
-    }
-
-    uint32_t* textureInSysmem = new uint32_t[desc.width * desc.height];
-
-    if (!textureInSysmem)
-    {
-        log::error("Couldn't allocate the memory for a %dx%d texture on the CPU.", desc.width, desc.height);
-        return false;
-    }
-    
-    for (uint32_t row = 0; row < desc.height; row++)
-    {
-        memcpy(textureInSysmem + row * desc.width, static_cast<char*>(pData) + row * rowPitch, desc.width * sizeof(uint32_t));
-    }
-
-    device->unmapStagingTexture(stagingTexture);
-    
-    
-    bool success = true;
-    if (writeFileName && *writeFileName)
-    {
-        fs::path parentFolder = fs::path(writeFileName).parent_path();
-        if (!parentFolder.empty() && !fs::exists(parentFolder))
-        {
-            log::info("Creating folder '%s'", parentFolder.generic_string().c_str());
-            fs::create_directories(parentFolder);
-        }
-
-        success = stbi_write_bmp(writeFileName, desc.width, desc.height, 4, pData) != 0;
-        if (success)
-            log::info("Saved the screenshot into '%s'", writeFileName);
-        else
-            log::error("Failed to save the screenshot into '%s'", writeFileName);
-    }
-    
-    delete[] textureInSysmem;
-
-    return success;
-}
@@ -28,14 +28,40 @@ struct CommandLineArguments
 {
     nvrhi::GraphicsAPI graphicsApi = nvrhi::GraphicsAPI::VULKAN;
     uint32_t saveFrameIndex = 0;
+    uint32_t saveLastFrameIndex = 0;
+    uint32_t saveFrameInterval = 1;
     std::string saveFrameFileName;
+    bool saveHdr = false;
     bool verbose = false;
     bool benchmark = false;
+    bool headless = false;
+    uint32_t benchmarkFrames = 0;
+    std::string benchmarkOutputFileName;
+    std::string benchmarkSweepFileName;
+    std::string convergencePresets;
+    uint32_t convergenceFrames = 64;
+    uint32_t convergenceReferenceFrames = 1024;
+    std::string convergenceOutputFileName;
+    std::string environmentMapName;
+    bool verifyEnvironmentPdf = false;
+    bool verifyGradientFilter = false;
+    bool verifyConfidence = false;
+    bool selfTest = false;
     bool disableBackgroundOptimization = false;
+    std::string prewarmPipelines;
+    uint32_t pipelineThreads = 0;
     int renderWidth = 0;
     int renderHeight = 0;
 };
 
-void ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args);
-void ApplicationLogCallback(donut::log::Severity severity, const char* message);
-bool SaveTexture(nvrhi::IDevice* device, nvrhi::ITexture* texture, const char* writeFileName);
\ No newline at end of file
+enum class CommandLineStatus
+{
+    Ok,     // Continue with the parsed arguments
+    Exit,   // The help was displayed, exit with success
+    Error   // The arguments are invalid, the error has been logged
+};
+
+// Parses the arguments into the device parameters, UI settings and application arguments.
+// Doesn't terminate the process, so it can be used from the self-tests.
+[[nodiscard]] CommandLineStatus ProcessCommandLine(int argc, char** argv, donut::app::DeviceCreationParameters& deviceParams, UIData& ui, CommandLineArguments& args);
+void ApplicationLogCallback(donut::log::Severity severity, const char* message);
\ No newline at end of file
@@ -0,0 +1,131 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#include "TileCompactionPass.h"
+#include "RenderTargets.h"
+
+#include <donut/engine/ShaderFactory.h>
+#include <donut/engine/View.h>
+#include <donut/core/log.h>
+#include <nvrhi/utils.h>
+
+
+using namespace donut::math;
+#include "../shaders/ShaderParameters.h"
+
+using namespace donut::engine;
+
+TileCompactionPass::TileCompactionPass(
+    nvrhi::IDevice* device,
+    std::shared_ptr<ShaderFactory> shaderFactory)
+    : m_Device(device)
+    , m_ShaderFactory(shaderFactory)
+{
+    nvrhi::BindingLayoutDesc bindingLayoutDesc;
+    bindingLayoutDesc.visibility = nvrhi::ShaderType::Compute;
+    bindingLayoutDesc.bindings = {
+        nvrhi::BindingLayoutItem::Texture_SRV(0),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(0),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(1),
+        nvrhi::BindingLayoutItem::TypedBuffer_UAV(2),
+        nvrhi::BindingLayoutItem::PushConstants(0, sizeof(TileCompactionConstants))
+    };
+
+    m_BindingLayout = m_Device->createBindingLayout(bindingLayoutDesc);
+}
+
+void TileCompactionPass::CreatePipeline()
+{
+    donut::log::debug("Initializing TileCompactionPass...");
+
+    m_ComputeShader = m_ShaderFactory->CreateShader("app/TileCompactionPass.hlsl", "main", nullptr, nvrhi::ShaderType::Compute);
+    m_ArgumentsShader = m_ShaderFactory->CreateShader("app/TileCompactionPass.hlsl", "WriteArguments", nullptr, nvrhi::ShaderType::Compute);
+
+    nvrhi::ComputePipelineDesc pipelineDesc;
+    pipelineDesc.bindingLayouts = { m_BindingLayout };
+    pipelineDesc.CS = m_ComputeShader;
+    m_ComputePipeline = m_Device->createComputePipeline(pipelineDesc);
+
+    pipelineDesc.CS = m_ArgumentsShader;
+    m_ArgumentsPipeline = m_Device->createComputePipeline(pipelineDesc);
+}
+
+void TileCompactionPass::CreateBindingSet(const RenderTargets& renderTargets)
+{
+    for (int currentFrame = 0; currentFrame <= 1; currentFrame++)
+    {
+        nvrhi::BindingSetDesc bindingSetDesc;
+
+        bindingSetDesc.bindings = {
+            nvrhi::BindingSetItem::Texture_SRV(0, currentFrame ? renderTargets.Depth : renderTargets.PrevDepth),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(0, renderTargets.ValidTiles),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(1, renderTargets.ValidTileCount),
+            nvrhi::BindingSetItem::TypedBuffer_UAV(2, renderTargets.TileDispatchArguments),
+            nvrhi::BindingSetItem::PushConstants(0, sizeof(TileCompactionConstants))
+        };
+
+        nvrhi::BindingSetHandle bindingSet = m_Device->createBindingSet(bindingSetDesc, m_BindingLayout);
+        if (currentFrame)
+            m_BindingSet = bindingSet;
+        else
+            m_PrevBindingSet = bindingSet;
+    }
+
+    m_ValidTileCountBuffer = renderTargets.ValidTileCount;
+}
+
+void TileCompactionPass::Render(
+    nvrhi::ICommandList* commandList,
+    const donut::engine::IView& view,
+    bool checkerboard)
+{
+    commandList->beginMarker("Tile Compaction");
+
+    commandList->clearBufferUInt(m_ValidTileCountBuffer, 0);
+
+    TileCompactionConstants constants = {};
+    constants.viewportSize = dm::uint2(view.GetViewExtent().width(), view.GetViewExtent().height());
+    constants.checkerboard = checkerboard;
+
+    // The tiles are in the reservoir space, which is half as wide with checkerboard rendering.
+    // This must match the dispatch size in LightingPasses, including the last column for odd widths.
+    const dm::uint2 reservoirSize = dm::uint2(
+        uint32_t(GetReservoirSpaceWidth(int(constants.viewportSize.x), checkerboard)),
+        constants.viewportSize.y);
+
+    nvrhi::ComputeState state;
+    state.bindings = { m_BindingSet };
+    state.pipeline = m_ComputePipeline;
+    commandList->setComputeState(state);
+
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    commandList->dispatch(
+        dm::div_ceil(reservoirSize.x, RTXDI_SCREEN_SPACE_GROUP_SIZE),
+        dm::div_ceil(reservoirSize.y, RTXDI_SCREEN_SPACE_GROUP_SIZE),
+        1);
+
+    // Both passes use the same binding set, so NVRHI doesn't place the barrier between them
+    nvrhi::utils::BufferUavBarrier(commandList, m_ValidTileCountBuffer);
+
+    state.pipeline = m_ArgumentsPipeline;
+    commandList->setComputeState(state);
+
+    commandList->setPushConstants(&constants, sizeof(constants));
+
+    commandList->dispatch(1, 1, 1);
+
+    commandList->endMarker();
+}
+
+void TileCompactionPass::NextFrame()
+{
+    std::swap(m_BindingSet, m_PrevBindingSet);
+}
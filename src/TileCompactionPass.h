@@ -0,0 +1,57 @@
+/***************************************************************************
+ # Copyright (c) 2023, NVIDIA CORPORATION.  All rights reserved.
+ #
+ # NVIDIA CORPORATION and its licensors retain all intellectual property
+ # and proprietary rights in and to this software, related documentation
+ # and any modifications thereto.  Any use, reproduction, disclosure or
+ # distribution of this software and related documentation without an express
+ # license agreement from NVIDIA CORPORATION is strictly prohibited.
+ **************************************************************************/
+
+#pragma once
+
+#include <nvrhi/nvrhi.h>
+#include <memory>
+
+namespace donut::engine
+{
+    class ShaderFactory;
+    class IView;
+}
+
+class RenderTargets;
+
+// Builds the list of screen-space tiles that contain valid G-buffer surfaces and the indirect dispatch
+// arguments for it, so that the lighting passes can skip the tiles that only contain the sky.
+class TileCompactionPass
+{
+private:
+    nvrhi::DeviceHandle m_Device;
+
+    nvrhi::ShaderHandle m_ComputeShader;
+    nvrhi::ShaderHandle m_ArgumentsShader;
+    nvrhi::ComputePipelineHandle m_ComputePipeline;
+    nvrhi::ComputePipelineHandle m_ArgumentsPipeline;
+    nvrhi::BindingLayoutHandle m_BindingLayout;
+    nvrhi::BindingSetHandle m_BindingSet;
+    nvrhi::BindingSetHandle m_PrevBindingSet;
+    nvrhi::BufferHandle m_ValidTileCountBuffer;
+
+    std::shared_ptr<donut::engine::ShaderFactory> m_ShaderFactory;
+
+public:
+    TileCompactionPass(
+        nvrhi::IDevice* device,
+        std::shared_ptr<donut::engine::ShaderFactory> shaderFactory);
+
+    void CreatePipeline();
+
+    void CreateBindingSet(const RenderTargets& renderTargets);
+
+    void Render(
+        nvrhi::ICommandList* commandList,
+        const donut::engine::IView& view,
+        bool checkerboard);
+
+    void NextFrame();
+};
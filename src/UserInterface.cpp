@@ -33,10 +33,10 @@
  */
 
 #include "UserInterface.h"
+#include "IesProfileAtlas.h"
 #include "Profiler.h"
 #include "SampleScene.h"
 
-#include <donut/engine/IesProfile.h>
 #include <donut/app/Camera.h>
 #include <donut/app/UserInterfaceUtils.h>
 #include <donut/core/json.h>
@@ -288,7 +288,7 @@ void UserInterface::GeneralRenderingSettings()
         {
             if (GetDevice()->queryFeatureSupport(nvrhi::Feature::RayTracingPipeline))
             {
-                m_ui.reloadShaders |= ImGui::Checkbox("Use RayQuery", (bool*)&m_ui.useRayQuery);
+                ImGui::Checkbox("Use RayQuery", (bool*)&m_ui.useRayQuery);
             }
             else
             {
@@ -304,10 +304,56 @@ void UserInterface::GeneralRenderingSettings()
 
         ImGui::Checkbox("Rasterize G-Buffer", (bool*)&m_ui.rasterizeGBuffer);
 
-        int resolutionScalePercents = int(m_ui.resolutionScale * 100.f);
-        ImGui::SliderInt("Resolution Scale (%)", &resolutionScalePercents, 50, 100);
-        m_ui.resolutionScale = float(resolutionScalePercents) * 0.01f;
-        m_ui.resolutionScale = dm::clamp(m_ui.resolutionScale, 0.5f, 1.0f);
+        if (m_ui.useRayQuery)
+        {
+            ImGui::Checkbox("Skip Sky Tiles", (bool*)&m_ui.lightingSettings.enableTileCompaction);
+            ShowHelpMarker(
+                "Build a list of the screen tiles that contain geometry and dispatch the lighting passes "
+                "indirectly over that list, so that the tiles with only the sky don't occupy the GPU.");
+        }
+
+        if (GetDevice()->queryFeatureSupport(nvrhi::Feature::ComputeQueue))
+        {
+            ImGui::Checkbox("Async Compute Light Preparation", (bool*)&m_ui.asyncCompute);
+            ShowHelpMarker(
+                "Run the light preparation and presampling passes on the compute queue, "
+                "overlapping with the G-buffer fill on the graphics queue.");
+        }
+        else
+        {
+            ImGui::Checkbox("Async Compute (Not available)", (bool*)&m_ui.asyncCompute);
+            m_ui.asyncCompute = false;
+        }
+
+        ImGui::Checkbox("Parallel Command Recording", (bool*)&m_ui.parallelRecording);
+        ShowHelpMarker(
+            "Record the G-buffer command list on a worker thread while the main thread records "
+            "the light preparation and lighting command lists. The recording times are shown in the profiler.");
+
+        ImGui::Checkbox("Dynamic Resolution", &m_ui.enableDynamicResolution);
+        ShowHelpMarker(
+            "Adjust the resolution scale in steps to keep the GPU frame time within the budget. "
+            "Requires the profiler, and the scale doesn't change while accumulating.");
+        if (m_ui.enableDynamicResolution)
+        {
+            ImGui::PushItemWidth(120.f);
+            ImGui::SliderFloat("Frame Time Budget (ms)", &m_ui.dynamicResolution.targetFrameTime, 4.f, 50.f, "%.1f");
+            int minScalePercents = int(roundf(m_ui.dynamicResolution.minScale * 100.f));
+            int maxScalePercents = int(roundf(m_ui.dynamicResolution.maxScale * 100.f));
+            ImGui::SliderInt("Min Scale (%)", &minScalePercents, 25, 100);
+            ImGui::SliderInt("Max Scale (%)", &maxScalePercents, minScalePercents, 100);
+            m_ui.dynamicResolution.minScale = float(minScalePercents) * 0.01f;
+            m_ui.dynamicResolution.maxScale = float(dm::max(minScalePercents, maxScalePercents)) * 0.01f;
+            ImGui::PopItemWidth();
+            ImGui::Text("Resolution Scale: %d%%", int(roundf(m_ui.resolutionScale * 100.f)));
+        }
+        else
+        {
+            int resolutionScalePercents = int(m_ui.resolutionScale * 100.f);
+            ImGui::SliderInt("Resolution Scale (%)", &resolutionScalePercents, 50, 100);
+            m_ui.resolutionScale = float(resolutionScalePercents) * 0.01f;
+            m_ui.resolutionScale = dm::clamp(m_ui.resolutionScale, 0.5f, 1.0f);
+        }
 
         ImGui::Checkbox("##enableFpsLimit", &m_ui.enableFpsLimit);
         ImGui::SameLine();
@@ -333,6 +379,9 @@ void UserInterface::SamplingSettings()
     {
         ShowHelpMarker("Heavyweight settings (e.g. that dictate buffer sizes) that require recreating the context to change.");
         m_ui.resetAccumulation |= ImGui::Checkbox("Importance Sample Env. Map", &m_ui.environmentMapImportanceSampling);
+        m_ui.resetAccumulation |= ImGui::Combo("Env. Map Presampling", (int*)&m_ui.environmentPresamplingMode, "Mip Descent\0Alias Table\0");
+        ShowHelpMarker("The alias table samples the environment map with one lookup instead of a walk down the PDF mip chain. "
+            "It is only used for the environment maps loaded from files, the procedural sky always uses the mip chain.");
 
         if (ImGui::TreeNode("RTXDI Context"))
         {
@@ -993,6 +1042,31 @@ void UserInterface::DenoiserSettings()
                 ImGui::SliderFloat("Gradient Sensitivity", &m_ui.lightingSettings.gradientSensitivity, 1.f, 20.f);
                 ImGui::SliderFloat("Darkness Bias (EV)", &m_ui.lightingSettings.gradientLogDarknessBias, -16.f, -4.f);
                 ImGui::SliderFloat("Confidence History Length", &m_ui.lightingSettings.confidenceHistoryLength, 0.f, 3.f);
+                ImGui::Checkbox("Fused Confidence Pass", (bool*)&m_ui.lightingSettings.enableFusedConfidence);
+                ShowHelpMarker(
+                    "Filter the gradients and convert them into confidence in one dispatch, "
+                    "keeping the filtered gradients in shared memory. "
+                    "The gradients visualization shows the unfiltered gradients in this mode.");
+                if (!m_ui.lightingSettings.enableFusedConfidence)
+                {
+                    ImGui::Checkbox("Fused Gradient Filter", (bool*)&m_ui.lightingSettings.enableFusedGradientFilter);
+                    ShowHelpMarker(
+                        "Run all gradient filter passes in one dispatch that keeps the intermediate results in shared memory. "
+                        "The gradients visualization shows the unfiltered gradients in this mode.");
+                }
+            }
+
+            if (m_ui.lightingSettings.enableGradients)
+            {
+                ImGui::Checkbox("Adaptive Sample Budget", (bool*)&m_ui.lightingSettings.enableAdaptiveSampleBudget);
+                ShowHelpMarker(
+                    "Reduce the ReSTIR DI local light and spatial samples in the screen tiles where the previous frame's confidence is high. "
+                    "Tiles where it's low or the surface is disoccluded keep the configured sample counts, which no tile exceeds.");
+                if (m_ui.lightingSettings.enableAdaptiveSampleBudget && m_showAdvancedDenoisingSettings)
+                {
+                    ImGui::SliderFloat("Converged Tile Need", &m_ui.lightingSettings.sampleBudgetConvergedNeed, 0.05f, 1.f);
+                    ImGui::SliderFloat("Min Tile Sample Scale", &m_ui.lightingSettings.minSampleBudgetScale, 0.f, 1.f);
+                }
             }
 
             if (m_showAdvancedDenoisingSettings)
@@ -1145,20 +1219,56 @@ void UserInterface::SceneSettings()
                 ImGui::Selectable(getEnvironmentMapName(*m_ui.resources->scene, index).c_str(), &selected);
                 if (selected)
                 {
-                    if (index != m_ui.environmentMapIndex)
-                    {
-                        m_ui.environmentMapIndex = index;
-                        m_ui.environmentMapDirty = 2;
-                    }
+                    m_ui.environmentMapIndex = index;
                     ImGui::SetItemDefaultFocus();
                 }
             }
             ImGui::EndCombo();
         }
         ImGui::PopItemWidth();
+        if (m_ui.environmentMapLoading)
+        {
+            ImGui::SameLine();
+            ImGui::TextUnformatted("Loading...");
+        }
+        ImGui::PushItemWidth(120.f);
+        ImGui::SliderInt("Prefetch Maps", &m_ui.environmentMapPrefetchCount, 0, 4);
+        ImGui::PopItemWidth();
+        ShowHelpMarker("Load the environment maps that follow the selected one in the list in the background, "
+            "so that switching to them is immediate. Every prefetched map stays in video memory.");
+        ImGui::Checkbox("Compress Environment Maps (BC6H)", &m_ui.environmentMapCompression);
+        ShowHelpMarker("Use BC6H textures for the environment maps loaded from files, with 1 byte per texel instead of 16 "
+            "for the float textures. The maps are encoded on the CPU once and cached next to the files, "
+            "and the importance sampling PDF is still built from the original map.");
         m_ui.resetAccumulation |= ImGui::SliderFloat("Environment Bias (EV)", &m_ui.environmentIntensityBias, -8.f, 4.f);
         m_ui.resetAccumulation |= ImGui::SliderFloat("Environment Rotation (deg)", &m_ui.environmentRotation, -180.f, 180.f);
 
+        if (m_ui.environmentMapIndex == 0)
+        {
+            static const uint32_t skyWidths[] = { 512, 1024, 2048, 4096 };
+            int skyWidthIndex = 2;
+            for (int index = 0; index < int(std::size(skyWidths)); index++)
+            {
+                if (skyWidths[index] == m_ui.proceduralSkyWidth)
+                    skyWidthIndex = index;
+            }
+
+            ImGui::PushItemWidth(120.f);
+            if (ImGui::Combo("Sky Resolution", &skyWidthIndex, "512 x 256\0" "1024 x 512\0" "2048 x 1024\0" "4096 x 2048\0"))
+            {
+                m_ui.proceduralSkyWidth = skyWidths[skyWidthIndex];
+                m_ui.resetAccumulation = true;
+            }
+            ImGui::PopItemWidth();
+
+            ImGui::Checkbox("Progressive Sky Updates", &m_ui.proceduralSkyProgressive);
+            ShowHelpMarker("Render the changes of the procedural sky over several frames, a band of rows at a time. "
+                "Good enough for slow sun motion. The sky is only rendered when the sun or the sky parameters change.");
+            if (m_ui.proceduralSkyProgressive)
+                ImGui::SliderInt("Frames per Sky Update", &m_ui.proceduralSkyProgressiveFrames, 2, 64);
+            ImGui::Text("Sky rows rendered: %u", m_ui.proceduralSkyRowsRendered);
+        }
+
         {
             static float globalEmissiveFactor = 1.0f;
             bool changed;
@@ -1255,8 +1365,7 @@ void UserInterface::SceneSettings()
             case LightType_Directional:
             {
                 engine::DirectionalLight& dirLight = static_cast<engine::DirectionalLight&>(*m_SelectedLight);
-                if (app::LightEditor_Directional(dirLight))
-                    m_ui.environmentMapDirty = 1;
+                app::LightEditor_Directional(dirLight);
                 break;
             }
             case LightType_Spot:
@@ -1272,15 +1381,17 @@ void UserInterface::SceneSettings()
                     {
                         spotLight.profileName = "";
                         spotLight.profileTextureIndex = -1;
+                        m_ui.iesProfilesChanged = true;
                     }
 
-                    for (auto profile : m_ui.resources->iesProfiles)
+                    for (const std::string& profileName : m_ui.resources->iesProfileAtlas->GetProfileNames())
                     {
-                        selected = profile->name == spotLight.profileName;
-                        if (ImGui::Selectable(profile->name.c_str(), &selected) && selected)
+                        selected = profileName == spotLight.profileName;
+                        if (ImGui::Selectable(profileName.c_str(), &selected) && selected)
                         {
-                            spotLight.profileName = profile->name;
+                            spotLight.profileName = profileName;
                             spotLight.profileTextureIndex = -1;
+                            m_ui.iesProfilesChanged = true;
                         }
 
                         if (selected)
@@ -1399,6 +1510,14 @@ void UserInterface::SceneSettings()
     {
         ImGui::SliderFloat("Camera vFOV", &m_ui.verticalFov, 10.f, 110.f);
 
+        ImGui::SliderInt("Additional Views", (int*)&m_ui.additionalViewCount, 0, int(c_MaxViewCount) - 1);
+        ShowHelpMarker(
+            "Render more views of the scene next to the main one, shown as picture-in-picture. "
+            "The views share the light buffer, the PDF textures, the RIS presampling and the ReGIR grid, "
+            "and each of them has its own G-buffer and reservoirs.");
+        if (m_ui.additionalViewCount > 0)
+            ImGui::SliderFloat("View Separation", &m_ui.additionalViewSeparation, 0.f, 1.f);
+
         dm::float3 cameraPos = m_ui.resources->camera->GetPosition();
         ImGui::Text("Camera: %.2f %.2f %.2f", cameraPos.x, cameraPos.y, cameraPos.z);
         if (ImGui::Button("Copy Camera to Clipboard"))
@@ -1415,7 +1534,10 @@ void UserInterface::SceneSettings()
             else
             {
                 ImGui::SameLine();
-                ImGui::Text("Frame %d", m_ui.animationFrame.value());
+                if (m_ui.animationFrame.value() < 0)
+                    ImGui::Text("Warming up");
+                else
+                    ImGui::Text("Frame %d", m_ui.animationFrame.value());
             }
         }
         else
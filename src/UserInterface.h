@@ -20,6 +20,7 @@
 #include <donut/app/imgui_renderer.h>
 #include "GBufferPass.h"
 #include "LightingPasses.h"
+#include "DynamicResolution.h"
 
 #if WITH_NRD
 #include <NRD.h>
@@ -30,10 +31,7 @@
 
 
 class SampleScene;
-
-namespace donut::engine {
-    struct IesProfile;
-}
+class IesProfileAtlas;
 
 namespace donut::app {
     class FirstPersonCamera;
@@ -53,6 +51,12 @@ enum class IndirectLightingMode : uint32_t
     ReStirGI
 };
 
+enum class EnvironmentPresamplingMode : uint32_t
+{
+    MipDescent,
+    AliasTable
+};
+
 enum class QualityPreset : uint32_t
 {
     Custom = 0,
@@ -80,7 +84,7 @@ struct UIResources
     std::shared_ptr<SampleScene> scene;
     donut::app::FirstPersonCamera* camera = nullptr;
 
-    std::vector<std::shared_ptr<donut::engine::IesProfile>> iesProfiles;
+    std::shared_ptr<IesProfileAtlas> iesProfileAtlas;
 
     std::shared_ptr<donut::engine::Material> selectedMaterial;
 };
@@ -105,6 +109,9 @@ enum DebugRenderOutput
     MotionVectors
 };
 
+// The main view and up to three additional views
+constexpr uint32_t c_MaxViewCount = 4;
+
 struct UIData
 {
     bool reloadShaders = false;
@@ -119,11 +126,18 @@ struct UIData
     ibool enableToneMapping = true;
     ibool enablePixelJitter = true;
     ibool rasterizeGBuffer = true;
+    ibool asyncCompute = false; // run the light preparation and presampling on the compute queue
+    ibool parallelRecording = false; // record the G-buffer command list on a worker thread
     ibool useRayQuery = true;
     ibool enableBloom = true;
     float exposureBias = -1.0f;
     float verticalFov = 60.f;
 
+    // The additional views are offset from the main camera horizontally, e.g. for the second eye of a stereo pair,
+    // and shown as picture-in-picture. They share the light presampling with the main view.
+    uint32_t additionalViewCount = 0;
+    float additionalViewSeparation = 0.065f;
+
     QualityPreset preset = QualityPreset::Medium;
 
 #ifdef WITH_DLSS
@@ -139,10 +153,19 @@ struct UIData
     ibool enableAnimations = true;
     float animationSpeed = 1.f;
     int environmentMapDirty = 0; // 1 -> needs to be rendered; 2 -> passes/textures need to be created
-    int environmentMapIndex = -1;
+    int environmentMapIndex = -1; // the renderer switches to the selected map once it has been loaded
+    bool environmentMapLoading = false; // set by the renderer every frame
+    bool iesProfilesChanged = false; // the IES profiles of the spot lights need to be resolved again
+    int environmentMapPrefetchCount = 0; // number of maps after the selected one to load in the background
+    bool environmentMapCompression = false; // load the maps from files as BC6H
     bool environmentMapImportanceSampling = true;
+    EnvironmentPresamplingMode environmentPresamplingMode = EnvironmentPresamplingMode::MipDescent;
     float environmentIntensityBias = 0.f;
     float environmentRotation = 0.f;
+    uint32_t proceduralSkyWidth = 2048;
+    bool proceduralSkyProgressive = false;
+    int proceduralSkyProgressiveFrames = 16;
+    uint32_t proceduralSkyRowsRendered = 0; // set by the renderer every frame
     
     bool enableDenoiser = true;
 #ifdef WITH_NRD
@@ -163,6 +186,8 @@ struct UIData
 #endif
 
     float resolutionScale = 1.f;
+    bool enableDynamicResolution = false; // drives resolutionScale from the GPU frame time
+    DynamicResolutionSettings dynamicResolution;
 
     bool enableFpsLimit = false;
     uint32_t fpsLimit = 60;
@@ -24,7 +24,6 @@
 #include <donut/engine/FramebufferFactory.h>
 #include <donut/engine/DescriptorTableManager.h>
 #include <donut/engine/View.h>
-#include <donut/engine/IesProfile.h>
 #include <donut/app/DeviceManager.h>
 #include <donut/core/log.h>
 #include <donut/core/vfs/VFS.h>
@@ -37,13 +36,19 @@
 #include "RenderTargets.h"
 #include "ConfidencePass.h"
 #include "FilterGradientsPass.h"
+#include "SampleBudgetPass.h"
+#include "TileCompactionPass.h"
 #include "CompositingPass.h"
 #include "AccumulationPass.h"
+#include "ConvergenceErrorPass.h"
 #include "GBufferPass.h"
 #include "GlassPass.h"
 #include "PrepareLightsPass.h"
 #include "RenderEnvironmentMapPass.h"
 #include "GenerateMipsPass.h"
+#include "EnvironmentPdfBuilder.h"
+#include "EnvironmentMapLoader.h"
+#include "IesProfileAtlas.h"
 #include "LightingPasses.h"
 #include "RtxdiResources.h"
 #include "SampleScene.h"
@@ -51,6 +56,14 @@
 #include "UserInterface.h"
 #include "VisualizationPass.h"
 #include "Testing.h"
+#include "Benchmark.h"
+#include "BenchmarkSweep.h"
+#include "ConvergenceMeasurement.h"
+#include "FrameCapture.h"
+#include "PipelineCreation.h"
+#include "DynamicResolution.h"
+#include "RecordingThreads.h"
+#include "SelfTest.h"
 #include "DebugViz/DebugVizPasses.h"
 
 #if WITH_NRD
@@ -61,6 +74,9 @@
 #include "DLSS.h"
 #endif
 
+#include <algorithm>
+#include <chrono>
+
 #ifndef _WIN32
 #include <unistd.h>
 #else
@@ -77,14 +93,41 @@ using namespace std::chrono;
 
 static int g_ExitCode = 0;
 
+// A view that is rendered after the main one, using the light buffer, the RIS presampling and the ReGIR grid
+// that were built for the main view. It has its own G-buffer, reservoirs and lighting outputs, and goes through
+// compositing and tone mapping without the denoiser or the temporal anti-aliasing.
+struct AdditionalView
+{
+    engine::PlanarView view;
+    engine::PlanarView viewPrevious;
+    bool previousViewValid = false;
+
+    std::unique_ptr<RenderTargets> renderTargets;
+    std::unique_ptr<RtxdiResources> rtxdiResources;
+    std::unique_ptr<RaytracedGBufferPass> gbufferPass;
+    std::unique_ptr<PostprocessGBufferPass> postprocessGBufferPass;
+    std::unique_ptr<LightingPasses> lightingPasses;
+    std::unique_ptr<CompositingPass> compositingPass;
+    std::unique_ptr<render::ToneMappingPass> toneMappingPass;
+};
+
 class SceneRenderer : public app::ApplicationBase
 {
 private:
     nvrhi::CommandListHandle m_CommandList;
+    nvrhi::CommandListHandle m_ComputeCommandList; // nullptr if the device has no compute queue
+    nvrhi::CommandListHandle m_GBufferCommandList;
+    nvrhi::CommandListHandle m_LightPreparationCommandList; // used instead of m_ComputeCommandList without async compute
+    nvrhi::CommandListHandle m_LightingCommandList;
+    std::unique_ptr<RecordingThreads> m_RecordingThreads;
+    bool m_PipelinesUseRayQuery = false; // setting that the G-buffer and glass pipelines were created with
+    std::vector<LightingPipelinePermutation> m_PrewarmPermutations; // lighting pipelines to create in LoadShaders
+    std::vector<PipelineCreationTime> m_PipelineCreationTimes; // pipelines created in LoadShaders, except the lighting passes
     
     nvrhi::BindingLayoutHandle m_BindlessLayout;
 
     std::shared_ptr<vfs::RootFileSystem> m_RootFs;
+    std::filesystem::path m_ScenePath;
     std::shared_ptr<engine::ShaderFactory> m_ShaderFactory;
     std::shared_ptr<SampleScene> m_Scene;
     std::shared_ptr<engine::DescriptorTableManager> m_DescriptorTableManager;
@@ -98,7 +141,13 @@ private:
     engine::PlanarView m_UpscaledView;
     std::shared_ptr<engine::DirectionalLight> m_SunLight;
     std::shared_ptr<EnvironmentLight> m_EnvironmentLight;
+    std::unique_ptr<EnvironmentMapLoader> m_EnvironmentMapLoader;
+    std::shared_ptr<EnvironmentMapLoader::Map> m_LoadedEnvironmentMap;
     std::shared_ptr<engine::LoadedTexture> m_EnvironmentMap;
+    int m_ActiveEnvironmentMapIndex = -1; // the map that is rendered, m_ui.environmentMapIndex may still be loading
+    bool m_ActiveEnvironmentMapCompression = false;
+    std::shared_ptr<EnvironmentPdfMips> m_EnvironmentPdfMips;
+    std::shared_ptr<EnvironmentAliasTable> m_EnvironmentAliasTable;
     engine::BindingCache m_BindingCache;
 
     std::unique_ptr<rtxdi::ImportanceSamplingContext> m_isContext;
@@ -108,8 +157,11 @@ private:
     std::unique_ptr<GlassPass> m_GlassPass;
     std::unique_ptr<FilterGradientsPass> m_FilterGradientsPass;
     std::unique_ptr<ConfidencePass> m_ConfidencePass;
+    std::unique_ptr<SampleBudgetPass> m_SampleBudgetPass;
+    std::unique_ptr<TileCompactionPass> m_TileCompactionPass;
     std::unique_ptr<CompositingPass> m_CompositingPass;
     std::unique_ptr<AccumulationPass> m_AccumulationPass;
+    std::unique_ptr<ConvergenceErrorPass> m_ConvergenceErrorPass;
     std::unique_ptr<PrepareLightsPass> m_PrepareLightsPass;
     std::unique_ptr<RenderEnvironmentMapPass> m_RenderEnvironmentMapPass;
     std::unique_ptr<GenerateMipsPass> m_EnvironmentMapPdfMipmapPass;
@@ -117,11 +169,28 @@ private:
     std::unique_ptr<LightingPasses> m_LightingPasses;
     std::unique_ptr<VisualizationPass> m_VisualizationPass;
     std::unique_ptr<RtxdiResources> m_RtxdiResources;
-    std::unique_ptr<engine::IesProfileLoader> m_IesProfileLoader;
+    std::vector<AdditionalView> m_AdditionalViews;
+    std::shared_ptr<IesProfileAtlas> m_IesProfileAtlas;
     std::shared_ptr<Profiler> m_Profiler;
     std::unique_ptr<DebugVizPasses> m_DebugVizPasses;
+    std::unique_ptr<BenchmarkStatistics> m_BenchmarkStatistics;
+    std::optional<int> m_BenchmarkFrameInFlight; // benchmark frame rendered in the previous RenderScene call
+    std::unique_ptr<BenchmarkSweep> m_BenchmarkSweep;
+    std::unique_ptr<FrameCapture> m_FrameCapture;
+    std::unique_ptr<ConvergenceMeasurement> m_ConvergenceMeasurement;
+    std::unique_ptr<SweepNoiseMeasurement> m_SweepNoiseMeasurement; // of the current sweep entry, after its timed frames
+    DynamicResolutionController m_DynamicResolution;
+    bool m_DynamicResolutionActive = false;
+    bool m_VerifyEnvironmentPdfPending = false;
+    size_t m_BenchmarkSweepIndex = 0;
 
     uint32_t m_RenderFrameIndex = 0;
+
+    // Offscreen replacement for the swap chain when running with --headless
+    nvrhi::TextureHandle m_HeadlessColorTexture;
+    nvrhi::FramebufferHandle m_HeadlessFramebuffer;
+    uint32_t m_HeadlessFrameIndex = 0;
+    bool m_ExitRequested = false;
     
 #if WITH_NRD
     std::unique_ptr<NrdIntegration> m_NRD;
@@ -137,7 +206,6 @@ private:
     bool m_PreviousViewValid = false;
     time_point<steady_clock> m_PreviousFrameTimeStamp;
 
-    std::vector<std::shared_ptr<engine::IesProfile>> m_IesProfiles;
     
     dm::float3 m_RegirCenter;
     
@@ -170,6 +238,20 @@ public:
         return m_RootFs;
     }
 
+    // The device manager doesn't advance its frame index without a swap chain, so count the frames here in headless mode.
+    [[nodiscard]] uint32_t GetCurrentFrameIndex() const
+    {
+        return m_args.headless ? m_HeadlessFrameIndex : GetFrameIndex();
+    }
+
+    void RequestExit()
+    {
+        if (m_args.headless)
+            m_ExitRequested = true;
+        else
+            glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
+    }
+
     bool Init()
     {
         std::filesystem::path mediaPath = app::GetDirectoryWithExecutable().parent_path() / "rtxdi-assets";
@@ -211,21 +293,25 @@ public:
             m_BindlessLayout = GetDevice()->createBindlessLayout(bindlessLayoutDesc);
         }
 
-        std::filesystem::path scenePath = "/rtxdi-assets/bistro-rtxdi.scene.json";
+        m_ScenePath = "/rtxdi-assets/bistro-rtxdi.scene.json";
 
         m_DescriptorTableManager = std::make_shared<engine::DescriptorTableManager>(GetDevice(), m_BindlessLayout);
 
         m_TextureCache = std::make_shared<donut::engine::TextureCache>(GetDevice(), m_RootFs, m_DescriptorTableManager);
         m_TextureCache->SetInfoLogSeverity(donut::log::Severity::Debug);
+
+        m_EnvironmentMapLoader = std::make_unique<EnvironmentMapLoader>(GetDevice(), m_RootFs, m_TextureCache, m_CommonPasses, m_DescriptorTableManager);
+        UpdateEnvironmentMapCompression();
         
-        m_IesProfileLoader = std::make_unique<engine::IesProfileLoader>(GetDevice(), m_ShaderFactory, m_DescriptorTableManager);
+        m_IesProfileAtlas = std::make_shared<IesProfileAtlas>(GetDevice(), m_DescriptorTableManager);
 
         auto sceneTypeFactory = std::make_shared<SampleSceneTypeFactory>();
         m_Scene = std::make_shared<SampleScene>(GetDevice(), *m_ShaderFactory, m_RootFs, m_TextureCache, m_DescriptorTableManager, sceneTypeFactory);
         m_ui.resources->scene = m_Scene;
 
-        SetAsynchronousLoadingEnabled(true);
-        BeginLoadingScene(m_RootFs, scenePath);
+        // Load synchronously in headless mode, there is no loading screen to keep responsive.
+        SetAsynchronousLoadingEnabled(!m_args.headless);
+        BeginLoadingScene(m_RootFs, m_ScenePath);
         GetDeviceManager()->SetVsyncEnabled(true);
 
         if (!GetDevice()->queryFeatureSupport(nvrhi::Feature::RayQuery))
@@ -234,8 +320,58 @@ public:
         m_Profiler = std::make_shared<Profiler>(*GetDeviceManager());
         m_ui.resources->profiler = m_Profiler;
 
+        std::vector<std::string> sectionNames;
+        for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+            sectionNames.push_back(Profiler::GetSectionName(ProfilerSection::Enum(section)));
+        m_BenchmarkStatistics = std::make_unique<BenchmarkStatistics>(std::move(sectionNames));
+
+        if (!m_args.saveFrameFileName.empty())
+        {
+            FrameCaptureSettings captureSettings;
+            captureSettings.firstFrame = m_args.saveFrameIndex;
+            captureSettings.lastFrame = m_args.saveLastFrameIndex;
+            captureSettings.interval = m_args.saveFrameInterval;
+            captureSettings.fileName = m_args.saveFrameFileName;
+            captureSettings.captureHdr = m_args.saveHdr;
+            m_FrameCapture = std::make_unique<FrameCapture>(GetDevice(), captureSettings);
+        }
+
+        if (!m_args.benchmarkSweepFileName.empty())
+        {
+            m_BenchmarkSweep = std::make_unique<BenchmarkSweep>();
+            if (!m_BenchmarkSweep->LoadConfig(m_args.benchmarkSweepFileName) || m_BenchmarkSweep->GetEntries().empty())
+                return false;
+
+            if (m_BenchmarkSweep->GetFramesPerEntry() > 0)
+                m_args.benchmarkFrames = m_BenchmarkSweep->GetFramesPerEntry();
+
+            if (m_BenchmarkSweep->GetErrorFrames() > 0)
+                m_ConvergenceErrorPass = std::make_unique<ConvergenceErrorPass>(GetDevice(), m_ShaderFactory);
+
+            StartBenchmarkSweepEntry(0);
+        }
+
+        if (!m_args.convergencePresets.empty())
+        {
+            ConvergenceSettings convergenceSettings;
+            if (!ParseConvergencePresets(m_args.convergencePresets, convergenceSettings.presets))
+                return false;
+
+            convergenceSettings.framesPerPreset = m_args.convergenceFrames;
+            convergenceSettings.referenceFrames = m_args.convergenceReferenceFrames;
+            m_ConvergenceMeasurement = std::make_unique<ConvergenceMeasurement>(convergenceSettings);
+            if (!m_ConvergenceErrorPass)
+                m_ConvergenceErrorPass = std::make_unique<ConvergenceErrorPass>(GetDevice(), m_ShaderFactory);
+        }
+
         m_FilterGradientsPass = std::make_unique<FilterGradientsPass>(GetDevice(), m_ShaderFactory);
+        if (m_args.verifyGradientFilter)
+            m_FilterGradientsPass->RequestCapture();
         m_ConfidencePass = std::make_unique<ConfidencePass>(GetDevice(), m_ShaderFactory);
+        if (m_args.verifyConfidence)
+            m_ConfidencePass->RequestCapture();
+        m_SampleBudgetPass = std::make_unique<SampleBudgetPass>(GetDevice(), m_ShaderFactory);
+        m_TileCompactionPass = std::make_unique<TileCompactionPass>(GetDevice(), m_ShaderFactory);
         m_CompositingPass = std::make_unique<CompositingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_BindlessLayout);
         m_AccumulationPass = std::make_unique<AccumulationPass>(GetDevice(), m_ShaderFactory);
         m_GBufferPass = std::make_unique<RaytracedGBufferPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
@@ -259,29 +395,41 @@ public:
         }
 #endif
 
+        if (!CollectPrewarmPermutations())
+            return false;
+
         LoadShaders();
 
-        std::vector<std::string> profileNames;
-        m_RootFs->enumerateFiles("/rtxdi-assets/ies-profiles", { ".ies" }, vfs::enumerate_to_vector(profileNames));
+        m_IesProfileAtlas->LoadProfiles(*m_RootFs, "/rtxdi-assets/ies-profiles");
+        m_ui.resources->iesProfileAtlas = m_IesProfileAtlas;
 
-        for (const std::string& profileName : profileNames)
-        {
-            auto profile = m_IesProfileLoader->LoadIesProfile(*m_RootFs, "/rtxdi-assets/ies-profiles/" + profileName);
+        m_CommandList = GetDevice()->createCommandList();
+        m_GBufferCommandList = GetDevice()->createCommandList();
+        m_LightPreparationCommandList = GetDevice()->createCommandList();
+        m_LightingCommandList = GetDevice()->createCommandList();
 
-            if (profile)
-            {
-                m_IesProfiles.push_back(profile);
-            }
-        }
-        m_ui.resources->iesProfiles = m_IesProfiles;
+        // Each command list tracks the resource states on its own and the binding cache is locked internally,
+        // so the G-buffer command list can be recorded on this thread while the main thread records the others.
+        m_RecordingThreads = std::make_unique<RecordingThreads>(1);
 
-        m_CommandList = GetDevice()->createCommandList();
+        if (GetDevice()->queryFeatureSupport(nvrhi::Feature::ComputeQueue))
+        {
+            m_ComputeCommandList = GetDevice()->createCommandList(nvrhi::CommandListParameters()
+                .setQueueType(nvrhi::CommandQueue::Compute));
+        }
 
         return true;
     }
 
+    // Resolves the profile names of the spot lights to atlas rows, and bakes the profiles that weren't used before.
+    // Only runs when the scene is loaded or a profile assignment changes in the UI, not every frame.
     void AssignIesProfiles(nvrhi::ICommandList* commandList)
     {
+        if (!m_ui.iesProfilesChanged)
+            return;
+
+        m_ui.iesProfilesChanged = false;
+
         for (const auto& light : m_Scene->GetSceneGraph()->GetLights())
         {
             if (light->GetLightType() == LightType_Spot)
@@ -294,24 +442,26 @@ public:
                 if (spotLight.profileTextureIndex >= 0)
                     continue;
 
-                auto foundProfile = std::find_if(m_IesProfiles.begin(), m_IesProfiles.end(),
-                    [&spotLight](auto it) { return it->name == spotLight.profileName; });
-
-                if (foundProfile != m_IesProfiles.end())
+                const int profileIndex = m_IesProfileAtlas->FindProfile(spotLight.profileName);
+                if (profileIndex < 0)
                 {
-                    m_IesProfileLoader->BakeIesProfile(**foundProfile, commandList);
-
-                    spotLight.profileTextureIndex = (*foundProfile)->textureIndex;
+                    log::warning("Unknown IES profile '%s'", spotLight.profileName.c_str());
+                    continue;
                 }
+
+                spotLight.profileAtlasRows = m_IesProfileAtlas->UseProfile(profileIndex);
+                spotLight.profileTextureIndex = m_IesProfileAtlas->GetTextureIndex();
             }
         }
+
+        m_IesProfileAtlas->Upload(commandList);
     }
 
     virtual void SceneLoaded() override
     {
         ApplicationBase::SceneLoaded();
 
-        m_Scene->FinishedLoading(GetFrameIndex());
+        m_Scene->FinishedLoading(GetCurrentFrameIndex());
 
         m_Camera.LookAt(float3(-7.688f, 2.0f, 5.594f), float3(-7.3341f, 2.0f, 6.5366f));
         m_Camera.SetMoveSpeed(3.f);
@@ -335,6 +485,8 @@ public:
             m_SunLight->angularSize = 1.f;
         }
 
+        m_ui.iesProfilesChanged = true;
+
         m_CommandList->open();
         AssignIesProfiles(m_CommandList);
         m_CommandList->close();
@@ -346,6 +498,29 @@ public:
         m_EnvironmentLight->SetName("Environment");
         m_ui.environmentMapDirty = 2;
         m_ui.environmentMapIndex = 0;
+
+        if (!m_args.environmentMapName.empty())
+        {
+            const auto& environmentMaps = m_Scene->GetEnvironmentMaps();
+            for (size_t index = 1; index < environmentMaps.size(); index++)
+            {
+                if (std::filesystem::path(environmentMaps[index]).filename() == m_args.environmentMapName)
+                {
+                    m_ui.environmentMapIndex = int(index);
+                    break;
+                }
+            }
+
+            if (m_ui.environmentMapIndex == 0)
+                log::warning("Environment map '%s' not found, using the procedural sky.", m_args.environmentMapName.c_str());
+            else
+            {
+                // There is no previous map to keep rendering while this one loads, so start with it right away
+                const std::string& environmentMapPath = environmentMaps[m_ui.environmentMapIndex];
+                m_EnvironmentMapLoader->Request(environmentMapPath);
+                m_EnvironmentMapLoader->Wait(environmentMapPath);
+            }
+        }
         
         m_RasterizedGBufferPass->CreateBindingSet();
 
@@ -358,14 +533,78 @@ public:
     
     void LoadShaders()
     {
-        m_FilterGradientsPass->CreatePipeline();
-        m_ConfidencePass->CreatePipeline();
-        m_CompositingPass->CreatePipeline();
-        m_AccumulationPass->CreatePipeline();
-        m_GBufferPass->CreatePipeline(m_ui.useRayQuery);
-        m_PostprocessGBufferPass->CreatePipeline();
-        m_GlassPass->CreatePipeline(m_ui.useRayQuery);
-        m_PrepareLightsPass->CreatePipeline();
+        // These passes load their shaders and create their pipelines in one call, which needs the shader factory,
+        // so they all run as the serial load step on this thread. The jobs are only used to time them.
+        // Unless running headless, this overlaps with the scene loading in the background.
+        std::vector<PipelineCreationJob> jobs = {
+            { "FilterGradients", [this]() { m_FilterGradientsPass->CreatePipeline(); } },
+            { "Confidence", [this]() { m_ConfidencePass->CreatePipeline(); } },
+            { "SampleBudget", [this]() { m_SampleBudgetPass->CreatePipeline(); } },
+            { "TileCompaction", [this]() { m_TileCompactionPass->CreatePipeline(); } },
+            { "Compositing", [this]() { m_CompositingPass->CreatePipeline(); } },
+            { "Accumulation", [this]() { m_AccumulationPass->CreatePipeline(); } },
+            { "GBuffer", [this]() { m_GBufferPass->CreatePipeline(m_ui.useRayQuery); } },
+            { "PostprocessGBuffer", [this]() { m_PostprocessGBufferPass->CreatePipeline(); } },
+            { "Glass", [this]() { m_GlassPass->CreatePipeline(m_ui.useRayQuery); } },
+            { "PrepareLights", [this]() { m_PrepareLightsPass->CreatePipeline(); } },
+        };
+        if (m_ConvergenceErrorPass)
+            jobs.push_back({ "ConvergenceError", [this]() { m_ConvergenceErrorPass->CreatePipeline(); } });
+
+        m_PipelineCreationTimes.clear();
+        RunPipelineCreationJobs(jobs, 1, m_PipelineCreationTimes);
+        m_PipelinesUseRayQuery = m_ui.useRayQuery;
+
+        if (!m_PrewarmPermutations.empty())
+            m_LightingPasses->PrewarmPipelines(m_PrewarmPermutations, m_args.pipelineThreads);
+    }
+
+    // Pipelines created so far, for the benchmark results
+    [[nodiscard]] std::vector<PipelineCreationTime> GetPipelineCreationTimes() const
+    {
+        std::vector<PipelineCreationTime> times = m_PipelineCreationTimes;
+        const auto& lightingTimes = m_LightingPasses->GetPipelineCreationTimes();
+        times.insert(times.end(), lightingTimes.begin(), lightingTimes.end());
+        return times;
+    }
+
+    // Collects the lighting pipeline permutations from the command line and from the benchmark sweep,
+    // skipping the ones that the device doesn't support.
+    bool CollectPrewarmPermutations()
+    {
+        std::vector<LightingPipelinePermutation> permutations;
+
+        if (!m_args.prewarmPipelines.empty() && !ParseLightingPipelinePermutations(m_args.prewarmPipelines, m_ui.useRayQuery, permutations))
+            return false;
+
+        // Switching between the sweep entries shouldn't wait for the shaders
+        if (m_BenchmarkSweep)
+        {
+            for (const auto& entry : m_BenchmarkSweep->GetEntries())
+            {
+                if (entry.regirMode.has_value())
+                    permutations.push_back({ *entry.regirMode, m_ui.useRayQuery });
+            }
+        }
+
+        const bool rayQuerySupported = GetDevice()->queryFeatureSupport(nvrhi::Feature::RayQuery);
+        const bool rayTracingPipelineSupported = GetDevice()->queryFeatureSupport(nvrhi::Feature::RayTracingPipeline);
+
+        for (const auto& permutation : permutations)
+        {
+            if (permutation.useRayQuery ? !rayQuerySupported : !rayTracingPipelineSupported)
+                continue;
+
+            const bool duplicate = std::any_of(m_PrewarmPermutations.begin(), m_PrewarmPermutations.end(),
+                [&permutation](const LightingPipelinePermutation& other) {
+                    return other.regirMode == permutation.regirMode && other.useRayQuery == permutation.useRayQuery;
+                });
+
+            if (!duplicate)
+                m_PrewarmPermutations.push_back(permutation);
+        }
+
+        return true;
     }
 
     virtual bool LoadScene(std::shared_ptr<vfs::IFileSystem> fs, const std::filesystem::path& sceneFileName) override 
@@ -456,7 +695,7 @@ public:
         if (m_ui.isLoading)
             return;
 
-        if (!m_args.saveFrameFileName.empty())
+        if (!m_args.saveFrameFileName.empty() || m_args.headless)
             fElapsedTimeSeconds = 1.f / 60.f;
 
         m_Camera.Animate(fElapsedTimeSeconds);
@@ -477,10 +716,16 @@ public:
         if (m_RenderTargets && m_RenderTargets->Size.x == int(width) && m_RenderTargets->Size.y == int(height))
             return;
 
+        ResetRenderTargets();
+    }
+
+    void ResetRenderTargets()
+    {
         m_BindingCache.Clear();
         m_RenderTargets = nullptr;
         m_isContext = nullptr;
         m_RtxdiResources = nullptr;
+        m_AdditionalViews.clear();
         m_TemporalAntiAliasingPass = nullptr;
         m_ToneMappingPass = nullptr;
         m_BloomPass = nullptr;
@@ -489,41 +734,113 @@ public:
 #endif
     }
 
-    void LoadEnvironmentMap()
+    void UpdateEnvironmentMapCompression()
     {
-        if (m_EnvironmentMap)
-        {
-            // Make sure there is no rendering in-flight before we unload the texture and erase its descriptor.
-            // Decsriptor manipulations are synchronous and immediately affect whatever is executing on the GPU.
-            GetDevice()->waitForIdle();
+        // The PDF verification runs the GPU PDF pass on the map texture, which must have the same contents as the file
+        m_EnvironmentMapLoader->SetCompressionEnabled(m_ui.environmentMapCompression && !m_args.verifyEnvironmentPdf);
+        m_ui.environmentMapCompression = m_EnvironmentMapLoader->IsCompressionEnabled();
+    }
 
-            m_TextureCache->UnloadTexture(m_EnvironmentMap);
-            
-            m_EnvironmentMap = nullptr;
-        }
+    // Switches to the selected environment map once it has been loaded in the background, and keeps rendering
+    // the previous map until then. Also starts loading the maps that follow the selected one when prefetching is enabled.
+    void UpdateEnvironmentMap()
+    {
+        if (m_ui.environmentMapCompression != m_EnvironmentMapLoader->IsCompressionEnabled())
+            UpdateEnvironmentMapCompression();
 
-        if (m_ui.environmentMapIndex > 0)
+        m_EnvironmentMapLoader->Update();
+
+        auto& environmentMaps = m_Scene->GetEnvironmentMaps();
+        m_ui.environmentMapLoading = false;
+
+        if (m_ui.environmentMapIndex > 0 && (m_ui.environmentMapIndex != m_ActiveEnvironmentMapIndex ||
+            m_ActiveEnvironmentMapCompression != m_EnvironmentMapLoader->IsCompressionEnabled()))
         {
-            auto& environmentMaps = m_Scene->GetEnvironmentMaps();
             const std::string& environmentMapPath = environmentMaps[m_ui.environmentMapIndex];
 
-            m_EnvironmentMap = m_TextureCache->LoadTextureFromFileDeferred(environmentMapPath, false);
+            m_EnvironmentMapLoader->Request(environmentMapPath);
 
-            if (m_TextureCache->IsTextureLoaded(m_EnvironmentMap))
-            {
-                m_TextureCache->ProcessRenderingThreadCommands(*m_CommonPasses, 0.f);
-                m_TextureCache->LoadingFinished();
+            // Captures must not depend on how long the loading takes
+            if (m_args.headless)
+                m_EnvironmentMapLoader->Wait(environmentMapPath);
 
-                m_EnvironmentMap->bindlessDescriptor = m_DescriptorTableManager->CreateDescriptorHandle(nvrhi::BindingSetItem::Texture_SRV(0, m_EnvironmentMap->texture));
-            }
-            else
+            if (m_EnvironmentMapLoader->HasFailed(environmentMapPath))
             {
                 // Failed to load the file: revert to the procedural map and remove this file from the list.
-                m_EnvironmentMap = nullptr;
                 environmentMaps.erase(environmentMaps.begin() + m_ui.environmentMapIndex);
+                if (m_ActiveEnvironmentMapIndex > m_ui.environmentMapIndex)
+                    --m_ActiveEnvironmentMapIndex;
                 m_ui.environmentMapIndex = 0;
             }
+            else if (const auto map = m_EnvironmentMapLoader->GetMap(environmentMapPath))
+            {
+                m_LoadedEnvironmentMap = map;
+                m_EnvironmentMap = map->texture;
+                m_EnvironmentPdfMips = map->pdfMips;
+                m_EnvironmentAliasTable = nullptr;
+                m_ActiveEnvironmentMapIndex = m_ui.environmentMapIndex;
+                m_ActiveEnvironmentMapCompression = m_EnvironmentMapLoader->IsCompressionEnabled();
+                m_ui.environmentMapDirty = 2;
+            }
+            else
+                m_ui.environmentMapLoading = true;
+        }
+
+        // The procedural map and no map at all don't need loading
+        if (m_ui.environmentMapIndex <= 0 && m_ui.environmentMapIndex != m_ActiveEnvironmentMapIndex)
+        {
+            m_LoadedEnvironmentMap = nullptr;
+            m_EnvironmentMap = nullptr;
+            m_EnvironmentPdfMips = nullptr;
+            m_EnvironmentAliasTable = nullptr;
+            m_ActiveEnvironmentMapIndex = m_ui.environmentMapIndex;
+            m_ui.environmentMapDirty = 2;
         }
+
+        // Keep the map that is rendered, the one that is loading, and the next ones in the list.
+        // The other maps are released by the loader after the GPU has finished using them, so there's no need to wait for idle here.
+        std::vector<std::string> retainedMaps;
+        if (m_ActiveEnvironmentMapIndex > 0)
+            retainedMaps.push_back(environmentMaps[m_ActiveEnvironmentMapIndex]);
+        if (m_ui.environmentMapIndex > 0)
+            retainedMaps.push_back(environmentMaps[m_ui.environmentMapIndex]);
+
+        const int numFileMaps = int(environmentMaps.size()) - 1;
+        const int prefetchCount = std::min(m_ui.environmentMapPrefetchCount, numFileMaps - 1);
+        for (int offset = 1; offset <= prefetchCount; offset++)
+        {
+            const int index = (std::max(m_ui.environmentMapIndex, 0) + offset - 1) % numFileMaps + 1;
+            m_EnvironmentMapLoader->Request(environmentMaps[index]);
+            retainedMaps.push_back(environmentMaps[index]);
+        }
+
+        m_EnvironmentMapLoader->Retain(retainedMaps, m_LoadedEnvironmentMap);
+    }
+
+    // Picks the resolution scale for the next frame from the GPU time of the last resolved one.
+    // The render targets are allocated for the full scale, so a new scale only changes the viewport,
+    // and the temporal passes take the previous viewport size from the previous view.
+    void UpdateDynamicResolution()
+    {
+        if (!m_ui.enableDynamicResolution)
+        {
+            m_DynamicResolutionActive = false;
+            return;
+        }
+
+        m_DynamicResolution.SetSettings(m_ui.dynamicResolution);
+
+        if (!m_DynamicResolutionActive)
+        {
+            m_DynamicResolution.Reset(m_ui.resolutionScale);
+            m_DynamicResolutionActive = true;
+        }
+
+        // Accumulation needs every frame to be rendered the same way
+        if (m_ui.aaMode != AntiAliasingMode::Accumulation && m_Profiler->IsEnabled())
+            m_DynamicResolution.Update(m_Profiler->GetLatestTimer(ProfilerSection::Frame));
+
+        m_ui.resolutionScale = m_DynamicResolution.GetScale();
     }
 
     void SetupView(uint32_t renderWidth, uint32_t renderHeight, const engine::PerspectiveCamera* activeCamera)
@@ -562,6 +879,52 @@ public:
         m_UpscaledView.SetViewport(windowViewport);
     }
 
+    // Creates or removes the additional views to match the UI. The views are created again when the resources
+    // of the main view change, because they share the light buffers and the RTXDI context with it.
+    void SetupAdditionalViews(uint32_t renderWidth, uint32_t renderHeight, bool mainViewResourcesCreated)
+    {
+        const size_t viewCount = mainViewResourcesCreated ? 0 : std::min<size_t>(m_AdditionalViews.size(), m_ui.additionalViewCount);
+        if (viewCount < m_AdditionalViews.size())
+        {
+            // The resources may still be in use by the previous frame
+            GetDevice()->waitForIdle();
+            m_AdditionalViews.resize(viewCount);
+        }
+
+        while (m_AdditionalViews.size() < m_ui.additionalViewCount)
+        {
+            AdditionalView& view = m_AdditionalViews.emplace_back();
+
+            view.renderTargets = std::make_unique<RenderTargets>(GetDevice(), int2((int)renderWidth, (int)renderHeight));
+            view.rtxdiResources = std::make_unique<RtxdiResources>(GetDevice(), m_isContext->getReSTIRDIContext(), *m_RtxdiResources);
+
+            view.gbufferPass = std::make_unique<RaytracedGBufferPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
+            view.gbufferPass->CreatePipeline(m_ui.useRayQuery);
+            view.gbufferPass->CreateBindingSet(m_Scene->GetTopLevelAS(), m_Scene->GetPrevTopLevelAS(), *view.renderTargets);
+
+            view.postprocessGBufferPass = std::make_unique<PostprocessGBufferPass>(GetDevice(), m_ShaderFactory);
+            view.postprocessGBufferPass->CreatePipeline();
+            view.postprocessGBufferPass->CreateBindingSet(*view.renderTargets);
+
+            view.lightingPasses = std::make_unique<LightingPasses>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_Profiler, m_BindlessLayout);
+            view.lightingPasses->SharePipelines(*m_LightingPasses);
+            view.lightingPasses->CreateBindingSet(m_Scene->GetTopLevelAS(), m_Scene->GetPrevTopLevelAS(), *view.renderTargets, *view.rtxdiResources);
+
+            view.compositingPass = std::make_unique<CompositingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, m_Scene, m_BindlessLayout);
+            view.compositingPass->CreatePipeline();
+            view.compositingPass->CreateBindingSet(*view.renderTargets);
+
+            render::ToneMappingPass::CreateParameters toneMappingParams;
+            view.toneMappingPass = std::make_unique<render::ToneMappingPass>(GetDevice(), m_ShaderFactory, m_CommonPasses, view.renderTargets->LdrFramebuffer, m_View, toneMappingParams);
+        }
+
+        // Follow the permutation changes of the main view
+        for (AdditionalView& view : m_AdditionalViews)
+            view.lightingPasses->SharePipelines(*m_LightingPasses);
+
+        m_Profiler->SetViewCount(uint32_t(m_AdditionalViews.size()) + 1);
+    }
+
     void SetupRenderPasses(uint32_t renderWidth, uint32_t renderHeight, bool& exposureResetRequired)
     {
         if (m_ui.environmentMapDirty == 2)
@@ -584,18 +947,40 @@ public:
             m_DebugVizPasses = nullptr;
             m_ui.environmentMapDirty = 1;
 
+            m_LightingPasses->ClearPipelineCache();
+            m_AdditionalViews.clear();
             LoadShaders();
         }
+        else if (m_ui.useRayQuery != m_PipelinesUseRayQuery)
+        {
+            // The lighting passes pick their ray query permutation from the cache in CreatePipelines below
+            m_GBufferPass->CreatePipeline(m_ui.useRayQuery);
+            m_GlassPass->CreatePipeline(m_ui.useRayQuery);
+            for (AdditionalView& view : m_AdditionalViews)
+                view.gbufferPass->CreatePipeline(m_ui.useRayQuery);
+            m_PipelinesUseRayQuery = m_ui.useRayQuery;
+        }
 
         bool renderTargetsCreated = false;
         bool rtxdiResourcesCreated = false;
 
+        if (m_RenderEnvironmentMapPass && m_RenderEnvironmentMapPass->GetTexture()->getDesc().width != m_ui.proceduralSkyWidth)
+        {
+            // The texture may still be in use by the previous frame
+            GetDevice()->waitForIdle();
+            m_RenderEnvironmentMapPass = nullptr;
+        }
+
         if (!m_RenderEnvironmentMapPass)
         {
-            m_RenderEnvironmentMapPass = std::make_unique<RenderEnvironmentMapPass>(GetDevice(), m_ShaderFactory, m_DescriptorTableManager, 2048);
+            m_RenderEnvironmentMapPass = std::make_unique<RenderEnvironmentMapPass>(GetDevice(), m_ShaderFactory, m_DescriptorTableManager, m_ui.proceduralSkyWidth);
+
+            // The PDF pass reads the sky texture, so it has to be created again, and the PDF regenerated
+            m_EnvironmentMapPdfMipmapPass = nullptr;
+            m_ui.environmentMapDirty = 1;
         }
         
-        const auto environmentMap = (m_ui.environmentMapIndex > 0)
+        const auto environmentMap = (m_ActiveEnvironmentMapIndex > 0)
             ? m_EnvironmentMap->texture.Get()
             : m_RenderEnvironmentMapPass->GetTexture();
 
@@ -604,11 +989,31 @@ public:
         uint32_t numPrimitiveLights = uint32_t(m_Scene->GetSceneGraph()->GetLights().size());
         uint32_t numGeometryInstances = uint32_t(m_Scene->GetSceneGraph()->GetGeometryInstancesCount());
         
-        uint2 environmentMapSize = uint2(environmentMap->getDesc().width, environmentMap->getDesc().height);
+        uint2 environmentPdfSize;
+        GetEnvironmentPdfTextureSize(environmentMap->getDesc().width, environmentMap->getDesc().height, environmentPdfSize.x, environmentPdfSize.y);
+
+        // The alias table is built from the CPU version of the PDF, so it's only available for the maps loaded from files
+        uint32_t environmentAliasTableSize = 0;
+        if (m_ui.environmentPresamplingMode == EnvironmentPresamplingMode::AliasTable && m_ActiveEnvironmentMapIndex > 0 && m_EnvironmentPdfMips)
+        {
+            if (!m_EnvironmentAliasTable)
+            {
+                // Leaves the table empty if the map is black, and then the mip descent is used instead
+                m_EnvironmentAliasTable = std::make_shared<EnvironmentAliasTable>();
+                if (BuildEnvironmentAliasTable(*m_EnvironmentPdfMips, *m_EnvironmentAliasTable) && m_args.verifyEnvironmentPdf &&
+                    !ValidateEnvironmentAliasTable(*m_EnvironmentPdfMips, *m_EnvironmentAliasTable))
+                {
+                    g_ExitCode = 1;
+                }
+            }
+
+            environmentAliasTableSize = uint32_t(m_EnvironmentAliasTable->entries.size());
+        }
 
         if (m_RtxdiResources && (
-            environmentMapSize.x != m_RtxdiResources->EnvironmentPdfTexture->getDesc().width ||
-            environmentMapSize.y != m_RtxdiResources->EnvironmentPdfTexture->getDesc().height ||
+            environmentPdfSize.x != m_RtxdiResources->EnvironmentPdfTexture->getDesc().width ||
+            environmentPdfSize.y != m_RtxdiResources->EnvironmentPdfTexture->getDesc().height ||
+            environmentAliasTableSize != m_RtxdiResources->GetEnvironmentAliasTableSize() ||
             numEmissiveMeshes > m_RtxdiResources->GetMaxEmissiveMeshes() ||
             numEmissiveTriangles > m_RtxdiResources->GetMaxEmissiveTriangles() || 
             numPrimitiveLights > m_RtxdiResources->GetMaxPrimitiveLights() ||
@@ -645,9 +1050,16 @@ public:
             m_FilterGradientsPass->CreateBindingSet(*m_RenderTargets);
 
             m_ConfidencePass->CreateBindingSet(*m_RenderTargets);
+
+            m_SampleBudgetPass->CreateBindingSet(*m_RenderTargets);
+
+            m_TileCompactionPass->CreateBindingSet(*m_RenderTargets);
             
             m_AccumulationPass->CreateBindingSet(*m_RenderTargets);
 
+            if (m_ConvergenceErrorPass)
+                m_ConvergenceErrorPass->CreateBindingSet(*m_RenderTargets);
+
             m_RasterizedGBufferPass->CreatePipeline(*m_RenderTargets);
 
             m_CompositingPass->CreateBindingSet(*m_RenderTargets);
@@ -672,8 +1084,9 @@ public:
                 (numEmissiveTriangles + triangleAllocationQuantum - 1) & ~(triangleAllocationQuantum - 1),
                 (numPrimitiveLights + primitiveAllocationQuantum - 1) & ~(primitiveAllocationQuantum - 1),
                 numGeometryInstances,
-                environmentMapSize.x,
-                environmentMapSize.y);
+                environmentPdfSize.x,
+                environmentPdfSize.y,
+                environmentAliasTableSize);
 
             m_PrepareLightsPass->CreateBindingSet(*m_RtxdiResources);
             
@@ -710,11 +1123,11 @@ public:
                 *m_RtxdiResources);
         }
 
-        if (rtxdiResourcesCreated || m_ui.reloadShaders)
-        {
-            // Some RTXDI context settings affect the shader permutations
-            m_LightingPasses->CreatePipelines(m_ui.regirStaticParams, m_ui.useRayQuery);
-        }
+        // Some RTXDI context settings affect the shader permutations. This only switches the pipelines when the
+        // permutation changes, and the pipelines don't depend on the resources, so recreating those doesn't matter.
+        m_LightingPasses->CreatePipelines(m_isContext->getReGIRContext().getReGIRStaticParameters(), m_ui.useRayQuery, m_args.pipelineThreads);
+
+        SetupAdditionalViews(renderWidth, renderHeight, renderTargetsCreated || rtxdiResourcesCreated);
 
         m_ui.reloadShaders = false;
 
@@ -766,7 +1179,12 @@ public:
 #endif
 #if WITH_DLSS
         {
-            m_DLSS->SetRenderSize(m_RenderTargets->Size.x, m_RenderTargets->Size.y, m_RenderTargets->Size.x, m_RenderTargets->Size.y);
+            // DLSS takes the largest input size, and the render viewport can be anywhere up to that.
+            // With the dynamic resolution, that's the upper bound, so the scale steps don't recreate the feature.
+            const float maxResolutionScale = m_ui.enableDynamicResolution ? m_ui.dynamicResolution.maxScale : m_ui.resolutionScale;
+            const uint32_t dlssInputWidth = uint32_t(ceilf(float(m_RenderTargets->Size.x) * maxResolutionScale));
+            const uint32_t dlssInputHeight = uint32_t(ceilf(float(m_RenderTargets->Size.y) * maxResolutionScale));
+            m_DLSS->SetRenderSize(dlssInputWidth, dlssInputHeight, m_RenderTargets->Size.x, m_RenderTargets->Size.y);
             
             m_ui.dlssAvailable = m_DLSS->IsAvailable();
         }
@@ -886,6 +1304,316 @@ public:
         return m_isContext->isLocalLightPowerRISEnabled();
     }
 
+    // Applies the settings of one sweep entry. The scene and its BLASes stay loaded, only the objects
+    // that depend on the changed settings are recreated: the render targets when the resolution changes,
+    // and the importance sampling context with the RTXDI resources when the static parameters change.
+    void StartBenchmarkSweepEntry(size_t index)
+    {
+        const BenchmarkSweepEntry& entry = m_BenchmarkSweep->GetEntries()[index];
+        m_BenchmarkSweepIndex = index;
+
+        log::info("Benchmark sweep %d/%d: %s", int(index + 1), int(m_BenchmarkSweep->GetEntries().size()), entry.GetLabel().c_str());
+
+        entry.ApplyToUI(m_ui);
+
+        if (entry.resolution.x > 0 && (entry.resolution.x != m_args.renderWidth || entry.resolution.y != m_args.renderHeight))
+        {
+            m_args.renderWidth = entry.resolution.x;
+            m_args.renderHeight = entry.resolution.y;
+
+            if (m_RenderTargets)
+            {
+                GetDevice()->waitForIdle();
+                ResetRenderTargets();
+            }
+        }
+
+        // Negative frames are warm-up frames, see RenderScene
+        m_ui.animationFrame = -c_BenchmarkSweepWarmupFrames;
+    }
+
+    // Reports what the checkerboard layout saves on the buffers, and the measured time of the passes that work
+    // in the reservoir space. Their saving can only be measured by running the same passes with the checkerboard off,
+    // for example with a sweep over the checkerboard mode.
+    std::string GetCheckerboardLayoutAsText()
+    {
+        if (!m_isContext || !m_RtxdiResources ||
+            m_isContext->getReSTIRDIContext().getStaticParameters().CheckerboardSamplingMode == rtxdi::CheckerboardMode::Off)
+            return "";
+
+        static const ProfilerSection::Enum halfWidthSections[] = {
+            ProfilerSection::BrdfRays,
+            ProfilerSection::ShadeSecondary,
+            ProfilerSection::GITemporalResampling,
+            ProfilerSection::GISpatialResampling,
+            ProfilerSection::GIFusedResampling,
+            ProfilerSection::GIFinalShading
+        };
+
+        double halfWidthTime = 0.0;
+        for (ProfilerSection::Enum section : halfWidthSections)
+            halfWidthTime += m_Profiler->GetTimer(section);
+
+        const double megabyte = 1024.0 * 1024.0;
+        const double size = double(m_RtxdiResources->GetViewResourcesSize()) / megabyte;
+        const double fullResolutionSize = double(m_RtxdiResources->GetFullResolutionViewResourcesSize()) / megabyte;
+
+        char text[256];
+        snprintf(text, sizeof(text),
+            "Checkerboard reservoir layout: %.2f MB (%.2f MB at full resolution, %.2f MB saved)\n"
+            "Checkerboard BRDF, secondary and GI passes: %.3f ms\n",
+            size, fullResolutionSize, fullResolutionSize - size,
+            halfWidthTime);
+
+        return text;
+    }
+
+    void FinishBenchmark()
+    {
+        const std::string pipelineCreationTimes = GetPipelineCreationTimesAsText(GetPipelineCreationTimes());
+        m_ui.benchmarkResults = m_Profiler->GetAsText() + GetCheckerboardLayoutAsText() + "\n" + m_BenchmarkStatistics->GetAsText() + "\n" + pipelineCreationTimes;
+        m_ui.animationFrame.reset();
+
+        if (m_BenchmarkSweep)
+        {
+            const auto& entries = m_BenchmarkSweep->GetEntries();
+            m_BenchmarkSweep->AddResult(entries[m_BenchmarkSweepIndex], *m_BenchmarkStatistics,
+                m_SweepNoiseMeasurement ? m_SweepNoiseMeasurement->GetResult() : std::nullopt);
+            m_SweepNoiseMeasurement = nullptr;
+
+            if (m_BenchmarkSweepIndex + 1 < entries.size())
+            {
+                StartBenchmarkSweepEntry(m_BenchmarkSweepIndex + 1);
+                return;
+            }
+
+            m_ui.benchmarkResults = m_BenchmarkSweep->GetResultsTable(m_ScenePath.filename().generic_string(), GetDeviceManager()->GetRendererString())
+                + "\n" + pipelineCreationTimes;
+        }
+
+        if (m_args.benchmark)
+        {
+            log::info("BENCHMARK RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
+
+            if (!m_args.benchmarkOutputFileName.empty())
+            {
+                if (!WriteBenchmarkResults(m_args.benchmarkOutputFileName, m_ui.benchmarkResults))
+                    g_ExitCode = 1;
+            }
+
+            if (m_FrameCapture && !m_FrameCapture->Flush())
+                g_ExitCode = 1;
+
+            RequestExit();
+        }
+    }
+
+    void FinishConvergenceMeasurement()
+    {
+        m_ui.benchmarkResults = m_ConvergenceMeasurement->GetSummary();
+        log::info("CONVERGENCE RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
+
+        if (!m_args.convergenceOutputFileName.empty())
+        {
+            if (!WriteBenchmarkResults(m_args.convergenceOutputFileName, m_ConvergenceMeasurement->GetCurveCsv()))
+                g_ExitCode = 1;
+        }
+
+        m_ConvergenceMeasurement = nullptr;
+
+        if (m_FrameCapture && !m_FrameCapture->Flush())
+            g_ExitCode = 1;
+
+        RequestExit();
+    }
+
+    HeadlessFrameStatus RenderHeadlessFrame()
+    {
+        if (!m_HeadlessFramebuffer ||
+            m_HeadlessColorTexture->getDesc().width != uint32_t(m_args.renderWidth) ||
+            m_HeadlessColorTexture->getDesc().height != uint32_t(m_args.renderHeight))
+        {
+            nvrhi::TextureDesc textureDesc;
+            textureDesc.width = m_args.renderWidth;
+            textureDesc.height = m_args.renderHeight;
+            textureDesc.format = nvrhi::Format::SRGBA8_UNORM;
+            textureDesc.isRenderTarget = true;
+            textureDesc.initialState = nvrhi::ResourceStates::RenderTarget;
+            textureDesc.keepInitialState = true;
+            textureDesc.clearValue = nvrhi::Color(0.f);
+            textureDesc.useClearValue = true;
+            textureDesc.debugName = "HeadlessColor";
+            m_HeadlessColorTexture = GetDevice()->createTexture(textureDesc);
+
+            m_HeadlessFramebuffer = GetDevice()->createFramebuffer(nvrhi::FramebufferDesc().addColorAttachment(m_HeadlessColorTexture));
+        }
+
+        const uint32_t renderFrameIndex = m_RenderFrameIndex;
+
+        Animate(1.f / 60.f);
+        Render(m_HeadlessFramebuffer);
+        GetDevice()->runGarbageCollection();
+
+        ++m_HeadlessFrameIndex;
+
+        if (m_ExitRequested)
+        {
+            GetDevice()->waitForIdle();
+            return (g_ExitCode == 0) ? HeadlessFrameStatus::Finished : HeadlessFrameStatus::Failed;
+        }
+
+        return (m_RenderFrameIndex != renderFrameIndex) ? HeadlessFrameStatus::Rendered : HeadlessFrameStatus::Loading;
+    }
+
+    // Renders the additional views with the light presampling of the main view, and shows them as a row of
+    // picture-in-picture insets in the bottom right corner of the framebuffer.
+    void RenderAdditionalViews(
+        nvrhi::ICommandList* commandList,
+        nvrhi::IFramebuffer* framebuffer,
+        const LightingPasses::RenderSettings& lightingSettings,
+        bool enableDirectReStirPass,
+        bool enableBrdfAndIndirectPass,
+        uint32_t activeCheckerboardField)
+    {
+        if (m_AdditionalViews.empty())
+            return;
+
+        ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::AdditionalViews);
+        commandList->beginMarker("AdditionalViews");
+
+        // The views have no denoiser, so they don't need the gradients, and the tile list and the sample budget
+        // are only built for the main view. Their rays are not counted either, neither in the G-buffer nor in the lighting.
+        LightingPasses::RenderSettings viewSettings = lightingSettings;
+        viewSettings.denoiserMode = DENOISER_MODE_OFF;
+        viewSettings.enableGradients = false;
+        viewSettings.enableAdaptiveSampleBudget = false;
+        viewSettings.enableTileCompaction = false;
+        viewSettings.enableRayCounts = false;
+
+        GBufferSettings gbufferSettings = m_ui.gbufferSettings;
+        gbufferSettings.enableMaterialReadback = false;
+        gbufferSettings.enableRayCounts = false;
+
+        const float insetSize = 0.25f;
+        const float insetMargin = 0.01f;
+
+        for (uint32_t index = 0; index < uint32_t(m_AdditionalViews.size()); index++)
+        {
+            AdditionalView& view = m_AdditionalViews[index];
+
+            // Move the camera to the right of the main view, in the view space
+            const float offset = m_ui.additionalViewSeparation * float(index + 1);
+            view.view.SetViewport(m_View.GetViewport());
+            view.view.SetMatrices(m_View.GetViewMatrix() * translation(float3(-offset, 0.f, 0.f)), m_View.GetProjectionMatrix(false));
+            view.view.UpdateCache();
+
+            if (!view.previousViewValid)
+                view.viewPrevious = view.view;
+
+            if (m_ui.rasterizeGBuffer)
+                m_RasterizedGBufferPass->Render(commandList, view.view, view.viewPrevious, *view.renderTargets, gbufferSettings);
+            else
+                view.gbufferPass->Render(commandList, view.view, view.viewPrevious, gbufferSettings);
+
+            view.postprocessGBufferPass->Render(commandList, view.view);
+
+            if (enableDirectReStirPass || enableBrdfAndIndirectPass)
+            {
+                view.lightingPasses->WriteResamplingConstants(commandList,
+                    *m_isContext,
+                    view.view, view.viewPrevious,
+                    viewSettings,
+                    m_ui.gbufferSettings,
+                    *m_EnvironmentLight,
+                    false);
+            }
+
+            if (enableDirectReStirPass)
+                view.lightingPasses->RenderDirectLighting(commandList, m_isContext->getReSTIRDIContext(), view.view, viewSettings);
+
+            if (enableBrdfAndIndirectPass)
+                view.lightingPasses->RenderBrdfRays(commandList, *m_isContext, view.view, viewSettings);
+
+            if (!enableDirectReStirPass && !enableBrdfAndIndirectPass)
+            {
+                commandList->clearTextureFloat(view.renderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+                commandList->clearTextureFloat(view.renderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            }
+
+            view.compositingPass->Render(
+                commandList,
+                view.view,
+                view.viewPrevious,
+                DENOISER_MODE_OFF,
+                activeCheckerboardField,
+                false,
+                m_ui,
+                *m_EnvironmentLight);
+
+            if (m_ui.enableToneMapping)
+            {
+                render::ToneMappingParameters toneMappingParams;
+                toneMappingParams.minAdaptedLuminance = 0.002f;
+                toneMappingParams.maxAdaptedLuminance = 0.2f;
+                toneMappingParams.exposureBias = m_ui.exposureBias;
+                toneMappingParams.eyeAdaptationSpeedUp = 2.0f;
+                toneMappingParams.eyeAdaptationSpeedDown = 1.0f;
+
+                view.toneMappingPass->SimpleRender(commandList, toneMappingParams, view.view, view.renderTargets->HdrColor);
+            }
+            else
+            {
+                m_CommonPasses->BlitTexture(commandList, view.renderTargets->LdrFramebuffer->GetFramebuffer(view.view), view.renderTargets->HdrColor, &m_BindingCache);
+            }
+
+            const float insetRight = 1.f - insetMargin - float(index) * (insetSize + insetMargin);
+
+            engine::BlitParameters blitParams;
+            blitParams.sourceTexture = view.renderTargets->LdrColor;
+            blitParams.sourceBox.m_maxs.x = view.view.GetViewport().width() / float(view.renderTargets->Size.x);
+            blitParams.sourceBox.m_maxs.y = view.view.GetViewport().height() / float(view.renderTargets->Size.y);
+            blitParams.targetFramebuffer = framebuffer;
+            blitParams.targetBox = dm::box2(float2(insetRight - insetSize, 1.f - insetMargin - insetSize), float2(insetRight, 1.f - insetMargin));
+            m_CommonPasses->BlitTexture(commandList, blitParams, &m_BindingCache);
+
+            view.viewPrevious = view.view;
+            view.previousViewValid = true;
+        }
+
+        commandList->endMarker();
+    }
+
+    // Records the G-buffer command list, which doesn't depend on the CPU state that the other command lists
+    // modify during the frame, so it can be recorded on a worker thread.
+    void RecordGBufferFill(nvrhi::ICommandList* commandList, nvrhi::IFramebuffer* framebuffer)
+    {
+        const auto startTime = std::chrono::steady_clock::now();
+
+        commandList->open();
+
+        nvrhi::utils::ClearColorAttachment(commandList, framebuffer, 0, nvrhi::Color(0.f));
+
+        {
+            ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::GBufferFill);
+
+            GBufferSettings gbufferSettings = m_ui.gbufferSettings;
+            float upscalingLodBias = ::log2f(m_View.GetViewport().width() / m_UpscaledView.GetViewport().width());
+            gbufferSettings.textureLodBias += upscalingLodBias;
+
+            if (m_ui.rasterizeGBuffer)
+                m_RasterizedGBufferPass->Render(commandList, m_View, m_ViewPrevious, *m_RenderTargets, m_ui.gbufferSettings);
+            else
+                m_GBufferPass->Render(commandList, m_View, m_ViewPrevious, m_ui.gbufferSettings);
+
+            m_PostprocessGBufferPass->Render(commandList, m_View);
+        }
+
+        commandList->close();
+
+        m_Profiler->SetRecordingTime(ProfilerCommandList::GBuffer,
+            std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count());
+    }
+
     void RenderScene(nvrhi::IFramebuffer* framebuffer) override
     {
         if (m_FrameStepMode == FrameStepMode::Wait)
@@ -913,34 +1641,81 @@ public:
         const engine::PerspectiveCamera* activeCamera = nullptr;
         uint effectiveFrameIndex = m_RenderFrameIndex;
 
+        ConvergenceMeasurement::FrameActions convergenceActions;
+        if (m_ConvergenceMeasurement)
+        {
+            convergenceActions = m_ConvergenceMeasurement->BeginFrame(m_ui);
+
+            if (convergenceActions.storeReference)
+                m_ui.storeReferenceImage = true;
+
+#if WITH_NRD
+            // Drop the denoiser history together with the RTXDI context
+            if (convergenceActions.startRun)
+                m_NRD = nullptr;
+#endif
+
+            if (m_ConvergenceMeasurement->IsFinished())
+                FinishConvergenceMeasurement();
+        }
+
+        // ResolvePreviousFrame below reads the timings of the frame rendered in the previous call.
+        // They go into the benchmark statistics when that frame was a benchmark frame.
+        const std::optional<int> resolvedBenchmarkFrame = m_BenchmarkFrameInFlight;
+        m_BenchmarkFrameInFlight.reset();
+
         if (m_ui.animationFrame.has_value())
         {
-            const float animationTime = float(m_ui.animationFrame.value()) * (1.f / 240.f);
-            
+            if (m_ui.animationFrame.value() == 0)
+                m_BenchmarkStatistics->Reset();
+
+            float animationTime = 0.f;
             auto* animation = m_Scene->GetBenchmarkAnimation();
-            if (animation && animationTime < animation->GetDuration())
+            if (m_ui.animationFrame.value() < 0)
+            {
+                // Warm-up frame: render the first benchmark frame without recording it
+                if (animation && GetBenchmarkAnimationTime(0, animation->GetDuration(), m_args.benchmarkFrames, animationTime))
+                {
+                    (void)animation->Apply(animationTime);
+                    activeCamera = m_Scene->GetBenchmarkCamera();
+                }
+                m_ui.animationFrame = m_ui.animationFrame.value() + 1;
+            }
+            else if (animation && GetBenchmarkAnimationTime(m_ui.animationFrame.value(), animation->GetDuration(), m_args.benchmarkFrames, animationTime))
             {
                 (void)animation->Apply(animationTime);
                 activeCamera = m_Scene->GetBenchmarkCamera();
                 effectiveFrameIndex = m_ui.animationFrame.value();
                 m_ui.animationFrame = effectiveFrameIndex + 1;
+                m_BenchmarkFrameInFlight = effectiveFrameIndex;
             }
-            else
+            else if (!resolvedBenchmarkFrame.has_value())
             {
-                m_ui.benchmarkResults = m_Profiler->GetAsText();
-                m_ui.animationFrame.reset();
+                // The timings of the last benchmark frame have been resolved. A sweep with "errorFrames"
+                // measures the noise of the entry next, at the first benchmark frame, see SweepNoiseMeasurement.
+                if (!m_SweepNoiseMeasurement && m_BenchmarkSweep && m_BenchmarkSweep->GetErrorFrames() > 0 && !m_ConvergenceMeasurement)
+                    m_SweepNoiseMeasurement = std::make_unique<SweepNoiseMeasurement>(m_BenchmarkSweep->GetReferenceFrames(), m_BenchmarkSweep->GetErrorFrames());
 
-                if (m_args.benchmark)
+                if (m_SweepNoiseMeasurement && !m_SweepNoiseMeasurement->IsFinished())
                 {
-                    glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), GLFW_TRUE);
-                    log::info("BENCHMARK RESULTS >>>\n\n%s<<<", m_ui.benchmarkResults.c_str());
+                    if (animation && GetBenchmarkAnimationTime(0, animation->GetDuration(), m_args.benchmarkFrames, animationTime))
+                    {
+                        (void)animation->Apply(animationTime);
+                        activeCamera = m_Scene->GetBenchmarkCamera();
+                    }
+
+                    convergenceActions = m_SweepNoiseMeasurement->BeginFrame(m_ui);
+                    if (convergenceActions.storeReference)
+                        m_ui.storeReferenceImage = true;
                 }
+                else
+                    FinishBenchmark();
             }
         }
 
         bool exposureResetRequired = false;
 
-        if (m_ui.enableFpsLimit && GetFrameIndex() > 0)
+        if (m_ui.enableFpsLimit && GetCurrentFrameIndex() > 0)
         {
             uint64_t expectedFrametime = 1000000 / m_ui.fpsLimit;
 
@@ -974,12 +1749,9 @@ public:
             m_ui.resetISContext = false;
         }
 
-        if (m_ui.environmentMapDirty == 2)
-        {
-            LoadEnvironmentMap();
-        }
+        UpdateEnvironmentMap();
 
-        m_Scene->RefreshSceneGraph(GetFrameIndex());
+        m_Scene->RefreshSceneGraph(GetCurrentFrameIndex());
 
         const auto& fbinfo = framebuffer->getFramebufferInfo();
         uint32_t renderWidth = fbinfo.width;
@@ -1005,17 +1777,27 @@ public:
         m_PostprocessGBufferPass->NextFrame();
         m_LightingPasses->NextFrame();
         m_ConfidencePass->NextFrame();
+        m_SampleBudgetPass->NextFrame();
+        m_TileCompactionPass->NextFrame();
         m_CompositingPass->NextFrame();
         m_VisualizationPass->NextFrame();
         m_RenderTargets->NextFrame();
         m_GlassPass->NextFrame();
         m_Scene->NextFrame();
         m_DebugVizPasses->NextFrame();
+        for (AdditionalView& view : m_AdditionalViews)
+        {
+            view.gbufferPass->NextFrame();
+            view.postprocessGBufferPass->NextFrame();
+            view.lightingPasses->NextFrame();
+            view.compositingPass->NextFrame();
+            view.renderTargets->NextFrame();
+        }
         
         // Advance the TAA jitter offset at half frame rate if accumulation is used with
         // checkerboard rendering. Otherwise, the jitter pattern resonates with the checkerboard,
         // and stipple patterns appear in the accumulated results.
-        if (!((m_ui.aaMode == AntiAliasingMode::Accumulation) && (m_isContext->getReSTIRDIContext().getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off) && (GetFrameIndex() & 1)))
+        if (!((m_ui.aaMode == AntiAliasingMode::Accumulation) && (m_isContext->getReSTIRDIContext().getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off) && (GetCurrentFrameIndex() & 1)))
         {
             m_TemporalAntiAliasingPass->AdvanceFrame();
         }
@@ -1038,7 +1820,37 @@ public:
 
         float accumulationWeight = 1.f / (float)m_ui.numAccumulatedFrames;
 
+        // Start the accumulation with the first benchmark frame, not with the frame before it
+        if (resolvedBenchmarkFrame == 0)
+            m_Profiler->ResetAccumulation();
+
         m_Profiler->ResolvePreviousFrame();
+
+        UpdateDynamicResolution();
+
+        if (resolvedBenchmarkFrame.has_value() && m_Profiler->IsEnabled())
+        {
+            std::vector<double> sectionTimes;
+            for (uint32_t section = 0; section < ProfilerSection::MaterialReadback; section++)
+                sectionTimes.push_back(m_Profiler->GetLatestTimer(ProfilerSection::Enum(section)));
+            m_BenchmarkStatistics->AddFrame(sectionTimes);
+        }
+
+        if (m_ConvergenceMeasurement)
+        {
+            // The error readback has the same latency as the timer queries, so both refer to the same frame.
+            uint32_t sampleIndex = 0;
+            double mse = 0.0, relMse = 0.0;
+            if (m_ConvergenceErrorPass->ResolvePreviousFrame(sampleIndex, mse, relMse))
+                m_ConvergenceMeasurement->AddSample(sampleIndex, m_Profiler->GetLatestTimer(ProfilerSection::Frame), mse, relMse);
+        }
+        else if (m_SweepNoiseMeasurement)
+        {
+            uint32_t sampleIndex = 0;
+            double mse = 0.0, relMse = 0.0;
+            if (m_ConvergenceErrorPass->ResolvePreviousFrame(sampleIndex, mse, relMse))
+                m_SweepNoiseMeasurement->AddSample(sampleIndex, mse, relMse);
+        }
         
         int materialIndex = m_Profiler->GetMaterialReadback();
         if (materialIndex >= 0)
@@ -1053,7 +1865,7 @@ public:
             }
         }
         
-        if (m_ui.environmentMapIndex >= 0)
+        if (m_ActiveEnvironmentMapIndex >= 0)
         {
             if (m_EnvironmentMap)
             {
@@ -1069,7 +1881,7 @@ public:
             }
             m_EnvironmentLight->radianceScale = ::exp2f(m_ui.environmentIntensityBias);
             m_EnvironmentLight->rotation = m_ui.environmentRotation / 360.f;  //  +/- 0.5
-            m_SunLight->irradiance = (m_ui.environmentMapIndex > 0) ? 0.f : 1.f;
+            m_SunLight->irradiance = (m_ActiveEnvironmentMapIndex > 0) ? 0.f : 1.f;
         }
         else
         {
@@ -1089,54 +1901,94 @@ public:
         uint32_t denoiserMode = DENOISER_MODE_OFF;
 #endif
 
+        // The frame is recorded into four command lists that are submitted in order: the setup (scene and
+        // environment map updates), the G-buffer fill, the light preparation and presampling, and the lighting
+        // and post-processing. The G-buffer command list can be recorded on a worker thread in parallel with
+        // the last two, which the main thread records because the lighting depends on the light preparation.
+        using clock = std::chrono::steady_clock;
+        const auto recordingStartTime = clock::now();
+        auto elapsedTime = [](clock::time_point startTime)
+        {
+            return std::chrono::duration<double, std::milli>(clock::now() - startTime).count();
+        };
+
         m_CommandList->open();
 
         m_Profiler->BeginFrame(m_CommandList);
 
         AssignIesProfiles(m_CommandList);
-        m_Scene->RefreshBuffers(m_CommandList, GetFrameIndex());
+        m_Scene->RefreshBuffers(m_CommandList, GetCurrentFrameIndex());
         m_RtxdiResources->InitializeNeighborOffsets(m_CommandList, m_isContext->getNeighborOffsetCount());
 
         if (m_FramesSinceAnimation < 2)
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::TlasUpdate);
 
-            m_Scene->UpdateSkinnedMeshBLASes(m_CommandList, GetFrameIndex());
+            m_Scene->UpdateSkinnedMeshBLASes(m_CommandList, GetCurrentFrameIndex());
             m_Scene->BuildTopLevelAccelStruct(m_CommandList);
         }
         m_CommandList->compactBottomLevelAccelStructs();
 
-        if (m_ui.environmentMapDirty)
+        m_ui.proceduralSkyRowsRendered = 0;
+
+        // The procedural sky is checked for changes every frame, so the section shows the average cost of keeping it up to date.
+        if (m_ui.environmentMapDirty || m_ActiveEnvironmentMapIndex == 0)
         {
             ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::EnvironmentMap);
 
-            if (m_ui.environmentMapIndex == 0)
+            if (m_ActiveEnvironmentMapIndex == 0)
             {
+                // A sky that is being updated progressively keeps the previous PDF until all rows are done.
+                // That's still unbiased because the sampling and the PDF evaluation use the same PDF texture.
                 donut::render::SkyParameters params;
-                m_RenderEnvironmentMapPass->Render(m_CommandList, *m_SunLight, params);
+                const uint32_t progressiveFrames = m_ui.proceduralSkyProgressive ? uint32_t(m_ui.proceduralSkyProgressiveFrames) : 1;
+                if (m_RenderEnvironmentMapPass->Update(m_CommandList, *m_SunLight, params, progressiveFrames))
+                    m_ui.environmentMapDirty = 1;
+
+                m_ui.proceduralSkyRowsRendered = m_RenderEnvironmentMapPass->GetLastRenderedRows();
             }
-            
-            m_EnvironmentMapPdfMipmapPass->Process(m_CommandList);
 
-            m_ui.environmentMapDirty = 0;
-        }
+            if (m_ui.environmentMapDirty)
+            {
+                if (m_ActiveEnvironmentMapIndex > 0 && m_EnvironmentPdfMips && !m_args.verifyEnvironmentPdf)
+                {
+                    UploadEnvironmentPdf(m_CommandList, m_RtxdiResources->EnvironmentPdfTexture, *m_EnvironmentPdfMips);
+                }
+                else
+                {
+                    m_EnvironmentMapPdfMipmapPass->Process(m_CommandList);
 
-        nvrhi::utils::ClearColorAttachment(m_CommandList, framebuffer, 0, nvrhi::Color(0.f));
+                    // Compare the GPU result with the CPU build once this frame is submitted
+                    m_VerifyEnvironmentPdfPending = m_args.verifyEnvironmentPdf && m_ActiveEnvironmentMapIndex > 0 && m_EnvironmentPdfMips;
+                }
 
-        {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::GBufferFill);
+                if (m_RtxdiResources->GetEnvironmentAliasTableSize() > 0)
+                {
+                    m_CommandList->writeBuffer(m_RtxdiResources->EnvironmentAliasTableBuffer, m_EnvironmentAliasTable->entries.data(),
+                        m_EnvironmentAliasTable->entries.size() * sizeof(EnvironmentAliasTable::Entry));
+                }
 
-            GBufferSettings gbufferSettings = m_ui.gbufferSettings;
-            float upscalingLodBias = ::log2f(m_View.GetViewport().width() / m_UpscaledView.GetViewport().width());
-            gbufferSettings.textureLodBias += upscalingLodBias;
+                m_ui.environmentMapDirty = 0;
+            }
+        }
 
-            if (m_ui.rasterizeGBuffer)
-                m_RasterizedGBufferPass->Render(m_CommandList, m_View, m_ViewPrevious, *m_RenderTargets, m_ui.gbufferSettings);
-            else
-                m_GBufferPass->Render(m_CommandList, m_View, m_ViewPrevious, m_ui.gbufferSettings);
+        m_CommandList->close();
+        m_Profiler->SetRecordingTime(ProfilerCommandList::Setup, elapsedTime(recordingStartTime));
 
-            m_PostprocessGBufferPass->Render(m_CommandList, m_View);
-        }
+        if (m_ui.parallelRecording)
+            m_RecordingThreads->Run([this, framebuffer]() { RecordGBufferFill(m_GBufferCommandList, framebuffer); });
+        else
+            RecordGBufferFill(m_GBufferCommandList, framebuffer);
+
+        // The light preparation and presampling passes don't depend on the G-buffer. With async compute, they run
+        // on the compute queue while the graphics queue fills the G-buffer.
+        const bool asyncCompute = m_ui.asyncCompute && m_ComputeCommandList;
+        const auto lightPreparationStartTime = clock::now();
+
+        nvrhi::ICommandList* lightPreparationCommandList = asyncCompute ? m_ComputeCommandList : m_LightPreparationCommandList;
+        lightPreparationCommandList->open();
+        if (asyncCompute)
+            m_Profiler->BeginSection(lightPreparationCommandList, ProfilerSection::AsyncCompute);
 
         // The light indexing members of frameParameters are written by PrepareLightsPass below
         rtxdi::ReSTIRDIContext& restirDIContext = m_isContext->getReSTIRDIContext();
@@ -1144,10 +1996,10 @@ public:
         m_isContext->getReSTIRGIContext().setFrameIndex(effectiveFrameIndex);
 
         {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::MeshProcessing);
+            ProfilerScope scope(*m_Profiler, lightPreparationCommandList, ProfilerSection::MeshProcessing);
             
             RTXDI_LightBufferParameters lightBufferParams = m_PrepareLightsPass->Process(
-                m_CommandList,
+                lightPreparationCommandList,
                 restirDIContext,
                 m_Scene->GetSceneGraph()->GetLights(),
                 m_EnvironmentMapPdfMipmapPass != nullptr && m_ui.environmentMapImportanceSampling);
@@ -1161,9 +2013,9 @@ public:
 
         if (IsLocalLightPowerRISEnabled())
         {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::LocalLightPdfMap);
+            ProfilerScope scope(*m_Profiler, lightPreparationCommandList, ProfilerSection::LocalLightPdfMap);
             
-            m_LocalLightPdfMipmapPass->Process(m_CommandList);
+            m_LocalLightPdfMipmapPass->Process(lightPreparationCommandList);
         }
 
 
@@ -1193,6 +2045,9 @@ public:
 #endif
         if (lightingSettings.denoiserMode == DENOISER_MODE_OFF)
             lightingSettings.enableGradients = false;
+        lightingSettings.environmentAliasTableInvTotalWeight = (m_RtxdiResources->GetEnvironmentAliasTableSize() > 0)
+            ? float(1.0 / m_EnvironmentAliasTable->totalWeight)
+            : 0.f;
 
         const bool checkerboard = restirDIContext.getStaticParameters().CheckerboardSamplingMode != rtxdi::CheckerboardMode::Off;
 
@@ -1206,6 +2061,14 @@ public:
         restirDIShadingParams.enableDenoiserInputPacking = !enableIndirect;
         m_isContext->getReSTIRDIContext().setShadingParameters(restirDIShadingParams);
 
+        // The constants are written once for all the lighting passes, so they include the BRDF pass settings
+        lightingSettings.enableBrdfIndirect = enableIndirect;
+        lightingSettings.enableBrdfAdditiveBlend = enableDirectReStirPass;
+        lightingSettings.brdfptParams.enableIndirectEmissiveSurfaces = m_ui.directLightingMode == DirectLightingMode::Brdf;
+        lightingSettings.brdfptParams.enableReSTIRGI = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
+        const bool enableAccumulation = m_ui.aaMode == AntiAliasingMode::Accumulation;
+        const bool enableLightSampling = enableDirectReStirPass || enableIndirect;
+
         if (!enableDirectReStirPass)
         {
             // Secondary resampling can only be done as a post-process of ReSTIR direct lighting
@@ -1215,100 +2078,150 @@ public:
             lightingSettings.enableGradients = false;
         }
 
-        if (enableDirectReStirPass || enableIndirect)
+        // The sample budget is derived from the confidence, which needs the gradients
+        lightingSettings.enableAdaptiveSampleBudget &= lightingSettings.enableGradients;
+
+        // Only the compute versions of the lighting passes can be dispatched over the tile list
+        lightingSettings.enableTileCompaction &= m_ui.useRayQuery;
+
+        if (enableLightSampling)
+        {
+            m_LightingPasses->PrepareForLightSampling(lightPreparationCommandList,
+                *m_isContext,
+                m_View, m_ViewPrevious,
+                lightingSettings,
+                m_ui.gbufferSettings,
+                *m_EnvironmentLight,
+                enableAccumulation);
+        }
+
+        if (asyncCompute)
+            m_Profiler->EndSection(lightPreparationCommandList, ProfilerSection::AsyncCompute);
+        lightPreparationCommandList->close();
+        m_Profiler->SetRecordingTime(ProfilerCommandList::LightPreparation, elapsedTime(lightPreparationStartTime));
+
+        const auto lightingStartTime = clock::now();
+        nvrhi::ICommandList* commandList = m_LightingCommandList;
+        commandList->open();
+
+        // The main view cost is measured directly for the view cost split, see Profiler::GetViewCosts
+        const bool measureMainView = !m_AdditionalViews.empty();
+        if (measureMainView)
+            m_Profiler->BeginSection(commandList, ProfilerSection::MainView);
+
+        // PrepareForLightSampling wrote the constants on the light preparation command list, which runs first.
+        // They still need writing when only the BRDF rays are traced.
+        if (!enableLightSampling && enableBrdfAndIndirectPass)
         {
-            m_LightingPasses->PrepareForLightSampling(m_CommandList,
+            m_LightingPasses->WriteResamplingConstants(commandList,
                 *m_isContext,
                 m_View, m_ViewPrevious,
                 lightingSettings,
-                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation);
+                m_ui.gbufferSettings,
+                *m_EnvironmentLight,
+                enableAccumulation);
+        }
+
+        if (lightingSettings.enableTileCompaction && (enableDirectReStirPass || enableBrdfAndIndirectPass))
+        {
+            ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::TileCompaction);
+
+            m_TileCompactionPass->Render(commandList, m_View, checkerboard);
         }
 
         if (enableDirectReStirPass)
         {
-            m_CommandList->clearTextureFloat(m_RenderTargets->Gradients, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            commandList->clearTextureFloat(m_RenderTargets->Gradients, nvrhi::AllSubresources, nvrhi::Color(0.f));
 
-            m_LightingPasses->RenderDirectLighting(m_CommandList,
+            if (lightingSettings.enableAdaptiveSampleBudget)
+            {
+                ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::SampleBudget);
+
+                m_SampleBudgetPass->Render(commandList, m_View,
+                    lightingSettings.sampleBudgetConvergedNeed,
+                    lightingSettings.sampleBudgetDisocclusionThreshold);
+            }
+
+            m_LightingPasses->RenderDirectLighting(commandList,
                 restirDIContext,
                 m_View,
                 lightingSettings);
 
-            // Post-process the gradients into a confidence buffer usable by NRD
+            // Compute the gradients and post-process them into a confidence buffer usable by NRD
             if (lightingSettings.enableGradients)
             {
-                m_FilterGradientsPass->Render(m_CommandList, m_View, checkerboard);
-                m_ConfidencePass->Render(m_CommandList, m_View, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
+                ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::Gradients);
+
+                m_LightingPasses->RenderGradients(commandList, restirDIContext, m_View, lightingSettings);
+
+                if (lightingSettings.enableFusedConfidence)
+                {
+                    m_ConfidencePass->RenderFused(commandList, m_View, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard);
+                }
+                else
+                {
+                    m_FilterGradientsPass->Render(commandList, m_View, checkerboard, lightingSettings.enableFusedGradientFilter);
+                    m_ConfidencePass->Render(commandList, m_View, lightingSettings.gradientLogDarknessBias, lightingSettings.gradientSensitivity, lightingSettings.confidenceHistoryLength, checkerboard,
+                        m_FilterGradientsPass->GetOutputBufferIndex());
+                }
             }
         }
 
         if (enableBrdfAndIndirectPass)
         {
-            ReSTIRDI_ShadingParameters restirDIShadingParams = m_isContext->getReSTIRDIContext().getShadingParameters();
-            restirDIShadingParams.enableDenoiserInputPacking = true;
-            m_isContext->getReSTIRDIContext().setShadingParameters(restirDIShadingParams);
-
-            bool enableReSTIRGI = m_ui.indirectLightingMode == IndirectLightingMode::ReStirGI;
-
             m_LightingPasses->RenderBrdfRays(
-                m_CommandList,
+                commandList,
                 *m_isContext,
-                m_View, m_ViewPrevious,
-                lightingSettings,
-                m_ui.gbufferSettings,
-                *m_EnvironmentLight,
-                /* enableIndirect = */ enableIndirect,
-                /* enableAdditiveBlend = */ enableDirectReStirPass,
-                /* enableEmissiveSurfaces = */ m_ui.directLightingMode == DirectLightingMode::Brdf,
-                /* enableAccumulation = */ m_ui.aaMode == AntiAliasingMode::Accumulation,
-                enableReSTIRGI
-                );
+                m_View,
+                lightingSettings);
         }
 
         // If none of the passes above were executed, clear the textures to avoid stale data there.
         // It's a weird mode but it can be selected from the UI.
         if (!enableDirectReStirPass && !enableBrdfAndIndirectPass)
         {
-            m_CommandList->clearTextureFloat(m_RenderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
-            m_CommandList->clearTextureFloat(m_RenderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            commandList->clearTextureFloat(m_RenderTargets->DiffuseLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
+            commandList->clearTextureFloat(m_RenderTargets->SpecularLighting, nvrhi::AllSubresources, nvrhi::Color(0.f));
         }
         
 #if WITH_NRD
         if (m_ui.enableDenoiser)
         {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::Denoising);
-            m_CommandList->beginMarker("Denoising");
+            ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::Denoising);
+            commandList->beginMarker("Denoising");
 
             const void* methodSettings = (m_ui.denoisingMethod == nrd::Denoiser::RELAX_DIFFUSE_SPECULAR)
                 ? (void*)&m_ui.relaxSettings
                 : (void*)&m_ui.reblurSettings;
 
-            m_NRD->RunDenoiserPasses(m_CommandList, *m_RenderTargets, m_View, m_ViewPrevious, GetFrameIndex(), lightingSettings.enableGradients, methodSettings, m_ui.debug);
+            m_NRD->RunDenoiserPasses(commandList, *m_RenderTargets, m_View, m_ViewPrevious, GetCurrentFrameIndex(), lightingSettings.enableGradients, methodSettings, m_ui.debug);
             
-            m_CommandList->endMarker();
+            commandList->endMarker();
         }
 #endif
 
         m_CompositingPass->Render(
-            m_CommandList,
+            commandList,
             m_View,
             m_ViewPrevious,
             denoiserMode,
-            checkerboard,
+            restirDIContext.getRuntimeParams().activeCheckerboardField,
+            enableAccumulation,
             m_ui,
             *m_EnvironmentLight);
 
         if (m_ui.gbufferSettings.enableTransparentGeometry)
         {
-            ProfilerScope scope(*m_Profiler, m_CommandList, ProfilerSection::Glass);
+            ProfilerScope scope(*m_Profiler, commandList, ProfilerSection::Glass);
 
-            m_GlassPass->Render(m_CommandList, m_View,
+            m_GlassPass->Render(commandList, m_View,
                 *m_EnvironmentLight,
                 m_ui.gbufferSettings.normalMapScale,
                 m_ui.gbufferSettings.enableMaterialReadback,
                 m_ui.gbufferSettings.materialReadbackPosition);
         }
 
-        Resolve(m_CommandList, accumulationWeight);
+        Resolve(commandList, accumulationWeight);
 
         if (m_ui.enableBloom)
         {
@@ -1321,7 +2234,7 @@ public:
             nvrhi::ITexture* bloomSource = m_RenderTargets->ResolvedColor;
 #endif
 
-            m_BloomPass->Render(m_CommandList, m_RenderTargets->ResolvedFramebuffer, m_UpscaledView, bloomSource, 32.f, 0.005f);
+            m_BloomPass->Render(commandList, m_RenderTargets->ResolvedFramebuffer, m_UpscaledView, bloomSource, 32.f, 0.005f);
         }
 
         // Reference image functionality:
@@ -1336,11 +2249,15 @@ public:
             // When the user clicks the "Store" button, copy the ResolvedColor texture into ReferenceColor.
             if (m_ui.storeReferenceImage)
             {
-                m_CommandList->copyTexture(m_RenderTargets->ReferenceColor, nvrhi::TextureSlice(), m_RenderTargets->ResolvedColor, nvrhi::TextureSlice());
+                commandList->copyTexture(m_RenderTargets->ReferenceColor, nvrhi::TextureSlice(), m_RenderTargets->ResolvedColor, nvrhi::TextureSlice());
                 m_ui.storeReferenceImage = false;
                 m_ui.referenceImageCaptured = true;
             }
 
+            // Measure before the split display modifies ResolvedColor
+            if (convergenceActions.measure)
+                m_ConvergenceErrorPass->Render(commandList, convergenceActions.sampleIndex);
+
             // When the "Split Display" parameter is nonzero, show a portion of the previously stored
             // ReferenceColor texture on the left side of the screen by copying it into the ResolvedColor texture.
             if (m_ui.referenceImageSplit > 0.f)
@@ -1351,7 +2268,7 @@ public:
                 blitParams.targetFramebuffer = m_RenderTargets->ResolvedFramebuffer->GetFramebuffer(nvrhi::AllSubresources);
                 blitParams.targetBox = blitParams.sourceBox;
                 blitParams.sampler = engine::BlitSampler::Point;
-                m_CommonPasses->BlitTexture(m_CommandList, blitParams, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, blitParams, &m_BindingCache);
             }
         }
 
@@ -1370,11 +2287,11 @@ public:
                 ToneMappingParams.eyeAdaptationSpeedDown = 0.f;
             }
 
-            m_ToneMappingPass->SimpleRender(m_CommandList, ToneMappingParams, m_UpscaledView, m_RenderTargets->ResolvedColor);
+            m_ToneMappingPass->SimpleRender(commandList, ToneMappingParams, m_UpscaledView, m_RenderTargets->ResolvedColor);
         }
         else
         {
-            m_CommonPasses->BlitTexture(m_CommandList, m_RenderTargets->LdrFramebuffer->GetFramebuffer(m_UpscaledView), m_RenderTargets->ResolvedColor, &m_BindingCache);
+            m_CommonPasses->BlitTexture(commandList, m_RenderTargets->LdrFramebuffer->GetFramebuffer(m_UpscaledView), m_RenderTargets->ResolvedColor, &m_BindingCache);
         }
 
         if (m_ui.visualizationMode != VIS_MODE_NONE)
@@ -1409,7 +2326,7 @@ public:
             if (haveSignal)
             {
                 m_VisualizationPass->Render(
-                    m_CommandList,
+                    commandList,
                     m_RenderTargets->LdrFramebuffer->GetFramebuffer(m_UpscaledView),
                     m_View,
                     m_UpscaledView,
@@ -1423,70 +2340,137 @@ public:
         switch (m_ui.debugRenderOutputBuffer)
         {
             case DebugRenderOutput::LDRColor:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->LdrColor, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->LdrColor, &m_BindingCache);
                 break;
             case DebugRenderOutput::Depth:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->Depth, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->Depth, &m_BindingCache);
                 break;
             case GBufferDiffuseAlbedo:
-                m_DebugVizPasses->RenderUnpackedDiffuseAlbeo(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                m_DebugVizPasses->RenderUnpackedDiffuseAlbeo(commandList, m_UpscaledView);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
                 break;
             case GBufferSpecularRough:
-                m_DebugVizPasses->RenderUnpackedSpecularRoughness(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                m_DebugVizPasses->RenderUnpackedSpecularRoughness(commandList, m_UpscaledView);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
                 break;
             case GBufferNormals:
-                m_DebugVizPasses->RenderUnpackedNormals(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                m_DebugVizPasses->RenderUnpackedNormals(commandList, m_UpscaledView);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
                 break;
             case GBufferGeoNormals:
-                m_DebugVizPasses->RenderUnpackedGeoNormals(m_CommandList, m_UpscaledView);
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
+                m_DebugVizPasses->RenderUnpackedGeoNormals(commandList, m_UpscaledView);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DebugColor, &m_BindingCache);
                 break;
             case GBufferEmissive:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->GBufferEmissive, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->GBufferEmissive, &m_BindingCache);
                 break;
             case DiffuseLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DiffuseLighting, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DiffuseLighting, &m_BindingCache);
                 break;
             case SpecularLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->SpecularLighting, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->SpecularLighting, &m_BindingCache);
                 break;
             case DenoisedDiffuseLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DenoisedDiffuseLighting, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DenoisedDiffuseLighting, &m_BindingCache);
                 break;
             case DenoisedSpecularLighting:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DenoisedSpecularLighting, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DenoisedSpecularLighting, &m_BindingCache);
                 break;
             case RestirLuminance:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->RestirLuminance, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->RestirLuminance, &m_BindingCache);
                 break;
             case PrevRestirLuminance:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->PrevRestirLuminance, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->PrevRestirLuminance, &m_BindingCache);
                 break;
             case DiffuseConfidence:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->DiffuseConfidence, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->DiffuseConfidence, &m_BindingCache);
                 break;
             case SpecularConfidence:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->SpecularConfidence, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->SpecularConfidence, &m_BindingCache);
                 break;
             case MotionVectors:
-                m_CommonPasses->BlitTexture(m_CommandList, framebuffer, m_RenderTargets->MotionVectors, &m_BindingCache);
+                m_CommonPasses->BlitTexture(commandList, framebuffer, m_RenderTargets->MotionVectors, &m_BindingCache);
         }
+
+        if (measureMainView)
+            m_Profiler->EndSection(commandList, ProfilerSection::MainView);
+
+        // The additional views use the rasterized G-buffer pass too, wait until the worker is done with it
+        if (!m_AdditionalViews.empty())
+            m_RecordingThreads->Wait();
+
+        RenderAdditionalViews(commandList, framebuffer, lightingSettings, enableDirectReStirPass, enableBrdfAndIndirectPass,
+            restirDIContext.getRuntimeParams().activeCheckerboardField);
         
-        m_Profiler->EndFrame(m_CommandList);
+        if (m_FrameCapture && m_FrameCapture->ShouldCapture(m_RenderFrameIndex))
+        {
+            std::vector<FrameCapture::Source> captureSources = { { "", m_RenderTargets->LdrColor } };
+            if (m_FrameCapture->IsHdrCaptureEnabled())
+            {
+                captureSources.push_back({ "HdrColor", m_RenderTargets->HdrColor });
+                captureSources.push_back({ "DiffuseLighting", m_RenderTargets->DiffuseLighting });
+                captureSources.push_back({ "SpecularLighting", m_RenderTargets->SpecularLighting });
+            }
 
-        m_CommandList->close();
-        GetDevice()->executeCommandList(m_CommandList);
+            m_FrameCapture->Capture(commandList, m_RenderFrameIndex, captureSources);
+        }
+
+        m_Profiler->EndFrame(commandList);
+
+        commandList->close();
+        m_Profiler->SetRecordingTime(ProfilerCommandList::Lighting, elapsedTime(lightingStartTime));
 
-        if (!m_args.saveFrameFileName.empty() && m_RenderFrameIndex == m_args.saveFrameIndex)
+        m_RecordingThreads->Wait();
+        m_Profiler->SetRecordingWallTime(elapsedTime(recordingStartTime));
+
+        if (asyncCompute)
         {
-            bool success = SaveTexture(GetDevice(), m_RenderTargets->LdrColor, m_args.saveFrameFileName.c_str());
+            const uint64_t lightInputsSubmission = GetDevice()->executeCommandList(m_CommandList);
+            GetDevice()->executeCommandList(m_GBufferCommandList);
+
+            GetDevice()->queueWaitForCommandList(nvrhi::CommandQueue::Compute, nvrhi::CommandQueue::Graphics, lightInputsSubmission);
+            const uint64_t lightPreparationSubmission = GetDevice()->executeCommandList(lightPreparationCommandList, nvrhi::CommandQueue::Compute);
 
-            g_ExitCode = success ? 0 : 1;
+            GetDevice()->queueWaitForCommandList(nvrhi::CommandQueue::Graphics, nvrhi::CommandQueue::Compute, lightPreparationSubmission);
+            GetDevice()->executeCommandList(commandList);
+        }
+        else
+        {
+            nvrhi::ICommandList* commandLists[] = { m_CommandList, m_GBufferCommandList, lightPreparationCommandList, commandList };
+            GetDevice()->executeCommandLists(commandLists, std::size(commandLists));
+        }
+
+        if (m_FrameCapture)
+        {
+            m_FrameCapture->ProcessPendingCaptures();
+
+            // When running a benchmark or a convergence measurement, keep going until it ends, the remaining captures are flushed then.
+            if (m_FrameCapture->IsComplete(m_RenderFrameIndex) && !m_args.benchmark && m_args.convergencePresets.empty())
+            {
+                g_ExitCode = m_FrameCapture->Flush() ? 0 : 1;
             
-            glfwSetWindowShouldClose(GetDeviceManager()->GetWindow(), 1);
+                RequestExit();
+            }
+        }
+
+        if (m_VerifyEnvironmentPdfPending)
+        {
+            m_VerifyEnvironmentPdfPending = false;
+
+            if (!VerifyEnvironmentPdf(GetDevice(), m_RtxdiResources->EnvironmentPdfTexture, *m_EnvironmentPdfMips))
+                g_ExitCode = 1;
+        }
+
+        if (m_FilterGradientsPass->IsCapturePending())
+        {
+            if (!m_FilterGradientsPass->VerifyCapture())
+                g_ExitCode = 1;
+        }
+
+        if (m_ConfidencePass->IsCapturePending())
+        {
+            if (!m_ConfidencePass->VerifyCapture())
+                g_ExitCode = 1;
         }
         
         m_ui.gbufferSettings.enableMaterialReadback = false;
@@ -1514,6 +2498,7 @@ int main(int argc, char** argv)
     app::DeviceCreationParameters deviceParams;
     deviceParams.swapChainBufferCount = 3;
     deviceParams.enableRayTracingExtensions = true;
+    deviceParams.enableComputeQueue = true;
     deviceParams.backBufferWidth = 1920;
     deviceParams.backBufferHeight = 1080;
     deviceParams.vsyncEnabled = true;
@@ -1523,11 +2508,19 @@ int main(int argc, char** argv)
     CommandLineArguments args;
 
 #if defined(_WIN32) && !defined(IS_CONSOLE_APP)
-    ProcessCommandLine(__argc, __argv, deviceParams, ui, args);
+    const CommandLineStatus commandLineStatus = ProcessCommandLine(__argc, __argv, deviceParams, ui, args);
 #else
-    ProcessCommandLine(argc, argv, deviceParams, ui, args);
+    const CommandLineStatus commandLineStatus = ProcessCommandLine(argc, argv, deviceParams, ui, args);
 #endif
 
+    if (commandLineStatus == CommandLineStatus::Error)
+        return 1;
+    if (commandLineStatus == CommandLineStatus::Exit)
+        return 0;
+
+    if (args.selfTest)
+        return RunSelfTests();
+
     if (args.verbose)
         log::SetMinSeverity(log::Severity::Debug);
     
@@ -1576,7 +2569,11 @@ int main(int argc, char** argv)
     SetProcessDpiAwarenessContext(DPI_AWARENESS_CONTEXT_PER_MONITOR_AWARE_V2);
 #endif
 
-    if (!deviceManager->CreateWindowDeviceAndSwapChain(deviceParams, windowTitle.c_str()))
+    bool deviceCreated = args.headless
+        ? deviceManager->CreateHeadlessDevice(deviceParams)
+        : deviceManager->CreateWindowDeviceAndSwapChain(deviceParams, windowTitle.c_str());
+
+    if (!deviceCreated)
     {
         log::error("Cannot initialize a %s graphics device.", apiString);
         return 1;
@@ -1616,7 +2613,26 @@ int main(int argc, char** argv)
 
     {
         SceneRenderer sceneRenderer(deviceManager, ui, args);
-        if (sceneRenderer.Init())
+        if (args.headless)
+        {
+            if (sceneRenderer.Init())
+            {
+                // Fail if the scene takes an unreasonable number of frames to load, or the benchmark doesn't finish
+                // when it should, instead of hanging the automation that runs us.
+                constexpr uint32_t maxLoadingFrames = 100000;
+                const uint32_t maxRenderedFrames = (args.benchmarkFrames > 0 && args.benchmarkSweepFileName.empty())
+                    ? args.benchmarkFrames * 2 + args.saveFrameIndex + 100
+                    : 0;
+
+                g_ExitCode = RunHeadlessFrameLoop([&sceneRenderer](uint32_t) { return sceneRenderer.RenderHeadlessFrame(); },
+                    maxRenderedFrames, maxLoadingFrames);
+
+                deviceManager->GetDevice()->waitForIdle();
+            }
+            else
+                g_ExitCode = 1;
+        }
+        else if (sceneRenderer.Init())
         {
             UserInterface userInterface(deviceManager, *sceneRenderer.GetRootFs(), ui);
             userInterface.Init(sceneRenderer.GetShaderFactory());